@@ -83,6 +83,12 @@ static void decoder_catch_signal(int signo) {
 	pipeline_set_end_all();
 }
 
+static volatile sig_atomic_t is_stats_requested;
+
+static void decoder_catch_stats_signal(int signo) {
+	is_stats_requested = 1;
+}
+
 #define DECODER_CONFIG_PATH_DEFAULT	BENCHMARKING_TOP_DIR \
 					"/res/configs/memory_heap_config.ini"
 static void decoder_init_config(config_ini_obj *cfg)
@@ -144,6 +150,10 @@ static void decoder_init_uart(uart_obj *uart)
 		exit(EXIT_FAILURE);
 	}
 
+	if (uart->uart_set_fill_gbl_config(uart)) {
+		exit(EXIT_FAILURE);
+	}
+
 	DEBUG("uart initialized\n");
 }
 
@@ -261,6 +271,11 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	/* kill -USR1 prints the statistics of each processing element */
+	if (signal(SIGUSR1, decoder_catch_stats_signal) == SIG_ERR) {
+		exit(EXIT_FAILURE);
+	}
+
 	decoder_init_config(&cfgini);
 	decoder_init_swd_ctrl(&swd_ctrl);
 	decoder_init_uart(&uart_src);
@@ -292,11 +307,18 @@ int main(int argc, char **argv)
 	pipeline.attach_proc(&pipeline, (processing_obj *) &file_raw_data);
 
 	while (!pipeline.is_stopped(&pipeline)) {
+		if (is_stats_requested) {
+			is_stats_requested = 0;
+			pipeline.print_stats(&pipeline, stderr);
+		}
+
 		if (pipeline.stream_data(&pipeline) < 0) {
 			WARNING("Problem while streaming\n");
 		}
 	}
 
+	pipeline.print_stats(&pipeline, stderr);
+
 	decoder_fini_decoder_swo(&decoder_proc);
 	decoder_fini_uart(&uart_src);
 	decoder_fini_swd_ctrl(&swd_ctrl);
@@ -146,6 +146,10 @@ static void decoder_init_uart(uart_obj *uart)
 		exit(EXIT_FAILURE);
 	}
 
+	if (uart->uart_set_fill_gbl_config(uart)) {
+		exit(EXIT_FAILURE);
+	}
+
 	DEBUG("uart initialized\n");
 }
 
@@ -5,7 +5,10 @@
 
 #include <config.h>
 #include <config_ini.h>
+#include <data_trace.h>
 #include <decoder_swo.h>
+#include <evtcnt.h>
+#include <exc_trace.h>
 #include <form.h>
 #include <file.h>
 #include <perf_ex.h>
@@ -13,6 +16,7 @@
 #include <processing.h>
 #include <uart.h>
 #include <swd_ctrl.h>
+#include <timestamp.h>
 
 #include <stdbool.h>
 #include <signal.h>
@@ -83,6 +87,12 @@ static void decoder_catch_signal(int signo) {
 	pipeline_set_end_all();
 }
 
+static volatile sig_atomic_t is_stats_requested;
+
+static void decoder_catch_stats_signal(int signo) {
+	is_stats_requested = 1;
+}
+
 #define DECODER_CONFIG_PATH_DEFAULT	BENCHMARKING_TOP_DIR \
 					"/res/configs/execution_config.ini"
 
@@ -135,9 +145,58 @@ void decoder_init_uart(uart_obj *uart)
 		exit(EXIT_FAILURE);
 	}
 
+	if (uart->uart_set_fill_gbl_config(uart)) {
+		exit(EXIT_FAILURE);
+	}
+
 	DEBUG("uart initialized\n");
 }
 
+bool decoder_init_file_replay(file_obj *file_r)
+{
+	cfg_param replay_cfg = {
+		.section = CFG_SECTION_REPLAY,
+		.name = CFG_SECTION_REPLAY_PATH,
+		.type = CONFIG_STR,
+	};
+	const char *path;
+	unsigned int baudrate;
+
+	path = CONFIG_HELPER_GET_STR(&replay_cfg);
+	if (!replay_cfg.found) {
+		return false;
+	}
+
+	DEBUG("initializing file replay...\n");
+	DEBUG("\t-capture replayed: %s\n", path);
+
+	memset(file_r, 0, sizeof(*file_r));
+	if (file_init(file_r)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_r->file_set_path(file_r, path, FILE_RDONLY)) {
+		exit(EXIT_FAILURE);
+	}
+
+	replay_cfg.name = CFG_SECTION_REPLAY_BAUDRATE;
+	replay_cfg.type = CONFIG_UNSIGNED_INT;
+	baudrate = CONFIG_HELPER_GET_U32(&replay_cfg);
+	if (replay_cfg.found) {
+		DEBUG("\t-replay baudrate: %u\n", baudrate);
+		if (file_r->file_set_baudrate(file_r, baudrate)) {
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (file_r->file_init(file_r)) {
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("file replay initialized.\n");
+	return true;
+}
+
 void decoder_init_form_cjson(form_obj *form)
 {
 	DEBUG("initializing cjson form...\n");
@@ -149,6 +208,76 @@ void decoder_init_form_cjson(form_obj *form)
 	DEBUG("cjson form initialized...\n");
 }
 
+bool decoder_init_form_pkt_log(form_obj *form, file_obj *file_f)
+{
+	cfg_param file_cfg = {
+		.section = CFG_SECTION_OUTPUT_FILE,
+		.name = CFG_SECTION_OUTPUT_FILE_PKT_LOG,
+		.type = CONFIG_STR,
+	};
+	const char *path;
+
+	path = CONFIG_HELPER_GET_STR(&file_cfg);
+	if (!file_cfg.found) {
+		return false;
+	}
+
+	DEBUG("initializing binary packet log...\n");
+	DEBUG("\t-packet log: %s\n", path);
+
+	memset(form, 0, sizeof(*form));
+	if (form_bin_init(form)) {
+		exit(EXIT_FAILURE);
+	}
+
+	memset(file_f, 0, sizeof(*file_f));
+	if (file_init(file_f)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_f->file_set_path(file_f, path, FILE_WRONLY)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_f->file_init(file_f)) {
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("binary packet log initialized.\n");
+	return true;
+}
+
+bool decoder_init_form_sqlite(form_obj *form)
+{
+	cfg_param file_cfg = {
+		.section = CFG_SECTION_OUTPUT_FILE,
+		.name = CFG_SECTION_OUTPUT_FILE_SQLITE,
+		.type = CONFIG_STR,
+	};
+	const char *path;
+
+	path = CONFIG_HELPER_GET_STR(&file_cfg);
+	if (!file_cfg.found) {
+		return false;
+	}
+
+#ifdef FORM_SQLITE
+	DEBUG("initializing SQLite form...\n");
+	DEBUG("\t-database: %s\n", path);
+
+	memset(form, 0, sizeof(*form));
+	if (form_sqlite_init(form)) {
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("SQLite form initialized.\n");
+	return true;
+#else
+	WARNING("Built without SQLite, %s is not written\n", path);
+	return false;
+#endif
+}
+
 void decoder_init_decoder_swo(decoder_swo_obj *dec)
 {
 	DEBUG("initializing decoder swo...\n");
@@ -161,7 +290,7 @@ void decoder_init_decoder_swo(decoder_swo_obj *dec)
 	DEBUG("decoder swo initialized...\n");
 }
 
-void decoder_init_perf_ex(perf_ex_obj *perf)
+void decoder_init_perf_ex(perf_ex_obj *perf, bool is_timestamp)
 {
 	memset(perf, 0, sizeof(*perf));
 	if (perf_ex_init(perf)) {
@@ -170,6 +299,222 @@ void decoder_init_perf_ex(perf_ex_obj *perf)
 
 	perf->set_tc_gbl_config(perf);
 	perf->set_elf_gbl_config(perf);
+
+	/* Behind the timestamp stage, the windows can be in cycles */
+	perf->set_timestamped(perf, is_timestamp);
+	if (perf->set_window_gbl_config(perf)) {
+		exit(EXIT_FAILURE);
+	}
+}
+
+bool decoder_init_timestamp(timestamp_obj *ts)
+{
+	cfg_param decoder_cfg = {
+		.section = CFG_SECTION_DECODER_SWO,
+		.name = CFG_SECTION_DECODER_SWO_TIMESTAMPS,
+		.type = CONFIG_UNSIGNED_INT,
+	};
+	unsigned int timestamps;
+
+	timestamps = CONFIG_HELPER_GET_U32(&decoder_cfg);
+	if (!decoder_cfg.found || !timestamps) {
+		return false;
+	}
+
+	DEBUG("initializing timestamp...\n");
+
+	memset(ts, 0, sizeof(*ts));
+	if (timestamp_init(ts)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (ts->set_lts_prescaler_gbl_config(ts)) {
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("timestamp initialized.\n");
+	return true;
+}
+
+bool decoder_init_exc_trace(exc_trace_obj *exc, file_obj *file_f,
+			    bool is_timestamp)
+{
+	cfg_param decoder_cfg = {
+		.section = CFG_SECTION_DECODER_SWO,
+		.name = CFG_SECTION_DECODER_SWO_EXCTRC,
+		.type = CONFIG_UNSIGNED_INT,
+	};
+	cfg_param file_cfg = {
+		.section = CFG_SECTION_OUTPUT_FILE,
+		.name = CFG_SECTION_OUTPUT_FILE_EXC,
+		.type = CONFIG_STR,
+	};
+	unsigned int exctrc;
+	const char *path;
+
+	exctrc = CONFIG_HELPER_GET_U32(&decoder_cfg);
+	if (!decoder_cfg.found || !exctrc) {
+		return false;
+	}
+
+	/* The durations are taken from the timestamp stage */
+	if (!is_timestamp) {
+		ERROR("The exception trace needs the timestamps\n");
+		exit(EXIT_FAILURE);
+	}
+
+	path = CONFIG_HELPER_GET_STR(&file_cfg);
+	if (!file_cfg.found) {
+		ERROR("%s/%s is not configured\n", file_cfg.section,
+		      file_cfg.name);
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("initializing exception trace...\n");
+	DEBUG("\t-report: %s\n", path);
+
+	memset(exc, 0, sizeof(*exc));
+	if (exc_trace_init(exc)) {
+		exit(EXIT_FAILURE);
+	}
+
+	memset(file_f, 0, sizeof(*file_f));
+	if (file_init(file_f)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_f->file_set_path(file_f, path, FILE_WRONLY)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_f->file_init(file_f)) {
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("exception trace initialized.\n");
+	return true;
+}
+
+bool decoder_init_evtcnt(evtcnt_obj *evt, file_obj *file_f, bool is_timestamp)
+{
+	cfg_param decoder_cfg = {
+		.section = CFG_SECTION_DECODER_SWO,
+		.name = CFG_SECTION_DECODER_SWO_EVTCNT,
+		.type = CONFIG_UNSIGNED_INT,
+	};
+	cfg_param file_cfg = {
+		.section = CFG_SECTION_OUTPUT_FILE,
+		.name = CFG_SECTION_OUTPUT_FILE_EVTCNT,
+		.type = CONFIG_STR,
+	};
+	unsigned int evtcnt;
+	const char *path;
+
+	evtcnt = CONFIG_HELPER_GET_U32(&decoder_cfg);
+	if (!decoder_cfg.found || !evtcnt) {
+		return false;
+	}
+
+	path = CONFIG_HELPER_GET_STR(&file_cfg);
+	if (!file_cfg.found) {
+		ERROR("%s/%s is not configured\n", file_cfg.section,
+		      file_cfg.name);
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("initializing event counters...\n");
+	DEBUG("\t-report: %s\n", path);
+
+	memset(evt, 0, sizeof(*evt));
+	if (evtcnt_init(evt)) {
+		exit(EXIT_FAILURE);
+	}
+
+	/* Behind the timestamp stage, the counters are split in windows */
+	evt->set_timestamped(evt, is_timestamp);
+	if (evt->set_window_gbl_config(evt)) {
+		exit(EXIT_FAILURE);
+	}
+
+	memset(file_f, 0, sizeof(*file_f));
+	if (file_init(file_f)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_f->file_set_path(file_f, path, FILE_WRONLY)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_f->file_init(file_f)) {
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("event counters initialized.\n");
+	return true;
+}
+
+bool decoder_init_data_trace(data_trace_obj *dt, file_obj *file_f,
+			     bool is_timestamp)
+{
+	cfg_param decoder_cfg = {
+		.section = CFG_SECTION_DECODER_SWO,
+		.name = CFG_SECTION_DECODER_SWO_DATATRACE,
+		.type = CONFIG_UNSIGNED_INT,
+	};
+	cfg_param file_cfg = {
+		.section = CFG_SECTION_OUTPUT_FILE,
+		.name = CFG_SECTION_OUTPUT_FILE_DATA_TRACE,
+		.type = CONFIG_STR,
+	};
+	unsigned int datatrace;
+	const char *path;
+
+	datatrace = CONFIG_HELPER_GET_U32(&decoder_cfg);
+	if (!decoder_cfg.found || !datatrace) {
+		return false;
+	}
+
+	/* The access rates are taken from the timestamp stage */
+	if (!is_timestamp) {
+		ERROR("The data trace needs the timestamps\n");
+		exit(EXIT_FAILURE);
+	}
+
+	path = CONFIG_HELPER_GET_STR(&file_cfg);
+	if (!file_cfg.found) {
+		ERROR("%s/%s is not configured\n", file_cfg.section,
+		      file_cfg.name);
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("initializing data trace...\n");
+	DEBUG("\t-report: %s\n", path);
+
+	memset(dt, 0, sizeof(*dt));
+	if (data_trace_init(dt)) {
+		exit(EXIT_FAILURE);
+	}
+
+	/* The comparators are named after the variables of the elf file */
+	if (dt->set_elf_gbl_config(dt) || dt->set_variables_gbl_config(dt)) {
+		exit(EXIT_FAILURE);
+	}
+
+	memset(file_f, 0, sizeof(*file_f));
+	if (file_init(file_f)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_f->file_set_path(file_f, path, FILE_WRONLY)) {
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_f->file_init(file_f)) {
+		exit(EXIT_FAILURE);
+	}
+
+	DEBUG("data trace initialized.\n");
+	return true;
 }
 
 int decoder_init_file_perf(file_obj *file_f)
@@ -230,6 +575,26 @@ int decoder_init_file_json(file_obj *file_f)
 	return 0;
 }
 
+void decoder_init_pipeline_mode(pipeline_obj *pipeline)
+{
+	cfg_param pipeline_cfg = {
+		.section = CFG_SECTION_PIPELINE,
+		.name = CFG_SECTION_PIPELINE_THREADED,
+		.type = CONFIG_UNSIGNED_INT,
+	};
+	unsigned int threaded;
+
+	threaded = CONFIG_HELPER_GET_U32(&pipeline_cfg);
+	if (!pipeline_cfg.found) {
+		return;
+	}
+
+	DEBUG("\t-threaded pipeline: %u\n", threaded);
+	if (pipeline->set_threaded(pipeline, threaded != 0)) {
+		exit(EXIT_FAILURE);
+	}
+}
+
 void decoder_init_swd_ctrl(swd_ctrl_obj *swd)
 {
 	DEBUG("swd ctrl initializing.\n");
@@ -274,11 +639,51 @@ static void decoder_fini_form_cjson(form_obj *cjson)
 	form_cjson_fini(cjson);
 }
 
+static void decoder_fini_form_pkt_log(form_obj *bin)
+{
+	form_bin_fini(bin);
+}
+
+#ifdef FORM_SQLITE
+static void decoder_fini_form_sqlite(form_obj *sqlite)
+{
+	form_sqlite_fini(sqlite);
+}
+#endif
+
+static void decoder_fini_timestamp(timestamp_obj *ts)
+{
+	timestamp_fini(ts);
+}
+
 static void decoder_fini_file_json(file_obj *file_p)
 {
 	file_p->file_fini(file_p);
 }
 
+static void decoder_fini_file_replay(file_obj *file_p)
+{
+	file_p->file_fini(file_p);
+}
+
+static void decoder_fini_exc_trace(exc_trace_obj *exc, file_obj *file_e)
+{
+	exc_trace_fini(exc);
+	file_e->file_fini(file_e);
+}
+
+static void decoder_fini_evtcnt(evtcnt_obj *evt, file_obj *file_e)
+{
+	evtcnt_fini(evt);
+	file_e->file_fini(file_e);
+}
+
+static void decoder_fini_data_trace(data_trace_obj *dt, file_obj *file_d)
+{
+	data_trace_fini(dt);
+	file_d->file_fini(file_d);
+}
+
 static void decoder_fini_file_perf(file_obj *file_p)
 {
 	file_p->file_fini(file_p);
@@ -294,12 +699,28 @@ int main(int argc, char **argv)
 	config_ini_obj	cfgini;
 	swd_ctrl_obj	swd_ctrl;
 	uart_obj	uart_src;
-	form_obj	cjson_proc;
+	file_obj	file_replay;
+	form_obj	form_proc;
 	perf_ex_obj	perf_proc;
+	timestamp_obj	ts_proc;
+	exc_trace_obj	exc_proc;
+	evtcnt_obj	evt_proc;
+	data_trace_obj	dt_proc;
 	decoder_swo_obj	decoder_proc;
-	file_obj 	file_json;
+	file_obj 	file_form;
 	file_obj 	file_perf;
+	file_obj 	file_exc;
+	file_obj 	file_evt;
+	file_obj 	file_dt;
 	processing_obj *proc;
+	processing_obj *src;
+	bool is_replay;
+	bool is_pkt_log;
+	bool is_sqlite;
+	bool is_timestamp;
+	bool is_exc_trace;
+	bool is_evtcnt;
+	bool is_data_trace;
 
 	pipeline_obj	pipeline;
 
@@ -309,29 +730,78 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	/* kill -USR1 prints the statistics of each processing element */
+	if (signal(SIGUSR1, decoder_catch_stats_signal) == SIG_ERR) {
+		exit(EXIT_FAILURE);
+	}
+
 	decoder_init_config(&cfgini);
-	decoder_init_swd_ctrl(&swd_ctrl);
-	decoder_init_uart(&uart_src);
+	is_replay = decoder_init_file_replay(&file_replay);
+	if (is_replay) {
+		src = (processing_obj *) &file_replay;
+	} else {
+		decoder_init_swd_ctrl(&swd_ctrl);
+		decoder_init_uart(&uart_src);
+		src = (processing_obj *) &uart_src;
+	}
+
 	decoder_init_decoder_swo(&decoder_proc);
-	decoder_init_form_cjson(&cjson_proc);
-	decoder_init_perf_ex(&perf_proc);
-	decoder_init_file_json(&file_json);
+	/* The database is a sink, it has no file after it */
+	is_sqlite = decoder_init_form_sqlite(&form_proc);
+	is_pkt_log = !is_sqlite &&
+		     decoder_init_form_pkt_log(&form_proc, &file_form);
+	if (!is_sqlite && !is_pkt_log) {
+		decoder_init_form_cjson(&form_proc);
+		decoder_init_file_json(&file_form);
+	}
+	is_timestamp = decoder_init_timestamp(&ts_proc);
+	decoder_init_perf_ex(&perf_proc, is_timestamp);
 	decoder_init_file_perf(&file_perf);
+	is_exc_trace = decoder_init_exc_trace(&exc_proc, &file_exc,
+					      is_timestamp);
+	is_evtcnt = decoder_init_evtcnt(&evt_proc, &file_evt, is_timestamp);
+	is_data_trace = decoder_init_data_trace(&dt_proc, &file_dt,
+						is_timestamp);
 
-	proc = (processing_obj *) &uart_src;
-	proc->register_element(proc, (processing_obj *) &decoder_proc);
+	src->register_element(src, (processing_obj *) &decoder_proc);
 
 	proc = (processing_obj *) &decoder_proc;
-	proc->register_element(proc, (processing_obj *) &cjson_proc);
+	proc->register_element(proc, (processing_obj *) &form_proc);
+	if (is_timestamp) {
+		proc->register_element(proc, (processing_obj *) &ts_proc);
+		proc = (processing_obj *) &ts_proc;
+	}
 	proc->register_element(proc, (processing_obj *) &perf_proc);
+	/* Next to perf_ex, on the same packets */
+	if (is_evtcnt) {
+		proc->register_element(proc, (processing_obj *) &evt_proc);
+	}
+	if (is_data_trace) {
+		proc->register_element(proc, (processing_obj *) &dt_proc);
+	}
+	if (is_exc_trace) {
+		proc->register_element(proc, (processing_obj *) &exc_proc);
+		proc = (processing_obj *) &exc_proc;
+		proc->register_element(proc, (processing_obj *) &file_exc);
+	}
+	if (is_data_trace) {
+		proc = (processing_obj *) &dt_proc;
+		proc->register_element(proc, (processing_obj *) &file_dt);
+	}
+	if (is_evtcnt) {
+		proc = (processing_obj *) &evt_proc;
+		proc->register_element(proc, (processing_obj *) &file_evt);
+	}
 
 	proc = (processing_obj *) &perf_proc;
 	proc->register_element(proc, (processing_obj *) &file_perf);
 
-	proc = (processing_obj *) &cjson_proc;
-	proc->register_element(proc, (processing_obj *) &file_json);
+	if (!is_sqlite) {
+		proc = (processing_obj *) &form_proc;
+		proc->register_element(proc, (processing_obj *) &file_form);
+	}
 
-	if (swd_ctrl.start(&swd_ctrl, argv[0])) {
+	if (!is_replay && swd_ctrl.start(&swd_ctrl, argv[0])) {
 		exit(EXIT_FAILURE);
 	}
 
@@ -339,27 +809,85 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	decoder_init_pipeline_mode(&pipeline);
+
 	DEBUG("Attaching elements\n");
-	pipeline.attach_src(&pipeline, (processing_obj *) &uart_src);
+	pipeline.attach_src(&pipeline, src);
 	pipeline.attach_proc(&pipeline, (processing_obj *) &decoder_proc);
-	pipeline.attach_proc(&pipeline, (processing_obj *) &cjson_proc);
+	pipeline.attach_proc(&pipeline, (processing_obj *) &form_proc);
 	pipeline.attach_proc(&pipeline, (processing_obj *) &perf_proc);
 	pipeline.attach_proc(&pipeline, (processing_obj *) &file_perf);
-	pipeline.attach_proc(&pipeline, (processing_obj *) &file_json);
+	if (is_timestamp) {
+		pipeline.attach_proc(&pipeline, (processing_obj *) &ts_proc);
+	}
+	if (is_exc_trace) {
+		pipeline.attach_proc(&pipeline, (processing_obj *) &exc_proc);
+		pipeline.attach_proc(&pipeline, (processing_obj *) &file_exc);
+	}
+	if (is_evtcnt) {
+		pipeline.attach_proc(&pipeline, (processing_obj *) &evt_proc);
+		pipeline.attach_proc(&pipeline, (processing_obj *) &file_evt);
+	}
+	if (is_data_trace) {
+		pipeline.attach_proc(&pipeline, (processing_obj *) &dt_proc);
+		pipeline.attach_proc(&pipeline, (processing_obj *) &file_dt);
+	}
+	if (!is_sqlite) {
+		pipeline.attach_proc(&pipeline, (processing_obj *) &file_form);
+	}
 
 	while (!pipeline.is_stopped(&pipeline)) {
-		if (pipeline.stream_data(&pipeline) < 0) {
+		if (is_stats_requested) {
+			is_stats_requested = 0;
+			pipeline.print_stats(&pipeline, stderr);
+		}
+
+		/* The whole capture was replayed, flush the stages */
+		if (is_replay && file_replay.file_is_eof(&file_replay)) {
+			pipeline_set_end_all();
+		}
+
+		if ((pipeline.stream_data(&pipeline) < 0) &&
+		    !(is_replay && file_replay.file_is_eof(&file_replay))) {
 			WARNING("Problem while streaming\n");
 		}
 	}
 
-	decoder_fini_form_cjson(&cjson_proc);
+	pipeline.print_stats(&pipeline, stderr);
+
+	if (is_sqlite) {
+#ifdef FORM_SQLITE
+		decoder_fini_form_sqlite(&form_proc);
+#endif
+	} else if (is_pkt_log) {
+		decoder_fini_form_pkt_log(&form_proc);
+	} else {
+		decoder_fini_form_cjson(&form_proc);
+	}
 	decoder_fini_decoder_swo(&decoder_proc);
-	decoder_fini_uart(&uart_src);
-	decoder_fini_swd_ctrl(&swd_ctrl);
+	if (is_replay) {
+		decoder_fini_file_replay(&file_replay);
+	} else {
+		decoder_fini_uart(&uart_src);
+		decoder_fini_swd_ctrl(&swd_ctrl);
+	}
 	decoder_fini_perf_ex(&perf_proc);
 	decoder_fini_file_perf(&file_perf);
-	decoder_fini_file_json(&file_json);
+	if (is_timestamp) {
+		decoder_fini_timestamp(&ts_proc);
+	}
+	if (is_exc_trace) {
+		decoder_fini_exc_trace(&exc_proc, &file_exc);
+	}
+	if (is_evtcnt) {
+		decoder_fini_evtcnt(&evt_proc, &file_evt);
+	}
+	if (is_data_trace) {
+		decoder_fini_data_trace(&dt_proc, &file_dt);
+	}
+	if (!is_sqlite) {
+		decoder_fini_file_json(&file_form);
+	}
 	decoder_fini_config(&cfgini);
 
 	DEBUG("Ending gracefully\n");
@@ -0,0 +1,365 @@
+/*****************************************************************
+ * file: pktlog2json.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Offline converter of the binary packet logs written by form_bin to
+ *		the JSON output of form_cjson, as a single document or one
+ *		packet per line. A range of packets can be converted, the
+ *		index records of a complete log are used to seek to the first
+ *		one instead of decoding the whole log.
+ *****************************************************************/
+#include <debug.h>
+#include <pkt_converter.h>
+#include <pkt_log.h>
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define USAGE    \
+	"%s [OPTIONS] LOG\n" \
+	"\n" \
+	"OPTIONS:\n" \
+	"  -o [FILE|-]		where the JSON is written (default -)\n" \
+	"  -f [json|ndjson]	a single JSON document or one packet per\n" \
+	"			line (default json)\n" \
+	"  -s FIRST		first packet converted (default 0)\n" \
+	"  -n COUNT		number of packets converted, 0 for all\n" \
+	"			(default 0)\n"
+
+#define APP_ARGS_OPTIONS		"o:f:s:n:h"
+
+/** Bytes of JSON formatted before being written to the output */
+#define PKTLOG2JSON_CHUNK_SZ		65536U
+/** Most fields of a header */
+#define PKTLOG2JSON_FIELDS_MAX		64U
+/** Storage of the strings of the header */
+#define PKTLOG2JSON_STRS_SZ		8192U
+
+static struct {
+	const char	*input;
+	const char	*output;
+	bool		is_ndjson;
+	uint64_t	first;
+	uint64_t	count;
+} app_cfg = {
+	.output = "-",
+};
+
+static struct {
+	char		buf[PKTLOG2JSON_CHUNK_SZ];
+	size_t		pos;
+	FILE		*out;
+	bool		is_nfirstpkt;
+} conv;
+
+static void app_print_usage(const char *name)
+{
+	fprintf(stdout, USAGE, name);
+}
+
+/**
+ * @brief Write the formatted JSON to the output.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pktlog2json_flush(void)
+{
+	if (conv.pos && (fwrite(conv.buf, 1, conv.pos, conv.out) != conv.pos)) {
+		ERROR("Could not write the output\n");
+		return -1;
+	}
+
+	conv.pos = 0;
+	return 0;
+}
+
+/**
+ * @brief Append a string to the JSON, as is or quoted and escaped. The JSON
+ *		is written to the output when the chunk is full.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pktlog2json_put(const char * const str, bool is_quoted)
+{
+	size_t len = strlen(str);
+
+	for (unsigned int retry = 0; retry < 2; retry++) {
+		if (is_quoted) {
+			if (!pkt_convert_json_str(conv.buf, &conv.pos,
+						  sizeof(conv.buf), str)) {
+				return 0;
+			}
+		} else if (len <= (sizeof(conv.buf) - conv.pos)) {
+			memcpy(&conv.buf[conv.pos], str, len);
+			conv.pos += len;
+			return 0;
+		}
+
+		if (pktlog2json_flush()) {
+			return -1;
+		}
+	}
+
+	ERROR("String too long\n");
+	return -1;
+}
+
+/**
+ * @brief Write the session information, grouped by node as form_cjson does.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pktlog2json_header(const pkt_log_field * const fields,
+			      unsigned int count)
+{
+	const char *sep = app_cfg.is_ndjson ? " " : "\n\t";
+	const char *node = NULL;
+	int rc = pktlog2json_put("{", false);
+
+	for (unsigned int i = 0; (i < count) && !rc; i++) {
+		if (!node || strcmp(fields[i].node, node)) {
+			rc = pktlog2json_put(node ? "}," : "", false) ||
+			     pktlog2json_put(sep, false) ||
+			     pktlog2json_put(fields[i].node, true) ||
+			     pktlog2json_put(": {", false);
+			node = fields[i].node;
+		} else {
+			rc = pktlog2json_put(", ", false);
+		}
+
+		rc = rc || pktlog2json_put(fields[i].name, true) ||
+		     pktlog2json_put(": ", false) ||
+		     pktlog2json_put(fields[i].value, true);
+	}
+
+	if (node) {
+		rc = rc || pktlog2json_put(app_cfg.is_ndjson ? "}" : "},",
+					   false);
+	}
+
+	return rc || pktlog2json_put(app_cfg.is_ndjson ? "}\n" :
+				     "\n\t\"packet\": [\n", false);
+}
+
+/**
+ * @brief Write one packet, preceded by its separator in a JSON document.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pktlog2json_pkt(pkt_to_form * const ptf,
+			   const union libswo_packet * const pkt)
+{
+	const char *sep = app_cfg.is_ndjson ? "" :
+			  (conv.is_nfirstpkt ? ",\n\t\t" : "\t\t");
+	size_t pos, len = sizeof(conv.buf);
+	int rc;
+
+	for (unsigned int retry = 0; retry < 2; retry++) {
+		pos = conv.pos;
+		if (strlen(sep) <= (len - pos)) {
+			memcpy(&conv.buf[pos], sep, strlen(sep));
+			conv.pos += strlen(sep);
+
+			rc = pkt_convert(ptf, pkt, conv.buf, &conv.pos, len);
+			if (rc > 0) {
+				/* No JSON representation */
+				conv.pos = pos;
+				return 0;
+			}
+
+			if (!rc && (!app_cfg.is_ndjson || (conv.pos < len))) {
+				if (app_cfg.is_ndjson) {
+					conv.buf[conv.pos++] = '\n';
+				}
+
+				conv.is_nfirstpkt = true;
+				return 0;
+			}
+		}
+
+		conv.pos = pos;
+		if (pktlog2json_flush()) {
+			return -1;
+		}
+	}
+
+	ERROR("Packet too long\n");
+	return -1;
+}
+
+/**
+ * @brief Find the record to start decoding from with the index records. They
+ *		are only used if the log is complete: it ends with the end
+ *		record.
+ * @param log The log.
+ * @param len Length of the log.
+ * @param start Offset of the first record, moved to the index record
+ *		preceding the packet app_cfg.first.
+ * @param count Set to the number of packets before start.
+ */
+static void pktlog2json_seek(const char * const log, size_t len,
+			     size_t * const start, uint64_t * const count)
+{
+	union libswo_packet pkt;
+	pkt_log_index idx;
+	size_t pos;
+
+	if ((len - *start) < PKT_LOG_INDEX_LEN) {
+		return;
+	}
+
+	pos = len - PKT_LOG_INDEX_LEN;
+	if (pkt_log_read(log, &pos, len, &pkt, &idx) != PKT_LOG_REC_END) {
+		WARNING("The log is not complete, decoding it from the start\n");
+		return;
+	}
+
+	/* Walk the index records backward up to the first packet wanted */
+	while (idx.prev && (idx.count > app_cfg.first)) {
+		pos = idx.prev;
+		if ((idx.prev < *start) || (idx.prev >= len) ||
+		    (pkt_log_read(log, &pos, len, &pkt, &idx) !=
+		     PKT_LOG_REC_INDEX)) {
+			WARNING("Invalid index, decoding the log from the "
+				"start\n");
+			return;
+		}
+	}
+
+	if (idx.count <= app_cfg.first) {
+		*start = pos;
+		*count = idx.count;
+	}
+}
+
+/**
+ * @brief Convert the records of the log to JSON.
+ * @param log The log.
+ * @param len Length of the log.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pktlog2json_convert(const char * const log, size_t len)
+{
+	pkt_to_form ptf = {
+		.fmt = PKT_CONVERTER_CJSON,
+	};
+	pkt_log_field fields[PKTLOG2JSON_FIELDS_MAX];
+	static char strs[PKTLOG2JSON_STRS_SZ];
+	unsigned int nfields = PKTLOG2JSON_FIELDS_MAX;
+	union libswo_packet pkt;
+	pkt_log_index idx;
+	uint64_t count = 0;
+	size_t pos = 0;
+	int type;
+
+	if (pkt_log_read_header(log, &pos, len, fields, &nfields, strs,
+				sizeof(strs)) ||
+	    pktlog2json_header(fields, nfields)) {
+		return -1;
+	}
+
+	pktlog2json_seek(log, len, &pos, &count);
+
+	while (pos < len) {
+		if ((type = pkt_log_read(log, &pos, len, &pkt, &idx)) < 0) {
+			WARNING("Truncated log after %llu packets\n",
+				(unsigned long long) count);
+			break;
+		}
+
+		if ((type == PKT_LOG_REC_INDEX) || (type == PKT_LOG_REC_END)) {
+			continue;
+		}
+
+		if (app_cfg.count &&
+		    (count >= (app_cfg.first + app_cfg.count))) {
+			break;
+		}
+
+		if ((count++ >= app_cfg.first) &&
+		    pktlog2json_pkt(&ptf, &pkt)) {
+			return -1;
+		}
+	}
+
+	if (!app_cfg.is_ndjson && pktlog2json_put("\n\t]\n}\n", false)) {
+		return -1;
+	}
+
+	return pktlog2json_flush();
+}
+
+int main(int argc, char **argv)
+{
+	int option_index;
+	struct stat st;
+	char *log;
+	int fd, rc;
+
+	while ((option_index = getopt(argc, argv, APP_ARGS_OPTIONS)) != -1) {
+		switch (option_index) {
+		case 'o':
+			app_cfg.output = optarg;
+			break;
+		case 'f':
+			app_cfg.is_ndjson = !strcmp(optarg, "ndjson");
+			if (!app_cfg.is_ndjson && strcmp(optarg, "json")) {
+				app_print_usage(argv[0]);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 's':
+			app_cfg.first = strtoull(optarg, NULL, 0);
+			break;
+		case 'n':
+			app_cfg.count = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			app_print_usage(argv[0]);
+			exit(EXIT_FAILURE);
+			break;
+		}
+	}
+
+	if (optind != (argc - 1)) {
+		app_print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	app_cfg.input = argv[optind];
+
+	if ((fd = open(app_cfg.input, O_RDONLY)) < 0) {
+		perror(app_cfg.input);
+		exit(EXIT_FAILURE);
+	}
+
+	if (fstat(fd, &st) || !st.st_size) {
+		ERROR("Empty log %s\n", app_cfg.input);
+		exit(EXIT_FAILURE);
+	}
+
+	log = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (log == MAP_FAILED) {
+		perror("mmap");
+		exit(EXIT_FAILURE);
+	}
+	madvise(log, st.st_size, MADV_SEQUENTIAL);
+
+	if (!strcmp(app_cfg.output, "-")) {
+		conv.out = stdout;
+	} else if (!(conv.out = fopen(app_cfg.output, "w"))) {
+		perror(app_cfg.output);
+		exit(EXIT_FAILURE);
+	}
+
+	rc = pktlog2json_convert(log, st.st_size);
+
+	if (conv.out != stdout) {
+		fclose(conv.out);
+	}
+	munmap(log, st.st_size);
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
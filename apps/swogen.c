@@ -0,0 +1,583 @@
+/*****************************************************************
+ * file: swogen.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Synthetic SWO generator. It encodes ITM/DWT packets (periodic PC
+ *		samples, data trace PC values, exception trace, event
+ *		counters, local/global timestamps and instrumentation
+ *		packets) as a target would send them on the SWO pin, at a
+ *		configurable mix and rate. The stream is written to a file, a
+ *		pipe or a pseudo-terminal so the uart_obj and decoder_swo
+ *		paths can be loaded without a board.
+ *****************************************************************/
+#define _GNU_SOURCE
+
+#include <debug.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define USAGE    \
+	"%s [OPTIONS]\n" \
+	"\n" \
+	"OPTIONS:\n" \
+	"  -o [FILE|pty|-]	where the SWO stream is written, pty creates\n" \
+	"			a pseudo-terminal and prints its path (default -)\n" \
+	"  -n COUNT		number of packets, 0 for no limit (default 0)\n" \
+	"  -b BAUDRATE		SWO baudrate the stream is paced at, 0 to write\n" \
+	"			as fast as possible (default 0)\n" \
+	"  -x FACTOR		multiply the paced rate, e.g. 10 or 100\n" \
+	"  -m MIX		packet mix as name:weight,... with the names\n" \
+	"			pc, sleep, pcv, exc, evt, itm, lts, gts\n" \
+	"			(default " SWOGEN_MIX_DEFAULT ")\n" \
+	"  -a ADDR		lowest sampled PC (default 0x08000000)\n" \
+	"  -l LENGTH		size of the sampled PC range (default 0x10000)\n" \
+	"  -s SEED		seed of the generator (default 1)\n"
+
+#define APP_ARGS_OPTIONS		"o:n:b:x:m:a:l:s:h"
+
+#define SWOGEN_MIX_DEFAULT		"pc:70,sleep:5,exc:10,lts:10,itm:5"
+
+/** Bytes generated before being written to the output */
+#define SWOGEN_CHUNK_SZ			4096U
+/** Longest packet encoded: header and 4 bytes of payload */
+#define SWOGEN_PACKET_SZ_MAX		8U
+/** A synchronization packet is sent every SWOGEN_SYNC_PERIOD packets */
+#define SWOGEN_SYNC_PERIOD		4096U
+/** Maximal nesting of the generated exceptions */
+#define SWOGEN_EXC_DEPTH_MAX		8U
+/** Bits sent per byte on the SWO UART (8N1) */
+#define SWOGEN_BITS_PER_BYTE		10ULL
+
+/* Packet headers, see ARMv7-M ARM appendix D4 */
+#define SWO_HDR_OVERFLOW		0x70
+#define SWO_HDR_LTS1			0xc0
+#define SWO_HDR_GTS1			0x94
+#define SWO_HDR_GTS2			0xb4
+#define SWO_HDR_HW			0x04
+#define SWO_HW_ID_EVTCNT		0
+#define SWO_HW_ID_EXCTRC		1
+#define SWO_HW_ID_PC_SAMPLE		2
+#define SWO_HW_ID_PC_VALUE		8
+#define SWO_EXC_ENTER			1
+#define SWO_EXC_EXIT			2
+#define SWO_EXC_RETURN			3
+
+typedef enum {
+	SWOGEN_PC,
+	SWOGEN_SLEEP,
+	SWOGEN_PCV,
+	SWOGEN_EXC,
+	SWOGEN_EVT,
+	SWOGEN_ITM,
+	SWOGEN_LTS,
+	SWOGEN_GTS,
+	SWOGEN_TYPE_COUNT,
+} swogen_type;
+
+static const char * const swogen_type_name[SWOGEN_TYPE_COUNT] = {
+	[SWOGEN_PC]	= "pc",
+	[SWOGEN_SLEEP]	= "sleep",
+	[SWOGEN_PCV]	= "pcv",
+	[SWOGEN_EXC]	= "exc",
+	[SWOGEN_EVT]	= "evt",
+	[SWOGEN_ITM]	= "itm",
+	[SWOGEN_LTS]	= "lts",
+	[SWOGEN_GTS]	= "gts",
+};
+
+static struct {
+	const char	*output;
+	unsigned long	count;
+	unsigned int	baudrate;
+	unsigned int	factor;
+	unsigned int	pc_base;
+	unsigned int	pc_len;
+	uint64_t	seed;
+	unsigned int	weight[SWOGEN_TYPE_COUNT];
+	unsigned int	weight_sum;
+} app_cfg = {
+	.output = "-",
+	.factor = 1,
+	.pc_base = 0x08000000,
+	.pc_len = 0x10000,
+	.seed = 1,
+};
+
+static struct {
+	uint64_t	rand;
+	uint64_t	timestamp;
+	unsigned int	exc_stack[SWOGEN_EXC_DEPTH_MAX];
+	unsigned int	exc_depth;
+	unsigned long	packets[SWOGEN_TYPE_COUNT];
+	unsigned long	tot_packets;
+	unsigned long long tot_bytes;
+} gen;
+
+static volatile sig_atomic_t is_running = 1;
+
+static void app_print_usage(const char *name)
+{
+	fprintf(stdout, USAGE, name);
+}
+
+static void swogen_catch_signal(int signo)
+{
+	is_running = 0;
+}
+
+/**
+ * @brief xorshift64* generator, the stream only has to be reproducible.
+ */
+static uint32_t swogen_rand(void)
+{
+	gen.rand ^= gen.rand >> 12;
+	gen.rand ^= gen.rand << 25;
+	gen.rand ^= gen.rand >> 27;
+
+	return (gen.rand * 0x2545f4914f6cdd1dULL) >> 32;
+}
+
+/**
+ * @brief Parse the packet mix, e.g. "pc:70,exc:10,itm:20".
+ * @return 0 upon success, -1 otherwise.
+ */
+static int swogen_parse_mix(const char *mix)
+{
+	char buf[256];
+	char *tok, *save, *sep;
+	unsigned int i;
+
+	if (strlen(mix) >= sizeof(buf)) {
+		ERROR("Mix too long\n");
+		return -1;
+	}
+
+	strcpy(buf, mix);
+	memset(app_cfg.weight, 0, sizeof(app_cfg.weight));
+	app_cfg.weight_sum = 0;
+
+	for (tok = strtok_r(buf, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		if (!(sep = strchr(tok, ':'))) {
+			ERROR("Missing weight in %s\n", tok);
+			return -1;
+		}
+		*sep++ = '\0';
+
+		for (i = 0; i < SWOGEN_TYPE_COUNT; i++) {
+			if (!strcmp(tok, swogen_type_name[i]))
+				break;
+		}
+
+		if (i == SWOGEN_TYPE_COUNT) {
+			ERROR("Unknown packet type %s\n", tok);
+			return -1;
+		}
+
+		app_cfg.weight[i] = strtoul(sep, NULL, 0);
+		app_cfg.weight_sum += app_cfg.weight[i];
+	}
+
+	if (!app_cfg.weight_sum) {
+		ERROR("The mix does not contain any packet\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static swogen_type swogen_pick_type(void)
+{
+	unsigned int r = swogen_rand() % app_cfg.weight_sum;
+	unsigned int i;
+
+	for (i = 0; r >= app_cfg.weight[i]; i++) {
+		r -= app_cfg.weight[i];
+	}
+
+	return (swogen_type) i;
+}
+
+/**
+ * @brief Encode a source packet: header followed by 1, 2 or 4 bytes of
+ *		payload in little endian.
+ * @return Number of bytes encoded.
+ */
+static size_t swogen_put_source(uint8_t *buf, uint8_t hdr, uint32_t payload,
+				unsigned int len)
+{
+	unsigned int i;
+
+	buf[0] = hdr | ((len == 4) ? 3 : len);
+	for (i = 0; i < len; i++) {
+		buf[1 + i] = (payload >> (8 * i)) & 0xff;
+	}
+
+	return 1 + len;
+}
+
+static size_t swogen_put_hw(uint8_t *buf, unsigned int id, uint32_t payload,
+			    unsigned int len)
+{
+	return swogen_put_source(buf, (id << 3) | SWO_HDR_HW, payload, len);
+}
+
+/**
+ * @brief Encode a synchronization packet: 47 zero bits followed by a one.
+ */
+static size_t swogen_put_sync(uint8_t *buf)
+{
+	memset(buf, 0, 5);
+	buf[5] = 0x80;
+
+	return 6;
+}
+
+/**
+ * @brief Encode a local timestamp, format 2 for small deltas, format 1
+ *		with up to 4 continuation bytes otherwise.
+ */
+static size_t swogen_put_lts(uint8_t *buf, uint32_t delta)
+{
+	size_t n = 1;
+
+	delta &= 0x0fffffff;
+	if (delta && (delta < 7)) {
+		buf[0] = delta << 4;
+		return 1;
+	}
+
+	buf[0] = SWO_HDR_LTS1;
+	do {
+		buf[n] = delta & 0x7f;
+		delta >>= 7;
+		if (delta)
+			buf[n] |= 0x80;
+		n++;
+	} while (delta);
+
+	return n;
+}
+
+/**
+ * @brief Encode the global timestamp: GTS1 holds bits [25:0], GTS2 the bits
+ *		[47:26] (48 bits format).
+ */
+static size_t swogen_put_gts(uint8_t *buf, uint64_t ts)
+{
+	size_t n = 0;
+	unsigned int i;
+
+	buf[n++] = SWO_HDR_GTS1;
+	for (i = 0; i < 4; i++) {
+		buf[n++] = ((ts >> (7 * i)) & 0x7f) | ((i < 3) ? 0x80 : 0);
+	}
+	buf[n - 1] &= 0x1f;
+
+	buf[n++] = SWO_HDR_GTS2;
+	for (i = 0; i < 4; i++) {
+		buf[n++] = ((ts >> (26 + 7 * i)) & 0x7f) |
+			   ((i < 3) ? 0x80 : 0);
+	}
+	buf[n - 1] &= 0x01;
+
+	return n;
+}
+
+/**
+ * @brief PCs are skewed toward the bottom of the range so the histogram of
+ *		the samples has hot spots, as a real profile would.
+ */
+static uint32_t swogen_pc(void)
+{
+	uint64_t r = swogen_rand() % app_cfg.pc_len;
+
+	r = (r * (swogen_rand() % app_cfg.pc_len)) / app_cfg.pc_len;
+
+	return (app_cfg.pc_base + r) & ~1U;
+}
+
+/**
+ * @brief Exception trace, exceptions are entered, nested, exited and
+ *		returned from like on a target.
+ */
+static size_t swogen_put_exc(uint8_t *buf)
+{
+	unsigned int exc, fn;
+	size_t n = 0;
+
+	if (!gen.exc_depth ||
+	    ((gen.exc_depth < SWOGEN_EXC_DEPTH_MAX) && (swogen_rand() & 1))) {
+		/* SysTick, PendSV or an external interrupt */
+		exc = 11 + (swogen_rand() % 48);
+		gen.exc_stack[gen.exc_depth++] = exc;
+		fn = SWO_EXC_ENTER;
+	} else {
+		exc = gen.exc_stack[--gen.exc_depth];
+		n = swogen_put_hw(buf, SWO_HW_ID_EXCTRC,
+				  exc | (SWO_EXC_EXIT << 12), 2);
+		/* Back to the preempted exception or to thread mode */
+		exc = gen.exc_depth ? gen.exc_stack[gen.exc_depth - 1] : 0;
+		fn = SWO_EXC_RETURN;
+	}
+
+	return n + swogen_put_hw(&buf[n], SWO_HW_ID_EXCTRC,
+				 (exc & 0x1ff) | (fn << 12), 2);
+}
+
+static size_t swogen_put_packet(uint8_t *buf, swogen_type type)
+{
+	static const unsigned int itm_len[] = { 1, 2, 4 };
+	uint32_t delta;
+
+	switch (type) {
+	case SWOGEN_PC:
+		return swogen_put_hw(buf, SWO_HW_ID_PC_SAMPLE, swogen_pc(), 4);
+	case SWOGEN_SLEEP:
+		return swogen_put_hw(buf, SWO_HW_ID_PC_SAMPLE, 0, 1);
+	case SWOGEN_PCV:
+		/* Comparator 0 */
+		return swogen_put_hw(buf, SWO_HW_ID_PC_VALUE, swogen_pc(), 4);
+	case SWOGEN_EXC:
+		return swogen_put_exc(buf);
+	case SWOGEN_EVT:
+		/* One counter wrapped among CPI, EXC, SLEEP, LSU, FOLD, CYC */
+		return swogen_put_hw(buf, SWO_HW_ID_EVTCNT,
+				     1U << (swogen_rand() % 6), 1);
+	case SWOGEN_ITM:
+		return swogen_put_source(buf, (swogen_rand() % 32) << 3,
+					 swogen_rand(),
+					 itm_len[swogen_rand() % 3]);
+	case SWOGEN_LTS:
+		delta = 1 + (swogen_rand() % 2000);
+		gen.timestamp += delta;
+		return swogen_put_lts(buf, delta);
+	case SWOGEN_GTS:
+		return swogen_put_gts(buf, gen.timestamp);
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Fill a buffer with whole packets.
+ * @return Number of bytes generated.
+ */
+static size_t swogen_fill(uint8_t *buf, size_t len)
+{
+	size_t pos = 0;
+	swogen_type type;
+
+	while ((pos + 2 * SWOGEN_PACKET_SZ_MAX + 6) <= len) {
+		if (app_cfg.count && (gen.tot_packets >= app_cfg.count))
+			break;
+
+		if (!(gen.tot_packets % SWOGEN_SYNC_PERIOD)) {
+			pos += swogen_put_sync(&buf[pos]);
+		}
+
+		type = swogen_pick_type();
+		pos += swogen_put_packet(&buf[pos], type);
+		gen.packets[type]++;
+		gen.tot_packets++;
+	}
+
+	return pos;
+}
+
+static int swogen_open_output(const char *path)
+{
+	struct termios tio;
+	int fd;
+
+	if (!strcmp(path, "-")) {
+		return STDOUT_FILENO;
+	}
+
+	if (strcmp(path, "pty")) {
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			ERROR("Cannot open %s: %s\n", path, strerror(errno));
+		}
+		return fd;
+	}
+
+	if ((fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0) {
+		ERROR("Cannot create a pseudo-terminal: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (grantpt(fd) || unlockpt(fd) || tcgetattr(fd, &tio)) {
+		ERROR("Cannot set the pseudo-terminal: %s\n", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	/* The SWO stream is binary */
+	cfmakeraw(&tio);
+	tcsetattr(fd, TCSANOW, &tio);
+
+	fprintf(stderr, "%s\n", ptsname(fd));
+
+	return fd;
+}
+
+static int swogen_write(int fd, const uint8_t *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len && is_running) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EPIPE)
+				ERROR("While writing: %s\n", strerror(errno));
+			return -1;
+		}
+
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Sleep until the bytes written so far would have been sent at the
+ *		requested rate.
+ */
+static void swogen_pace(const struct timespec *start,
+			unsigned long long bytes_per_sec)
+{
+	unsigned long long ns;
+	struct timespec t = *start;
+
+	ns = (gen.tot_bytes * 1000000000ULL) / bytes_per_sec;
+	t.tv_sec += ns / 1000000000ULL;
+	t.tv_nsec += ns % 1000000000ULL;
+	if (t.tv_nsec >= 1000000000L) {
+		t.tv_sec++;
+		t.tv_nsec -= 1000000000L;
+	}
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) ==
+	       EINTR && is_running);
+}
+
+static void swogen_print_stats(const struct timespec *start)
+{
+	struct timespec end;
+	double elapsed;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - start->tv_sec) +
+		  (end.tv_nsec - start->tv_nsec) / 1e9;
+
+	fprintf(stderr, "packets %lu bytes %llu time %.3f s rate %.0f B/s\n",
+		gen.tot_packets, gen.tot_bytes, elapsed,
+		elapsed > 0 ? gen.tot_bytes / elapsed : 0.0);
+	for (i = 0; i < SWOGEN_TYPE_COUNT; i++) {
+		if (gen.packets[i])
+			fprintf(stderr, "\t%-6s %lu\n", swogen_type_name[i],
+				gen.packets[i]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t buf[SWOGEN_CHUNK_SZ];
+	unsigned long long bytes_per_sec = 0;
+	struct timespec start;
+	int option_index;
+	size_t len;
+	int fd;
+
+	if (swogen_parse_mix(SWOGEN_MIX_DEFAULT)) {
+		exit(EXIT_FAILURE);
+	}
+
+	while ((option_index = getopt(argc, argv, APP_ARGS_OPTIONS)) != -1) {
+		switch (option_index) {
+		case 'o':
+			app_cfg.output = optarg;
+			break;
+		case 'n':
+			app_cfg.count = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			app_cfg.baudrate = strtoul(optarg, NULL, 0);
+			break;
+		case 'x':
+			app_cfg.factor = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			if (swogen_parse_mix(optarg)) {
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'a':
+			app_cfg.pc_base = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			app_cfg.pc_len = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			app_cfg.seed = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			app_print_usage(argv[0]);
+			exit(EXIT_FAILURE);
+			break;
+		}
+	}
+
+	if (!app_cfg.pc_len || !app_cfg.factor) {
+		app_print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	if (signal(SIGINT, swogen_catch_signal) == SIG_ERR ||
+	    signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
+		exit(EXIT_FAILURE);
+	}
+
+	if ((fd = swogen_open_output(app_cfg.output)) < 0) {
+		exit(EXIT_FAILURE);
+	}
+
+	gen.rand = app_cfg.seed ? app_cfg.seed : 1;
+	if (app_cfg.baudrate) {
+		bytes_per_sec = ((unsigned long long) app_cfg.baudrate *
+				 app_cfg.factor) / SWOGEN_BITS_PER_BYTE;
+		if (!bytes_per_sec)
+			bytes_per_sec = 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (is_running && (len = swogen_fill(buf, sizeof(buf)))) {
+		if (swogen_write(fd, buf, len))
+			break;
+
+		gen.tot_bytes += len;
+		if (bytes_per_sec)
+			swogen_pace(&start, bytes_per_sec);
+	}
+
+	swogen_print_stats(&start);
+
+	if (fd != STDOUT_FILENO)
+		close(fd);
+
+	return 0;
+}
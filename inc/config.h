@@ -12,13 +12,17 @@
 
 #include <stdbool.h>
 
-#ifdef  MESSAGE_DYNAMIC
+/** Default capacity of a message, the maximum one without MESSAGE_DYNAMIC */
+#define MESSAGE_BUFFER_SZ_MAX		16384
 
+#ifdef  MESSAGE_DYNAMIC
+/** Smallest size class of the message pool */
+#define MESSAGE_POOL_SZ_MIN		256U
+/** A message does not grow beyond this size */
+#define MESSAGE_POOL_SZ_MAX		(1U << 20)
 #else
 /** This is */
 #define MESSAGE_NSTANCES_CNT_MAX	32
-/** This is */
-#define MESSAGE_BUFFER_SZ_MAX		16384
 
 #endif
 
@@ -30,14 +34,79 @@
 /** The maximum length of the string */
 #define CONFIG_STR_LEN_MAX		512
 
+/** Longest session information written at the beginning of a form output */
+#define FORM_HEADER_LEN_MAX		4096
+
+/** Packets between two index records of the binary packet log */
+#define PKT_LOG_INDEX_INTERVAL		4096U
+
+/** Page cache of the SQLite packet database, in KiB */
+#define PKT_SQL_CACHE_KB		16384U
+
 /** Max number of file that can be opened */
 #define FILE_COUNT_MAX			16
 
 /** Max number of uart device that can be openned */
 #define UART_DEV_COUNT_MAX		1
 
+/** Max number of entries of the perf_ex symbol cache (power of two) */
+#define PERF_EX_CACHE_ENTRIES_MAX	65536
+
+/** Initial number of entries of the perf_ex PC histogram (power of two) */
+#define PERF_EX_HIST_ENTRIES_MIN	1024
+
+/**
+ * Default number of packets of the decoder_swo ring. The smallest packet kept
+ * by the filters is 2 bytes long and libswo buffers up to two messages, a
+ * full decoding session always fits.
+ */
+#define DECODER_SWO_RING_LEN_DEFAULT	MESSAGE_BUFFER_SZ_MAX
+
+/**
+ * Most packets held by the timestamp object while waiting for the local
+ * timestamp following them, they are then released with an approximate time.
+ */
+#define TIMESTAMP_PENDING_MAX		256U
+
+/** Exception numbers tracked by the exception trace object */
+#define EXC_TRACE_EXC_MAX		512U
+
+/** Deepest nesting of exceptions tracked by the exception trace object */
+#define EXC_TRACE_DEPTH_MAX		64U
+
+/**
+ * Number of buckets of the exception trace histograms, bucket i holds the
+ * durations in [2^i, 2^(i+1)) cycles, the last one the longer ones.
+ */
+#define EXC_TRACE_HIST_LEN		32
+
+/** Number of DWT comparators followed by the data trace object */
+#define DATA_TRACE_CMP_MAX		4U
+
+/** Last accesses kept per comparator by the data trace object */
+#define DATA_TRACE_RING_LEN		256U
+
+/** Size of the ring filled by the uart reader thread (power of two) */
+#define UART_RING_SZ			(1U << 20)
+
+/** Number of messages queued between two threaded pipeline stages */
+#define PIPELINE_QUEUE_LEN		4
+
+/**
+ * Number of buckets of the processing objects latency histograms, bucket i
+ * holds the calls that lasted [2^i, 2^(i+1)) ns, the last one the longer ones.
+ */
+#define PROCESSING_STATS_HIST_LEN	32
+
 #define UART_COUNT_MAX			STRING_MAX_LENGTH
+/** Highest deviation accepted between the requested and applied baudrate */
+#define UART_BAUDRATE_TOLERANCE_PCT	3
 #define UART_TIMEOUT_MS			100U
+/**
+ * Default longest wait for a message to fill once the first byte arrived, a
+ * pipeline round then handles a batch instead of a few bytes.
+ */
+#define UART_FILL_DEADLINE_MS		5U
 #define UART_MAX_POLL_RETRIES		10
 
 /* Configuration */
@@ -49,6 +118,54 @@
 #define CFG_SECTION_SESSION_TYPE_VAL_PE	"execution-performance"
 #define CFG_SECTION_SESSION_TYPE_VAL_PM	"memory-performance"
 
+/* Section UART SWO */
+#define CFG_SECTION_UART_SWO			"uart-swo"
+#define CFG_SECTION_UART_SWO_FILL		"fill"
+#define CFG_SECTION_UART_SWO_FILL_DEADLINE	"fill_deadline_ms"
+
+/* Section decoder SWO */
+#define CFG_SECTION_DECODER_SWO			"decoder-swo"
+#define CFG_SECTION_DECODER_SWO_RING_LEN	"packet_ring_len"
+/** Non zero to keep the local and global timestamp packets */
+#define CFG_SECTION_DECODER_SWO_TIMESTAMPS	"timestamps"
+/** Non zero to keep the exception trace packets */
+#define CFG_SECTION_DECODER_SWO_EXCTRC		"exctrc"
+/** Non zero to keep the event counter packets */
+#define CFG_SECTION_DECODER_SWO_EVTCNT		"evtcnt"
+/** Non zero to keep the data value and address offset packets */
+#define CFG_SECTION_DECODER_SWO_DATATRACE	"datatrace"
+
+/* Section timestamp */
+#define CFG_SECTION_TIMESTAMP			"timestamp"
+#define CFG_SECTION_TIMESTAMP_LTS_PRESCALER	"lts_prescaler"
+
+/* Section event counters */
+#define CFG_SECTION_EVTCNT			"evtcnt"
+/** Cycles per window of the event counters, needs the timestamps */
+#define CFG_SECTION_EVTCNT_WINDOW_LEN		"window_len"
+
+/* Section data trace */
+#define CFG_SECTION_DATA_TRACE			"data-trace"
+/** Prefix of the keys naming the variable of each comparator: comparator0 */
+#define CFG_SECTION_DATA_TRACE_COMPARATOR	"comparator"
+
+/* Section perf_ex */
+#define CFG_SECTION_PERF_EX			"perf-ex"
+/** "samples" or "cycles" to split the profile in windows, none otherwise */
+#define CFG_SECTION_PERF_EX_WINDOW		"window"
+#define CFG_SECTION_PERF_EX_WINDOW_LEN		"window_len"
+/** "incremental" (default) or "matrix" printed at the end */
+#define CFG_SECTION_PERF_EX_WINDOW_OUTPUT	"window_output"
+
+/* Section pipeline */
+#define CFG_SECTION_PIPELINE		"pipeline"
+#define CFG_SECTION_PIPELINE_THREADED	"threaded"
+
+/* Section replay, raw SWO capture read instead of the UART */
+#define CFG_SECTION_REPLAY		"replay"
+#define CFG_SECTION_REPLAY_PATH		"path"
+#define CFG_SECTION_REPLAY_BAUDRATE	"baudrate"
+
 /* Section SWD CTRL */
 #define CFG_SECTION_SWD_CTRL		"swd-ctrl"
 
@@ -68,6 +185,18 @@
 #define CFG_SECTION_OUTPUT_FILE		"output-files"
 #define CFG_SECTION_OUTPUT_FILE_PM	"path-mem"
 #define CFG_SECTION_OUTPUT_FILE_PE	"path-perf"
+/** "json" for a single document (default), "ndjson" for a packet per line */
+#define CFG_SECTION_OUTPUT_FILE_JSON_FMT	"json-format"
+/** Binary packet log written instead of the JSON output */
+#define CFG_SECTION_OUTPUT_FILE_PKT_LOG	"path-pkt-log"
+/** SQLite packet database written instead of the JSON output */
+#define CFG_SECTION_OUTPUT_FILE_SQLITE	"path-sqlite"
+/** Report of the exception trace stage */
+#define CFG_SECTION_OUTPUT_FILE_EXC	"path-exc"
+/** Report of the event counter stage */
+#define CFG_SECTION_OUTPUT_FILE_EVTCNT	"path-evtcnt"
+/** Report of the data trace stage */
+#define CFG_SECTION_OUTPUT_FILE_DATA_TRACE	"path-data-trace"
 
 #else /* CONFIG_LIBINI */
 
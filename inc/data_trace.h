@@ -0,0 +1,55 @@
+/*****************************************************************
+ * file: data_trace.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the DWT data trace processing object.
+ *		more details in the source file data_trace.c .
+ *****************************************************************/
+#ifndef __DATA_TRACE_H__
+#define __DATA_TRACE_H__
+
+#include <processing.h>
+
+typedef struct data_trace_obj_st data_trace_obj;
+
+typedef int (*data_trace_set_elf_cb) (data_trace_obj * const obj,
+				      const char * const path);
+typedef int (*data_trace_set_elf_gbl_config_cb) (data_trace_obj * const obj);
+typedef int (*data_trace_set_variable_cb) (data_trace_obj * const obj,
+					   unsigned int cmpn,
+					   const char * const name);
+typedef int (*data_trace_set_variables_gbl_config_cb)
+					(data_trace_obj * const obj);
+
+/** This structure inherits from the processing object */
+struct data_trace_obj_st {
+	/** Processing abstraction object */
+	processing_obj	proc_obj;
+	/** Method loading the elf file holding the variables */
+	data_trace_set_elf_cb set_elf;
+	/** Method loading the elf file using config object */
+	data_trace_set_elf_gbl_config_cb set_elf_gbl_config;
+	/** Method naming the variable watched by a DWT comparator */
+	data_trace_set_variable_cb set_variable;
+	/** Method naming the variables of the comparators using config object */
+	data_trace_set_variables_gbl_config_cb set_variables_gbl_config;
+	/** Internal data structure */
+	void		*pdata;
+};
+
+/**
+ * @brief Initialize the data trace object. It receives the array of
+ *		timestamp_pkt of the timestamp object and writes a text report
+ *		per DWT comparator at the end of the session.
+ * @param obj The data trace object.
+ * @return 0 upon success, -1 otherwise.
+ */
+int data_trace_init(data_trace_obj * const obj);
+
+/**
+ * @brief De-initialize the data trace object.
+ * @param obj The data trace object.
+ * @return 0 upon success, -1 otherwise.
+ */
+int data_trace_fini(data_trace_obj * const obj);
+
+#endif /* __DATA_TRACE_H__ */
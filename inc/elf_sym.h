@@ -0,0 +1,70 @@
+/*****************************************************************
+ * file: elf_sym.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the in-process ELF symbolizer. More
+ * 		information in the source file elf_sym.c .
+ *****************************************************************/
+#ifndef __ELF_SYM_H__
+#define __ELF_SYM_H__
+
+typedef struct elf_sym_table_st elf_sym_table;
+
+/** Result of an address resolution, strings are owned by the table */
+typedef struct {
+	/** Name of the function containing the address */
+	const char	*function;
+	/** Path of the source file containing the address */
+	const char	*file;
+	/** Line in the source file, 0 if unknown */
+	unsigned int	line;
+} elf_sym_info;
+
+/**
+ * @brief Load the function symbols (.symtab) and the line table (.debug_line)
+ * 		of an ELF file into an address sorted table. The data object
+ * 		symbols are kept as well, to be found by name.
+ * @param path Path to the ELF file.
+ * @return A new table upon success, NULL otherwise.
+ */
+elf_sym_table *elf_sym_load(const char * const path);
+
+/**
+ * @brief Resolve an address to its function, file and line.
+ * @param tbl Table returned by elf_sym_load.
+ * @param addr Address to resolve (PC value).
+ * @param info Structure filled with the result.
+ * @return 0 if the address belongs to a function, -1 otherwise.
+ */
+int elf_sym_resolve(const elf_sym_table * const tbl, unsigned int addr,
+		    elf_sym_info * const info);
+
+/**
+ * @brief Get the address range covered by the function symbols, this is
+ * 		roughly the .text range of the image.
+ * @param tbl Table returned by elf_sym_load.
+ * @param start Set to the lowest function address.
+ * @param end Set to the address following the last function.
+ * @return 0 upon success, -1 if the table holds no function.
+ */
+int elf_sym_get_range(const elf_sym_table * const tbl, unsigned int *start,
+		      unsigned int *end);
+
+/**
+ * @brief Find a data object symbol, a variable, by its name.
+ * @param tbl Table returned by elf_sym_load.
+ * @param name Name of the variable.
+ * @param addr Set to the address of the variable.
+ * @param size Set to the size of the variable, 0 if unknown.
+ * @return 0 upon success, -1 if there is no such variable.
+ */
+int elf_sym_find_object(const elf_sym_table * const tbl,
+			const char * const name, unsigned int *addr,
+			unsigned int *size);
+
+/**
+ * @brief Release a table returned by elf_sym_load.
+ * @param tbl The table to release, can be NULL.
+ */
+void elf_sym_free(elf_sym_table *tbl);
+
+#endif /* __ELF_SYM_H__ */
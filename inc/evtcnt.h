@@ -0,0 +1,52 @@
+/*****************************************************************
+ * file: evtcnt.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the DWT event counter processing object.
+ *		more details in the source file evtcnt.c .
+ *****************************************************************/
+#ifndef __EVTCNT_H__
+#define __EVTCNT_H__
+
+#include <processing.h>
+
+#include <stdbool.h>
+
+typedef struct evtcnt_obj_st evtcnt_obj;
+
+typedef int (*evtcnt_set_timestamped_cb) (evtcnt_obj * const obj,
+					  bool is_timestamped);
+typedef int (*evtcnt_set_window_cb) (evtcnt_obj * const obj,
+				     unsigned int len);
+typedef int (*evtcnt_set_window_gbl_config_cb) (evtcnt_obj * const obj);
+
+/** This structure inherits from the processing object */
+struct evtcnt_obj_st {
+	/** Processing abstraction object */
+	processing_obj	proc_obj;
+	/** Method telling the packets are timestamp_pkt from the timestamp object */
+	evtcnt_set_timestamped_cb set_timestamped;
+	/** Method setting the cycles per window, 0 to disable them */
+	evtcnt_set_window_cb set_window;
+	/** Method setting the cycles per window using config object */
+	evtcnt_set_window_gbl_config_cb set_window_gbl_config;
+	/** Internal data structure */
+	void		*pdata;
+};
+
+/**
+ * @brief Initialize the event counter object. It receives the libswo packets
+ *		of the decoder, or the timestamp_pkt of the timestamp object,
+ *		and writes the cycles counted by the DWT event counters as text.
+ * @param obj The event counter object.
+ * @return 0 upon success, -1 otherwise.
+ */
+int evtcnt_init(evtcnt_obj * const obj);
+
+/**
+ * @brief De-initialize the event counter object.
+ * @param obj The event counter object.
+ * @return 0 upon success, -1 otherwise.
+ */
+int evtcnt_fini(evtcnt_obj * const obj);
+
+#endif /* __EVTCNT_H__ */
@@ -0,0 +1,38 @@
+/*****************************************************************
+ * file: exc_trace.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the exception trace processing object.
+ *		more details in the source file exc_trace.c .
+ *****************************************************************/
+#ifndef __EXC_TRACE_H__
+#define __EXC_TRACE_H__
+
+#include <processing.h>
+
+typedef struct exc_trace_obj_st exc_trace_obj;
+
+/** This structure inherits from the processing object */
+struct exc_trace_obj_st {
+	/** Processing abstraction object */
+	processing_obj	proc_obj;
+	/** Internal data structure */
+	void		*pdata;
+};
+
+/**
+ * @brief Initialize the exception trace object. It receives the array of
+ *		timestamp_pkt of the timestamp object and writes a text report
+ *		per exception at the end of the session.
+ * @param obj The exception trace object.
+ * @return 0 upon success, -1 otherwise.
+ */
+int exc_trace_init(exc_trace_obj * const obj);
+
+/**
+ * @brief De-initialize the exception trace object.
+ * @param obj The exception trace object.
+ * @return 0 upon success, -1 otherwise.
+ */
+int exc_trace_fini(exc_trace_obj * const obj);
+
+#endif /* __EXC_TRACE_H__ */
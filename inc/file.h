@@ -8,6 +8,8 @@
 
 #include <processing.h>
 
+#include <stdbool.h>
+
 enum file_mode {
 	/** Do not truncate and simply read */
 	FILE_RDONLY,
@@ -28,6 +30,13 @@ typedef int (*file_init_cb)(file_obj * const obj);
 /** This callback will close the file set to */
 typedef int (*file_fini_cb)(file_obj * const obj);
 
+/** This callback will set the baudrate a read file is replayed at */
+typedef int (*file_set_baudrate_cb)(file_obj * const obj,
+				    unsigned int baudrate);
+
+/** This callback will tell if the whole file was read */
+typedef bool (*file_is_eof_cb)(file_obj * const obj);
+
 
 /** This structure inherits from the processing object */
 struct  file_obj_st {
@@ -39,6 +48,10 @@ struct  file_obj_st {
 	file_init_cb		file_init;
 	/** Callback to de-init internal file specific info and close file */
 	file_fini_cb		file_fini;
+	/** Callback to pace the replay of a read file, 0 for no pacing */
+	file_set_baudrate_cb	file_set_baudrate;
+	/** Callback to check if a read file reached its end */
+	file_is_eof_cb		file_is_eof;
 	/** Internal data structure */
 	void *pdata;
 };
@@ -10,6 +10,8 @@
 #include <processing.h>
 #include <pipeline.h>
 
+#include <libswo/libswo.h>
+
 
 typedef struct form_obj_st form_obj;
 
@@ -21,6 +23,61 @@ struct form_obj_st {
 	void *pdata;
 };
 
+/**
+ * Packets received by a form and not written yet, they are kept until data_out
+ * writes them: the message they are in is reused for the output.
+ */
+typedef struct {
+	/** Copy of the packets */
+	union libswo_packet *pkt;
+	/** Number of packets received */
+	size_t	count;
+	/** Next packet to write */
+	size_t	next;
+	/** Number of packets pkt can hold */
+	size_t	cap;
+} form_pkt_buf;
+
+/**
+ * @brief Copy the packets of a message, the previous ones are dropped.
+ * @param buf Packets of the form.
+ * @param obj Processing object of the form, its statistics are updated.
+ * @param msg Message holding the libswo packets.
+ * @return The number of bytes read from the message, -1 if the packets could
+ *		not be copied.
+ */
+size_t form_pkt_buf_receive(form_pkt_buf * const buf,
+			    processing_obj * const obj,
+			    message_obj * const msg);
+
+/**
+ * @brief Release the packets of a form.
+ * @param buf Packets of the form.
+ */
+void form_pkt_buf_free(form_pkt_buf * const buf);
+
+/** Session, board and software information written by the forms */
+typedef struct {
+	/** Section of the configuration */
+	const char	*section;
+	/** Name of the value in the section and in the output */
+	const char	*name;
+	/** Name of the object holding the value in the output */
+	const char	*node;
+} form_session_field;
+
+/** The session information, the fields of a same node are contiguous */
+extern const form_session_field form_session_fields[];
+/** Number of entries of form_session_fields */
+extern const unsigned int form_session_fields_count;
+
+/**
+ * @brief Get the value of a session field from the configuration.
+ * @param field Session field.
+ * @return The value, NULL if it is not configured.
+ */
+const char *form_session_get(const form_session_field * const field);
+
 /**
  * @brief Initialization of the cjson object 
  * @param obj form_obj Object to initialize.
@@ -35,4 +92,34 @@ int form_cjson_init(form_obj * const obj);
  */
 int form_cjson_fini(form_obj * const obj);
 
+/**
+ * @brief Initialization of the binary packet log object
+ * @param obj form_obj Object to initialize.
+ * @return 0 upon sucess, -1 otherwise.
+ */
+int form_bin_init(form_obj * const obj);
+
+/**
+ * @brief De-initialization of the binary packet log object
+ * @param obj form_obj Object to de-initialize.
+ * @return 0 upon sucess, -1 otherwise.
+ */
+int form_bin_fini(form_obj * const obj);
+
+/**
+ * @brief Initialization of the SQLite object, the database is the one of
+ *		[output-files] path-sqlite.
+ * @param obj form_obj Object to initialize.
+ * @return 0 upon sucess, -1 otherwise.
+ */
+int form_sqlite_init(form_obj * const obj);
+
+/**
+ * @brief De-initialization of the SQLite object, the indexes are built and
+ *		the database closed.
+ * @param obj form_obj Object to de-initialize.
+ * @return 0 upon sucess, -1 otherwise.
+ */
+int form_sqlite_fini(form_obj * const obj);
+
 #endif /*  __FORM_H__ */
@@ -11,10 +11,53 @@
 
 #include <processing.h>
 
+/**
+ * Heap events are written by the target as binary records on the ITM
+ * stimulus port ITM2MEM_INFO_PORT, one 32-bit word per ITM write (narrower
+ * writes are reassembled, little endian):
+ *	word 0: type (bits 31-28), frames (bits 27-24), block size (bits 23-0)
+ *	word 1: pointer of the block
+ *	word 2 and next: return address of each backtrace frame
+ * The target builds the header with ITM2MEM_REC_HEADER, no text is formatted.
+ */
+#define ITM2MEM_INFO_PORT		1U
+
+#define ITM2MEM_REC_TYPE_SHIFT		28
+#define ITM2MEM_REC_DEPTH_SHIFT		24
+#define ITM2MEM_REC_DEPTH_MASK		0xfU
+#define ITM2MEM_REC_SIZE_MASK		0xffffffU
+
+/** Allocation record */
+#define ITM2MEM_REC_ALLOC		0xaU
+/** Free record */
+#define ITM2MEM_REC_FREE		0xfU
+
+#define ITM2MEM_REC_HEADER(type, depth, size)				\
+	(((type) << ITM2MEM_REC_TYPE_SHIFT) |				\
+	 (((depth) & ITM2MEM_REC_DEPTH_MASK) << ITM2MEM_REC_DEPTH_SHIFT) | \
+	 ((size) & ITM2MEM_REC_SIZE_MASK))
+
 typedef struct itm2mem_info_obj_st itm2mem_info_obj;
 
+/** Counters of the records received */
+typedef struct {
+	/** Number of allocation records */
+	unsigned long	allocs;
+	/** Number of free records */
+	unsigned long	frees;
+	/** Number of words skipped while looking for a record header */
+	unsigned long	skipped;
+	/** Number of records cut by the end of the session */
+	unsigned long	truncated;
+} itm2mem_info_stats;
+
+typedef int (*itm2mem_info_get_stats_cb) (itm2mem_info_obj * const obj,
+					  itm2mem_info_stats * const stats);
+
 struct itm2mem_info_obj_st {
 	processing_obj	proc_obj;
+	/** Method retrieving the counters of the records */
+	itm2mem_info_get_stats_cb get_stats;
 
 	void		*pdata;
 };
@@ -33,6 +33,9 @@ typedef size_t (*message_size_cb	)
 typedef size_t (*message_cpy_cb )
 		(message_obj * const msg, message_obj * restrict src);
 
+typedef size_t (*message_share_cb )
+		(message_obj * const msg, message_obj * const src);
+
 
 typedef char *(*message_ptr_cb ) (const message_obj * const obj);
 
@@ -52,6 +55,8 @@ struct message_obj_st {
 	message_size_cb		total_len;
 	/** Copy to one message to another */
 	message_cpy_cb		cpy;
+	/** View the buffer of another message, read-only, without copy */
+	message_share_cb	share;
 	/** Get the buffer pointer */
 	message_ptr_cb		ptr;
 	/** Internal data */
@@ -66,6 +71,18 @@ struct message_obj_st {
  */
 int message_init(message_obj * const obj);
 
+/**
+ * @brief Initialize the message object with a given capacity. With
+ * 		MESSAGE_DYNAMIC the buffer is only allocated when needed and
+ * 		grows on write/append, otherwise the capacity is limited to
+ * 		MESSAGE_BUFFER_SZ_MAX.
+ * @param obj This is the message object to initilized. Must be
+ * 		allocated before hand.
+ * @param size Capacity of the message in bytes.
+ * @return 0 upon success, -1 otherwise.
+ */
+int message_init_sz(message_obj * const obj, size_t size);
+
 /**
  * @brief Initialize the message object, and remote the attached
  * 		 a buffer to it.
@@ -10,14 +10,35 @@
 
 #include <processing.h>
 
+#include <stdbool.h>
+
 typedef struct perf_ex_obj_st perf_ex_obj;
 
+/** Windows the samples are bucketed in, on top of the whole session */
+typedef enum {
+	/** No windows, a single report at the end */
+	PERF_EX_WINDOW_NONE = 0,
+	/** Fixed number of samples per window */
+	PERF_EX_WINDOW_SAMPLES,
+	/** Fixed number of cycles per window, needs timestamped samples */
+	PERF_EX_WINDOW_CYCLES,
+} perf_ex_window_kind;
+
 typedef int (*perf_ex_set_elf_gbl_config_cb) (perf_ex_obj * const obj);
 typedef int (*perf_ex_set_elf_cb) (perf_ex_obj * const obj,
 					const char * const path);
 typedef int (*perf_ex_set_tc_gbl_config_cb) (perf_ex_obj * const obj);
 typedef int (*perf_ex_set_tc_cb) (perf_ex_obj * const obj,
 					const char * const path);
+typedef int (*perf_ex_get_cache_stats_cb) (perf_ex_obj * const obj,
+					unsigned long * const hits,
+					unsigned long * const misses);
+typedef int (*perf_ex_set_timestamped_cb) (perf_ex_obj * const obj,
+					bool is_timestamped);
+typedef int (*perf_ex_set_window_cb) (perf_ex_obj * const obj,
+					perf_ex_window_kind kind,
+					unsigned int len, bool is_matrix);
+typedef int (*perf_ex_set_window_gbl_config_cb) (perf_ex_obj * const obj);
 
 /** This structure inherits from the processing object */
 struct perf_ex_obj_st {
@@ -31,6 +52,14 @@ struct perf_ex_obj_st {
 	perf_ex_set_tc_gbl_config_cb set_tc_gbl_config;
 	/** Method setting the toolchain path using the string char*/
 	perf_ex_set_tc_cb set_tc;
+	/** Method retrieving the hit/miss counters of the symbol cache */
+	perf_ex_get_cache_stats_cb get_cache_stats;
+	/** Method telling the samples are timestamp_pkt from the timestamp object */
+	perf_ex_set_timestamped_cb set_timestamped;
+	/** Method splitting the profile in sample or cycle windows */
+	perf_ex_set_window_cb set_window;
+	/** Method splitting the profile in windows using config object */
+	perf_ex_set_window_gbl_config_cb set_window_gbl_config;
 	/** Internal data structure */
 	void		*pdata;
 };
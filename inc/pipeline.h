@@ -9,6 +9,7 @@
 
 #include <processing.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 typedef struct pipeline_obj_st pipeline_obj;
 
@@ -20,6 +21,9 @@ typedef int (*pipeline_attach_proc_cb)(pipeline_obj * const obj,
 
 typedef int (*pipeline_stream_data_cb)(pipeline_obj *obj);
 typedef bool (*pipeline_is_stopped_cb)(pipeline_obj *obj);
+typedef int (*pipeline_set_threaded_cb)(pipeline_obj * const obj,
+					bool threaded);
+typedef void (*pipeline_print_stats_cb)(pipeline_obj * const obj, FILE *out);
 
 /**
  * This structure holds all the processing objects used in the application.
@@ -44,6 +48,16 @@ struct pipeline_obj_st {
 	 * Method that set the pipeline to stop 
 	 */
 	pipeline_is_stopped_cb	 is_stopped;
+	/**
+	 * Method to run each processing object on its own thread, the
+	 * objects are connected by bounded queues.
+	 */
+	pipeline_set_threaded_cb set_threaded;
+	/**
+	 * Method to print the calls, bytes and latencies of each processing
+	 * object.
+	 */
+	pipeline_print_stats_cb	 print_stats;
 	/** Internal data */
 	void *pdata;
 };
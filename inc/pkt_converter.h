@@ -7,21 +7,61 @@
 
 #include <message.h>
 #include <libswo/libswo.h>
-#include <cJSON.h>
 
 typedef enum {
 	PKT_CONVERTER_CJSON = 0,
-	PKT_CONVERTER_MYSQL = 1,
-	PKT_CONVERTER_MAX   = 2,
+	PKT_CONVERTER_SQLITE = 1,
+	PKT_CONVERTER_BIN   = 2,
+	PKT_CONVERTER_MAX   = 3,
 } pkt_format_output;
 
+typedef struct pkt_sql_db_st pkt_sql_db;
+
 typedef struct {
 	pkt_format_output fmt;
-	union {
-		cJSON *root;
-	};
+	/** Database the packets are inserted in by PKT_CONVERTER_SQLITE */
+	pkt_sql_db *db;
 } pkt_to_form;
 
-size_t pkt_convert(pkt_to_form * const ptf, message_obj * const obj);
+/**
+ * @brief Convert one packet to the format of the converter and append it to
+ *		a buffer. A JSON packet is one object on a single line, without
+ *		separator nor line feed. A binary packet is a record of the
+ *		packet log, see pkt_log.c . A SQLite packet is inserted in the
+ *		database of the converter instead, the buffer is not used.
+ * @param ptf Converter.
+ * @param pkt Packet to convert.
+ * @param buf Output buffer.
+ * @param pos Position in buf where the packet is written, moved past it upon
+ *		success and left untouched otherwise.
+ * @param len Size of buf.
+ * @return 0 upon success, 1 if the packet has no representation and was
+ *		skipped, -1 if it does not fit.
+ */
+int pkt_convert(pkt_to_form * const ptf, const union libswo_packet * const pkt,
+		char * const buf, size_t * const pos, size_t len);
+
+/**
+ * @brief Append a JSON string, quoted and escaped, to a buffer.
+ * @param buf Output buffer.
+ * @param pos Position in buf where the string is written, moved past it upon
+ *		success and left untouched otherwise.
+ * @param len Size of buf.
+ * @param str String to append.
+ * @return 0 upon success, -1 if it does not fit.
+ */
+int pkt_convert_json_str(char * const buf, size_t * const pos, size_t len,
+			 const char * const str);
+
+/**
+ * @brief Name of an exception number of the exception trace packets, see
+ *		section B1.5 of the ARMv7-M Architecture Reference Manual.
+ * @param exception Exception number.
+ * @param buf Buffer where the name of an external interrupt is written.
+ * @param len Size of buf.
+ * @return The name of the exception, buf for an external interrupt.
+ */
+const char *pkt_convert_exception_name(unsigned int exception,
+				       char * const buf, size_t len);
 
 #endif /* __PKT_CONVERTER_H__*/
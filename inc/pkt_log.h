@@ -0,0 +1,116 @@
+/*****************************************************************
+ * file: pkt_log.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the binary packet log format. More
+ * 		information in the source file pkt_log.c .
+ *****************************************************************/
+#ifndef __PKT_LOG_H__
+#define __PKT_LOG_H__
+
+#include <libswo/libswo.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** First bytes of a packet log */
+#define PKT_LOG_MAGIC			"SWOPKTLG"
+#define PKT_LOG_MAGIC_LEN		8U
+/** Version of the format, incremented on incompatible changes */
+#define PKT_LOG_VERSION			1U
+
+/** Record type of the index written every PKT_LOG_INDEX_INTERVAL packets */
+#define PKT_LOG_REC_INDEX		0xffU
+/** Record type of the index closing the log */
+#define PKT_LOG_REC_END			0xfeU
+/** Length of an index or end record: type, packet count, previous index */
+#define PKT_LOG_INDEX_LEN		17U
+
+/** One session information of the header */
+typedef struct {
+	/** Name of the object holding the value, e.g. "board_info" */
+	const char	*node;
+	/** Name of the value */
+	const char	*name;
+	/** The value */
+	const char	*value;
+} pkt_log_field;
+
+/** Index record, a backward linked list of the positions in the log */
+typedef struct {
+	/** Number of packets written before the index */
+	uint64_t	count;
+	/** Offset of the previous index record, 0 for the first one */
+	uint64_t	prev;
+} pkt_log_index;
+
+/**
+ * @brief Write the magic, the version and the fields of the header.
+ * @param buf Output buffer.
+ * @param pos Position in buf, moved past the header upon success and left
+ *		untouched otherwise.
+ * @param len Size of buf.
+ * @param fields Session information.
+ * @param count Number of fields.
+ * @return 0 upon success, -1 if it does not fit.
+ */
+int pkt_log_write_header(char * const buf, size_t * const pos, size_t len,
+			 const pkt_log_field * const fields,
+			 unsigned int count);
+
+/**
+ * @brief Read the header. The strings of the fields are copied into strs.
+ * @param buf Input buffer.
+ * @param pos Position in buf, moved past the header upon success.
+ * @param len Size of buf.
+ * @param fields Filled with the session information.
+ * @param count Number of entries of fields, set to the number of fields read.
+ * @param strs Storage of the strings of the fields.
+ * @param strs_len Size of strs.
+ * @return 0 upon success, -1 if this is not a valid header.
+ */
+int pkt_log_read_header(const char * const buf, size_t * const pos,
+			size_t len, pkt_log_field * const fields,
+			unsigned int * const count, char * const strs,
+			size_t strs_len);
+
+/**
+ * @brief Write one packet as a record: its type, then fixed width little
+ *		endian fields depending on the type.
+ * @param pkt Packet to write.
+ * @param buf Output buffer.
+ * @param pos Position in buf, moved past the record upon success and left
+ *		untouched otherwise.
+ * @param len Size of buf.
+ * @return 0 upon success, 1 if the packet has no record and was skipped, -1
+ *		if it does not fit.
+ */
+int pkt_log_write_pkt(const union libswo_packet * const pkt,
+		      char * const buf, size_t * const pos, size_t len);
+
+/**
+ * @brief Write an index or end record.
+ * @param type PKT_LOG_REC_INDEX or PKT_LOG_REC_END.
+ * @param idx Index to write.
+ * @param buf Output buffer.
+ * @param pos Position in buf, moved past the record upon success and left
+ *		untouched otherwise.
+ * @param len Size of buf.
+ * @return 0 upon success, -1 if it does not fit.
+ */
+int pkt_log_write_index(unsigned int type, const pkt_log_index * const idx,
+			char * const buf, size_t * const pos, size_t len);
+
+/**
+ * @brief Read the record at pos.
+ * @param buf Input buffer.
+ * @param pos Position in buf, moved past the record upon success.
+ * @param len Size of buf.
+ * @param pkt Filled when the record is a packet.
+ * @param idx Filled when the record is an index or the end.
+ * @return The type of the record (a libswo packet type, PKT_LOG_REC_INDEX or
+ *		PKT_LOG_REC_END), -1 if the record is truncated or unknown.
+ */
+int pkt_log_read(const char * const buf, size_t * const pos, size_t len,
+		 union libswo_packet * const pkt, pkt_log_index * const idx);
+
+#endif /* __PKT_LOG_H__ */
@@ -0,0 +1,75 @@
+/*****************************************************************
+ * file: pkt_sql.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the SQLite packet database. More
+ * 		information in the source file pkt_sql.c .
+ *****************************************************************/
+#ifndef __PKT_SQL_H__
+#define __PKT_SQL_H__
+
+#include <libswo/libswo.h>
+
+#include <stdint.h>
+
+typedef struct pkt_sql_db_st pkt_sql_db;
+
+/**
+ * @brief Create the database, an existing one is overwritten. The packet
+ *		tables are created without their indexes, they are built by
+ *		pkt_sql_close once all the packets are inserted.
+ * @param db Set to the database upon success.
+ * @param path Path of the database.
+ * @return 0 upon success, -1 otherwise.
+ */
+int pkt_sql_open(pkt_sql_db ** const db, const char * const path);
+
+/**
+ * @brief Insert one session, board or software information.
+ * @param db The database.
+ * @param node Name of the object holding the value, e.g. "board_info".
+ * @param name Name of the value.
+ * @param value The value.
+ * @return 0 upon success, -1 otherwise.
+ */
+int pkt_sql_add_session(pkt_sql_db * const db, const char * const node,
+			const char * const name, const char * const value);
+
+/**
+ * @brief Start a transaction, the packets inserted until pkt_sql_commit are
+ *		written at once.
+ * @param db The database.
+ * @return 0 upon success, -1 otherwise.
+ */
+int pkt_sql_begin(pkt_sql_db * const db);
+
+/**
+ * @brief Insert one packet in the table of its type.
+ * @param db The database.
+ * @param pkt Packet to insert.
+ * @return 0 upon success, 1 if the packet has no table and was skipped, -1
+ *		otherwise.
+ */
+int pkt_sql_insert(pkt_sql_db * const db,
+		   const union libswo_packet * const pkt);
+
+/**
+ * @brief Commit the transaction started by pkt_sql_begin.
+ * @param db The database.
+ * @return 0 upon success, -1 otherwise.
+ */
+int pkt_sql_commit(pkt_sql_db * const db);
+
+/**
+ * @brief Cancel the transaction started by pkt_sql_begin.
+ * @param db The database.
+ */
+void pkt_sql_rollback(pkt_sql_db * const db);
+
+/**
+ * @brief Build the indexes, checkpoint the WAL and close the database.
+ * @param db The database, freed.
+ * @return 0 upon success, -1 otherwise.
+ */
+int pkt_sql_close(pkt_sql_db * const db);
+
+#endif /* __PKT_SQL_H__ */
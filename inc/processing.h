@@ -7,9 +7,11 @@
 #ifndef __PROCESSING_H__
 #define __PROCESSING_H__
 
+#include <config.h>
 #include <message.h>
 
 #include <stdbool.h>
+#include <stdio.h>
 
 typedef struct processing_obj_st processing_obj;
 
@@ -21,6 +23,31 @@ typedef int (*processing_reg_reader_cb)
 			 (processing_obj * const obj, processing_obj * const el);
 typedef int (*processing_execute_out_cb) (processing_obj * const obj);
 
+/** Statistics of the calls to data_in or data_out */
+typedef struct {
+	/** Number of calls */
+	unsigned long		calls;
+	/** Number of calls that returned -1 */
+	unsigned long		errors;
+	/** Bytes received (data_in) or produced (data_out) */
+	unsigned long long	bytes;
+	/** Time spent in the callback */
+	unsigned long long	time_ns;
+	/** Log2 histogram of the duration of the calls */
+	unsigned long		hist[PROCESSING_STATS_HIST_LEN];
+} processing_stats_dir;
+
+/**
+ * Statistics of a processing object. They are only updated by the thread
+ * executing the object.
+ */
+typedef struct {
+	processing_stats_dir	in;
+	processing_stats_dir	out;
+	/** Packets handled, only counted by the objects dealing with packets */
+	unsigned long long	packets;
+} processing_stats;
+
 struct processing_obj_st {
 	/** Callback to register to receive data */
 	processing_data_in_cb 		data_in;
@@ -40,7 +67,8 @@ struct processing_obj_st {
 	/** bool set by the pipeline obj to request an end */
 	bool				req_end;
 	/** This will happen when the one processing element needs to send
-	 * more data than the tranmit buffer can hold.
+	 * more data than the tranmit buffer can hold. It is set by data_out
+	 * and execute_out calls data_out again until it is cleared.
 	 */
 	bool				req_send_more;
 	/** Child object procssing object */
@@ -49,6 +77,8 @@ struct processing_obj_st {
 	processing_obj			*next;
 	/** Name of the object "Defaulting to Unknown */
 	char				*name;
+	/** Calls, bytes and latencies of data_in and data_out */
+	processing_stats		stats;
 	/** Internal data */
 	void 				*pdata;
 };
@@ -71,4 +101,30 @@ int processing_init(processing_obj * const obj);
  */
 int processing_fini(processing_obj * const obj);
 
+/**
+ * @brief Call data_in of the object and account it in the statistics. The
+ *		pipeline shall only call data_in through this function.
+ * @param obj processing object receiving the data.
+ * @param msg message holding the data.
+ * @return The return value of data_in.
+ */
+size_t processing_data_in(processing_obj * const obj, message_obj * const msg);
+
+/**
+ * @brief Call data_out of the object and account it in the statistics. The
+ *		pipeline shall only call data_out through this function.
+ * @param obj processing object producing the data.
+ * @param msg message receiving the data.
+ * @return The return value of data_out.
+ */
+size_t processing_data_out(processing_obj * const obj,
+			   message_obj * const msg);
+
+/**
+ * @brief Print the statistics of the object.
+ * @param obj processing object.
+ * @param out Stream the statistics are printed to.
+ */
+void processing_print_stats(const processing_obj * const obj, FILE *out);
+
 #endif /* __PROCESSING_H__ */
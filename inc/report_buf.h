@@ -0,0 +1,53 @@
+/*****************************************************************
+ * file: report_buf.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the text buffer of the reports. More
+ * 		information in the source file report_buf.c .
+ *****************************************************************/
+#ifndef __REPORT_BUF_H__
+#define __REPORT_BUF_H__
+
+#include <message.h>
+#include <processing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+	/** Stream writing the text, NULL until the first use */
+	FILE		*stream;
+	/** Text written, owned by the stream */
+	char		*text;
+	/** Length of the text, updated when the stream is flushed */
+	size_t		len;
+	/** Part of the text already sent */
+	size_t		sent;
+} report_buf;
+
+/**
+ * @brief Get the stream writing the text, it is opened on the first use.
+ * @param buf The report buffer, zeroed before its first use.
+ * @return The stream, NULL if it could not be opened.
+ */
+FILE *report_buf_stream(report_buf * const buf);
+
+/**
+ * @brief Write the next chunk of the text, of at most one message. Once the
+ *		whole text is sent, the buffer is emptied and can be written
+ *		again.
+ * @param buf The report buffer.
+ * @param proc_obj The processing object sending the text, req_send_more
+ *		is set while text is left.
+ * @param msg Message where the text is written.
+ * @return The number of bytes written.
+ */
+size_t report_buf_send(report_buf * const buf, processing_obj * const proc_obj,
+		       message_obj * const msg);
+
+/**
+ * @brief Release the stream and the text of the buffer.
+ * @param buf The report buffer.
+ */
+void report_buf_fini(report_buf * const buf);
+
+#endif /* __REPORT_BUF_H__ */
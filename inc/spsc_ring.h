@@ -0,0 +1,82 @@
+/*****************************************************************
+ * file: spsc_ring.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the single producer/single consumer byte
+ * 		ring. More information in the source file spsc_ring.c .
+ *****************************************************************/
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+typedef struct {
+	/** Storage of the ring */
+	char			*buffer;
+	/** Size of the storage, power of two */
+	size_t			size;
+	/** Bytes written so far, only modified by the producer */
+	atomic_size_t		head;
+	/** Bytes read so far, only modified by the consumer */
+	atomic_size_t		tail;
+} spsc_ring;
+
+/**
+ * @brief Allocate the storage of the ring.
+ * @param ring The ring to initialize.
+ * @param size Size of the ring in bytes, must be a power of two.
+ * @return 0 upon success, -1 otherwise.
+ */
+int spsc_ring_init(spsc_ring * const ring, size_t size);
+
+/**
+ * @brief Release the storage of the ring.
+ * @param ring The ring to release.
+ */
+void spsc_ring_fini(spsc_ring * const ring);
+
+/**
+ * @brief Producer side: get the contiguous free space of the ring, the
+ *		producer can write there directly and then call
+ *		spsc_ring_commit.
+ * @param ring The ring.
+ * @param ptr Set to the first free byte.
+ * @return The number of contiguous free bytes.
+ */
+size_t spsc_ring_write_region(spsc_ring * const ring, char **ptr);
+
+/**
+ * @brief Producer side: publish bytes written in the region returned by
+ *		spsc_ring_write_region.
+ * @param ring The ring.
+ * @param len Number of bytes written, at most the size of the region.
+ */
+void spsc_ring_commit(spsc_ring * const ring, size_t len);
+
+/**
+ * @brief Producer side: copy bytes into the ring.
+ * @param ring The ring.
+ * @param buf Bytes to copy.
+ * @param len Number of bytes to copy.
+ * @return The number of bytes copied, lower than len if the ring is full.
+ */
+size_t spsc_ring_write(spsc_ring * const ring, const char * const buf,
+		       size_t len);
+
+/**
+ * @brief Consumer side: copy bytes out of the ring.
+ * @param ring The ring.
+ * @param buf Buffer receiving the bytes.
+ * @param len Size of the buffer.
+ * @return The number of bytes copied, 0 if the ring is empty.
+ */
+size_t spsc_ring_read(spsc_ring * const ring, char * const buf, size_t len);
+
+/**
+ * @brief Number of bytes available to the consumer.
+ * @param ring The ring.
+ * @return The number of bytes in the ring.
+ */
+size_t spsc_ring_count(spsc_ring * const ring);
+
+#endif /* __SPSC_RING_H__ */
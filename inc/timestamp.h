@@ -0,0 +1,88 @@
+/*****************************************************************
+ * file: timestamp.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the timestamp processing object.
+ *		more details in the source file timestamp.c .
+ *****************************************************************/
+#ifndef __TIMESTAMP_H__
+#define __TIMESTAMP_H__
+
+#include <processing.h>
+
+#include <stdint.h>
+
+/** The timestamp is not exact: delayed by the target or never confirmed */
+#define TIMESTAMP_PKT_DELAYED		0x01U
+/** Data value packet of a write access */
+#define TIMESTAMP_PKT_WNR		0x02U
+
+/** Event counter flags of an evtcnt packet, in arg */
+#define TIMESTAMP_PKT_EVT_CPI		0x01U
+#define TIMESTAMP_PKT_EVT_EXC		0x02U
+#define TIMESTAMP_PKT_EVT_SLEEP		0x04U
+#define TIMESTAMP_PKT_EVT_LSU		0x08U
+#define TIMESTAMP_PKT_EVT_FOLD		0x10U
+#define TIMESTAMP_PKT_EVT_CYC		0x20U
+
+/**
+ * Packet output by the timestamp object, the fields of the libswo packet are
+ * squeezed in next to its time.
+ */
+typedef struct {
+	/** Time of the packet in cycles */
+	uint64_t	ts;
+	/**
+	 * pc of the pc samples and values, payload of the source packets,
+	 * exception number, address offset or data value
+	 */
+	uint32_t	value;
+	/** libswo packet type */
+	uint8_t		type;
+	/**
+	 * Port of the source packets, comparator of the DWT packets,
+	 * function of the exception trace, 1 for a pc sample while sleeping,
+	 * TIMESTAMP_PKT_EVT_* of the event counters
+	 */
+	uint8_t		arg;
+	/** libswo size, header included, of the source and data value packets */
+	uint8_t		size;
+	/** TIMESTAMP_PKT_* flags */
+	uint8_t		flags;
+} timestamp_pkt;
+
+typedef struct timestamp_obj_st timestamp_obj;
+
+typedef int (*timestamp_set_lts_prescaler_cb) (timestamp_obj * const obj,
+					       unsigned int prescaler);
+typedef int (*timestamp_set_lts_prescaler_gbl_config_cb)
+					(timestamp_obj * const obj);
+
+/** This structure inherits from the processing object */
+struct timestamp_obj_st {
+	/** Processing abstraction object */
+	processing_obj	proc_obj;
+	/** Method setting the cycles per local timestamp tick */
+	timestamp_set_lts_prescaler_cb set_lts_prescaler;
+	/** Method setting the cycles per local timestamp tick from the config */
+	timestamp_set_lts_prescaler_gbl_config_cb set_lts_prescaler_gbl_config;
+	/** Internal data structure */
+	void		*pdata;
+};
+
+/**
+ * @brief Initialize the timestamp object. It receives libswo packets and
+ *		outputs an array of timestamp_pkt, the timestamp packets
+ *		themselves are consumed.
+ * @param obj The timestamp object.
+ * @return 0 upon success, -1 otherwise.
+ */
+int timestamp_init(timestamp_obj * const obj);
+
+/**
+ * @brief De-initialize the timestamp object.
+ * @param obj The timestamp object.
+ * @return 0 upon success, -1 otherwise.
+ */
+int timestamp_fini(timestamp_obj * const obj);
+
+#endif /* __TIMESTAMP_H__ */
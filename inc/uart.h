@@ -13,6 +13,9 @@ typedef int (*uart_set_dev_cb)(uart_obj * const obj,
 typedef int (*uart_init_dev_cb)(uart_obj * const obj);
 
 typedef int (*uart_fini_dev_cb)(uart_obj * const obj);
+typedef int (*uart_set_fill_cb)(uart_obj * const obj, size_t fill,
+				unsigned int deadline_ms);
+typedef int (*uart_set_fill_gbl_config_cb)(uart_obj * const obj);
 
 struct uart_obj_st {
 	processing_obj		proc_obj;
@@ -24,6 +27,11 @@ struct uart_obj_st {
 
 	uart_init_dev_cb	uart_init_dev;
 	uart_fini_dev_cb	uart_fini_dev;
+	/** Bytes a message is filled with before being sent, at most
+	 *  deadline_ms after the first byte arrived */
+	uart_set_fill_cb	uart_set_fill;
+	/** Same as uart_set_fill with the values of the configuration */
+	uart_set_fill_gbl_config_cb uart_set_fill_gbl_config;
 	/** private data */
 	void 	   *pdata;		
 };
@@ -0,0 +1,27 @@
+/*****************************************************************
+ * file: uart_baudrate.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: This is the header of the arbitrary UART baudrate helpers. More
+ * 		information in the source file uart_baudrate.c .
+ *****************************************************************/
+#ifndef __UART_BAUDRATE_H__
+#define __UART_BAUDRATE_H__
+
+/**
+ * @brief Set the input and output baudrate of a tty to any value, the other
+ *		settings of the tty are kept.
+ * @param fd File descriptor of the tty.
+ * @param baudrate Baudrate in bit/s.
+ * @return 0 upon success, -1 if the rate is refused or not supported.
+ */
+int uart_baudrate_set(int fd, unsigned int baudrate);
+
+/**
+ * @brief Read back the output baudrate applied to a tty.
+ * @param fd File descriptor of the tty.
+ * @param baudrate Set to the baudrate in bit/s.
+ * @return 0 upon success, -1 otherwise.
+ */
+int uart_baudrate_get(int fd, unsigned int * const baudrate);
+
+#endif /* __UART_BAUDRATE_H__ */
@@ -0,0 +1,627 @@
+/*****************************************************************
+ * file: pipeline_bench.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Micro-benchmarks of the hot paths of the pipeline: message
+ *		copies, SWO decoding, PC sample accounting, JSON conversion
+ *		and ITM memory trace parsing. The data set is synthetic and
+ *		generated from a fixed seed so runs can be compared between
+ *		releases.
+ *
+ *		Each benchmark is repeated until it ran at least
+ *		BENCH_MIN_TIME_NS. One tab separated line is printed per
+ *		benchmark:
+ *		name	unit	ops	ns_per_op	bytes_per_s
+ *		Arguments, if any, select the benchmarks whose name contains
+ *		one of them.
+ *****************************************************************/
+#include <common-macros.h>
+#include <config.h>
+#include <config_ini.h>
+#include <decoder_swo.h>
+#include <form.h>
+#include <itm2mem_info.h>
+#include <message.h>
+#include <perf_ex.h>
+
+#include <libswo/libswo.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Configuration providing the sections needed by every stage */
+#define BENCH_CONFIG_PATH	BENCHMARKING_TOP_DIR \
+				"/res/configs/memory_heap_config.ini"
+/** ELF file used to resolve the samples */
+#define BENCH_ELF_PATH		BENCHMARKING_TOP_DIR "/res/tests/main.elf"
+
+/** Minimal duration of a benchmark */
+#define BENCH_MIN_TIME_NS	200000000ULL
+/** Seed of the synthetic data set */
+#define BENCH_SEED		0x5eed5eedULL
+/** Size of the buffers copied by the message benchmarks */
+#define BENCH_MSG_LEN		4096U
+/** Size of the raw SWO capture and of a chunk fed to the decoder */
+#define BENCH_SWO_LEN		(1U << 16)
+#define BENCH_SWO_CHUNK		4096U
+/** Number of packets sent per call to the packet stages */
+#define BENCH_PKT_COUNT		256U
+/** Memory records are never released, limit the trace parsed */
+#define BENCH_ITM_MAX_BYTES	(1U << 20)
+
+typedef struct {
+	/** Number of operations done */
+	unsigned long		ops;
+	/** Number of bytes processed by these operations */
+	unsigned long long	bytes;
+} bench_result;
+
+typedef struct {
+	/** Name printed in the result */
+	const char	*name;
+	/** What one operation is */
+	const char	*unit;
+	/** Prepare the stage, 0 upon success, -1 otherwise */
+	int		(*setup)(void);
+	/** Run the given number of calls */
+	bench_result	(*run)(unsigned long calls);
+	/** Release the stage */
+	void		(*teardown)(void);
+	/** Highest number of calls, 0 if unbounded */
+	unsigned long	max_calls;
+} bench_case;
+
+static struct {
+	uint64_t		rand;
+	config_ini_obj		cfg;
+	bool			is_cfg_open;
+	message_obj		in;
+	message_obj		out;
+	char			buf[BENCH_MSG_LEN];
+	uint8_t			swo[BENCH_SWO_LEN];
+	size_t			swo_pos;
+	union libswo_packet	packets[BENCH_PKT_COUNT];
+	size_t			itm_len;
+	unsigned int		itm_records;
+	decoder_swo_obj		decoder;
+	perf_ex_obj		perf;
+	form_obj		form;
+	int			(*form_fini)(form_obj * const obj);
+	itm2mem_info_obj	itm2mem;
+} bench;
+
+/**
+ * @brief xorshift64* generator, the data set only has to be reproducible.
+ */
+static uint32_t bench_rand(void)
+{
+	bench.rand ^= bench.rand >> 12;
+	bench.rand ^= bench.rand << 25;
+	bench.rand ^= bench.rand >> 27;
+
+	return (bench.rand * 0x2545f4914f6cdd1dULL) >> 32;
+}
+
+/**
+ * @brief PC in the first 16 KiB of the flash, skewed toward its start.
+ */
+static uint32_t bench_pc(void)
+{
+	uint32_t r = bench_rand() % 0x4000;
+
+	return (0x08000000 + ((r * (bench_rand() % 0x4000)) >> 14)) & ~1U;
+}
+
+static unsigned long long bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_open_config(void)
+{
+	if (bench.is_cfg_open) {
+		return 0;
+	}
+
+	if (config_ini_init(&bench.cfg)) {
+		return -1;
+	}
+
+	if (bench.cfg.open_cfg(&bench.cfg, BENCH_CONFIG_PATH)) {
+		config_ini_fini(&bench.cfg);
+		return -1;
+	}
+
+	bench.is_cfg_open = true;
+	return 0;
+}
+
+/**
+ * @brief Raw SWO as sent by a target profiling: mostly periodic PC samples,
+ *		some local timestamps and 1 byte instrumentation packets.
+ */
+static void bench_gen_swo(void)
+{
+	size_t pos = 0;
+	uint32_t pc, r;
+
+	/* Synchronization packet */
+	memset(bench.swo, 0, 5);
+	bench.swo[5] = 0x80;
+	pos = 6;
+
+	while ((pos + 5) <= sizeof(bench.swo)) {
+		r = bench_rand() % 10;
+		if (r < 8) {
+			pc = bench_pc();
+			bench.swo[pos++] = 0x17;
+			memcpy(&bench.swo[pos], &pc, sizeof(pc));
+			pos += sizeof(pc);
+		} else if (r < 9) {
+			/* Local timestamp format 1, 2 bytes of delta */
+			bench.swo[pos++] = 0xc0;
+			bench.swo[pos++] = 0x80 | (bench_rand() & 0x7f);
+			bench.swo[pos++] = bench_rand() & 0x7f;
+		} else {
+			bench.swo[pos++] = 0x01;
+			bench.swo[pos++] = 'a' + (bench_rand() % 26);
+		}
+	}
+
+	memset(&bench.swo[pos], 0, sizeof(bench.swo) - pos);
+}
+
+static void bench_gen_pc_packets(void)
+{
+	for (unsigned int i = 0; i < BENCH_PKT_COUNT; i++) {
+		memset(&bench.packets[i], 0, sizeof(bench.packets[i]));
+		bench.packets[i].pc_sample.type =
+					LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE;
+		bench.packets[i].pc_sample.size = 5;
+		bench.packets[i].pc_sample.pc = bench_pc();
+	}
+}
+
+static void bench_gen_mixed_packets(void)
+{
+	union libswo_packet *pkt;
+
+	for (unsigned int i = 0; i < BENCH_PKT_COUNT; i++) {
+		pkt = &bench.packets[i];
+		memset(pkt, 0, sizeof(*pkt));
+
+		switch (bench_rand() % 4) {
+		case 0:
+			pkt->lts.type = LIBSWO_PACKET_TYPE_LTS;
+			pkt->lts.size = 3;
+			pkt->lts.relation = LIBSWO_LTS_REL_SYNC;
+			pkt->lts.value = bench_rand() & 0x3fff;
+			break;
+		case 1:
+			pkt->inst.type = LIBSWO_PACKET_TYPE_INST;
+			pkt->inst.size = 2;
+			pkt->inst.address = bench_rand() % 32;
+			pkt->inst.value = 'a' + (bench_rand() % 26);
+			break;
+		default:
+			pkt->pc_sample.type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE;
+			pkt->pc_sample.size = 5;
+			pkt->pc_sample.pc = bench_pc();
+			break;
+		}
+	}
+}
+
+/**
+ * @brief Instrumentation packet of the memory trace, a 32-bit ITM write.
+ */
+static void bench_put_itm_word(uint32_t word)
+{
+	union libswo_packet *pkt = &bench.packets[bench.itm_len++];
+
+	memset(pkt, 0, sizeof(*pkt));
+	pkt->inst.type = LIBSWO_PACKET_TYPE_INST;
+	pkt->inst.address = ITM2MEM_INFO_PORT;
+	pkt->inst.size = 5;
+	pkt->inst.value = word;
+}
+
+/**
+ * @brief Binary records of the memory trace: an allocation followed by its
+ *		backtrace, one word per instrumentation packet.
+ */
+static void bench_gen_itm_packets(void)
+{
+	unsigned int depth;
+
+	/* A record is at most 2 + 4 words long */
+	bench.itm_len = 0;
+	bench.itm_records = 0;
+	while (bench.itm_len <= (BENCH_PKT_COUNT - 6)) {
+		depth = 1 + (bench_rand() % 4);
+		bench_put_itm_word(ITM2MEM_REC_HEADER(ITM2MEM_REC_ALLOC, depth,
+						      8 + (bench_rand() % 256)));
+		bench_put_itm_word(0x20000000 + (bench_rand() & 0xfff8));
+
+		for (unsigned int d = 0; d < depth; d++) {
+			bench_put_itm_word(bench_pc());
+		}
+		bench.itm_records++;
+	}
+}
+
+static void bench_load_packets(void)
+{
+	bench.in.write(&bench.in, (char *) bench.packets,
+		       sizeof(bench.packets));
+}
+
+/* message */
+static int bench_message_setup(void)
+{
+	for (unsigned int i = 0; i < sizeof(bench.buf); i++) {
+		bench.buf[i] = (char) bench_rand();
+	}
+
+	return 0;
+}
+
+static bench_result bench_message_write_run(unsigned long calls)
+{
+	bench_result res = { 0 };
+
+	for (res.ops = 0; res.ops < calls; res.ops++) {
+		res.bytes += bench.in.write(&bench.in, bench.buf,
+					    sizeof(bench.buf));
+	}
+
+	return res;
+}
+
+static bench_result bench_message_cpy_run(unsigned long calls)
+{
+	bench_result res = { 0 };
+
+	bench.in.write(&bench.in, bench.buf, sizeof(bench.buf));
+	for (res.ops = 0; res.ops < calls; res.ops++) {
+		res.bytes += bench.out.cpy(&bench.out, &bench.in);
+	}
+
+	return res;
+}
+
+/* decoder_swo */
+static int bench_decoder_setup(void)
+{
+	bench_gen_swo();
+	bench.swo_pos = 0;
+
+	memset(&bench.decoder, 0, sizeof(bench.decoder));
+	return decoder_swo_init(&bench.decoder);
+}
+
+static bench_result bench_decoder_run(unsigned long calls)
+{
+	processing_obj *proc = (processing_obj *) &bench.decoder;
+	bench_result res = { 0 };
+
+	for (unsigned long i = 0; i < calls; i++) {
+		bench.in.write(&bench.in, (char *) &bench.swo[bench.swo_pos],
+			       BENCH_SWO_CHUNK);
+		bench.swo_pos = (bench.swo_pos + BENCH_SWO_CHUNK) %
+				sizeof(bench.swo);
+
+		if (proc->data_in(proc, &bench.in) == (size_t) -1) {
+			break;
+		}
+
+		/* Drain the packet ring as the pipeline would */
+		do {
+			proc->req_send_more = false;
+			proc->data_out(proc, &bench.out);
+		} while (proc->req_send_more);
+
+		res.ops += BENCH_SWO_CHUNK;
+		res.bytes += BENCH_SWO_CHUNK;
+	}
+
+	return res;
+}
+
+static void bench_decoder_teardown(void)
+{
+	decoder_swo_fini(&bench.decoder);
+}
+
+/* perf_ex */
+static int bench_perf_ex_setup(void)
+{
+	bench_gen_pc_packets();
+	bench_load_packets();
+
+	memset(&bench.perf, 0, sizeof(bench.perf));
+	if (perf_ex_init(&bench.perf)) {
+		return -1;
+	}
+
+	return bench.perf.set_elf(&bench.perf, BENCH_ELF_PATH);
+}
+
+static bench_result bench_perf_ex_run(unsigned long calls)
+{
+	processing_obj *proc = (processing_obj *) &bench.perf;
+	bench_result res = { 0 };
+
+	for (unsigned long i = 0; i < calls; i++) {
+		if (proc->data_in(proc, &bench.in) == (size_t) -1) {
+			break;
+		}
+
+		res.ops += BENCH_PKT_COUNT;
+		res.bytes += sizeof(bench.packets);
+	}
+
+	return res;
+}
+
+static void bench_perf_ex_teardown(void)
+{
+	perf_ex_fini(&bench.perf);
+}
+
+/* form_cjson and form_bin */
+static int bench_form_init(int (*form_init)(form_obj * const obj))
+{
+	processing_obj *proc = (processing_obj *) &bench.form;
+
+	bench_gen_mixed_packets();
+	bench.in.write(&bench.in, (char *) bench.packets,
+		       BENCH_PKT_COUNT * sizeof(bench.packets[0]));
+
+	if (bench_open_config()) {
+		return -1;
+	}
+
+	memset(&bench.form, 0, sizeof(bench.form));
+	if (form_init(&bench.form)) {
+		return -1;
+	}
+
+	/* The first output holds the session information, skip it */
+	proc->data_in(proc, &bench.in);
+	proc->data_out(proc, &bench.out);
+
+	return 0;
+}
+
+static int bench_form_setup(void)
+{
+	bench.form_fini = form_cjson_fini;
+	return bench_form_init(form_cjson_init);
+}
+
+static int bench_form_bin_setup(void)
+{
+	bench.form_fini = form_bin_fini;
+	return bench_form_init(form_bin_init);
+}
+
+static bench_result bench_form_run(unsigned long calls)
+{
+	processing_obj *proc = (processing_obj *) &bench.form;
+	bench_result res = { 0 };
+	size_t n;
+
+	for (unsigned long i = 0; i < calls; i++) {
+		if (proc->data_in(proc, &bench.in) == (size_t) -1) {
+			break;
+		}
+
+		/* The packets may take several messages */
+		do {
+			proc->req_send_more = false;
+			bench.out.set_length(&bench.out, 0);
+			if ((n = proc->data_out(proc, &bench.out)) ==
+			    (size_t) -1) {
+				return res;
+			}
+
+			res.bytes += n;
+		} while (proc->req_send_more);
+
+		res.ops += BENCH_PKT_COUNT;
+	}
+
+	return res;
+}
+
+static void bench_form_teardown(void)
+{
+	bench.form_fini(&bench.form);
+}
+
+/* itm2mem_info */
+static int bench_itm2mem_setup(void)
+{
+	bench_gen_itm_packets();
+	bench.in.write(&bench.in, (char *) bench.packets,
+		       bench.itm_len * sizeof(bench.packets[0]));
+
+	if (bench_open_config()) {
+		return -1;
+	}
+
+	memset(&bench.itm2mem, 0, sizeof(bench.itm2mem));
+	return itm2mem_info_init(&bench.itm2mem);
+}
+
+static bench_result bench_itm2mem_run(unsigned long calls)
+{
+	processing_obj *proc = (processing_obj *) &bench.itm2mem;
+	bench_result res = { 0 };
+
+	for (unsigned long i = 0; i < calls; i++) {
+		proc->data_in(proc, &bench.in);
+		res.ops += bench.itm_records;
+		res.bytes += bench.itm_len * sizeof(uint32_t);
+	}
+
+	return res;
+}
+
+static void bench_itm2mem_teardown(void)
+{
+	itm2mem_info_fini(&bench.itm2mem);
+}
+
+static const bench_case bench_cases[] = {
+	{
+		.name = "message_write",
+		.unit = "write_4k",
+		.setup = bench_message_setup,
+		.run = bench_message_write_run,
+	},
+	{
+		.name = "message_cpy",
+		.unit = "cpy_4k",
+		.setup = bench_message_setup,
+		.run = bench_message_cpy_run,
+	},
+	{
+		.name = "decoder_swo_data_in",
+		.unit = "byte",
+		.setup = bench_decoder_setup,
+		.run = bench_decoder_run,
+		.teardown = bench_decoder_teardown,
+	},
+	{
+		.name = "perf_ex_data_in",
+		.unit = "sample",
+		.setup = bench_perf_ex_setup,
+		.run = bench_perf_ex_run,
+		.teardown = bench_perf_ex_teardown,
+	},
+	{
+		.name = "form_json",
+		.unit = "packet",
+		.setup = bench_form_setup,
+		.run = bench_form_run,
+		.teardown = bench_form_teardown,
+	},
+	{
+		.name = "form_bin",
+		.unit = "packet",
+		.setup = bench_form_bin_setup,
+		.run = bench_form_run,
+		.teardown = bench_form_teardown,
+	},
+	{
+		.name = "itm2mem_info_data_in",
+		.unit = "record",
+		.setup = bench_itm2mem_setup,
+		.run = bench_itm2mem_run,
+		.teardown = bench_itm2mem_teardown,
+		.max_calls = BENCH_ITM_MAX_BYTES /
+			     (BENCH_PKT_COUNT * sizeof(uint32_t)),
+	},
+};
+
+static bool bench_is_selected(const bench_case *bc, int argc, char **argv)
+{
+	if (argc < 2) {
+		return true;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (strstr(bc->name, argv[i])) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Run a benchmark with an increasing number of calls until it lasts
+ *		long enough to be measured.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int bench_run_case(const bench_case *bc)
+{
+	unsigned long long start, elapsed;
+	unsigned long calls = 1;
+	bench_result res;
+
+	bench.rand = BENCH_SEED;
+	if (bc->setup()) {
+		fprintf(stderr, "%s: setup failed\n", bc->name);
+		return -1;
+	}
+
+	for (;;) {
+		start = bench_now_ns();
+		res = bc->run(calls);
+		elapsed = bench_now_ns() - start;
+
+		if (!res.ops) {
+			fprintf(stderr, "%s: run failed\n", bc->name);
+			break;
+		}
+
+		if ((elapsed >= BENCH_MIN_TIME_NS) ||
+		    (bc->max_calls && (calls >= bc->max_calls))) {
+			break;
+		}
+
+		calls *= 2;
+		if (bc->max_calls && (calls > bc->max_calls)) {
+			calls = bc->max_calls;
+		}
+	}
+
+	if (res.ops && elapsed) {
+		printf("%s\t%s\t%lu\t%.3f\t%.0f\n", bc->name, bc->unit,
+		       res.ops, (double) elapsed / res.ops,
+		       res.bytes * 1e9 / elapsed);
+	}
+
+	if (bc->teardown) {
+		bc->teardown();
+	}
+
+	return res.ops ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	int rc = EXIT_SUCCESS;
+
+	if (message_init(&bench.in) || message_init(&bench.out)) {
+		return EXIT_FAILURE;
+	}
+
+	printf("# name\tunit\tops\tns_per_op\tbytes_per_s\n");
+	for (unsigned int i = 0; i < ARRAY_SIZE(bench_cases); i++) {
+		if (!bench_is_selected(&bench_cases[i], argc, argv)) {
+			continue;
+		}
+
+		if (bench_run_case(&bench_cases[i])) {
+			rc = EXIT_FAILURE;
+		}
+	}
+
+	message_fini(&bench.in);
+	message_fini(&bench.out);
+	if (bench.is_cfg_open) {
+		config_ini_fini(&bench.cfg);
+	}
+
+	return rc;
+}
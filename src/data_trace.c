@@ -0,0 +1,586 @@
+/*****************************************************************
+ * file: data_trace.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: DWT data trace processing object. It receives the timestamped
+ * 		packets of the timestamp object and follows the data value and
+ * 		address offset packets emitted by the DWT comparators watching
+ * 		variables.
+ *
+ * 		The packets only carry the number of the comparator: each one
+ * 		is given the name of the variable it watches, its address and
+ * 		size are then taken from the data object symbols of the elf
+ * 		file. An address offset packet is attached to the data value
+ * 		packet of the same comparator following it.
+ *
+ * 		Per comparator it accounts the reads and writes, their rate per
+ * 		million cycles, the changes of value, the writes storing the
+ * 		value already there, and keeps the last DATA_TRACE_RING_LEN
+ * 		accesses in a ring. A report with their timeline is written at
+ * 		the end of the session.
+ *****************************************************************/
+#include <config.h>
+#include <data_trace.h>
+#include <debug.h>
+#include <elf_sym.h>
+#include <message.h>
+#include <report_buf.h>
+#include <timestamp.h>
+
+#include <libswo/libswo.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Write access */
+#define DATA_TRACE_EVT_WRITE	0x01U
+/** The offset of the access is known */
+#define DATA_TRACE_EVT_OFFSET	0x02U
+/** The time of the access is approximate */
+#define DATA_TRACE_EVT_DELAYED	0x04U
+
+/** An access to a variable, kept in the ring of its comparator */
+typedef struct {
+	/** Time of the access in cycles */
+	uint64_t	ts;
+	/** Value read or written */
+	uint32_t	value;
+	/** Offset of the access in the variable, DATA_TRACE_EVT_OFFSET set */
+	uint16_t	offset;
+	/** Size of the value in bytes */
+	uint8_t		size;
+	/** DATA_TRACE_EVT_* flags */
+	uint8_t		flags;
+} data_trace_evt;
+
+/** A DWT comparator and the variable it watches */
+typedef struct {
+	/** Name of the variable, NULL if not set */
+	char		*name;
+	/** Address of the variable */
+	unsigned int	addr;
+	/** Size of the variable in bytes, 0 if unknown */
+	unsigned int	size;
+	/** Number of read accesses */
+	unsigned long	reads;
+	/** Number of write accesses */
+	unsigned long	writes;
+	/** Number of accesses seeing another value than the previous one */
+	unsigned long	changes;
+	/** Number of writes storing the value already there */
+	unsigned long	silent_writes;
+	/** Number of address offset packets */
+	unsigned long	offsets;
+	/** Smallest value seen */
+	uint32_t	min;
+	/** Largest value seen */
+	uint32_t	max;
+	/** Last value seen */
+	uint32_t	last;
+	/** Time of the first access */
+	uint64_t	first_ts;
+	/** Time of the last access */
+	uint64_t	last_ts;
+	/** Offset of the address offset packet waiting for its data value */
+	uint16_t	offset;
+	/** Set while an address offset packet waits for its data value */
+	bool		is_offset;
+	/** Last accesses, the oldest one at ring_head once the ring is full */
+	data_trace_evt	ring[DATA_TRACE_RING_LEN];
+	/** Next slot written in the ring */
+	unsigned int	ring_head;
+	/** Number of accesses in the ring */
+	unsigned int	ring_count;
+} data_trace_cmp;
+
+/** Private data of the data trace object */
+typedef struct {
+	/** Check if the object is initialized to avoid double init/fini */
+	bool		is_init;
+	/** Data object symbols of the elf file, NULL if not loaded */
+	elf_sym_table	*syms;
+	/** The comparators, by number */
+	data_trace_cmp	*cmp;
+	/** Number of data value packets */
+	unsigned long	values;
+	/** Number of packets with an approximate time */
+	unsigned long	approximate;
+	/** Report, built at the end of the session */
+	report_buf	report;
+	/** Set once the report is built */
+	bool		is_reported;
+} data_trace_private_data;
+
+static data_trace_private_data data_trace_priv_data;
+
+/**
+ * @brief Mask of the bytes of a data value packet.
+ * @param size Size of the libswo packet, header included.
+ */
+static inline uint32_t data_trace_mask(unsigned int size)
+{
+	return (size == 2) ? 0xffU : (size == 3) ? 0xffffU : 0xffffffffU;
+}
+
+/**
+ * @brief Account an address offset packet, it waits for the data value of
+ *		the comparator.
+ * @param cmp The comparator.
+ * @param pkt The packet.
+ */
+static void data_trace_offset(data_trace_cmp * const cmp,
+			      const timestamp_pkt * const pkt)
+{
+	cmp->offsets++;
+	cmp->offset = pkt->value;
+	cmp->is_offset = true;
+}
+
+/**
+ * @brief Account a data value packet and keep it in the ring.
+ * @param cmp The comparator.
+ * @param pkt The packet.
+ */
+static void data_trace_value(data_trace_cmp * const cmp,
+			     const timestamp_pkt * const pkt)
+{
+	uint32_t value = pkt->value & data_trace_mask(pkt->size);
+	bool is_write = pkt->flags & TIMESTAMP_PKT_WNR;
+	data_trace_evt *evt;
+
+	if (!cmp->reads && !cmp->writes) {
+		cmp->first_ts = pkt->ts;
+		cmp->min = value;
+		cmp->max = value;
+	} else if (value != cmp->last) {
+		cmp->changes++;
+	} else if (is_write) {
+		cmp->silent_writes++;
+	}
+
+	if (value < cmp->min) {
+		cmp->min = value;
+	}
+
+	if (value > cmp->max) {
+		cmp->max = value;
+	}
+
+	if (is_write) {
+		cmp->writes++;
+	} else {
+		cmp->reads++;
+	}
+
+	cmp->last = value;
+	cmp->last_ts = pkt->ts;
+
+	evt = &cmp->ring[cmp->ring_head];
+	evt->ts = pkt->ts;
+	evt->value = value;
+	evt->size = (pkt->size > 1) ? (pkt->size - 1) : 0;
+	evt->offset = cmp->offset;
+	evt->flags = (is_write ? DATA_TRACE_EVT_WRITE : 0) |
+		     (cmp->is_offset ? DATA_TRACE_EVT_OFFSET : 0) |
+		     ((pkt->flags & TIMESTAMP_PKT_DELAYED) ?
+		      DATA_TRACE_EVT_DELAYED : 0);
+	cmp->is_offset = false;
+
+	cmp->ring_head = (cmp->ring_head + 1) % DATA_TRACE_RING_LEN;
+	if (cmp->ring_count < DATA_TRACE_RING_LEN) {
+		cmp->ring_count++;
+	}
+}
+
+/**
+ * @brief This is the receiving callback, it follows the data value and
+ *		address offset packets, the other packets are skipped.
+ * @param proc_obj Processing obj abstraction.
+ * @param msg Message holding a table of timestamp_pkt.
+ * @return The number of bytes read.
+ */
+static size_t
+data_trace_data_in(processing_obj * const proc_obj, message_obj * const msg)
+{
+	data_trace_obj *obj = (data_trace_obj *) proc_obj;
+	data_trace_private_data *pdata = (data_trace_private_data *) obj->pdata;
+	const timestamp_pkt *pkts = (const timestamp_pkt *) msg->ptr(msg);
+	size_t pkt_count = msg->length(msg) / sizeof(timestamp_pkt);
+
+	for (size_t i = 0; i < pkt_count; i++) {
+		if (pkts[i].arg >= DATA_TRACE_CMP_MAX) {
+			continue;
+		}
+
+		switch (pkts[i].type) {
+		case LIBSWO_PACKET_TYPE_DWT_ADDR_OFFSET:
+			data_trace_offset(&pdata->cmp[pkts[i].arg], &pkts[i]);
+			break;
+		case LIBSWO_PACKET_TYPE_DWT_DATA_VALUE:
+			pdata->values++;
+			if (pkts[i].flags & TIMESTAMP_PKT_DELAYED) {
+				pdata->approximate++;
+			}
+
+			data_trace_value(&pdata->cmp[pkts[i].arg], &pkts[i]);
+			break;
+		default:
+			break;
+		}
+	}
+
+	proc_obj->stats.packets += pkt_count;
+	return pkt_count * sizeof(timestamp_pkt);
+}
+
+/**
+ * @brief Print the accesses kept in the ring of a comparator, the oldest
+ *		first: time, r or w, value, +offset when known and ~ when the
+ *		time is approximate.
+ * @param out Report stream.
+ * @param cmp The comparator.
+ */
+static void data_trace_print_ring(FILE *out, const data_trace_cmp * const cmp)
+{
+	unsigned int start = (cmp->ring_head + DATA_TRACE_RING_LEN -
+			      cmp->ring_count) % DATA_TRACE_RING_LEN;
+	const data_trace_evt *evt;
+
+	fprintf(out, "timeline: %u of %lu accesses\n", cmp->ring_count,
+		cmp->reads + cmp->writes);
+
+	for (unsigned int i = 0; i < cmp->ring_count; i++) {
+		evt = &cmp->ring[(start + i) % DATA_TRACE_RING_LEN];
+		fprintf(out, "\t%llu %c 0x%0*x", (unsigned long long) evt->ts,
+			(evt->flags & DATA_TRACE_EVT_WRITE) ? 'w' : 'r',
+			evt->size ? (int) (evt->size * 2) : 8, evt->value);
+		if (evt->flags & DATA_TRACE_EVT_OFFSET) {
+			fprintf(out, " +%u", evt->offset);
+		}
+
+		fprintf(out, "%s\n",
+			(evt->flags & DATA_TRACE_EVT_DELAYED) ? " ~" : "");
+	}
+}
+
+/**
+ * @brief Build the report: a summary, then one block per comparator with a
+ *		variable or accesses.
+ * @param pdata Private data.
+ * @return 0 upon success, -1 if the report could not be allocated.
+ */
+static int data_trace_build_report(data_trace_private_data * const pdata)
+{
+	const data_trace_cmp *cmp;
+	unsigned long accesses;
+	uint64_t span;
+	FILE *out;
+
+	if (!(out = report_buf_stream(&pdata->report))) {
+		return -1;
+	}
+
+	fprintf(out, "data_trace: values %lu approximate %lu\n", pdata->values,
+		pdata->approximate);
+
+	for (unsigned int i = 0; i < DATA_TRACE_CMP_MAX; i++) {
+		cmp = &pdata->cmp[i];
+		accesses = cmp->reads + cmp->writes;
+		if (!cmp->name && !accesses && !cmp->offsets) {
+			continue;
+		}
+
+		if (cmp->name) {
+			fprintf(out, "\nvariable: %s (comparator %u) address: "
+				"0x%08x size: %u\n", cmp->name, i, cmp->addr,
+				cmp->size);
+		} else {
+			fprintf(out, "\nvariable: - (comparator %u)\n", i);
+		}
+
+		span = cmp->last_ts - cmp->first_ts;
+		fprintf(out, "accesses: reads %lu writes %lu offsets %lu "
+			"rate_per_mcycle %.1f\n", cmp->reads, cmp->writes,
+			cmp->offsets,
+			span ? (double) accesses * 1000000.0 / span : 0.0);
+
+		if (!accesses) {
+			continue;
+		}
+
+		fprintf(out, "values: changes %lu silent_writes %lu min 0x%x "
+			"max 0x%x last 0x%x\n", cmp->changes,
+			cmp->silent_writes, cmp->min, cmp->max, cmp->last);
+		data_trace_print_ring(out, cmp);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief This is the sending callback. Nothing is written before the end of
+ *		the session, the report is then written in chunks of at most
+ *		one message.
+ * @param proc_obj Processing obj abstraction.
+ * @param msg Message where the report is written.
+ * @return The number of bytes written.
+ */
+static size_t
+data_trace_data_out(processing_obj * const proc_obj, message_obj * const msg)
+{
+	data_trace_obj *obj = (data_trace_obj *) proc_obj;
+	data_trace_private_data *pdata = (data_trace_private_data *) obj->pdata;
+
+	if (!proc_obj->req_end) {
+		return 0;
+	}
+
+	if (!pdata->is_reported) {
+		pdata->is_reported = true;
+		if (data_trace_build_report(pdata)) {
+			return 0;
+		}
+	}
+
+	return report_buf_send(&pdata->report, proc_obj, msg);
+}
+
+/**
+ * @brief This function loads the data object symbols of the elf file, any
+ *		previously loaded table is released.
+ * @param obj The processing object pointer abstraction.
+ * @param path Path to the elf file.
+ * @return 0 if successfully loaded the file, -1 otherwise.
+ */
+static int data_trace_set_elf(data_trace_obj * const obj,
+			      const char * const path)
+{
+	data_trace_private_data *pdata = (data_trace_private_data *) obj->pdata;
+	elf_sym_table *syms;
+
+	if (!(syms = elf_sym_load(path))) {
+		return -1;
+	}
+
+	elf_sym_free(pdata->syms);
+	pdata->syms = syms;
+	return 0;
+}
+
+/**
+ * @brief This function loads the elf file whose path is found in the config
+ *		object.
+ * @param obj The processing object pointer abstraction.
+ * @pre The config object must be initialized.
+ * @return 0 if successfully loaded the file, -1 otherwise.
+ */
+static int data_trace_set_elf_gbl_config(data_trace_obj * const obj)
+{
+	cfg_param param = {
+				.section = CFG_SECTION_EXT_BIN,
+				.type = CONFIG_STR,
+				.name = CFG_SECTION_EXT_BIN_ELF,
+			  };
+	const char *path;
+
+	path = CONFIG_HELPER_GET_STR(&param);
+	if (!param.found) {
+		ERROR("%s/%s is not configured\n", param.section, param.name);
+		return -1;
+	}
+
+	return data_trace_set_elf(obj, path);
+}
+
+/**
+ * @brief This function names the variable watched by a comparator, its
+ *		address and size are taken from the elf file.
+ * @param obj The processing object pointer abstraction.
+ * @param cmpn Number of the comparator.
+ * @param name Name of the variable.
+ * @return 0 upon success, -1 if the variable is not in the elf file.
+ * @pre The elf file is loaded.
+ */
+static int data_trace_set_variable(data_trace_obj * const obj,
+				   unsigned int cmpn, const char * const name)
+{
+	data_trace_private_data *pdata = (data_trace_private_data *) obj->pdata;
+	data_trace_cmp *cmp;
+	unsigned int addr, size;
+	char *dup;
+
+	if (cmpn >= DATA_TRACE_CMP_MAX) {
+		ERROR("No comparator %u\n", cmpn);
+		return -1;
+	}
+
+	if (!pdata->syms) {
+		ERROR("Provide a valid elf file\n");
+		return -1;
+	}
+
+	if (elf_sym_find_object(pdata->syms, name, &addr, &size)) {
+		ERROR("No variable %s in the elf file\n", name);
+		return -1;
+	}
+
+	if (!(dup = strdup(name))) {
+		ERROR("Could not allocate memory\n");
+		return -1;
+	}
+
+	cmp = &pdata->cmp[cmpn];
+	free(cmp->name);
+	cmp->name = dup;
+	cmp->addr = addr;
+	cmp->size = size;
+
+	return 0;
+}
+
+/**
+ * @brief This function names the variables of the comparators found in the
+ *		config object, comparator0 to comparator3.
+ * @param obj The processing object pointer abstraction.
+ * @pre The config object must be initialized.
+ * @return 0 upon success, -1 if a variable is not in the elf file.
+ */
+static int data_trace_set_variables_gbl_config(data_trace_obj * const obj)
+{
+	char key[sizeof(CFG_SECTION_DATA_TRACE_COMPARATOR) + 4];
+	cfg_param param = {
+				.section = CFG_SECTION_DATA_TRACE,
+				.type = CONFIG_STR,
+				.name = key,
+			  };
+	const char *name;
+
+	for (unsigned int i = 0; i < DATA_TRACE_CMP_MAX; i++) {
+		snprintf(key, sizeof(key), CFG_SECTION_DATA_TRACE_COMPARATOR
+			 "%u", i);
+		name = CONFIG_HELPER_GET_STR(&param);
+		if (!param.found || !*name) {
+			continue;
+		}
+
+		DEBUG("\t-comparator %u: %s\n", i, name);
+		if (data_trace_set_variable(obj, i, name)) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @return -1.
+ */
+static int data_trace_set_elf_default(data_trace_obj * const obj,
+				      const char * const path)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @return -1.
+ */
+static int data_trace_set_elf_gbl_config_default(data_trace_obj * const obj)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @return -1.
+ */
+static int data_trace_set_variable_default(data_trace_obj * const obj,
+					   unsigned int cmpn,
+					   const char * const name)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @return -1.
+ */
+static int
+data_trace_set_variables_gbl_config_default(data_trace_obj * const obj)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
+int data_trace_init(data_trace_obj * const obj)
+{
+	processing_obj *proc_obj = (processing_obj *) obj;
+	data_trace_private_data *pdata = &data_trace_priv_data;
+
+	if (pdata->is_init) {
+		ERROR("Cannot initialize more than one instance\n");
+		return -1;
+	}
+
+	if (processing_init(proc_obj)) {
+		return -1;
+	}
+
+	memset(pdata, 0, sizeof(*pdata));
+	if (!(pdata->cmp = calloc(DATA_TRACE_CMP_MAX, sizeof(*pdata->cmp)))) {
+		ERROR("Could not allocate memory\n");
+		processing_fini(proc_obj);
+		return -1;
+	}
+
+	proc_obj->name = "data_trace";
+	obj->pdata = (void *) pdata;
+
+	obj->set_elf = data_trace_set_elf;
+	obj->set_elf_gbl_config = data_trace_set_elf_gbl_config;
+	obj->set_variable = data_trace_set_variable;
+	obj->set_variables_gbl_config = data_trace_set_variables_gbl_config;
+
+	proc_obj->data_in = data_trace_data_in;
+	proc_obj->data_out = data_trace_data_out;
+
+	pdata->is_init = true;
+
+	return 0;
+}
+
+int data_trace_fini(data_trace_obj * const obj)
+{
+	data_trace_private_data *pdata = &data_trace_priv_data;
+
+	if (!pdata->is_init) {
+		ERROR("Not initialized\n");
+		return -1;
+	}
+
+	obj->set_elf = data_trace_set_elf_default;
+	obj->set_elf_gbl_config = data_trace_set_elf_gbl_config_default;
+	obj->set_variable = data_trace_set_variable_default;
+	obj->set_variables_gbl_config =
+				data_trace_set_variables_gbl_config_default;
+
+	for (unsigned int i = 0; i < DATA_TRACE_CMP_MAX; i++) {
+		free(pdata->cmp[i].name);
+	}
+
+	free(pdata->cmp);
+	pdata->cmp = NULL;
+	elf_sym_free(pdata->syms);
+	pdata->syms = NULL;
+	report_buf_fini(&pdata->report);
+
+	processing_fini((processing_obj *) obj);
+	pdata->is_init = false;
+	return 0;
+}
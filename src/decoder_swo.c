@@ -6,15 +6,15 @@
  */
 #include <decoder_swo.h>
 #include <common-macros.h>
+#include <config.h>
 #include <debug.h>
 
 #include <libswo/libswo.h>
 
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define DECODER_SWO_BUFFER_MAX_LEN	4096
-
 /** Internal private data used to keep track of the number of packets decodded
  * 	and if the element was initialized or not.
  */
@@ -29,7 +29,19 @@ typedef struct {
 	/** Number of packet decoded on last decoding sessionl */
 	unsigned int cur_packet_decoded;
 	/** Number of packet decoded since the start of the applicationl */
-	unsigned int tot_packet_decoded;
+	unsigned long tot_packet_decoded;
+	/** Ring of the decoded packets waiting to be sent to the children */
+	union libswo_packet *ring;
+	/** Number of packets the ring can hold */
+	unsigned int ring_len;
+	/** Index of the oldest packet of the ring */
+	unsigned int ring_head;
+	/** Number of packets in the ring */
+	unsigned int ring_count;
+	/** Number of packets dropped because the ring was full */
+	unsigned long dropped;
+	/** Packet types kept besides the filter, one bit per type */
+	unsigned int keep_mask;
 	/**
 	 * Indicating if yes or not the object is used or not, avoid double
 	 * init/fini on the same object.
@@ -44,9 +56,6 @@ typedef struct {
 /** Instantiation of the only decoder that can be runned */
 static decoder_swo_priv_data decoder_swo_pdata;
 
-/** Buffer holding number of packet to hold. */
-static union libswo_packet packets_decoded[DECODER_SWO_BUFFER_MAX_LEN / sizeof(union libswo_packet)];
-
 /**
  * @brief The default packet handler, here for debug only.
  * @param packet Information about the SWD packet.
@@ -172,11 +181,19 @@ static int packet_cb(struct libswo_context *ctx,
 
 
 	/** Dedicated filter depending on the packet */
-	if (!pdata->filter_cb(packet)) {
+	if (!pdata->filter_cb(packet) &&
+	    !(pdata->keep_mask & (1U << packet->type))) {
 		return true;
 	}
 
-	memcpy(&packets_decoded[pdata->cur_packet_decoded], packet, sizeof(*packet));
+	if (pdata->ring_count == pdata->ring_len) {
+		pdata->dropped++;
+		return true;
+	}
+
+	memcpy(&pdata->ring[(pdata->ring_head + pdata->ring_count) %
+			    pdata->ring_len], packet, sizeof(*packet));
+	pdata->ring_count++;
 	pdata->cur_packet_decoded++;
 
 	return true;
@@ -194,8 +211,10 @@ static size_t decoder_swo_data_in(processing_obj * const obj,
 	decoder_swo_obj *dec_swo = (decoder_swo_obj *) obj;
 	decoder_swo_priv_data *pdata =
 		(decoder_swo_priv_data *) dec_swo->pdata;
+	unsigned long dropped = pdata->dropped;
 	int ret;
 
+	pdata->cur_packet_decoded = 0;
 	ret = libswo_feed(pdata->swo_ctx,
 			       msg->ptr(msg), msg->length(msg));
 	if (ret) {
@@ -210,18 +229,27 @@ static size_t decoder_swo_data_in(processing_obj * const obj,
 		ERROR(" --> %s\n", libswo_strerror_name(ret));
 		return -1;
 	}
+	if (pdata->dropped != dropped) {
+		WARNING("Packet ring full, %lu packets dropped (%lu total)\n",
+			pdata->dropped - dropped, pdata->dropped);
+	}
+
 	pdata->tot_packet_decoded += pdata->cur_packet_decoded;
+	obj->stats.packets += pdata->cur_packet_decoded;
 	DEBUG("decoded %d\n", pdata->cur_packet_decoded);
 	DEBUG("total size decoded %ld\n",
 			pdata->cur_packet_decoded* sizeof (union libswo_packet));
-	DEBUG("Total number of decoded packet %d\n", pdata->tot_packet_decoded);
+	DEBUG("Total number of decoded packet %lu\n", pdata->tot_packet_decoded);
 	return pdata->cur_packet_decoded * sizeof (union libswo_packet);
 }
 
 /**
- * @brief The function that feeds the decoder.
+ * @brief The function sending the decoded packets to the children. At most
+ *		one message of packets is sent, req_send_more is set as long as
+ *		packets are left in the ring so the whole batch is sent before
+ *		the next data is read.
  * @param obj The generic processing object.
- * @param msg The message data coming form the above level.
+ * @param msg The message where the packets are written.
  * @return The number of written bytes written, -1 on error.
  */
 static size_t decoder_swo_data_out(processing_obj * const obj,
@@ -229,15 +257,33 @@ static size_t decoder_swo_data_out(processing_obj * const obj,
 {
 	decoder_swo_obj *dec_swo = (decoder_swo_obj *) obj;
 	decoder_swo_priv_data *pdata = (decoder_swo_priv_data *) dec_swo->pdata;
-	message_obj *msg_internal = &pdata->msg;
-	unsigned int __packet_decoded ;
+	unsigned int __packet_decoded, first;
+
+	__packet_decoded = msg->total_len(msg) / sizeof (union libswo_packet);
+	if (__packet_decoded > pdata->ring_count) {
+		__packet_decoded = pdata->ring_count;
+	}
+
+	/* The packets might wrap around the end of the ring */
+	first = pdata->ring_len - pdata->ring_head;
+	if (first > __packet_decoded) {
+		first = __packet_decoded;
+	}
 
-	msg->write(msg, (void *) packets_decoded,
-	       pdata->cur_packet_decoded * sizeof (union libswo_packet));
+	msg->write(msg, (void *) &pdata->ring[pdata->ring_head],
+		   first * sizeof (union libswo_packet));
+	if (__packet_decoded > first) {
+		msg->append(msg, (void *) pdata->ring,
+			    (__packet_decoded - first) *
+			    sizeof (union libswo_packet));
+	}
+
+	pdata->ring_head = (pdata->ring_head + __packet_decoded) %
+			   pdata->ring_len;
+	pdata->ring_count -= __packet_decoded;
+	obj->req_send_more = (pdata->ring_count != 0);
 
-	__packet_decoded = pdata->cur_packet_decoded;
 	DEBUG("Number of data received %ld\n", __packet_decoded * sizeof (union libswo_packet));
-	pdata->cur_packet_decoded = 0;
 
 	return __packet_decoded * sizeof (union libswo_packet);
 }
@@ -302,6 +348,85 @@ static int decoder_swo_set_filter(decoder_swo_obj * const obj)
 	return 0;
 }
 
+/**
+ * @brief Read from the configuration the packets kept besides the filter:
+ *		the timestamps, the exception trace, the event counters and
+ *		the data trace.
+ * @param pdata Private data.
+ */
+static void decoder_swo_set_keep_mask(decoder_swo_priv_data * const pdata)
+{
+	unsigned int value;
+	cfg_param param = {
+				.section = CFG_SECTION_DECODER_SWO,
+				.type = CONFIG_UNSIGNED_INT,
+				.name = CFG_SECTION_DECODER_SWO_TIMESTAMPS,
+			  };
+
+	pdata->keep_mask = 0;
+	value = CONFIG_HELPER_GET_U32(&param);
+	if (param.found && value) {
+		pdata->keep_mask |= (1U << LIBSWO_PACKET_TYPE_LTS) |
+				    (1U << LIBSWO_PACKET_TYPE_GTS1) |
+				    (1U << LIBSWO_PACKET_TYPE_GTS2);
+	}
+
+	param.name = CFG_SECTION_DECODER_SWO_EXCTRC;
+	value = CONFIG_HELPER_GET_U32(&param);
+	if (param.found && value) {
+		pdata->keep_mask |= (1U << LIBSWO_PACKET_TYPE_DWT_EXCTRC);
+	}
+
+	param.name = CFG_SECTION_DECODER_SWO_EVTCNT;
+	value = CONFIG_HELPER_GET_U32(&param);
+	if (param.found && value) {
+		pdata->keep_mask |= (1U << LIBSWO_PACKET_TYPE_DWT_EVTCNT);
+	}
+
+	param.name = CFG_SECTION_DECODER_SWO_DATATRACE;
+	value = CONFIG_HELPER_GET_U32(&param);
+	if (param.found && value) {
+		pdata->keep_mask |= (1U << LIBSWO_PACKET_TYPE_DWT_ADDR_OFFSET) |
+				    (1U << LIBSWO_PACKET_TYPE_DWT_DATA_VALUE);
+	}
+
+	DEBUG("Packet types kept besides the filter: %#x\n", pdata->keep_mask);
+}
+
+/**
+ * @brief Allocate the packet ring. Its length is taken from the configuration
+ *		when set, DECODER_SWO_RING_LEN_DEFAULT otherwise.
+ * @param pdata Private data holding the ring.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int decoder_swo_alloc_ring(decoder_swo_priv_data * const pdata)
+{
+	unsigned int ring_len;
+	cfg_param param = {
+				.section = CFG_SECTION_DECODER_SWO,
+				.type = CONFIG_UNSIGNED_INT,
+				.name = CFG_SECTION_DECODER_SWO_RING_LEN,
+			  };
+
+	ring_len = CONFIG_HELPER_GET_U32(&param);
+	if (!param.found || !ring_len) {
+		ring_len = DECODER_SWO_RING_LEN_DEFAULT;
+	}
+
+	if (!(pdata->ring = calloc(ring_len, sizeof(*pdata->ring)))) {
+		ERROR("Could not allocate the packet ring\n");
+		return -1;
+	}
+
+	pdata->ring_len = ring_len;
+	pdata->ring_head = 0;
+	pdata->ring_count = 0;
+	pdata->dropped = 0;
+	DEBUG("Packet ring of %u packets\n", ring_len);
+
+	return 0;
+}
+
 int decoder_swo_init(decoder_swo_obj * const obj)
 {
 	processing_obj *proc_obj = (processing_obj *) obj;
@@ -312,6 +437,8 @@ int decoder_swo_init(decoder_swo_obj * const obj)
 		goto processing_init_failed;
 	}
 
+	proc_obj->name = "decoder_swo";
+
 	if (!(pdata = decoder_swo_get_free_instance())) {
 		goto get_free_instance_failed;
 	}
@@ -322,12 +449,18 @@ int decoder_swo_init(decoder_swo_obj * const obj)
 		goto filter_setup_failed;
 	}
 
+	decoder_swo_set_keep_mask(pdata);
+
 	if (message_init(&pdata->msg)) {
 		goto message_init_failed;
 	}
 
 	msg = &pdata->msg;
 
+	if (decoder_swo_alloc_ring(pdata)) {
+		goto alloc_ring_failed;
+	}
+
 	proc_obj->data_in  = decoder_swo_data_in;
 	proc_obj->data_out = decoder_swo_data_out;
 
@@ -347,6 +480,10 @@ int decoder_swo_init(decoder_swo_obj * const obj)
 libswo_set_callback_failed:
 	libswo_exit(pdata->swo_ctx);
 libswo_init_failed:
+	free(pdata->ring);
+	pdata->ring = NULL;
+alloc_ring_failed:
+	message_fini(msg);
 filter_setup_failed:
 message_init_failed:
 get_free_instance_failed:
@@ -361,6 +498,14 @@ int decoder_swo_fini(decoder_swo_obj * const obj)
 	decoder_swo_priv_data *pdata = (decoder_swo_priv_data *) obj->pdata;
 	message_obj *msg = &pdata->msg;
 
+	if (pdata->dropped) {
+		WARNING("%lu packets dropped, increase [%s] %s\n",
+			pdata->dropped, CFG_SECTION_DECODER_SWO,
+			CFG_SECTION_DECODER_SWO_RING_LEN);
+	}
+
+	free(pdata->ring);
+	pdata->ring = NULL;
 	message_fini(msg);
 	processing_fini(proc_obj);
 
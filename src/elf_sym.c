@@ -0,0 +1,1054 @@
+/*****************************************************************
+ * file: elf_sym.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: In-process symbolizer used to translate PC samples into
+ * 		function/file/line information without forking addr2line.
+ *
+ * 		The ELF file is mapped once, the function symbols of the
+ * 		.symtab section and the rows of the .debug_line programs
+ * 		(DWARF 2 up to 5) are copied into two arrays sorted by address.
+ * 		A lookup is then two binary searches. Only 32 bits little
+ * 		endian ELF files are handled, which covers the Cortex-M targets.
+ *****************************************************************/
+#include <common-macros.h>
+#include <debug.h>
+#include <elf_sym.h>
+
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/** File index of a line row marking the end of a sequence */
+#define ELF_SYM_END_SEQUENCE	UINT_MAX
+
+/** File index of a line row whose file could not be found */
+#define ELF_SYM_NO_FILE		(UINT_MAX - 1)
+
+/** Name returned when the file of an address is not known */
+#define ELF_SYM_UNKNOWN		"??"
+
+/* DWARF line number program opcodes, section 6.2.5 of the DWARF standard */
+#define DW_LNS_copy			0x01
+#define DW_LNS_advance_pc		0x02
+#define DW_LNS_advance_line		0x03
+#define DW_LNS_set_file			0x04
+#define DW_LNS_set_column		0x05
+#define DW_LNS_negate_stmt		0x06
+#define DW_LNS_set_basic_block		0x07
+#define DW_LNS_const_add_pc		0x08
+#define DW_LNS_fixed_advance_pc		0x09
+#define DW_LNS_set_prologue_end		0x0a
+#define DW_LNS_set_epilogue_begin	0x0b
+#define DW_LNS_set_isa			0x0c
+
+#define DW_LNE_end_sequence		0x01
+#define DW_LNE_set_address		0x02
+
+/* DWARF 5 line header entry formats */
+#define DW_LNCT_path			0x1
+#define DW_LNCT_directory_index		0x2
+
+#define DW_FORM_block			0x09
+#define DW_FORM_block1			0x0a
+#define DW_FORM_data1			0x0b
+#define DW_FORM_data2			0x05
+#define DW_FORM_data4			0x06
+#define DW_FORM_data8			0x07
+#define DW_FORM_data16			0x1e
+#define DW_FORM_string			0x08
+#define DW_FORM_strp			0x0e
+#define DW_FORM_udata			0x0f
+#define DW_FORM_line_strp		0x1f
+
+/** A function or data object symbol taken from .symtab */
+typedef struct {
+	/** Start address, the thumb bit is cleared */
+	unsigned int	addr;
+	/** Size of the function, 0 if unknown */
+	unsigned int	size;
+	/** Name of the function, points into the table's string table */
+	const char	*name;
+} elf_sym_func;
+
+/** A row of the line number matrix */
+typedef struct {
+	/** First address of the row */
+	unsigned int	addr;
+	/** Line in the source file */
+	unsigned int	line;
+	/** Index in the file table or ELF_SYM_END_SEQUENCE */
+	unsigned int	file;
+} elf_sym_line;
+
+struct elf_sym_table_st {
+	/** Function symbols sorted by address */
+	elf_sym_func	*funcs;
+	/** Number of function symbols */
+	size_t		funcs_count;
+	/** Data object symbols, the variables, in the order of .symtab */
+	elf_sym_func	*objs;
+	/** Number of data object symbols */
+	size_t		objs_count;
+	/** Line rows sorted by address */
+	elf_sym_line	*lines;
+	/** Number of line rows */
+	size_t		lines_count;
+	/** Number of line rows allocated */
+	size_t		lines_cap;
+	/** Source file paths referenced by the line rows */
+	char		**files;
+	/** Number of source file paths */
+	size_t		files_count;
+	/** Number of source file paths allocated */
+	size_t		files_cap;
+	/** Copy of the string table of .symtab */
+	char		*strtab;
+};
+
+/** Boundaries of a section inside the mapped file */
+typedef struct {
+	const unsigned char	*ptr;
+	size_t			size;
+} elf_sym_section;
+
+/** Sections needed to parse the line programs */
+typedef struct {
+	elf_sym_section		line;
+	elf_sym_section		line_str;
+	elf_sym_section		str;
+} elf_sym_dwarf;
+
+/** Bounded little endian reader */
+typedef struct {
+	const unsigned char	*pos;
+	const unsigned char	*end;
+	bool			overflow;
+} elf_sym_reader;
+
+static uint64_t elf_sym_read_uint(elf_sym_reader * const rd, unsigned int n)
+{
+	uint64_t val = 0;
+
+	if ((size_t) (rd->end - rd->pos) < n) {
+		rd->overflow = true;
+		rd->pos = rd->end;
+		return 0;
+	}
+
+	for (unsigned int i = 0; i < n; i++) {
+		val |= ((uint64_t) rd->pos[i]) << (8 * i);
+	}
+
+	rd->pos += n;
+	return val;
+}
+
+static uint64_t elf_sym_read_uleb(elf_sym_reader * const rd)
+{
+	uint64_t val = 0;
+	unsigned int shift = 0;
+	unsigned char byte;
+
+	while (rd->pos < rd->end) {
+		byte = *rd->pos++;
+		if (shift < 64) {
+			val |= ((uint64_t) (byte & 0x7f)) << shift;
+		}
+		shift += 7;
+
+		if (!(byte & 0x80)) {
+			return val;
+		}
+	}
+
+	rd->overflow = true;
+	return val;
+}
+
+static int64_t elf_sym_read_sleb(elf_sym_reader * const rd)
+{
+	int64_t val = 0;
+	unsigned int shift = 0;
+	unsigned char byte = 0;
+
+	while (rd->pos < rd->end) {
+		byte = *rd->pos++;
+		if (shift < 64) {
+			val |= ((int64_t) (byte & 0x7f)) << shift;
+		}
+		shift += 7;
+
+		if (!(byte & 0x80)) {
+			if ((shift < 64) && (byte & 0x40)) {
+				val |= -(((int64_t) 1) << shift);
+			}
+			return val;
+		}
+	}
+
+	rd->overflow = true;
+	return val;
+}
+
+static const char *elf_sym_read_str(elf_sym_reader * const rd)
+{
+	const char *str = (const char *) rd->pos;
+	const unsigned char *nul;
+
+	nul = memchr(rd->pos, '\0', rd->end - rd->pos);
+	if (!nul) {
+		rd->overflow = true;
+		rd->pos = rd->end;
+		return NULL;
+	}
+
+	rd->pos = nul + 1;
+	return str;
+}
+
+/**
+ * @brief Get a string at a given offset of a string section.
+ * @return The string or NULL if the offset is not valid.
+ */
+static const char *elf_sym_section_str(const elf_sym_section * const sec,
+				       uint64_t offset)
+{
+	if (!sec->ptr || (offset >= sec->size)) {
+		return NULL;
+	}
+
+	if (!memchr(&sec->ptr[offset], '\0', sec->size - offset)) {
+		return NULL;
+	}
+
+	return (const char *) &sec->ptr[offset];
+}
+
+/**
+ * @brief Make sure that an array can hold one more element.
+ * @return 0 upon success, -1 if the allocation failed.
+ */
+static int elf_sym_grow(void **array, size_t *cap, size_t count, size_t el_sz)
+{
+	size_t new_cap;
+	void *new_array;
+
+	if (count < *cap) {
+		return 0;
+	}
+
+	new_cap = *cap ? (*cap * 2) : 64;
+	if (!(new_array = realloc(*array, new_cap * el_sz))) {
+		ERROR("Could not allocate memory\n");
+		return -1;
+	}
+
+	*array = new_array;
+	*cap = new_cap;
+
+	return 0;
+}
+
+static int elf_sym_add_line(elf_sym_table * const tbl, unsigned int addr,
+			    unsigned int line, unsigned int file)
+{
+	elf_sym_line *row;
+
+	if (elf_sym_grow((void **) &tbl->lines, &tbl->lines_cap,
+			 tbl->lines_count, sizeof(*tbl->lines))) {
+		return -1;
+	}
+
+	row = &tbl->lines[tbl->lines_count++];
+	row->addr = addr;
+	row->line = line;
+	row->file = file;
+
+	return 0;
+}
+
+/**
+ * @brief Add a source file to the table. The path is build from the directory
+ * 		and the name, as addr2line does.
+ * @return The index of the file in the table, ELF_SYM_NO_FILE on error.
+ */
+static unsigned int elf_sym_add_file(elf_sym_table * const tbl,
+				     const char * const dir,
+				     const char * const name)
+{
+	size_t dir_len = 0, name_len = strlen(name);
+	char *path;
+
+	if (dir && dir[0] && (name[0] != '/')) {
+		dir_len = strlen(dir);
+	}
+
+	if (elf_sym_grow((void **) &tbl->files, &tbl->files_cap,
+			 tbl->files_count, sizeof(*tbl->files))) {
+		return ELF_SYM_NO_FILE;
+	}
+
+	if (!(path = malloc(dir_len + name_len + 2))) {
+		ERROR("Could not allocate memory\n");
+		return ELF_SYM_NO_FILE;
+	}
+
+	if (dir_len) {
+		memcpy(path, dir, dir_len);
+		path[dir_len++] = '/';
+	}
+	memcpy(&path[dir_len], name, name_len + 1);
+
+	tbl->files[tbl->files_count] = path;
+
+	return tbl->files_count++;
+}
+
+/**
+ * @brief Read one attribute of a DWARF 5 directory/file entry.
+ * @param str Set if the attribute is a string.
+ * @param num Set if the attribute is a number.
+ * @return 0 upon success, -1 if the form is not handled.
+ */
+static int elf_sym_read_form(elf_sym_reader * const rd,
+			     const elf_sym_dwarf * const dwarf,
+			     uint64_t form, unsigned int offset_sz,
+			     const char **str, uint64_t *num)
+{
+	uint64_t len;
+
+	switch (form) {
+	case DW_FORM_string:
+		*str = elf_sym_read_str(rd);
+	break;
+	case DW_FORM_line_strp:
+		*str = elf_sym_section_str(&dwarf->line_str,
+					   elf_sym_read_uint(rd, offset_sz));
+	break;
+	case DW_FORM_strp:
+		*str = elf_sym_section_str(&dwarf->str,
+					   elf_sym_read_uint(rd, offset_sz));
+	break;
+	case DW_FORM_udata:
+		*num = elf_sym_read_uleb(rd);
+	break;
+	case DW_FORM_data1:
+		*num = elf_sym_read_uint(rd, 1);
+	break;
+	case DW_FORM_data2:
+		*num = elf_sym_read_uint(rd, 2);
+	break;
+	case DW_FORM_data4:
+		*num = elf_sym_read_uint(rd, 4);
+	break;
+	case DW_FORM_data8:
+		*num = elf_sym_read_uint(rd, 8);
+	break;
+	case DW_FORM_data16:
+		elf_sym_read_uint(rd, 8);
+		elf_sym_read_uint(rd, 8);
+	break;
+	case DW_FORM_block:
+		/* MIN evaluates its arguments twice, read the length first */
+		len = elf_sym_read_uleb(rd);
+		rd->pos += MIN(len, (uint64_t) (rd->end - rd->pos));
+	break;
+	case DW_FORM_block1:
+		len = elf_sym_read_uint(rd, 1);
+		rd->pos += MIN(len, (uint64_t) (rd->end - rd->pos));
+	break;
+	default:
+		WARNING("Unhandled DWARF form 0x%lx\n", (unsigned long) form);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Parse the DWARF 5 directory or file name table of a line header.
+ * @param dirs Directory table, NULL when parsing the directory table itself.
+ * @param out Parsed directories (dirs == NULL) or table file indexes.
+ * @return The number of entries, -1 upon error.
+ */
+static long elf_sym_parse_entries_v5(elf_sym_table * const tbl,
+				     elf_sym_reader * const rd,
+				     const elf_sym_dwarf * const dwarf,
+				     unsigned int offset_sz,
+				     const char ** const dirs, size_t dirs_count,
+				     void **out)
+{
+	uint64_t formats[16][2];
+	unsigned int formats_count = elf_sym_read_uint(rd, 1);
+	uint64_t count;
+	const char *path, *str;
+	uint64_t dir_idx, num;
+
+	if (formats_count > ARRAY_SIZE(formats)) {
+		ERROR("Too many entry formats in the line header\n");
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < formats_count; i++) {
+		formats[i][0] = elf_sym_read_uleb(rd);
+		formats[i][1] = elf_sym_read_uleb(rd);
+	}
+
+	count = elf_sym_read_uleb(rd);
+	if (rd->overflow || (count > (uint64_t) (rd->end - rd->pos))) {
+		return -1;
+	}
+
+	*out = calloc(count ? count : 1,
+		      dirs ? sizeof(unsigned int) : sizeof(const char *));
+	if (!*out) {
+		ERROR("Could not allocate memory\n");
+		return -1;
+	}
+
+	for (uint64_t i = 0; i < count; i++) {
+		path = NULL;
+		dir_idx = 0;
+
+		for (unsigned int j = 0; j < formats_count; j++) {
+			str = NULL;
+			num = 0;
+			if (elf_sym_read_form(rd, dwarf, formats[j][1],
+					      offset_sz, &str, &num)) {
+				return -1;
+			}
+
+			if (DW_LNCT_path == formats[j][0]) {
+				path = str;
+			} else if (DW_LNCT_directory_index == formats[j][0]) {
+				dir_idx = num;
+			}
+		}
+
+		if (rd->overflow) {
+			return -1;
+		}
+
+		if (!dirs) {
+			((const char **) *out)[i] = path ? path : "";
+			continue;
+		}
+
+		((unsigned int *) *out)[i] = elf_sym_add_file(tbl,
+				(dir_idx < dirs_count) ? dirs[dir_idx] : NULL,
+				path ? path : ELF_SYM_UNKNOWN);
+	}
+
+	return count;
+}
+
+/**
+ * @brief Parse the DWARF 2 to 4 directory and file name tables of a line
+ * 		header.
+ * @param files Table file indexes of the unit's files.
+ * @return The number of files, -1 upon error.
+ */
+static long elf_sym_parse_entries_v2(elf_sym_table * const tbl,
+				     elf_sym_reader * const rd,
+				     unsigned int **files)
+{
+	const char **dirs = NULL;
+	size_t dirs_count = 0, dirs_cap = 0;
+	size_t files_count = 0, files_cap = 0;
+	const char *name;
+	uint64_t dir_idx;
+	long rc = -1;
+
+	*files = NULL;
+
+	/* Directory 0 is the compilation directory, not stored in the table */
+	if (elf_sym_grow((void **) &dirs, &dirs_cap, dirs_count,
+			 sizeof(*dirs))) {
+		goto failed;
+	}
+	dirs[dirs_count++] = NULL;
+
+	while ((name = elf_sym_read_str(rd)) && name[0]) {
+		if (elf_sym_grow((void **) &dirs, &dirs_cap, dirs_count,
+				 sizeof(*dirs))) {
+			goto failed;
+		}
+		dirs[dirs_count++] = name;
+	}
+
+	while ((name = elf_sym_read_str(rd)) && name[0]) {
+		dir_idx = elf_sym_read_uleb(rd);
+		/* modification time and length */
+		elf_sym_read_uleb(rd);
+		elf_sym_read_uleb(rd);
+
+		if (elf_sym_grow((void **) files, &files_cap, files_count,
+				 sizeof(**files))) {
+			goto failed;
+		}
+
+		(*files)[files_count++] = elf_sym_add_file(tbl,
+				(dir_idx < dirs_count) ? dirs[dir_idx] : NULL,
+				name);
+	}
+
+	if (!rd->overflow) {
+		rc = files_count;
+	}
+
+failed:
+	free(dirs);
+	return rc;
+}
+
+/**
+ * @brief Parse one line number program (one compilation unit) and append
+ * 		its rows to the table.
+ * @param rd Reader positioned on the unit header. It is moved to the next
+ * 		unit upon return.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int elf_sym_parse_line_unit(elf_sym_table * const tbl,
+				   elf_sym_reader * const rd,
+				   const elf_sym_dwarf * const dwarf)
+{
+	elf_sym_reader hdr, prog;
+	unsigned int offset_sz = 4;
+	uint64_t unit_len, header_len;
+	unsigned int version, min_inst_len, line_range, opcode_base;
+	int line_base;
+	unsigned char std_lengths[256] = {0};
+	const char **dirs = NULL;
+	unsigned int *files = NULL;
+	long dirs_count = 0, files_count;
+	unsigned int file_base;
+	uint64_t addr, ext_len;
+	unsigned int file, row_file, opcode, adjusted;
+	int64_t line;
+	const unsigned char *ext_end;
+	int rc = -1;
+
+	unit_len = elf_sym_read_uint(rd, 4);
+	if (0xffffffffULL == unit_len) {
+		offset_sz = 8;
+		unit_len = elf_sym_read_uint(rd, 8);
+	}
+
+	if (rd->overflow || (unit_len > (uint64_t) (rd->end - rd->pos))) {
+		ERROR("Truncated line number program\n");
+		return -1;
+	}
+
+	hdr.pos = rd->pos;
+	hdr.end = rd->pos + unit_len;
+	hdr.overflow = false;
+	/* Move to the next unit whatever happens to this one */
+	rd->pos = hdr.end;
+
+	version = elf_sym_read_uint(&hdr, 2);
+	if ((version < 2) || (version > 5)) {
+		WARNING("Unhandled line table version %u\n", version);
+		return 0;
+	}
+
+	if (version >= 5) {
+		/* address_size and segment_selector_size */
+		elf_sym_read_uint(&hdr, 2);
+	}
+
+	header_len = elf_sym_read_uint(&hdr, offset_sz);
+	if (hdr.overflow || (header_len > (uint64_t) (hdr.end - hdr.pos))) {
+		return -1;
+	}
+
+	prog.pos = hdr.pos + header_len;
+	prog.end = hdr.end;
+	prog.overflow = false;
+
+	min_inst_len = elf_sym_read_uint(&hdr, 1);
+	if (version >= 4) {
+		/* maximum_operations_per_instruction, always 1 on ARM */
+		elf_sym_read_uint(&hdr, 1);
+	}
+	/* default_is_stmt */
+	elf_sym_read_uint(&hdr, 1);
+	line_base = (signed char) elf_sym_read_uint(&hdr, 1);
+	line_range = elf_sym_read_uint(&hdr, 1);
+	opcode_base = elf_sym_read_uint(&hdr, 1);
+
+	if (!line_range || !opcode_base) {
+		ERROR("Invalid line number program header\n");
+		return -1;
+	}
+
+	for (unsigned int i = 1; i < opcode_base; i++) {
+		std_lengths[i] = elf_sym_read_uint(&hdr, 1);
+	}
+
+	if (version >= 5) {
+		file_base = 0;
+		dirs_count = elf_sym_parse_entries_v5(tbl, &hdr, dwarf, offset_sz,
+						      NULL, 0, (void **) &dirs);
+		if (dirs_count < 0) {
+			goto failed;
+		}
+
+		files_count = elf_sym_parse_entries_v5(tbl, &hdr, dwarf,
+						       offset_sz, dirs,
+						       dirs_count,
+						       (void **) &files);
+	} else {
+		file_base = 1;
+		files_count = elf_sym_parse_entries_v2(tbl, &hdr, &files);
+	}
+
+	if (files_count < 0) {
+		ERROR("Invalid file table in line number program\n");
+		goto failed;
+	}
+
+	addr = 0;
+	file = 1;
+	line = 1;
+
+	while (prog.pos < prog.end) {
+		opcode = elf_sym_read_uint(&prog, 1);
+
+		if (opcode >= opcode_base) {
+			adjusted = opcode - opcode_base;
+			addr += (adjusted / line_range) * min_inst_len;
+			line += line_base + (int) (adjusted % line_range);
+		} else {
+			switch (opcode) {
+			case 0:
+				ext_len = elf_sym_read_uleb(&prog);
+				if (!ext_len ||
+				    (ext_len > (uint64_t) (prog.end - prog.pos))) {
+					goto done;
+				}
+				ext_end = prog.pos + ext_len;
+
+				switch (elf_sym_read_uint(&prog, 1)) {
+				case DW_LNE_end_sequence:
+					if (elf_sym_add_line(tbl, addr, 0,
+							ELF_SYM_END_SEQUENCE)) {
+						goto failed;
+					}
+					addr = 0;
+					file = 1;
+					line = 1;
+				break;
+				case DW_LNE_set_address:
+					addr = elf_sym_read_uint(&prog,
+							MIN(ext_len - 1, 8));
+				break;
+				default:
+				break;
+				}
+
+				prog.pos = ext_end;
+				continue;
+			case DW_LNS_copy:
+			break;
+			case DW_LNS_advance_pc:
+				addr += elf_sym_read_uleb(&prog) * min_inst_len;
+				continue;
+			case DW_LNS_advance_line:
+				line += elf_sym_read_sleb(&prog);
+				continue;
+			case DW_LNS_set_file:
+				file = elf_sym_read_uleb(&prog);
+				continue;
+			case DW_LNS_const_add_pc:
+				addr += ((255 - opcode_base) / line_range) *
+					min_inst_len;
+				continue;
+			case DW_LNS_fixed_advance_pc:
+				addr += elf_sym_read_uint(&prog, 2);
+				continue;
+			default:
+				/* Skip the operands of the other opcodes */
+				for (unsigned int i = 0; i < std_lengths[opcode]; i++) {
+					elf_sym_read_uleb(&prog);
+				}
+				continue;
+			}
+		}
+
+		/* Append a row to the matrix */
+		if ((file < file_base) ||
+		    ((file - file_base) >= (unsigned long) files_count)) {
+			row_file = ELF_SYM_NO_FILE;
+		} else {
+			row_file = files[file - file_base];
+		}
+
+		if (elf_sym_add_line(tbl, addr, line < 0 ? 0 : line, row_file)) {
+			goto failed;
+		}
+	}
+
+done:
+	rc = 0;
+failed:
+	free(dirs);
+	free(files);
+	return rc;
+}
+
+static int elf_sym_compare_funcs(const void *a, const void *b)
+{
+	const elf_sym_func *fa = a, *fb = b;
+
+	if (fa->addr != fb->addr) {
+		return fa->addr < fb->addr ? -1 : 1;
+	}
+
+	/*
+	 * Sized symbols last: the lookup takes the last entry at or below the
+	 * address, an unsized alias would match up to the next symbol
+	 */
+	return (fa->size > fb->size) - (fa->size < fb->size);
+}
+
+static int elf_sym_compare_lines(const void *a, const void *b)
+{
+	const elf_sym_line *la = a, *lb = b;
+	bool end_a = ELF_SYM_END_SEQUENCE == la->file;
+	bool end_b = ELF_SYM_END_SEQUENCE == lb->file;
+
+	if (la->addr != lb->addr) {
+		return la->addr < lb->addr ? -1 : 1;
+	}
+
+	/* A sequence starting where another ends must win the lookup */
+	return end_b - end_a;
+}
+
+/**
+ * @brief Copy the function and data object symbols of the .symtab section
+ *		into the table.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int elf_sym_load_funcs(elf_sym_table * const tbl,
+			      const unsigned char * const base, size_t size,
+			      const Elf32_Shdr * const symtab,
+			      const Elf32_Shdr * const strtab)
+{
+	const Elf32_Sym *syms = (const Elf32_Sym *) &base[symtab->sh_offset];
+	size_t count = symtab->sh_size / sizeof(Elf32_Sym);
+	elf_sym_func *sym;
+	size_t n = 0;
+
+	if (!(tbl->strtab = malloc(strtab->sh_size + 1))) {
+		ERROR("Could not allocate memory\n");
+		return -1;
+	}
+
+	memcpy(tbl->strtab, &base[strtab->sh_offset], strtab->sh_size);
+	tbl->strtab[strtab->sh_size] = '\0';
+
+	if (!(tbl->funcs = calloc(count ? count : 1, sizeof(*tbl->funcs))) ||
+	    !(tbl->objs = calloc(count ? count : 1, sizeof(*tbl->objs)))) {
+		ERROR("Could not allocate memory\n");
+		return -1;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if ((SHN_UNDEF == syms[i].st_shndx) ||
+		    (syms[i].st_name >= strtab->sh_size)) {
+			continue;
+		}
+
+		if (ELF32_ST_TYPE(syms[i].st_info) == STT_OBJECT) {
+			sym = &tbl->objs[tbl->objs_count++];
+			sym->addr = syms[i].st_value;
+		} else if (ELF32_ST_TYPE(syms[i].st_info) == STT_FUNC) {
+			sym = &tbl->funcs[n++];
+			sym->addr = syms[i].st_value & ~1U;
+		} else {
+			continue;
+		}
+
+		sym->size = syms[i].st_size;
+		sym->name = &tbl->strtab[syms[i].st_name];
+	}
+
+	tbl->funcs_count = n;
+	qsort(tbl->funcs, n, sizeof(*tbl->funcs), elf_sym_compare_funcs);
+
+	return 0;
+}
+
+/**
+ * @brief Check that a section lies inside the file.
+ */
+static bool elf_sym_section_valid(const Elf32_Shdr * const shdr, size_t size)
+{
+	return (SHT_NOBITS != shdr->sh_type) &&
+		(shdr->sh_offset <= size) &&
+		(shdr->sh_size <= size - shdr->sh_offset);
+}
+
+/**
+ * @brief Parse the mapped ELF file and fill the table.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int elf_sym_parse(elf_sym_table * const tbl,
+			 const unsigned char * const base, size_t size)
+{
+	const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *) base;
+	const Elf32_Shdr *shdrs, *shstr, *symtab = NULL;
+	elf_sym_dwarf dwarf = {{0}};
+	elf_sym_section *sec;
+	elf_sym_reader rd;
+	const char *name;
+
+	if ((size < sizeof(*ehdr)) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG)) {
+		ERROR("Not an ELF file\n");
+		return -1;
+	}
+
+	if ((ELFCLASS32 != ehdr->e_ident[EI_CLASS]) ||
+	    (ELFDATA2LSB != ehdr->e_ident[EI_DATA])) {
+		ERROR("Only 32 bits little endian ELF files are handled\n");
+		return -1;
+	}
+
+	if ((ehdr->e_shentsize != sizeof(Elf32_Shdr)) ||
+	    (ehdr->e_shoff > size) ||
+	    (ehdr->e_shnum > (size - ehdr->e_shoff) / sizeof(Elf32_Shdr)) ||
+	    (ehdr->e_shstrndx >= ehdr->e_shnum)) {
+		ERROR("Invalid section header table\n");
+		return -1;
+	}
+
+	shdrs = (const Elf32_Shdr *) &base[ehdr->e_shoff];
+	shstr = &shdrs[ehdr->e_shstrndx];
+	if (!elf_sym_section_valid(shstr, size)) {
+		ERROR("Invalid section name table\n");
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < ehdr->e_shnum; i++) {
+		if (!elf_sym_section_valid(&shdrs[i], size) ||
+		    (shdrs[i].sh_name >= shstr->sh_size)) {
+			continue;
+		}
+
+		if ((SHT_SYMTAB == shdrs[i].sh_type) &&
+		    (shdrs[i].sh_link < ehdr->e_shnum) &&
+		    elf_sym_section_valid(&shdrs[shdrs[i].sh_link], size)) {
+			symtab = &shdrs[i];
+			continue;
+		}
+
+		name = (const char *) &base[shstr->sh_offset + shdrs[i].sh_name];
+		if (!strncmp(name, ".debug_line", sizeof(".debug_line"))) {
+			sec = &dwarf.line;
+		} else if (!strncmp(name, ".debug_line_str",
+				    sizeof(".debug_line_str"))) {
+			sec = &dwarf.line_str;
+		} else if (!strncmp(name, ".debug_str", sizeof(".debug_str"))) {
+			sec = &dwarf.str;
+		} else {
+			continue;
+		}
+
+		sec->ptr = &base[shdrs[i].sh_offset];
+		sec->size = shdrs[i].sh_size;
+	}
+
+	if (!symtab) {
+		ERROR("No symbol table found, is the ELF file stripped?\n");
+		return -1;
+	}
+
+	if (elf_sym_load_funcs(tbl, base, size, symtab,
+			       &shdrs[symtab->sh_link])) {
+		return -1;
+	}
+
+	if (!dwarf.line.ptr) {
+		WARNING("No .debug_line section, lines will not be resolved\n");
+		return 0;
+	}
+
+	rd.pos = dwarf.line.ptr;
+	rd.end = dwarf.line.ptr + dwarf.line.size;
+	rd.overflow = false;
+
+	while (rd.pos < rd.end) {
+		if (elf_sym_parse_line_unit(tbl, &rd, &dwarf)) {
+			return -1;
+		}
+	}
+
+	qsort(tbl->lines, tbl->lines_count, sizeof(*tbl->lines),
+	      elf_sym_compare_lines);
+
+	return 0;
+}
+
+elf_sym_table *elf_sym_load(const char * const path)
+{
+	elf_sym_table *tbl;
+	struct stat st;
+	void *base;
+	int fd;
+
+	if (!path) {
+		ERROR("Provide a valid elf file\n");
+		return NULL;
+	}
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		ERROR("Could not open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if (fstat(fd, &st) || !st.st_size) {
+		ERROR("Could not get the size of %s\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == base) {
+		ERROR("Could not map %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if (!(tbl = calloc(1, sizeof(*tbl)))) {
+		ERROR("Could not allocate memory\n");
+		goto alloc_failed;
+	}
+
+	if (elf_sym_parse(tbl, base, st.st_size)) {
+		ERROR("Could not parse %s\n", path);
+		elf_sym_free(tbl);
+		tbl = NULL;
+	} else {
+		DEBUG("%s: %ld functions, %ld line rows\n", path,
+		      tbl->funcs_count, tbl->lines_count);
+	}
+
+alloc_failed:
+	munmap(base, st.st_size);
+	return tbl;
+}
+
+int elf_sym_resolve(const elf_sym_table * const tbl, unsigned int addr,
+		    elf_sym_info * const info)
+{
+	const elf_sym_func *func;
+	const elf_sym_line *row;
+	size_t lo, hi, mid;
+
+	/* Last function starting at or before addr */
+	lo = 0;
+	hi = tbl->funcs_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (tbl->funcs[mid].addr <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (!lo) {
+		return -1;
+	}
+
+	func = &tbl->funcs[lo - 1];
+	if (func->size && (addr - func->addr >= func->size)) {
+		return -1;
+	}
+
+	info->function = func->name;
+	info->file = ELF_SYM_UNKNOWN;
+	info->line = 0;
+
+	/* Last line row starting at or before addr */
+	lo = 0;
+	hi = tbl->lines_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (tbl->lines[mid].addr <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo) {
+		row = &tbl->lines[lo - 1];
+		if (row->file < tbl->files_count) {
+			info->file = tbl->files[row->file];
+			info->line = row->line;
+		}
+	}
+
+	return 0;
+}
+
+int elf_sym_get_range(const elf_sym_table * const tbl, unsigned int *start,
+		      unsigned int *end)
+{
+	const elf_sym_func *last;
+
+	if (!tbl->funcs_count) {
+		return -1;
+	}
+
+	last = &tbl->funcs[tbl->funcs_count - 1];
+	*start = tbl->funcs[0].addr;
+	*end = last->addr + (last->size ? last->size : 1);
+
+	return 0;
+}
+
+int elf_sym_find_object(const elf_sym_table * const tbl,
+			const char * const name, unsigned int *addr,
+			unsigned int *size)
+{
+	for (size_t i = 0; i < tbl->objs_count; i++) {
+		if (!strcmp(tbl->objs[i].name, name)) {
+			*addr = tbl->objs[i].addr;
+			*size = tbl->objs[i].size;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+void elf_sym_free(elf_sym_table *tbl)
+{
+	if (!tbl) {
+		return;
+	}
+
+	for (size_t i = 0; i < tbl->files_count; i++) {
+		free(tbl->files[i]);
+	}
+
+	free(tbl->files);
+	free(tbl->lines);
+	free(tbl->funcs);
+	free(tbl->objs);
+	free(tbl->strtab);
+	free(tbl);
+}
@@ -0,0 +1,443 @@
+/*****************************************************************
+ * file: evtcnt.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: DWT event counter processing object. The DWT counts, on 8 bits,
+ * 		the cycles spent on extra instruction cycles (CPI), on the
+ * 		exception entries and exits, sleeping, on load/store stalls
+ * 		(LSU) and the instructions folded. Each time a counter wraps,
+ * 		an event counter packet carries its flag: the flags are
+ * 		integrated into 64 bits totals, at a 256 cycles resolution.
+ * 		The POSTCNT wraps (CYC) are counted as they are.
+ *
+ * 		The totals of the session are written at its end. Behind the
+ * 		timestamp object, they are also written per window of a fixed
+ * 		number of cycles when the window closes, and compared to the
+ * 		elapsed cycles. The windows are aligned on multiples of their
+ * 		length and the windows without events are skipped.
+ *****************************************************************/
+#include <config.h>
+#include <debug.h>
+#include <evtcnt.h>
+#include <message.h>
+#include <report_buf.h>
+#include <timestamp.h>
+
+#include <libswo/libswo.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Cycles counted between two wraps of an 8 bits counter */
+#define EVTCNT_WRAP_CYCLES		256U
+
+/** Counters, in the order of the report */
+typedef enum {
+	EVTCNT_CPI = 0,
+	EVTCNT_EXC,
+	EVTCNT_SLEEP,
+	EVTCNT_LSU,
+	EVTCNT_FOLD,
+	EVTCNT_CYC,
+	EVTCNT_MAX,
+} evtcnt_counter;
+
+/** Name and flag of the counters */
+static const struct {
+	const char	*name;
+	uint8_t		flag;
+} evtcnt_counters[EVTCNT_MAX] = {
+	[EVTCNT_CPI] = { "cpi", TIMESTAMP_PKT_EVT_CPI },
+	[EVTCNT_EXC] = { "exc", TIMESTAMP_PKT_EVT_EXC },
+	[EVTCNT_SLEEP] = { "sleep", TIMESTAMP_PKT_EVT_SLEEP },
+	[EVTCNT_LSU] = { "lsu", TIMESTAMP_PKT_EVT_LSU },
+	[EVTCNT_FOLD] = { "fold", TIMESTAMP_PKT_EVT_FOLD },
+	[EVTCNT_CYC] = { "cyc", TIMESTAMP_PKT_EVT_CYC },
+};
+
+/** Wraps of the counters */
+typedef struct {
+	/** Wraps of each counter */
+	uint64_t	wraps[EVTCNT_MAX];
+} evtcnt_totals;
+
+/** Private data of the event counter object */
+typedef struct {
+	/** Check if the object is initialized to avoid double init/fini */
+	bool		is_init;
+	/** Input is an array of timestamp_pkt instead of libswo packets */
+	bool		is_timestamped;
+	/** Cycles per window, 0 if disabled */
+	unsigned int	window_len;
+	/** Number of event counter packets */
+	unsigned long	packets;
+	/** Totals of the session */
+	evtcnt_totals	session;
+	/** Totals of the current window */
+	evtcnt_totals	window;
+	/** First cycle of the current window */
+	uint64_t	window_start;
+	/** Set while the current window holds events */
+	bool		is_window_open;
+	/** Time of the first packet, with the timestamps */
+	uint64_t	first_ts;
+	/** Time of the last packet, with the timestamps */
+	uint64_t	last_ts;
+	/** Set once a timestamped packet was received */
+	bool		is_ts_set;
+	/** Text waiting to be sent */
+	report_buf	out;
+	/** Set once the report is written */
+	bool		is_reported;
+} evtcnt_private_data;
+
+static evtcnt_private_data evtcnt_priv_data;
+
+/**
+ * @brief Print the cycles of the counters.
+ * @param out Stream of the report.
+ * @param totals Wraps of the counters.
+ * @param elapsed Elapsed cycles, 0 if unknown.
+ * @param sep Separator written before each counter.
+ */
+static void evtcnt_print_totals(FILE * const out,
+				const evtcnt_totals * const totals,
+				uint64_t elapsed, const char * const sep)
+{
+	unsigned long long cycles;
+
+	for (unsigned int i = 0; i < EVTCNT_CYC; i++) {
+		cycles = totals->wraps[i] * EVTCNT_WRAP_CYCLES;
+		fprintf(out, "%s%s_cycles: %llu", sep, evtcnt_counters[i].name,
+			cycles);
+		if (elapsed) {
+			fprintf(out, " (%.1f%%)", 100.0 * cycles / elapsed);
+		}
+	}
+
+	fprintf(out, "%s%s_wraps: %llu", sep, evtcnt_counters[EVTCNT_CYC].name,
+		(unsigned long long) totals->wraps[EVTCNT_CYC]);
+}
+
+/**
+ * @brief Close the current window, its line is written.
+ * @param pdata Private data.
+ * @return 0 upon success, -1 if the report could not be allocated.
+ */
+static int evtcnt_window_close(evtcnt_private_data * const pdata)
+{
+	FILE *out;
+
+	if (!pdata->is_window_open) {
+		return 0;
+	}
+
+	if (!(out = report_buf_stream(&pdata->out))) {
+		return -1;
+	}
+
+	fprintf(out, "window: start %llu",
+		(unsigned long long) pdata->window_start);
+	evtcnt_print_totals(out, &pdata->window, pdata->window_len, " ");
+	fprintf(out, "\n");
+
+	memset(&pdata->window, 0, sizeof(pdata->window));
+	pdata->is_window_open = false;
+
+	return 0;
+}
+
+/**
+ * @brief Account the wraps of an event counter packet.
+ * @param pdata Private data.
+ * @param flags TIMESTAMP_PKT_EVT_* flags of the counters that wrapped.
+ * @param ts Time of the packet, only used by the windows.
+ * @return 0 upon success, -1 if the allocation failed.
+ */
+static int evtcnt_add(evtcnt_private_data * const pdata, uint8_t flags,
+		      uint64_t ts)
+{
+	pdata->packets++;
+	if (pdata->window_len) {
+		if (pdata->is_window_open &&
+		    ((ts - pdata->window_start) >= pdata->window_len) &&
+		    evtcnt_window_close(pdata)) {
+			return -1;
+		}
+
+		if (!pdata->is_window_open) {
+			pdata->window_start = ts - (ts % pdata->window_len);
+			pdata->is_window_open = true;
+		}
+	}
+
+	for (unsigned int i = 0; i < EVTCNT_MAX; i++) {
+		if (flags & evtcnt_counters[i].flag) {
+			pdata->session.wraps[i]++;
+			pdata->window.wraps[i]++;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Flags of the counters that wrapped, as in timestamp_pkt.
+ * @param pkt Event counter packet.
+ * @return The TIMESTAMP_PKT_EVT_* flags.
+ */
+static uint8_t evtcnt_pkt_flags(const union libswo_packet * const pkt)
+{
+	return (pkt->evtcnt.cpi ? TIMESTAMP_PKT_EVT_CPI : 0) |
+	       (pkt->evtcnt.exc ? TIMESTAMP_PKT_EVT_EXC : 0) |
+	       (pkt->evtcnt.sleep ? TIMESTAMP_PKT_EVT_SLEEP : 0) |
+	       (pkt->evtcnt.lsu ? TIMESTAMP_PKT_EVT_LSU : 0) |
+	       (pkt->evtcnt.fold ? TIMESTAMP_PKT_EVT_FOLD : 0) |
+	       (pkt->evtcnt.cyc ? TIMESTAMP_PKT_EVT_CYC : 0);
+}
+
+/**
+ * @brief This is the receiving callback, it accounts the event counter
+ *		packets, the other packets are skipped. The packets are either
+ *		libswo packets or timestamp_pkt.
+ * @param proc_obj Processing obj abstraction.
+ * @param msg Message holding the packets.
+ * @return The number of bytes read, -1 upon error.
+ */
+static size_t
+evtcnt_data_in(processing_obj * const proc_obj, message_obj * const msg)
+{
+	evtcnt_obj *obj = (evtcnt_obj *) proc_obj;
+	evtcnt_private_data *pdata = (evtcnt_private_data *) obj->pdata;
+	const union libswo_packet *pkts;
+	const timestamp_pkt *tpkts;
+	size_t pkt_count;
+
+	if (pdata->is_timestamped) {
+		tpkts = (const timestamp_pkt *) msg->ptr(msg);
+		pkt_count = msg->length(msg) / sizeof(*tpkts);
+		for (size_t i = 0; i < pkt_count; i++) {
+			if (!pdata->is_ts_set) {
+				pdata->first_ts = tpkts[i].ts;
+				pdata->is_ts_set = true;
+			}
+
+			pdata->last_ts = tpkts[i].ts;
+			if ((tpkts[i].type == LIBSWO_PACKET_TYPE_DWT_EVTCNT) &&
+			    evtcnt_add(pdata, tpkts[i].arg, tpkts[i].ts)) {
+				return -1;
+			}
+		}
+
+		proc_obj->stats.packets += pkt_count;
+		return pkt_count * sizeof(*tpkts);
+	}
+
+	pkts = (const union libswo_packet *) msg->ptr(msg);
+	pkt_count = msg->length(msg) / sizeof(*pkts);
+	for (size_t i = 0; i < pkt_count; i++) {
+		if ((pkts[i].type == LIBSWO_PACKET_TYPE_DWT_EVTCNT) &&
+		    evtcnt_add(pdata, evtcnt_pkt_flags(&pkts[i]), 0)) {
+			return -1;
+		}
+	}
+
+	proc_obj->stats.packets += pkt_count;
+	return pkt_count * sizeof(*pkts);
+}
+
+/**
+ * @brief Write the totals of the session after the last window.
+ * @param pdata Private data.
+ * @return 0 upon success, -1 if the report could not be allocated.
+ */
+static int evtcnt_report(evtcnt_private_data * const pdata)
+{
+	uint64_t elapsed = pdata->last_ts - pdata->first_ts;
+	FILE *out;
+
+	if (evtcnt_window_close(pdata) ||
+	    !(out = report_buf_stream(&pdata->out))) {
+		return -1;
+	}
+
+	fprintf(out, "evtcnt: packets %lu", pdata->packets);
+	if (pdata->is_ts_set) {
+		fprintf(out, " elapsed_cycles %llu",
+			(unsigned long long) elapsed);
+	}
+
+	evtcnt_print_totals(out, &pdata->session, elapsed, "\n");
+	fprintf(out, "\n");
+	return 0;
+}
+
+/**
+ * @brief This is the sending callback, it writes the lines of the closed
+ *		windows and, at the end of the session, the report. The text
+ *		is written in chunks of at most one message.
+ * @param proc_obj Processing obj abstraction.
+ * @param msg Message where the text is written.
+ * @return The number of bytes written.
+ */
+static size_t
+evtcnt_data_out(processing_obj * const proc_obj, message_obj * const msg)
+{
+	evtcnt_obj *obj = (evtcnt_obj *) proc_obj;
+	evtcnt_private_data *pdata = (evtcnt_private_data *) obj->pdata;
+
+	if (proc_obj->req_end && !pdata->is_reported) {
+		pdata->is_reported = true;
+		if (evtcnt_report(pdata)) {
+			WARNING("Event counter report incomplete\n");
+		}
+	}
+
+	return report_buf_send(&pdata->out, proc_obj, msg);
+}
+
+/**
+ * @brief Tell whether the packets come from the timestamp object, as an
+ *		array of timestamp_pkt, instead of the decoder. The windows
+ *		need them.
+ * @param obj The event counter object.
+ * @param is_timestamped true if the input is timestamped.
+ * @return 0.
+ */
+static int evtcnt_set_timestamped(evtcnt_obj * const obj,
+				  bool is_timestamped)
+{
+	evtcnt_private_data *pdata = (evtcnt_private_data *) obj->pdata;
+
+	pdata->is_timestamped = is_timestamped;
+	return 0;
+}
+
+/**
+ * @brief Set the cycles per window.
+ * @param obj The event counter object.
+ * @param len Cycles per window, 0 to disable the windows.
+ * @return 0 upon success, -1 if the windows cannot be used.
+ */
+static int evtcnt_set_window(evtcnt_obj * const obj, unsigned int len)
+{
+	evtcnt_private_data *pdata = (evtcnt_private_data *) obj->pdata;
+
+	if (len && !pdata->is_timestamped) {
+		ERROR("The event counter windows need the timestamps\n");
+		return -1;
+	}
+
+	pdata->window_len = len;
+	memset(&pdata->window, 0, sizeof(pdata->window));
+	pdata->is_window_open = false;
+
+	return 0;
+}
+
+/**
+ * @brief Set the cycles per window from the configuration, the windows are
+ *		left disabled if not configured.
+ * @param obj The event counter object.
+ * @pre The config object must be initialized.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int evtcnt_set_window_gbl_config(evtcnt_obj * const obj)
+{
+	cfg_param param = {
+				.section = CFG_SECTION_EVTCNT,
+				.type = CONFIG_UNSIGNED_INT,
+				.name = CFG_SECTION_EVTCNT_WINDOW_LEN,
+			  };
+	unsigned int len;
+
+	len = CONFIG_HELPER_GET_U32(&param);
+	if (!param.found) {
+		return 0;
+	}
+
+	DEBUG("\t-event counter window: %u cycles\n", len);
+	return evtcnt_set_window(obj, len);
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @return -1.
+ */
+static int evtcnt_set_timestamped_default(evtcnt_obj * const obj,
+					  bool is_timestamped)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @return -1.
+ */
+static int evtcnt_set_window_default(evtcnt_obj * const obj,
+				     unsigned int len)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @return -1.
+ */
+static int evtcnt_set_window_gbl_config_default(evtcnt_obj * const obj)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
+int evtcnt_init(evtcnt_obj * const obj)
+{
+	processing_obj *proc_obj = (processing_obj *) obj;
+	evtcnt_private_data *pdata = &evtcnt_priv_data;
+
+	if (pdata->is_init) {
+		ERROR("Cannot initialize more than one instance\n");
+		return -1;
+	}
+
+	if (processing_init(proc_obj)) {
+		return -1;
+	}
+
+	proc_obj->name = "evtcnt";
+	obj->pdata = (void *) pdata;
+	obj->set_timestamped = evtcnt_set_timestamped;
+	obj->set_window = evtcnt_set_window;
+	obj->set_window_gbl_config = evtcnt_set_window_gbl_config;
+
+	proc_obj->data_in = evtcnt_data_in;
+	proc_obj->data_out = evtcnt_data_out;
+
+	memset(pdata, 0, sizeof(*pdata));
+	pdata->is_init = true;
+
+	return 0;
+}
+
+int evtcnt_fini(evtcnt_obj * const obj)
+{
+	evtcnt_private_data *pdata = &evtcnt_priv_data;
+
+	if (!pdata->is_init) {
+		ERROR("Not initialized\n");
+		return -1;
+	}
+
+	obj->set_timestamped = evtcnt_set_timestamped_default;
+	obj->set_window = evtcnt_set_window_default;
+	obj->set_window_gbl_config = evtcnt_set_window_gbl_config_default;
+
+	report_buf_fini(&pdata->out);
+
+	processing_fini((processing_obj *) obj);
+	pdata->is_init = false;
+	return 0;
+}
@@ -0,0 +1,482 @@
+/*****************************************************************
+ * file: exc_trace.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Exception trace processing object. It receives the timestamped
+ * 		packets of the timestamp object and follows the exception
+ * 		trace packets of the DWT: an exception is entered, exited, and
+ * 		the core returns to the exception it preempted or to the
+ * 		thread.
+ *
+ * 		The active exceptions are kept on a stack. Per exception
+ * 		number it accounts:
+ * 		- the number of entries, and of entries preempting another
+ * 		  handler;
+ * 		- the time in the handler, from its entry to its exit minus
+ * 		  the time spent in the handlers preempting it;
+ * 		- the time the handler was preempted, from the entry of the
+ * 		  handler preempting it to the return to it. Tail chained
+ * 		  handlers extend the same preemption.
+ * 		The durations are kept in log2 histograms of cycles. A report
+ * 		is written at the end of the session.
+ *
+ * 		An exit or a return to an exception that is not on the stack
+ * 		is counted as unmatched, as are the exceptions left above it:
+ * 		their exit packet was lost, e.g. on an overflow.
+ *****************************************************************/
+#include <config.h>
+#include <debug.h>
+#include <exc_trace.h>
+#include <message.h>
+#include <report_buf.h>
+#include <pkt_converter.h>
+#include <timestamp.h>
+
+#include <libswo/libswo.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Durations in cycles, with their log2 histogram */
+typedef struct {
+	/** Number of durations */
+	unsigned long	count;
+	/** Sum of the durations */
+	uint64_t	total;
+	/** Shortest duration */
+	uint64_t	min;
+	/** Longest duration */
+	uint64_t	max;
+	/** Bucket i holds the durations in [2^i, 2^(i+1)) */
+	unsigned long	hist[EXC_TRACE_HIST_LEN];
+} exc_trace_dist;
+
+/** Statistics of an exception number */
+typedef struct {
+	/** Number of times the handler was entered */
+	unsigned long	entries;
+	/** Number of entries preempting another handler */
+	unsigned long	preempting;
+	/** Time in the handler, without the handlers preempting it */
+	exc_trace_dist	handler;
+	/** Time the handler was preempted */
+	exc_trace_dist	preempted;
+} exc_trace_exc;
+
+/** Active exception */
+typedef struct {
+	/** Exception number */
+	unsigned int	exc;
+	/** Time of the entry */
+	uint64_t	enter;
+	/** Time of the preemption, only meaningful if is_suspended */
+	uint64_t	suspend;
+	/** Time spent in the handlers preempting it */
+	uint64_t	preempted;
+	/** Set while a handler preempting it runs */
+	bool		is_suspended;
+} exc_trace_frame;
+
+/** Private data of the exception trace object */
+typedef struct {
+	/** Check if the object is initialized to avoid double init/fini */
+	bool		is_init;
+	/** Statistics per exception number */
+	exc_trace_exc	*exc;
+	/** Active exceptions, the running one on top */
+	exc_trace_frame	stack[EXC_TRACE_DEPTH_MAX];
+	/** Number of active exceptions */
+	unsigned int	depth;
+	/** Deepest nesting seen */
+	unsigned int	depth_max;
+	/** Number of exception trace packets */
+	unsigned long	events;
+	/** Number of packets with an approximate time */
+	unsigned long	approximate;
+	/** Number of exits and returns that do not match the stack */
+	unsigned long	unmatched;
+	/** Number of entries dropped because the stack was full */
+	unsigned long	overflows;
+	/** Report, built at the end of the session */
+	report_buf	report;
+	/** Set once the report is built */
+	bool		is_reported;
+} exc_trace_private_data;
+
+static exc_trace_private_data exc_trace_priv_data;
+
+/**
+ * @brief Duration between two times, 0 if they are out of order. That only
+ *		happens with approximate times.
+ */
+static inline uint64_t exc_trace_delta(uint64_t from, uint64_t to)
+{
+	return (to > from) ? (to - from) : 0;
+}
+
+/**
+ * @brief Account a duration.
+ * @param dist Durations.
+ * @param cycles Duration in cycles.
+ */
+static void exc_trace_dist_add(exc_trace_dist * const dist, uint64_t cycles)
+{
+	unsigned int bucket = 0;
+
+	if (!dist->count || (cycles < dist->min)) {
+		dist->min = cycles;
+	}
+
+	if (cycles > dist->max) {
+		dist->max = cycles;
+	}
+
+	dist->count++;
+	dist->total += cycles;
+
+	while ((cycles >>= 1) && (bucket < (EXC_TRACE_HIST_LEN - 1))) {
+		bucket++;
+	}
+	dist->hist[bucket]++;
+}
+
+/**
+ * @brief Find an exception on the stack, from the top.
+ * @param pdata Private data.
+ * @param exc Exception number.
+ * @return The index of the exception in the stack, -1 if not active.
+ */
+static int exc_trace_find(const exc_trace_private_data * const pdata,
+			  unsigned int exc)
+{
+	for (unsigned int i = pdata->depth; i > 0; i--) {
+		if (pdata->stack[i - 1].exc == exc) {
+			return i - 1;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Drop the exceptions above a depth, their exit was lost.
+ * @param pdata Private data.
+ * @param depth Depth kept.
+ */
+static void exc_trace_unwind(exc_trace_private_data * const pdata,
+			     unsigned int depth)
+{
+	pdata->unmatched += pdata->depth - depth;
+	pdata->depth = depth;
+}
+
+/**
+ * @brief Resume a preempted exception.
+ * @param pdata Private data.
+ * @param frame The exception.
+ * @param ts Time of the return to it.
+ */
+static void exc_trace_resume(exc_trace_private_data * const pdata,
+			     exc_trace_frame * const frame, uint64_t ts)
+{
+	uint64_t cycles = exc_trace_delta(frame->suspend, ts);
+
+	frame->preempted += cycles;
+	frame->is_suspended = false;
+	exc_trace_dist_add(&pdata->exc[frame->exc].preempted, cycles);
+}
+
+/**
+ * @brief Enter an exception, the running one if any is preempted unless it
+ *		already is: a tail chained handler extends its preemption.
+ * @param pdata Private data.
+ * @param exc Exception number.
+ * @param ts Time of the entry.
+ */
+static void exc_trace_enter(exc_trace_private_data * const pdata,
+			    unsigned int exc, uint64_t ts)
+{
+	exc_trace_frame *frame;
+
+	if (pdata->depth) {
+		frame = &pdata->stack[pdata->depth - 1];
+		if (!frame->is_suspended) {
+			frame->is_suspended = true;
+			frame->suspend = ts;
+		}
+
+		pdata->exc[exc].preempting++;
+	}
+
+	if (pdata->depth == EXC_TRACE_DEPTH_MAX) {
+		pdata->overflows++;
+		return;
+	}
+
+	frame = &pdata->stack[pdata->depth++];
+	frame->exc = exc;
+	frame->enter = ts;
+	frame->preempted = 0;
+	frame->is_suspended = false;
+
+	pdata->exc[exc].entries++;
+	if (pdata->depth > pdata->depth_max) {
+		pdata->depth_max = pdata->depth;
+	}
+}
+
+/**
+ * @brief Exit an exception, the time in its handler is accounted.
+ * @param pdata Private data.
+ * @param exc Exception number.
+ * @param ts Time of the exit.
+ */
+static void exc_trace_exit(exc_trace_private_data * const pdata,
+			   unsigned int exc, uint64_t ts)
+{
+	exc_trace_frame *frame;
+	uint64_t cycles;
+	int i;
+
+	if ((i = exc_trace_find(pdata, exc)) < 0) {
+		pdata->unmatched++;
+		return;
+	}
+
+	exc_trace_unwind(pdata, i + 1);
+	frame = &pdata->stack[i];
+	if (frame->is_suspended) {
+		/* The return to it was lost */
+		exc_trace_resume(pdata, frame, ts);
+	}
+
+	cycles = exc_trace_delta(frame->enter, ts);
+	exc_trace_dist_add(&pdata->exc[exc].handler,
+			   exc_trace_delta(frame->preempted, cycles));
+	pdata->depth = i;
+}
+
+/**
+ * @brief Return to an exception, or to the thread for exception 0.
+ * @param pdata Private data.
+ * @param exc Exception number.
+ * @param ts Time of the return.
+ */
+static void exc_trace_return(exc_trace_private_data * const pdata,
+			     unsigned int exc, uint64_t ts)
+{
+	int i;
+
+	if (!exc) {
+		exc_trace_unwind(pdata, 0);
+		return;
+	}
+
+	if ((i = exc_trace_find(pdata, exc)) < 0) {
+		pdata->unmatched++;
+		return;
+	}
+
+	exc_trace_unwind(pdata, i + 1);
+	if (pdata->stack[i].is_suspended) {
+		exc_trace_resume(pdata, &pdata->stack[i], ts);
+	}
+}
+
+/**
+ * @brief This is the receiving callback, it follows the exception trace
+ *		packets, the other packets are skipped.
+ * @param proc_obj Processing obj abstraction.
+ * @param msg Message holding a table of timestamp_pkt.
+ * @return The number of bytes read.
+ */
+static size_t
+exc_trace_data_in(processing_obj * const proc_obj, message_obj * const msg)
+{
+	exc_trace_obj *obj = (exc_trace_obj *) proc_obj;
+	exc_trace_private_data *pdata = (exc_trace_private_data *) obj->pdata;
+	const timestamp_pkt *pkts = (const timestamp_pkt *) msg->ptr(msg);
+	size_t pkt_count = msg->length(msg) / sizeof(timestamp_pkt);
+
+	for (size_t i = 0; i < pkt_count; i++) {
+		if ((pkts[i].type != LIBSWO_PACKET_TYPE_DWT_EXCTRC) ||
+		    (pkts[i].value >= EXC_TRACE_EXC_MAX)) {
+			continue;
+		}
+
+		pdata->events++;
+		if (pkts[i].flags & TIMESTAMP_PKT_DELAYED) {
+			pdata->approximate++;
+		}
+
+		switch (pkts[i].arg) {
+		case LIBSWO_EXCTRC_FUNC_ENTER:
+			exc_trace_enter(pdata, pkts[i].value, pkts[i].ts);
+			break;
+		case LIBSWO_EXCTRC_FUNC_EXIT:
+			exc_trace_exit(pdata, pkts[i].value, pkts[i].ts);
+			break;
+		case LIBSWO_EXCTRC_FUNC_RETURN:
+			exc_trace_return(pdata, pkts[i].value, pkts[i].ts);
+			break;
+		default:
+			pdata->unmatched++;
+		}
+	}
+
+	proc_obj->stats.packets += pkt_count;
+	return pkt_count * sizeof(timestamp_pkt);
+}
+
+/**
+ * @brief Print durations: count, mean, min, max and the non empty buckets
+ *		of the histogram as upper_bound_cycles:count.
+ * @param out Report stream.
+ * @param name Name of the durations.
+ * @param dist Durations.
+ */
+static void exc_trace_print_dist(FILE *out, const char * const name,
+				 const exc_trace_dist * const dist)
+{
+	fprintf(out, "%s_cycles: count %lu", name, dist->count);
+	if (!dist->count) {
+		fprintf(out, "\n");
+		return;
+	}
+
+	fprintf(out, " mean %.1f min %llu max %llu\n",
+		(double) dist->total / dist->count,
+		(unsigned long long) dist->min,
+		(unsigned long long) dist->max);
+
+	fprintf(out, "%s_hist", name);
+	for (unsigned int i = 0; i < EXC_TRACE_HIST_LEN; i++) {
+		if (dist->hist[i]) {
+			fprintf(out, " %llu:%lu", 2ULL << i, dist->hist[i]);
+		}
+	}
+	fprintf(out, "\n");
+}
+
+/**
+ * @brief Build the report: a summary, then one block per exception entered
+ *		during the session.
+ * @param pdata Private data.
+ * @return 0 upon success, -1 if the report could not be allocated.
+ */
+static int exc_trace_build_report(exc_trace_private_data * const pdata)
+{
+	const exc_trace_exc *exc;
+	char name[32];
+	FILE *out;
+
+	if (!(out = report_buf_stream(&pdata->report))) {
+		return -1;
+	}
+
+	fprintf(out, "exceptions: events %lu approximate %lu unmatched %lu "
+		"overflows %lu max_depth %u\n", pdata->events,
+		pdata->approximate, pdata->unmatched, pdata->overflows,
+		pdata->depth_max);
+
+	for (unsigned int i = 0; i < EXC_TRACE_EXC_MAX; i++) {
+		exc = &pdata->exc[i];
+		if (!exc->entries) {
+			continue;
+		}
+
+		fprintf(out, "\nexception: %s (%u)\n",
+			pkt_convert_exception_name(i, name, sizeof(name)), i);
+		fprintf(out, "entries: %lu preempting: %lu preempted: %lu\n",
+			exc->entries, exc->preempting, exc->preempted.count);
+		exc_trace_print_dist(out, "handler", &exc->handler);
+		exc_trace_print_dist(out, "preempted", &exc->preempted);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief This is the sending callback. Nothing is written before the end of
+ *		the session, the report is then written in chunks of at most
+ *		one message.
+ * @param proc_obj Processing obj abstraction.
+ * @param msg Message where the report is written.
+ * @return The number of bytes written.
+ */
+static size_t
+exc_trace_data_out(processing_obj * const proc_obj, message_obj * const msg)
+{
+	exc_trace_obj *obj = (exc_trace_obj *) proc_obj;
+	exc_trace_private_data *pdata = (exc_trace_private_data *) obj->pdata;
+
+	if (!proc_obj->req_end) {
+		return 0;
+	}
+
+	if (!pdata->is_reported) {
+		pdata->is_reported = true;
+		if (exc_trace_build_report(pdata)) {
+			return 0;
+		}
+	}
+
+	return report_buf_send(&pdata->report, proc_obj, msg);
+}
+
+int exc_trace_init(exc_trace_obj * const obj)
+{
+	processing_obj *proc_obj = (processing_obj *) obj;
+	exc_trace_private_data *pdata = &exc_trace_priv_data;
+
+	if (pdata->is_init) {
+		ERROR("Cannot initialize more than one instance\n");
+		return -1;
+	}
+
+	if (processing_init(proc_obj)) {
+		return -1;
+	}
+
+	memset(pdata, 0, sizeof(*pdata));
+	if (!(pdata->exc = calloc(EXC_TRACE_EXC_MAX, sizeof(*pdata->exc)))) {
+		ERROR("Could not allocate memory\n");
+		processing_fini(proc_obj);
+		return -1;
+	}
+
+	proc_obj->name = "exc_trace";
+	obj->pdata = (void *) pdata;
+
+	proc_obj->data_in = exc_trace_data_in;
+	proc_obj->data_out = exc_trace_data_out;
+
+	pdata->is_init = true;
+
+	return 0;
+}
+
+int exc_trace_fini(exc_trace_obj * const obj)
+{
+	exc_trace_private_data *pdata = &exc_trace_priv_data;
+
+	if (!pdata->is_init) {
+		ERROR("Not initialized\n");
+		return -1;
+	}
+
+	if (pdata->unmatched || pdata->overflows) {
+		WARNING("%lu unmatched exception packets, %lu overflows\n",
+			pdata->unmatched, pdata->overflows);
+	}
+
+	free(pdata->exc);
+	pdata->exc = NULL;
+	report_buf_fini(&pdata->report);
+
+	processing_fini((processing_obj *) obj);
+	pdata->is_init = false;
+	return 0;
+}
@@ -3,8 +3,11 @@
  * @author	Alexandre Malki <amalki@piap.pl>
  * @brief	Source file of containing methods and private data related to the
  *		file processing object. The file object inherits the 
- *		processing object. Currenlty the file object only write
- *		and does not read.
+ *		processing object. A file opened with FILE_WRONLY is a sink
+ *		writing the data received, a file opened with FILE_RDONLY is
+ *		a source replaying its content (e.g. a raw SWO capture) one
+ *		message at a time. The replay runs as fast as the pipeline
+ *		consumes the data, or paced to a baudrate.
  *****************************************************************/
 #include <debug.h>
 #include <config.h>
@@ -15,7 +18,9 @@
 #include <fcntl.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -28,6 +33,12 @@
 /** Default read flags: only read */
 #define FILE_DEFAULT_RD_FLAGS (O_RDONLY)
 
+/** Bits sent per byte on the UART (8N1) */
+#define FILE_BITS_PER_BYTE	10ULL
+
+/** Paced replay period, a message holds the bytes received meanwhile */
+#define FILE_PACE_PERIOD_MS	10ULL
+
 /* TODO create a common interface file and uart */
 
 /** This structure contains information regarding the file being openned */
@@ -41,7 +52,18 @@ typedef struct {
 	bool is_open;
 	/** is the file used by a processing element (function file_init) */
 	bool is_used;
-
+	/** Content of the file mapped when read, NULL if it cannot be mapped */
+	char *map;
+	/** Size of the mapping */
+	size_t map_len;
+	/** Number of bytes read so far */
+	size_t pos;
+	/** The whole file was read */
+	bool is_eof;
+	/** Replay baudrate, 0 to replay as fast as possible */
+	unsigned int baudrate;
+	/** Time of the first read, the paced replay is relative to it */
+	struct timespec start;
 } file_priv_data;
 
 /**
@@ -112,11 +134,41 @@ static int file_set_path(file_obj * const obj, const char * const path,
 
 	strncpy(pdata->file_path, path, sizeof(pdata->file_path) - 1);
 	pdata->mode = mode;
+	/* The statistics are reported per file */
+	obj->proc_obj.name = pdata->file_path;
 
 	return 0;
 }
 
 
+/**
+ * @brief Map a file opened for reading. Files that cannot be mapped (pipes,
+ *		empty files) are read with read() instead.
+ * @param pdata File private data.
+ */
+static void file_map(file_priv_data * const pdata)
+{
+	struct stat st;
+	void *map;
+
+	pdata->map = NULL;
+	pdata->map_len = 0;
+	if (fstat(pdata->fd, &st) || !S_ISREG(st.st_mode) || !st.st_size) {
+		return;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, pdata->fd, 0);
+	if (map == MAP_FAILED) {
+		WARNING("Cannot map %s, reading it: %s\n", pdata->file_path,
+			strerror(errno));
+		return;
+	}
+
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	pdata->map = (char *) map;
+	pdata->map_len = st.st_size;
+}
+
 /**
  * @brief This function is assigned to the file init callback of the file_obj.
  * @param obj File object.
@@ -157,6 +209,12 @@ static int file_open(file_obj * const obj)
 
 	pdata->is_open = true;
 	pdata->fd = rc;
+	pdata->pos = 0;
+	pdata->is_eof = false;
+
+	if (pdata->mode == FILE_RDONLY) {
+		file_map(pdata);
+	}
 
 	return 0;
 }
@@ -180,12 +238,142 @@ static int file_close(file_obj * const obj)
 		return -1;
 	}
 
+	if (pdata->map) {
+		munmap(pdata->map, pdata->map_len);
+		pdata->map = NULL;
+	}
+
 	close(pdata->fd);
 	pdata->is_open = false;
 
 	return 0;
 }
 
+/**
+ * @brief This function is assigned to the file_set_baudrate callback of the
+ *		file_obj.
+ * @param obj File object.
+ * @param baudrate Baudrate the capture was recorded at, 0 to replay as fast
+ *		as possible.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int file_set_baudrate(file_obj * const obj, unsigned int baudrate)
+{
+	file_priv_data *pdata = (file_priv_data *) obj->pdata;
+
+	if (!pdata->is_used) {
+		ERROR("The object was not initialized corretly\n");
+		return -1;
+	}
+
+	pdata->baudrate = baudrate;
+	return 0;
+}
+
+/**
+ * @brief This function is assigned to the file_is_eof callback of the
+ *		file_obj.
+ * @param obj File object.
+ * @return true once the whole file was read, false otherwise.
+ */
+static bool file_is_eof(file_obj * const obj)
+{
+	file_priv_data *pdata = (file_priv_data *) obj->pdata;
+
+	return pdata->is_eof;
+}
+
+/**
+ * @brief Wait until the bytes read so far would have been received at the
+ *		replay baudrate.
+ * @param pdata File private data.
+ */
+static void file_pace(file_priv_data * const pdata)
+{
+	unsigned long long ns;
+	struct timespec t = pdata->start;
+
+	ns = (pdata->pos * FILE_BITS_PER_BYTE * 1000000000ULL) /
+							pdata->baudrate;
+	t.tv_sec += ns / 1000000000ULL;
+	t.tv_nsec += ns % 1000000000ULL;
+	if (t.tv_nsec >= 1000000000L) {
+		t.tv_sec++;
+		t.tv_nsec -= 1000000000L;
+	}
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) ==
+	       EINTR);
+}
+
+/**
+ * @brief This callback will is the implemenatation of the virtual function
+ * 		data_out. The file content is sent one message at a time, when
+ * 		paced, a message holds the bytes received in FILE_PACE_PERIOD_MS.
+ *		Files opened for writing do not produce any data.
+ * @param obj Processing obj abstraction.
+ * @param msg message receiving the data read.
+ * @return Number of bytes read, 0 at the end of the file, -1 if there is an
+ *		error.
+ */
+static size_t file_read(processing_obj * const obj, message_obj * const msg)
+{
+	file_obj *f_obj = (file_obj *) obj;
+	file_priv_data *pdata = (file_priv_data *) f_obj->pdata;
+	size_t len = msg->total_len(msg);
+	size_t chunk;
+	ssize_t n;
+
+	if ((pdata->mode != FILE_RDONLY) || !pdata->is_open || pdata->is_eof) {
+		return 0;
+	}
+
+	if (pdata->baudrate) {
+		if (!pdata->pos) {
+			clock_gettime(CLOCK_MONOTONIC, &pdata->start);
+		}
+
+		chunk = (pdata->baudrate * FILE_PACE_PERIOD_MS) /
+					(FILE_BITS_PER_BYTE * 1000ULL);
+		if (chunk && (chunk < len)) {
+			len = chunk;
+		}
+	}
+
+	if (pdata->map) {
+		n = pdata->map_len - pdata->pos;
+		if ((size_t) n > len) {
+			n = len;
+		}
+		msg->write(msg, &pdata->map[pdata->pos], n);
+	} else {
+		n = read(pdata->fd, msg->ptr(msg), len);
+		if (n < 0) {
+			ERROR("While reading file %s\n", strerror(errno));
+			return -1;
+		}
+		msg->set_length(msg, n);
+	}
+
+	if (!n) {
+		DEBUG("End of %s after %zu bytes\n", pdata->file_path,
+		      pdata->pos);
+		pdata->is_eof = true;
+		return 0;
+	}
+
+	pdata->pos += n;
+	if (pdata->map && (pdata->pos == pdata->map_len)) {
+		pdata->is_eof = true;
+	}
+
+	if (pdata->baudrate) {
+		file_pace(pdata);
+	}
+
+	return n;
+}
+
 /**
  * @brief This callback will is the implemenatation of the virtual function
  * 		data_in.
@@ -223,13 +411,16 @@ int file_init(file_obj * const obj)
 	obj->file_init = file_open;
 	obj->file_fini = file_close;
 	obj->file_set_path = file_set_path;
+	obj->file_set_baudrate = file_set_baudrate;
+	obj->file_is_eof = file_is_eof;
 
 	if (processing_init(proc_obj)) {
 		goto processing_init_failed;
 	}
 
 	proc_obj->data_in = file_write;
-	/** TODO File read for now leave the normal one */
+	proc_obj->data_out = file_read;
+	proc_obj->name = "file";
 
 	return 0;
 processing_init_failed:
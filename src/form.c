@@ -0,0 +1,95 @@
+/**
+ * @file form.c
+ * @brief Definitions shared by the form objects: the session, board and
+ *		software information written at the beginning of their outputs
+ *		and the buffering of the packets received.
+ * @author	Alexandre Malki <amalki@piap.pl>
+ */
+#include <form.h>
+#include <config.h>
+#include <common-macros.h>
+#include <debug.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FORM_SESSION_FIELD(section_cfg, name_cfg, node_name)		\
+		{							\
+			.section = section_cfg,				\
+			.name = name_cfg,				\
+			.node = node_name,				\
+		}
+
+/**
+ * This is the table linking the configuration file to the session
+ * information of the outputs. The values of a same node are contiguous.
+ */
+const form_session_field form_session_fields[] = {
+	FORM_SESSION_FIELD("session", "id", "session_info"),
+	FORM_SESSION_FIELD("session", "date", "session_info"),
+	FORM_SESSION_FIELD("session", "type", "session_info"),
+
+	FORM_SESSION_FIELD("board-info", "name", "board_info"),
+	FORM_SESSION_FIELD("board-info", "cpu", "board_info"),
+	FORM_SESSION_FIELD("board-info", "cortex", "board_info"),
+	FORM_SESSION_FIELD("board-info", "hardware_module", "board_info"),
+
+	FORM_SESSION_FIELD("soft-info", "name", "soft_info"),
+	FORM_SESSION_FIELD("soft-info", "version_nuttx", "soft_info"),
+	FORM_SESSION_FIELD("soft-info", "commit-id_nuttx", "soft_info"),
+	FORM_SESSION_FIELD("soft-info", "config_nuttx", "soft_info"),
+};
+
+const unsigned int form_session_fields_count = ARRAY_SIZE(form_session_fields);
+
+const char *form_session_get(const form_session_field * const field)
+{
+	cfg_param param = {
+		.section = field->section,
+		.name = field->name,
+		.type = CONFIG_STR,
+	};
+	const char *value;
+
+	value = CONFIG_HELPER_GET_STR(&param);
+
+	return param.found ? value : NULL;
+}
+
+size_t form_pkt_buf_receive(form_pkt_buf * const buf,
+			    processing_obj * const obj,
+			    message_obj * const msg)
+{
+	size_t count = msg->length(msg) / sizeof(union libswo_packet);
+	union libswo_packet *pkt;
+
+	buf->count = 0;
+	buf->next = 0;
+
+	if (!count) {
+		return 0;
+	}
+
+	if (count > buf->cap) {
+		pkt = realloc(buf->pkt, count * sizeof(*pkt));
+		if (!pkt) {
+			ERROR("Could not allocate memory\n");
+			return -1;
+		}
+
+		buf->pkt = pkt;
+		buf->cap = count;
+	}
+
+	memcpy(buf->pkt, msg->ptr(msg), count * sizeof(*pkt));
+	buf->count = count;
+	obj->stats.packets += count;
+
+	return count * sizeof(*pkt);
+}
+
+void form_pkt_buf_free(form_pkt_buf * const buf)
+{
+	free(buf->pkt);
+	memset(buf, 0, sizeof(*buf));
+}
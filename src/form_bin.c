@@ -0,0 +1,265 @@
+/**
+ * @file form_bin.c
+ * @brief Form object writing the packets as a binary packet log, a compact
+ *		alternative to the JSON output. The format is described in
+ *		pkt_log.c, pktlog2json converts a log to JSON offline.
+ * @author	Alexandre Malki <amalki@piap.pl>
+ */
+#include <debug.h>
+#include <config.h>
+#include <common-macros.h>
+#include <form.h>
+#include <pkt_converter.h>
+#include <pkt_log.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * This structure represent the binary output. The offsets are the ones in the
+ * output stream, it is expected to be written to a file as is.
+ */
+typedef struct {
+	/** Header of the log, formatted at init */
+	char	header[FORM_HEADER_LEN_MAX];
+	/** Length of the header */
+	size_t	header_len;
+	/** Packets received and not written yet */
+	form_pkt_buf	pkts;
+	/** Bytes written so far */
+	uint64_t offset;
+	/** Packets written so far */
+	uint64_t written;
+	/** Offset of the last index record, 0 if none */
+	uint64_t last_index;
+	/** Packets written since the last index record */
+	unsigned int since_index;
+	/** Indicating if the node is used or not */
+	bool	is_used;
+	/** Indicating if this is the first run */
+	bool	is_nfirstrun;
+	/** Indicating if the end record was written */
+	bool	is_end_written;
+	/** Pointer on a packet to binary form translator*/
+	pkt_to_form *ptf;
+} form_bin_priv_data;
+
+/** Configure the kind of pkt translator needed */
+static pkt_to_form bin_ptf = {
+		.fmt = PKT_CONVERTER_BIN,
+	};
+
+/** Instantiate on element of the private data */
+static form_bin_priv_data bin_priv_data = {
+	.ptf = &bin_ptf,
+};
+
+/**
+ * @brief Write an index record, the offset of the record is kept so the next
+ *		one links to it.
+ * @param bpdata Binary private data.
+ * @param type PKT_LOG_REC_INDEX or PKT_LOG_REC_END.
+ * @param buf Output buffer.
+ * @param pos Position in buf, moved past the record upon success.
+ * @param len Size of buf.
+ * @return 0 upon success, -1 if it does not fit.
+ */
+static int form_bin_write_index(form_bin_priv_data * const bpdata,
+				unsigned int type, char * const buf,
+				size_t * const pos, size_t len)
+{
+	pkt_log_index idx = {
+		.count = bpdata->written,
+		.prev = bpdata->last_index,
+	};
+	uint64_t offset = bpdata->offset + *pos;
+
+	if (pkt_log_write_index(type, &idx, buf, pos, len)) {
+		return -1;
+	}
+
+	bpdata->last_index = offset;
+	bpdata->since_index = 0;
+	return 0;
+}
+
+/**
+ * @brief This callback is the implentation of the processing object function
+ *		data_out. It writes the header first, then a record per packet
+ *		and an index record every PKT_LOG_INDEX_INTERVAL packets. When
+ *		the packets do not fit in one message, req_send_more is set and
+ *		the next call carries on where the previous one stopped.
+ * @param obj Processing abstraction object
+ * @param msg Message obj that hold the records.
+ * @return The number of byte written upon sucecss, -1 otherwise.
+ */
+static size_t form_bin_send_data(processing_obj * const obj,
+				 message_obj * const msg)
+{
+	form_bin_priv_data *bpdata = (form_bin_priv_data *)
+						((form_obj *) obj)->pdata;
+	size_t totlen = msg->total_len(msg);
+	char *buf = msg->ptr(msg);
+	size_t pos = 0;
+	int rc;
+
+	if (!bpdata->is_nfirstrun) {
+		if (bpdata->header_len > totlen) {
+			ERROR("Header does not fit the message\n");
+			return -1;
+		}
+
+		memcpy(buf, bpdata->header, bpdata->header_len);
+		pos = bpdata->header_len;
+		bpdata->is_nfirstrun = true;
+	}
+
+	while (bpdata->pkts.next < bpdata->pkts.count) {
+		if ((bpdata->since_index >= PKT_LOG_INDEX_INTERVAL) &&
+		    form_bin_write_index(bpdata, PKT_LOG_REC_INDEX, buf, &pos,
+					 totlen)) {
+			obj->req_send_more = true;
+			break;
+		}
+
+		rc = pkt_convert(bpdata->ptf,
+				 &bpdata->pkts.pkt[bpdata->pkts.next], buf,
+				 &pos, totlen);
+		if (rc < 0) {
+			obj->req_send_more = true;
+			break;
+		}
+
+		if (!rc) {
+			bpdata->written++;
+			bpdata->since_index++;
+		}
+		bpdata->pkts.next++;
+	}
+
+	if (obj->req_end && !obj->req_send_more && !bpdata->is_end_written) {
+		if (!form_bin_write_index(bpdata, PKT_LOG_REC_END, buf, &pos,
+					  totlen)) {
+			bpdata->is_end_written = true;
+		} else {
+			obj->req_send_more = true;
+		}
+	}
+
+	bpdata->offset += pos;
+	msg->set_length(msg, pos);
+	return pos;
+}
+
+/**
+ * @brief This callback is the implentation of the processing object function
+ *		data_in. The packets are kept until data_out writes them, the
+ *		message they are in is reused for the output.
+ * @param obj Processing abstraction object
+ * @param msg Message object that holds the libswo data.
+ * @return The number of byte read from the message object buffer.
+ */
+static size_t form_bin_receive_data(processing_obj * const obj,
+				    message_obj * const msg)
+{
+	form_bin_priv_data *bpdata = (form_bin_priv_data *)
+						((form_obj *) obj)->pdata;
+
+	return form_pkt_buf_receive(&bpdata->pkts, obj, msg);
+}
+
+/*
+ * @brief Format the header of the log with the session, board and software
+ *		information.
+ * @param obj The generic form_obj.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int form_bin_init_header(form_obj * const obj)
+{
+	form_bin_priv_data *bpdata = (form_bin_priv_data *) obj->pdata;
+	pkt_log_field *fields;
+	const form_session_field *field;
+	size_t pos = 0;
+	int rc = -1;
+
+	fields = calloc(form_session_fields_count, sizeof(*fields));
+	if (!fields) {
+		ERROR("Could not allocate memory\n");
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < form_session_fields_count; i++) {
+		field = &form_session_fields[i];
+		fields[i].node = field->node;
+		fields[i].name = field->name;
+		if (!(fields[i].value = form_session_get(field))) {
+			ERROR("%s/%s is not configured\n", field->section,
+			      field->name);
+			goto field_failed;
+		}
+	}
+
+	if (pkt_log_write_header(bpdata->header, &pos, sizeof(bpdata->header),
+				 fields, form_session_fields_count)) {
+		ERROR("Session information longer than %zu bytes\n",
+		      sizeof(bpdata->header));
+		goto field_failed;
+	}
+
+	bpdata->header_len = pos;
+	rc = 0;
+field_failed:
+	free(fields);
+	return rc;
+}
+
+int form_bin_init(form_obj * const obj)
+{
+	processing_obj * const proc_obj = (processing_obj *)obj;
+
+	if (processing_init(proc_obj)) {
+		return -1;
+	}
+
+	proc_obj->name = "form_bin";
+
+	if (bin_priv_data.is_used) {
+		ERROR("Binary form object already used\n");
+		goto no_free_instance;
+	}
+
+	bin_priv_data.is_used = true;
+	obj->pdata = (void *) &bin_priv_data;
+
+	/* The header only needs to be formatted once */
+	if (form_bin_init_header(obj)) {
+		goto init_header_failed;
+	}
+
+	proc_obj->data_in = form_bin_receive_data;
+	proc_obj->data_out = form_bin_send_data;
+
+	return 0;
+init_header_failed:
+	bin_priv_data.is_used = false;
+no_free_instance:
+	processing_fini((processing_obj *) obj);
+	return -1;
+}
+
+int form_bin_fini(form_obj * const obj)
+{
+	form_bin_priv_data *pdata = (form_bin_priv_data *) obj->pdata;
+
+	if (!pdata) {
+		return 0;
+	}
+
+	form_pkt_buf_free(&pdata->pkts);
+	memset(pdata, 0, sizeof(*pdata));
+	pdata->ptf = &bin_ptf;
+	obj->pdata = NULL;
+
+	return processing_fini((processing_obj *) obj);
+}
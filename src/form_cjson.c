@@ -10,51 +10,46 @@
 #include <form.h>
 #include <pkt_converter.h>
 
-#include <cJSON.h>
-
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 
 /** End of file char to append to the JSON data */
-#define CJSON_END_OF_FILE "\n\t]\n}"
+#define JSON_END_OF_FILE "\n\t]\n}\n"
 
-/** This structure link the configuration param to the json element */
-typedef struct {
-	/** Configuration parameter */
-	cfg_param param;
-	/**
-	 * Using the address of the pointer in case of  changes
-	 */
-	cJSON **parent;
-} json_config;
-
-/** This structure represend the cjson output with its different node */
+/** Value of the output format selecting one packet per line */
+#define JSON_FORMAT_NDJSON "ndjson"
+
+/**
+ * This structure represend the json output. The packets are written straight
+ * into the output message, the session information is only formatted once.
+ */
 typedef struct {
-	/** Root benchmarking CJSON node */
-	cJSON	*root_benchmarking;
-	/**  Session CJSON node */
-	cJSON	*session_info;
-	/** Board related information CJSON node */
-	cJSON	*board_info;
-	/** Software related information CJSON node */
-	cJSON	*soft_info;
-	/**  Packets table CJSON node */
-	cJSON	*packets;
+	/** Session, board and software information, formatted at init */
+	char	header[FORM_HEADER_LEN_MAX];
+	/** Length of the header */
+	size_t	header_len;
+	/** Packets received and not written yet */
+	form_pkt_buf	pkts;
 	/** Indicating if the node is used or not */
 	bool	is_used;
 	/** Indicating if this is the first run */
 	bool	is_nfirstrun;
-	/** Table on the list of json_cfg */
-	json_config *json_cfgs;
-	/** Pointer on a packet to cjson form translator*/
+	/** Indicating if a packet was already written */
+	bool	is_nfirstpkt;
+	/** Indicating if the end of the document was written */
+	bool	is_end_written;
+	/** One packet per line (NDJSON) instead of a single document */
+	bool	is_ndjson;
+	/** Pointer on a packet to json form translator*/
 	pkt_to_form *ptf;
 } form_json_priv_data;
 
 
-/* TODO Stringify */
-
 /** Configure the kind of pkt translator needed */
 static pkt_to_form cjson_ptf = {
 		.fmt = PKT_CONVERTER_CJSON,
@@ -65,154 +60,77 @@ static form_json_priv_data json_priv_data = {
 	.ptf = &cjson_ptf,
 };
 
-#define JSON_CONFIG_INIT(section, name, type, ROOT_CJSON)			\
-		{	 							\
-			.param = CONFIG_HELPER_CREATE(section, name, type),	\
-			.parent = &json_priv_data.ROOT_CJSON,			\
-		}
-
-/**
- * This is the table of structure linkes the cJSON object to the configuration
- * file.
- */
-static json_config form_json_cfgs[] = {
-	JSON_CONFIG_INIT("session", "id", CONFIG_STR, session_info),
-	JSON_CONFIG_INIT("session", "date", CONFIG_STR, session_info),
-	JSON_CONFIG_INIT("session", "type", CONFIG_STR, session_info),
-
-	JSON_CONFIG_INIT("board-info", "name", CONFIG_STR, board_info),
-	JSON_CONFIG_INIT("board-info", "cpu", CONFIG_STR, board_info),
-	JSON_CONFIG_INIT("board-info", "cortex", CONFIG_STR, board_info),
-	JSON_CONFIG_INIT("board-info", "hardware_module", CONFIG_STR, board_info),
-
-	JSON_CONFIG_INIT("soft-info", "name", CONFIG_STR, soft_info),
-	JSON_CONFIG_INIT("soft-info", "version_nuttx", CONFIG_STR, soft_info),
-	JSON_CONFIG_INIT("soft-info", "commit-id_nuttx", CONFIG_STR, soft_info),
-	JSON_CONFIG_INIT("soft-info", "config_nuttx", CONFIG_STR, soft_info),
-};
-
 /**
- * @brief It will format the output of the first message by removing the last
- *		square bracket and last curly bracket.
- * @param msg A message containing a string containing at least one square bracket
- *		and one curly bracket.
+ * @brief Append a formatted string to a buffer.
+ * @param buf Output buffer.
+ * @param pos Position in buf, moved past the string upon success.
+ * @param len Size of buf.
+ * @param fmt printf format.
+ * @return 0 upon success, -1 if it does not fit.
  */
-static void form_json_format_init_output(message_obj * const msg)
+static int form_json_print_fmt(char * const buf, size_t * const pos,
+			       size_t len, const char * const fmt, ...)
 {
-	char *brace = strrchr(msg->ptr(msg), ']');
-	char *end = strrchr(msg->ptr(msg), '}');
-
+	va_list args;
+	int n;
 
-	brace[0] = ',';
-	brace[1] = '\n';
+	va_start(args, fmt);
+	n = vsnprintf(&buf[*pos], len - *pos, fmt, args);
+	va_end(args);
 
-	msg->set_length(msg, msg->length(msg) - ((uintptr_t) end
-				- (uintptr_t)brace) - 1);
-}
-
-/**
- * @brief It will format the output of the all messages except the first  by
- *		 removing the last square bracket and last curly bracket.
- * @param msg A message containing a string containing at least one square bracket
- *		and one curly bracket.
- * @return 0 upon success, -1 otherwise.
- */
-static int form_json_format_child_output(message_obj * const msg)
-{
-	size_t written = 0;
-	char *prev_token, *token, *copy, *temp;
-	char buffer[STRING_MAX_LENGTH];
-	char *delimiter = "\n";
-	size_t tot_len = msg->total_len(msg);
-	size_t read;
-	unsigned int pos = 0;
-
-	if (!(temp = strndup(msg->ptr(msg), MESSAGE_BUFFER_SZ_MAX - 1))) {
-		ERROR("Could not allocate memory to temp buffer\n");
-		return -1;
-	}
-	if (!(copy = strndup(msg->ptr(msg), MESSAGE_BUFFER_SZ_MAX - 1))) {
-		ERROR("Could not allocate memory to copy buffer\n");
+	if ((n < 0) || ((size_t) n >= (len - *pos))) {
 		return -1;
 	}
 
-	token = strtok(temp, delimiter);
-	msg->set_length(msg, 0);
-	while (token) {
-		pos = token - temp;
-
-		if (copy[pos] == '{') {
-			read = snprintf(buffer, sizeof(buffer) - 1,
-					    ", %s\n", token);
-		} else if (copy[pos] == '}') {
-			read = snprintf(buffer, sizeof(buffer) - 1,
-					    "\t\t}, {\n");
-		} else {
-			read = snprintf(buffer, sizeof(buffer) - 1,
-					    "\t\t%s\n", token);
-		}
-
-		if (tot_len < (written + read)) {
-			WARNING("not all messages will be printed\n");
-			break;
-		}
-
-		written += read;
-		msg->append(msg, buffer, read);
-		token = strtok(NULL, delimiter);
-	}
-
-	if (!written) {
-		WARNING("nothing written by json child node needs checkout\n");
-		return 0;
-	}
-
-	msg->ptr(msg)[written - 4] = '\0';
-	msg->set_length(msg, written - 4);
-	free(copy);
-	free(temp);
+	*pos += n;
+	return 0;
 }
 
 /**
- * @brief This function is formating into a string the JSON nodes.
- * @param pnode Parent node. All children of this parent will be printed into 
- *		the buffer string message msg.
- * @param msg The message object containing the string buffer.
- * @return the number of byte written upon success, otherwise -1.
+ * @brief Write one packet preceded by its separator. In the JSON document the
+ *		packets are the elements of the "packet" table, in NDJSON each
+ *		one is a line.
+ * @param jpdata JSON private data.
+ * @param pkt Packet to write.
+ * @param buf Output buffer.
+ * @param pos Position in buf, moved past the packet upon success.
+ * @param len Size of buf.
+ * @return 0 upon success, 1 if the packet is skipped, -1 if it does not fit.
  */
-static size_t form_json_print_nodes(cJSON *pnode, message_obj * const msg)
+static int form_json_write_pkt(form_json_priv_data * const jpdata,
+			       const union libswo_packet * const pkt,
+			       char * const buf, size_t * const pos,
+			       size_t len)
 {
-	size_t rc = -1;
-	char *data = NULL;
-
-	data = cJSON_Print(pnode);
+	size_t n = *pos;
+	int rc;
 
-	if (!data) {
-		ERROR("could not print to json\n");
-		return 0;
+	if (!jpdata->is_ndjson) {
+		if (form_json_print_fmt(buf, &n, len, "%s\t\t",
+					jpdata->is_nfirstpkt ? ",\n" : "")) {
+			return -1;
+		}
 	}
 
-	rc = strnlen(data, msg->total_len(msg) * 2);
-	if (rc + msg->length(msg) > msg->total_len(msg)) {
-		WARNING("Data to write is bigger than the msg's buffer, "
-		      "%ld/%ld\n", (rc + msg->length(msg)), msg->total_len(msg));
-		/* We cannot go futher, so we return an error to the calling function */
-		rc = -1 ;
-		goto buffer_failed;
+	if ((rc = pkt_convert(jpdata->ptf, pkt, buf, &n, len))) {
+		return rc;
 	}
 
-	msg->append(msg, data, rc);
-	rc = msg->length(msg);
-buffer_failed:
-	free(data);
-	return rc;
+	if (jpdata->is_ndjson && form_json_print_fmt(buf, &n, len, "\n")) {
+		return -1;
+	}
 
+	jpdata->is_nfirstpkt = true;
+	*pos = n;
+	return 0;
 }
 
 /**
  * @brief This callback is the implentation of the processing object function 
- *		data_out. It will convert the cJSON data to a formate string to
- *		be written into a file.
+ *		data_out. It writes the packets received as JSON straight into
+ *		the message, the session information first. When the packets do
+ *		not fit in one message, req_send_more is set and the next call
+ *		carries on where the previous one stopped.
  * @param obj Processing abstraction object 
  * @param msg Message obj that hold the string buffer.
  * @return The number of byte written upon sucecss, -1 otherwise.
@@ -222,50 +140,60 @@ static size_t form_json_send_data(processing_obj * const obj,
 {
 	form_json_priv_data *jpdata = (form_json_priv_data *)
 						((form_obj *) obj)->pdata;
-	cJSON *node;
-	int rc = 0, err;
+	size_t totlen = msg->total_len(msg);
+	char *buf = msg->ptr(msg);
+	size_t pos = 0;
+	int rc = 0;
 
-	if (obj->req_end) {
-		msg->write(msg, CJSON_END_OF_FILE ,sizeof(CJSON_END_OF_FILE) - 1);
-		return sizeof(CJSON_END_OF_FILE) - 1;
+	if (!jpdata->is_nfirstrun) {
+		/* First time, we shall write information + data */
+		if (jpdata->header_len > totlen) {
+			ERROR("Session information does not fit the message\n");
+			return -1;
+		}
+
+		memcpy(buf, jpdata->header, jpdata->header_len);
+		pos = jpdata->header_len;
+		jpdata->is_nfirstrun = true;
 	}
 
-	/* TODO clean this function */
-	if (!jpdata->is_nfirstrun) {
-		/* First time, we shall write data + information */
-		node = jpdata->root_benchmarking;
-		rc = form_json_print_nodes(node, msg);
-		jpdata->is_nfirstrun = 1;
-		form_json_format_init_output(msg);
-	} else {
-		/* Loop over packet node */
-		node = jpdata->ptf->root->child;
-		while (node) {
-			if ((err = form_json_print_nodes(node, msg)) < 0) {
-				return -1;
+	while (jpdata->pkts.next < jpdata->pkts.count) {
+		rc = form_json_write_pkt(jpdata,
+					 &jpdata->pkts.pkt[jpdata->pkts.next],
+					 buf, &pos, totlen);
+		if (rc < 0) {
+			if (!pos) {
+				/* Would never fit, do not loop forever on it */
+				WARNING("Packet too long, skipping\n");
+				jpdata->pkts.next++;
+				continue;
 			}
-			rc = err;
-			node = node->next;
+
+			obj->req_send_more = true;
+			break;
 		}
 
-		if (form_json_format_child_output(msg))
-			return 0;
+		jpdata->pkts.next++;
 	}
 
-	cJSON_Delete(jpdata->ptf->root->child);
-	jpdata->ptf->root->child = NULL;
-
-	if (rc < 0) {
-		return rc;
+	if (obj->req_end && !obj->req_send_more && !jpdata->is_ndjson &&
+	    !jpdata->is_end_written) {
+		if (!form_json_print_fmt(buf, &pos, totlen,
+					 JSON_END_OF_FILE)) {
+			jpdata->is_end_written = true;
+		} else {
+			obj->req_send_more = true;
+		}
 	}
 
-	return msg->length(msg);
+	msg->set_length(msg, pos);
+	return pos;
 }
 
 /**
  * @brief This callback is the implentation of the processing object function 
- *		data_in. It will convert the cJSON data to a formate string to
- *		be written into a file.
+ *		data_in. The packets are kept until data_out writes them, the
+ *		message they are in is reused for the output.
  * @param obj Processing abstraction object 
  * @param msg Message object that holds the libswo data.
  * @return The number of byte read from the message object buffer.
@@ -275,186 +203,113 @@ static size_t form_json_receive_data(processing_obj * const obj,
 {
 	form_json_priv_data *jpdata = (form_json_priv_data *)
 						((form_obj *) obj)->pdata;
-	jpdata->ptf->root = jpdata->packets;
-
-	if (obj->req_end) {
-		return 0;
-	}
 
-	return pkt_convert(jpdata->ptf, msg);
+	return form_pkt_buf_receive(&jpdata->pkts, obj, msg);
 }
 
 /*
- * @brief Creating a cJSON string node.
- * @param parent The cJSON parent node.
- * @param name Name of the cJSON string node.
- * @param value The name that will be displayed in the JSON output.
- */
-static int form_json_create_str_node(cJSON *parent, const char * const name,
-				      char const * const value)
-{
-	if (!cJSON_AddStringToObject(parent, name, value)) {
-		ERROR("Error while creating string node\n");
-		return -1;
-	}
-
-	return 0;
-}
-
-/*
- * @brief Creating a cJSON number node. cJSON library uses float number.
- * @param parent The cJSON parent node.
- * @param name Name of the cJSON number node.
- * @param value The number that will be stored in that node.
- * @return 0 upon success, -1 otherwise.
- */
-static int form_json_create_num_node(cJSON *parent, const char * const name,
-				     float value)
-{
-	if (!cJSON_AddNumberToObject(parent, name, value)) {
-		ERROR("Error while creating float node\n");
-		return -1;
-	}
-
-	return 0;
-}
-
-/*
- * @brief Create the firsts nodes that holds information such as the session,
- * 		board, software and type of benchmarking information.
- * @param This is the software info.
+ * @brief Format the session, board and software information once. In a JSON
+ *		document they come before the "packet" table, in NDJSON they are
+ *		the first line.
+ * @param obj The generic form_obj.
  * @return 0 upon success, -1 otherwise.
  */
-static int form_json_init_nodes(form_obj * const obj)
+static int form_json_init_header(form_obj * const obj)
 {
 	form_json_priv_data *jpdata = (form_json_priv_data *) obj->pdata;
-	cfg_param *cfg;
-	cJSON *parent;
-	const char *name;
-	float value_fl;
-	char const * value_str;
-	int rc = -1;
-
-	for (unsigned int i=0; i<ARRAY_SIZE(form_json_cfgs);i++) {
-		cfg = &jpdata->json_cfgs[i].param;
-		parent = *jpdata->json_cfgs[i].parent;
-		name = cfg->name;
-
-		switch(cfg->type) {
-			case CONFIG_STR:
-				value_str = CONFIG_HELPER_GET_STR(cfg);
-				if (!cfg->found) {
-					return -1;
-				}
-
-				rc = form_json_create_str_node(parent, name,
-							       value_str);
-			break;
-			case CONFIG_INT:
-				value_fl = (float) CONFIG_HELPER_GET_S32(cfg);
-				if (!cfg->found) {
-					return -1;
-				}
-
-				rc = form_json_create_num_node(parent, name,
-							       value_fl);
-			break;
-			case CONFIG_UNSIGNED_INT:
-				value_fl = (float) CONFIG_HELPER_GET_U32(cfg);
-				if (!cfg->found) {
-					return -1;
-				}
-
-				rc = form_json_create_num_node(parent, name,
-							       value_fl);
-			break;
-			default:
-				ERROR("Invalid type of configuration\n");
-			break;
+	const size_t len = sizeof(jpdata->header);
+	char * const buf = jpdata->header;
+	const char *sep = jpdata->is_ndjson ? " " : "\n\t";
+	const form_session_field *field;
+	const char *node = NULL;
+	const char *value;
+	size_t pos = 0;
+	int rc = 0;
+
+	for (unsigned int i=0; (i<form_session_fields_count) && !rc; i++) {
+		field = &form_session_fields[i];
+		if (!(value = form_session_get(field))) {
+			ERROR("%s/%s is not configured\n", field->section,
+			      field->name);
+			return -1;
+		}
+
+		/* Open the object of the value, closing the previous one */
+		if (field->node != node) {
+			rc = form_json_print_fmt(buf, &pos, len, "%s%s\"%s\": {",
+						 node ? "}," : "{", sep,
+						 field->node);
+			node = field->node;
+		} else {
+			rc = form_json_print_fmt(buf, &pos, len, ", ");
 		}
 
-		if (rc)
-			return rc;
+		rc = rc || pkt_convert_json_str(buf, &pos, len, field->name) ||
+		     form_json_print_fmt(buf, &pos, len, ": ") ||
+		     pkt_convert_json_str(buf, &pos, len, value);
 	}
 
-	/* Creating packet table which will hold the debugging information */
-	jpdata->packets = cJSON_AddArrayToObject(jpdata->root_benchmarking,
-						   "packet");
-	if (!jpdata->packets) {
-		ERROR("Error while creating string node\n");
+	if (!rc) {
+		/* Packets are written after the header */
+		rc = form_json_print_fmt(buf, &pos, len,
+					 jpdata->is_ndjson ? "}}\n" :
+					 "},\n\t\"packet\": [\n");
+	}
+
+	if (rc) {
+		ERROR("Session information longer than %zu bytes\n", len);
 		return -1;
 	}
 
+	jpdata->header_len = pos;
 	return 0;
 }
 
 /**
- * @brief this Function init the main cJSON objects describing the session 
+ * @brief Read the output format from the configuration, a JSON document by
+ *		default.
  * @param obj The generic form_obj.
- * @return 0 upon success, -1 if an error ocurred while add/creatin cJSON object.
  */
-static int form_json_init_session(form_obj * const obj)
+static void form_json_init_format(form_obj * const obj)
 {
-	form_json_priv_data *pdata = (form_json_priv_data *) obj->pdata;
-	json_config *json_cfgs = pdata->json_cfgs;
-
-	/* create root nodes 8 */
-	pdata->session_info = cJSON_AddObjectToObject(pdata->root_benchmarking, "session");
-	if (!pdata->session_info)
-		return -1;
-
-	pdata->board_info =  cJSON_AddObjectToObject(pdata->root_benchmarking, "board_info");
-	if (!pdata->board_info)
-		return -1;
-
-	pdata->soft_info =  cJSON_AddObjectToObject(pdata->root_benchmarking, "soft_info");
-	if (!pdata->soft_info)
-		return -1;
-
-	pdata->session_info =  cJSON_AddObjectToObject(pdata->root_benchmarking, "session_info");
-	if (!pdata->session_info)
-		return -1;
-
-	if (form_json_init_nodes(obj)) {
-		return -1;
-	}
+	form_json_priv_data *jpdata = (form_json_priv_data *) obj->pdata;
+	cfg_param param = {
+		.section = CFG_SECTION_OUTPUT_FILE,
+		.name = CFG_SECTION_OUTPUT_FILE_JSON_FMT,
+		.type = CONFIG_STR,
+	};
+	const char *fmt;
 
-	return 0;
+	fmt = CONFIG_HELPER_GET_STR(&param);
+	jpdata->is_ndjson = param.found && !strcmp(fmt, JSON_FORMAT_NDJSON);
+	DEBUG("JSON output format: %s\n",
+	      jpdata->is_ndjson ? JSON_FORMAT_NDJSON : "json");
 }
 
 int form_cjson_init(form_obj * const obj)
 {
 	processing_obj * const proc_obj = (processing_obj *)obj;
-	form_json_priv_data *pdata;
 
 	if (processing_init(proc_obj)) {
 		return -1;
 	}
 
+	proc_obj->name = "form_cjson";
+
 	if (json_priv_data.is_used) {
 		ERROR("JSON from object already used\n");
 		goto no_free_instance;
 	}
 
 	json_priv_data.is_used = true;
-	json_priv_data.json_cfgs = form_json_cfgs;
 
 	obj->pdata = (void *) &json_priv_data;
-	pdata = obj->pdata;
-
-	/**
-	 * Creating root JSON object here the root only is needed
-	 * to be freed
-	 */
-	pdata->root_benchmarking = cJSON_CreateObject();
-	if (!pdata->root_benchmarking) {
-		ERROR("JSON root object creation failed\n");
-		goto json_failed;
-	}
 
-	/* Create other default object */
-	if (form_json_init_session(obj)) {
-		goto init_session_failed;
+	form_json_init_format(obj);
+
+	/* The session information only needs to be formatted once */
+	if (form_json_init_header(obj)) {
+		goto init_header_failed;
 	}
 
 	/* Set up processing callbacks that will translate the
@@ -463,9 +318,8 @@ int form_cjson_init(form_obj * const obj)
 	proc_obj->data_out = form_json_send_data;
 
 	return 0;
-init_session_failed:
-	cJSON_Delete(json_priv_data.root_benchmarking);
-json_failed:
+init_header_failed:
+	json_priv_data.is_used = false;
 no_free_instance:
 	processing_fini((processing_obj *) obj);
 	return -1;
@@ -473,7 +327,16 @@ no_free_instance:
 
 int form_cjson_fini(form_obj * const obj)
 {
-/** TODO implemente this */
-	DEBUG("To Be implemented\n");
-	return 0;
+	form_json_priv_data *pdata = (form_json_priv_data *) obj->pdata;
+
+	if (!pdata) {
+		return 0;
+	}
+
+	form_pkt_buf_free(&pdata->pkts);
+	memset(pdata, 0, sizeof(*pdata));
+	pdata->ptf = &cjson_ptf;
+	obj->pdata = NULL;
+
+	return processing_fini((processing_obj *) obj);
 }
@@ -0,0 +1,196 @@
+/**
+ * @file form_sqlite.c
+ * @brief Form object inserting the packets in a SQLite database, the capture
+ *		can then be queried without any conversion. The object is a
+ *		sink: it has no output. The tables are described in pkt_sql.c .
+ * @author	Alexandre Malki <amalki@piap.pl>
+ */
+#include <debug.h>
+#include <config.h>
+#include <common-macros.h>
+#include <form.h>
+#include <pkt_converter.h>
+#include <pkt_sql.h>
+
+#include <stdbool.h>
+#include <string.h>
+
+/** This structure represent the database output */
+typedef struct {
+	/** The database */
+	pkt_sql_db *db;
+	/** Indicating if the node is used or not */
+	bool	is_used;
+	/** Pointer on a packet to database translator*/
+	pkt_to_form *ptf;
+} form_sqlite_priv_data;
+
+/** Configure the kind of pkt translator needed */
+static pkt_to_form sqlite_ptf = {
+		.fmt = PKT_CONVERTER_SQLITE,
+	};
+
+/** Instantiate on element of the private data */
+static form_sqlite_priv_data sqlite_priv_data = {
+	.ptf = &sqlite_ptf,
+};
+
+/**
+ * @brief This callback is the implentation of the processing object function
+ *		data_out. The packets are already in the database, nothing is
+ *		passed to the children.
+ * @param obj Processing abstraction object
+ * @param msg Message obj, left empty.
+ * @return 0.
+ */
+static size_t form_sqlite_send_data(processing_obj * const obj,
+				    message_obj * const msg)
+{
+	msg->set_length(msg, 0);
+	return 0;
+}
+
+/**
+ * @brief This callback is the implentation of the processing object function
+ *		data_in. The packets of the message are inserted in a single
+ *		transaction, one per pipeline round.
+ * @param obj Processing abstraction object
+ * @param msg Message object that holds the libswo data.
+ * @return The number of byte read from the message object buffer, -1 if the
+ *		transaction failed.
+ */
+static size_t form_sqlite_receive_data(processing_obj * const obj,
+				       message_obj * const msg)
+{
+	form_sqlite_priv_data *spdata = (form_sqlite_priv_data *)
+						((form_obj *) obj)->pdata;
+	size_t count = msg->length(msg) / sizeof(union libswo_packet);
+	const union libswo_packet *pkts;
+
+	if (!count) {
+		return 0;
+	}
+
+	pkts = (const union libswo_packet *) msg->ptr(msg);
+	if (pkt_sql_begin(spdata->db)) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (pkt_convert(spdata->ptf, &pkts[i], NULL, NULL, 0) < 0) {
+			pkt_sql_rollback(spdata->db);
+			return -1;
+		}
+	}
+
+	if (pkt_sql_commit(spdata->db)) {
+		pkt_sql_rollback(spdata->db);
+		return -1;
+	}
+
+	obj->stats.packets += count;
+	return count * sizeof(*pkts);
+}
+
+/*
+ * @brief Insert the session, board and software information.
+ * @param spdata Private data.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int form_sqlite_init_session(form_sqlite_priv_data * const spdata)
+{
+	const form_session_field *field;
+	const char *value;
+
+	for (unsigned int i = 0; i < form_session_fields_count; i++) {
+		field = &form_session_fields[i];
+		if (!(value = form_session_get(field))) {
+			ERROR("%s/%s is not configured\n", field->section,
+			      field->name);
+			return -1;
+		}
+
+		if (pkt_sql_add_session(spdata->db, field->node, field->name,
+					value)) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int form_sqlite_init(form_obj * const obj)
+{
+	processing_obj * const proc_obj = (processing_obj *)obj;
+	cfg_param param = {
+		.section = CFG_SECTION_OUTPUT_FILE,
+		.name = CFG_SECTION_OUTPUT_FILE_SQLITE,
+		.type = CONFIG_STR,
+	};
+	const char *path;
+
+	if (processing_init(proc_obj)) {
+		return -1;
+	}
+
+	proc_obj->name = "form_sqlite";
+
+	if (sqlite_priv_data.is_used) {
+		ERROR("SQLite form object already used\n");
+		goto no_free_instance;
+	}
+
+	path = CONFIG_HELPER_GET_STR(&param);
+	if (!param.found) {
+		ERROR("%s/%s is not configured\n", param.section, param.name);
+		goto no_free_instance;
+	}
+
+	if (pkt_sql_open(&sqlite_priv_data.db, path)) {
+		goto no_free_instance;
+	}
+
+	sqlite_priv_data.is_used = true;
+	sqlite_ptf.db = sqlite_priv_data.db;
+	obj->pdata = (void *) &sqlite_priv_data;
+
+	if (form_sqlite_init_session(&sqlite_priv_data)) {
+		goto init_session_failed;
+	}
+
+	proc_obj->data_in = form_sqlite_receive_data;
+	proc_obj->data_out = form_sqlite_send_data;
+
+	return 0;
+init_session_failed:
+	pkt_sql_close(sqlite_priv_data.db);
+	sqlite_priv_data.db = NULL;
+	sqlite_ptf.db = NULL;
+	sqlite_priv_data.is_used = false;
+	obj->pdata = NULL;
+no_free_instance:
+	processing_fini((processing_obj *) obj);
+	return -1;
+}
+
+int form_sqlite_fini(form_obj * const obj)
+{
+	form_sqlite_priv_data *pdata = (form_sqlite_priv_data *) obj->pdata;
+	int rc;
+
+	if (!pdata) {
+		return 0;
+	}
+
+	rc = pkt_sql_close(pdata->db);
+	pdata->db = NULL;
+	pdata->is_used = false;
+	sqlite_ptf.db = NULL;
+	obj->pdata = NULL;
+
+	if (processing_fini((processing_obj *) obj)) {
+		return -1;
+	}
+
+	return rc;
+}
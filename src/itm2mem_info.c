@@ -2,7 +2,8 @@
  * file: itm2mem_info
  * author: Alexandre Malki <alexandremalki@gmail.com>
  * brief: This file gather data from the decoded SWO (ITM trace)
- *	  sort and print the information to a json file format. 
+ *	  sort and print the information to a json file format. The heap
+ *	  events are binary records described in itm2mem_info.h . 
  *
  *****************************************************************/
 
@@ -14,31 +15,38 @@
 #include <libswo/libswo.h>
 #include <message.h>
 #include <memory_info.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <tree.h>
 
-#define SSCANF_ALLOC "alloc %ld %x"
-#define SSCANF_ADDR_FUNC "%x %s"
+/** Part of a record expected next */
+enum itm2mem_state {
+	/** Type, depth and size word */
+	ITM2MEM_STATE_HEADER,
+	/** Pointer of the block */
+	ITM2MEM_STATE_PTR,
+	/** Return addresses of the backtrace */
+	ITM2MEM_STATE_FRAMES,
+};
 
 typedef struct {
-	/** Temporary mem_info buffer. */
-	struct mem_info mi[2];
-	/** Temp buffer index switch. */
-	size_t mi_count;
-
-	unsigned int depth_flush;
-	/** 
-	 * Buffer holding characters from 
-	 * the buffer from the ITM trace 
-	 * this is used as a circular buffer.
-	 */
-	char buffer[MESSAGE_BUFFER_SZ_MAX];
-	/** Head of the circular buffer. */
-	size_t buffer_head;
-	/** Tail of the circular buffer. */
-	size_t buffer_tail;
-	/** Tail of the circular buffer. */
-	node_file *nf_head;
+	/** mem_info of the record being received. */
+	struct mem_info mi;
+	/** Part of the record expected next. */
+	enum itm2mem_state state;
+	/** Type of the record being received. */
+	unsigned int type;
+	/** Number of frames announced by the record header. */
+	unsigned int depth;
+	/** Number of frames received. */
+	unsigned int frame;
+	/** Word being reassembled from narrower ITM writes. */
+	uint32_t word;
+	/** Number of bytes of word already received. */
+	unsigned int word_len;
+	/** Counters of the records. */
+	itm2mem_info_stats stats;
 	/**
 	 * Informing if the structure is initialized to
 	 * protect from double init/de-init.
@@ -48,179 +56,123 @@ typedef struct {
 
 static itm2mem_info_private_data itm2mem_info_priv_data;
 
-
 /**
- * \brief Function splitting the received data into lines and
- * 	processing them and/storing then to the circular buffer.
- * \param char line (between \n) received from the ITM trace.
- * \return a pointer on the begigning of a line. NULL pointer
- * 	returned if an error occured.
+ * \brief Function ending the record being received, an allocation is
+ * 	appended to the memory information list.
+ * \param pdata itm2mem_info private structure.
+ * \return 0 upon success, -1 if an error occured.
  */
-static char *
-itm2mem_get_next_line(itm2mem_info_private_data * const pdata)
+static int
+itm2mem_end_record(itm2mem_info_private_data * const pdata)
 {
-	char *pos;
-	size_t buffer_head;
-	size_t buffer_tail;
-	size_t prev_buffer_head;
-	size_t move_sz;
-
-	prev_buffer_head = buffer_head = pdata->buffer_head;
-	buffer_tail = pdata->buffer_tail;
-	buffer_head = pdata->buffer_head;
-
-	pos = strchr(&pdata->buffer[buffer_head], '\n');
-	if (!pos && buffer_tail < buffer_head) {
-		move_sz = (sizeof(pdata->buffer) - 1) - buffer_head;
-		memmove(&pdata->buffer[move_sz], pdata->buffer, pdata->buffer_tail + 1); 
-		memmove(pdata->buffer, &pdata->buffer[buffer_head], move_sz); 
-
-		pdata->buffer_head  = 0;
-		pdata->buffer_tail += move_sz ;
-
-		return itm2mem_get_next_line(pdata);
-	} else if (!pos) {
-		return NULL;
-	}
-
-	*pos = '\0';
-	pos++;
-	
-	pdata->buffer_head += (size_t) ((uintptr_t)pos - (uintptr_t)&pdata->buffer[buffer_head]);
-	pdata->buffer_head %= sizeof(pdata->buffer) - 1;
-
-	return (char *) &pdata->buffer[prev_buffer_head];
-}
+	int rc = 0;
 
-/**
- * \brief Function parsing the string char received.
- * \param minfo is the memory information (size, ptr etc..).
- * \param char line (between \n) received from the ITM trace.
- */
-static void
-itm2mem_create_new_mem_info(struct mem_info *minfo, const char *line)
-{
-	sscanf(line, SSCANF_ALLOC, (size_t *) &minfo->blk_sz,
-					 (unsigned int *) &minfo->ptr);
-}
+	pdata->state = ITM2MEM_STATE_HEADER;
+	if (pdata->type == ITM2MEM_REC_FREE) {
+		/* The memory information list only holds the allocations */
+		pdata->stats.frees++;
+		return 0;
+	}
 
-/**
- * \brief this function will add append the filled mem_info structure according
- * 		to the depth.
- * \param pdata itm2mem_info private structure.
- */
-static void 
-itm2mem_add_to_backtrace(struct mem_info *minfo, const char *line, unsigned int depth)
-{
-	char *strbacktrace = NULL;
-	sscanf(line, SSCANF_ADDR_FUNC, (unsigned int *)&minfo->backtrace[depth],
-				 		strbacktrace);
-	strncpy(minfo->strbacktrace[depth], line, BACKTRACE_STR_MAX_SIZE - 1);
+	pdata->stats.allocs++;
+	pdata->mi.size = (pdata->frame < BACKTRACE_MAX_DEPTH) ?
+				pdata->frame : BACKTRACE_MAX_DEPTH;
+	if (mem_info_append_to_list(&pdata->mi)) {
+		ERROR("Error while adding itm memory info to list\n");
+		rc = -1;
+	}
 
+	memset(&pdata->mi, 0, sizeof(pdata->mi));
+	return rc;
 }
 
-
 /**
- * \brief this function will add append the filled mem_info structure according
- * 		to the depth.
+ * \brief Function starting a record from its header word. A word that is
+ * 	not a header, e.g. after lost packets, is skipped.
  * \param pdata itm2mem_info private structure.
- * \return the amount of char processed from the ITM trace. 
- * 	-1 if an error occured.
+ * \param word the header word.
  */
-static int
-itm2mem_add_to_list(itm2mem_info_private_data *const pdata)
+static void
+itm2mem_start_record(itm2mem_info_private_data * const pdata, uint32_t word)
 {
-	if (pdata->mi_count > 0) {
-		pdata->mi[pdata->mi_count - 1].size = pdata->depth_flush;
-		if (mem_info_append_to_list(&pdata->mi[pdata->mi_count - 1])) {
-			return -1;	
-		}
-		memset(&pdata->mi[pdata->mi_count - 1], 0, sizeof(struct mem_info));
-		/* Switch to the next buffer */
-		pdata->mi_count ^=3;
-			
-	} else {
-		pdata->mi_count = 1;
+	pdata->type = word >> ITM2MEM_REC_TYPE_SHIFT;
+	if ((pdata->type != ITM2MEM_REC_ALLOC) &&
+	    (pdata->type != ITM2MEM_REC_FREE)) {
+		pdata->stats.skipped++;
+		return;
 	}
 
-	return 0;
-}
-
-static size_t
-itm2mem_force_flush(itm2mem_info_private_data *const pdata)
-{
-	if (pdata->depth_flush)
-		return itm2mem_add_to_list(pdata);
-
-	return 0;
+	pdata->depth = (word >> ITM2MEM_REC_DEPTH_SHIFT) &
+		       ITM2MEM_REC_DEPTH_MASK;
+	pdata->frame = 0;
+	pdata->mi.blk_sz = word & ITM2MEM_REC_SIZE_MASK;
+	pdata->state = ITM2MEM_STATE_PTR;
 }
 
 /**
- * \brief this function will fill the mem_info structure according
- * 	to what is received from the ITM trace.
+ * \brief Function feeding a word of the ITM trace to the record being
+ * 	received.
  * \param pdata itm2mem_info private structure.
- * \return the amount of char processed from the ITM trace. 
- * 	-1 if an error occured.
+ * \param word the word received.
+ * \return 0 upon success, -1 if an error occured.
  */
-static size_t
-itm2mem_parse(itm2mem_info_private_data *const pdata, const char *line)
+static int
+itm2mem_parse_word(itm2mem_info_private_data * const pdata, uint32_t word)
 {
-	size_t total_sz = -1;
-
-	if (!strncmp(line, "alloc ", sizeof("alloc ") - 1)) {
-		if (itm2mem_add_to_list(pdata)) {
-			ERROR("Error while adding itm memory info to list\n");
-			goto failed_adding_to_list;
-		}
-		pdata->depth_flush = 0;
-
-		itm2mem_create_new_mem_info(&pdata->mi[pdata->mi_count -1],
-					    line);
-	} else {
-		/** case alloc was not met yet */
-		if (pdata->mi_count - 1 < 0 ) {
-			goto no_alloc_yet;
+	struct mem_info *minfo = &pdata->mi;
+
+	switch (pdata->state) {
+	case ITM2MEM_STATE_HEADER:
+		itm2mem_start_record(pdata, word);
+		return 0;
+	case ITM2MEM_STATE_PTR:
+		minfo->ptr = (void *) (uintptr_t) word;
+		pdata->state = ITM2MEM_STATE_FRAMES;
+		break;
+	case ITM2MEM_STATE_FRAMES:
+		/* The frames deeper than the mem_info are dropped */
+		if ((pdata->type == ITM2MEM_REC_ALLOC) &&
+		    (pdata->frame < BACKTRACE_MAX_DEPTH)) {
+			minfo->backtrace[pdata->frame] = word;
+			snprintf(minfo->strbacktrace[pdata->frame],
+				 BACKTRACE_STR_MAX_SIZE, "%x", word);
 		}
 
-		itm2mem_add_to_backtrace(&pdata->mi[pdata->mi_count - 1],
-					 line, pdata->depth_flush);
+		pdata->frame++;
+		break;
+	}
 
-		pdata->depth_flush++;
+	if (pdata->frame == pdata->depth) {
+		return itm2mem_end_record(pdata);
 	}
 
-	total_sz += strlen(line);
-failed_adding_to_list:
-no_alloc_yet:
-	return total_sz;
+	return 0;
 }
 
 /**
- * \brief this function will fill the mem_info structure according
- * 	to what is received from the ITM trace.
+ * \brief Function dropping the record being received at the end of the
+ * 	session, the rest of it was never sent.
  * \param pdata itm2mem_info private structure.
- * \return the amount of char processed from the ITM trace. 
- * 	-1 if an error occured.
  */
-static size_t
-itm2mem_fill_info(itm2mem_info_private_data * const pdata)
+static void
+itm2mem_drop_record(itm2mem_info_private_data * const pdata)
 {
-	const char *line;
-	size_t res;
-	size_t total_sz = 0;
-
-	while ((line = itm2mem_get_next_line(pdata))) {
-		if ((res = itm2mem_parse(pdata, line)) < 0) {
-			return res;
-		}
-
-		total_sz += res;
+	if ((pdata->state == ITM2MEM_STATE_HEADER) && !pdata->word_len) {
+		return;
 	}
 
-	return total_sz;
+	pdata->stats.truncated++;
+	pdata->state = ITM2MEM_STATE_HEADER;
+	memset(&pdata->mi, 0, sizeof(pdata->mi));
+	pdata->word = 0;
+	pdata->word_len = 0;
 }
 
 /**
- * \brief Function receiving data from the decoder. 
+ * \brief Function receiving data from the decoder. The payload of the
+ * 	instrumentation packets of the ITM2MEM_INFO_PORT port is gathered in
+ * 	words, the other packets are skipped.
+ * \return the number of bytes read, -1 if an error occured.
  */
 static size_t 
 itm2mem_info_data_in(processing_obj * const proc_obj, message_obj *const msg)
@@ -231,16 +183,48 @@ itm2mem_info_data_in(processing_obj * const proc_obj, message_obj *const msg)
 
 	union libswo_packet *packets = (union libswo_packet *) msg->ptr(msg);
 	unsigned int pkt_count = msg->length(msg) / sizeof (union libswo_packet);
-	unsigned int i;
+	unsigned int i, len;
+	uint32_t value;
 
+	proc_obj->stats.packets += pkt_count;
 	for (i = 0; i < pkt_count; i++) {
-		DEBUG("Size of payload %ld\n", packets[i].inst.size);
-		pdata->buffer[pdata->buffer_tail] = (char) packets[i].inst.value;
-		pdata->buffer_tail = 
-				(pdata->buffer_tail + 1) % (sizeof(pdata->buffer) - 1);
+		/* The decoder may keep the timestamps as well */
+		if ((packets[i].type != LIBSWO_PACKET_TYPE_INST) ||
+		    (packets[i].inst.address != ITM2MEM_INFO_PORT)) {
+			continue;
+		}
+
+		/* A 32-bit write fills the word at once */
+		len = packets[i].inst.size - 1;
+		value = packets[i].inst.value;
+		if (!pdata->word_len && (len == sizeof(uint32_t))) {
+			if (itm2mem_parse_word(pdata, value)) {
+				return -1;
+			}
+			continue;
+		}
+
+		while (len--) {
+			pdata->word |= (value & 0xffU) << (8 * pdata->word_len);
+			value >>= 8;
+			if (++pdata->word_len < sizeof(uint32_t)) {
+				continue;
+			}
+
+			if (itm2mem_parse_word(pdata, pdata->word)) {
+				return -1;
+			}
+			pdata->word = 0;
+			pdata->word_len = 0;
+		}
 	}
 
-	return itm2mem_fill_info(pdata);
+	/* The last packets of the session come with req_end */
+	if (proc_obj->req_end) {
+		itm2mem_drop_record(pdata);
+	}
+
+	return pkt_count * sizeof(union libswo_packet);
 }
 
 /**
@@ -273,7 +257,7 @@ itm2mem_info_data_out(processing_obj * const proc_obj, message_obj *const msg)
 				(itm2mem_info_private_data *) obj->pdata;
 
 	if (proc_obj->req_end) {
-		itm2mem_force_flush(pdata);
+		itm2mem_drop_record(pdata);
 		return itm2_mem_get_list();
 
 	}
@@ -281,6 +265,35 @@ itm2mem_info_data_out(processing_obj * const proc_obj, message_obj *const msg)
 	return 0;
 }
 
+/**
+ * \brief Function retrieving the counters of the records.
+ * \param obj the itm2mem_info object.
+ * \param stats the counters, filled.
+ * \return 0.
+ */
+static int
+itm2mem_info_get_stats(itm2mem_info_obj * const obj,
+		       itm2mem_info_stats * const stats)
+{
+	itm2mem_info_private_data *pdata =
+				(itm2mem_info_private_data *) obj->pdata;
+
+	*stats = pdata->stats;
+	return 0;
+}
+
+/**
+ * \brief Default function in case of acessing a deinitialized object.
+ * \return -1.
+ */
+static int
+itm2mem_info_get_stats_default(itm2mem_info_obj * const obj,
+			       itm2mem_info_stats * const stats)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
 /**
  * \brief  Initializing the  the processing element.
  */
@@ -300,13 +313,12 @@ int itm2mem_info_init(itm2mem_info_obj * const obj)
 
 	proc_obj->data_in  = itm2mem_info_data_in;
 	proc_obj->data_out = itm2mem_info_data_out;
+	proc_obj->name = "itm2mem_info";
+	obj->get_stats = itm2mem_info_get_stats;
 
 	pdata = &itm2mem_info_priv_data;
 
-	memset(pdata->buffer, 0, sizeof(pdata->buffer));
-	pdata->mi_count = 0;
-	pdata->buffer_head = 0;
-	pdata->buffer_tail = 0;
+	memset(pdata, 0, sizeof(*pdata));
 	obj->pdata = (void *) pdata;
 
 	CONFIG_HELPER_GET_STR(&param);
@@ -336,6 +348,18 @@ int itm2mem_info_init(itm2mem_info_obj * const obj)
  */
 int itm2mem_info_fini(itm2mem_info_obj * const obj)
 {
+	itm2mem_info_private_data *pdata = &itm2mem_info_priv_data;
+
+	DEBUG("%lu allocations, %lu frees\n", pdata->stats.allocs,
+	      pdata->stats.frees);
+	if (pdata->stats.skipped || pdata->stats.truncated) {
+		WARNING("%lu words skipped, %lu records truncated\n",
+			pdata->stats.skipped, pdata->stats.truncated);
+	}
+
+	obj->get_stats = itm2mem_info_get_stats_default;
+
+	processing_fini((processing_obj *) obj);
 	return 0;
 }
 
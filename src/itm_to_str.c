@@ -72,6 +72,7 @@ int itm_to_str_init(itm_to_str_obj * const obj)
 
 	proc_obj->data_in  = itm_to_str_data_in;
 	proc_obj->data_out = itm_to_str_data_out;
+	proc_obj->name = "itm_to_str";
 
 	pdata = &itm_to_str_priv_data;
 
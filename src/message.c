@@ -6,6 +6,19 @@
  * 		object holds information such as the size of the internal buffer
  * 		the number of byte written to it (usable). And some internal
  * 		method that allow to write/append/read and access the raw pointer.
+ *
+ * 		A message can also share the buffer of another message instead
+ * 		of copying it (share method). The shared buffer is read-only
+ * 		for the viewing message: writing, appending or setting a non
+ * 		zero length makes a private copy first. The viewed message
+ * 		counts its viewers, they are expected to be released before it
+ * 		is written again. Sharing is not thread safe.
+ *
+ * 		With MESSAGE_DYNAMIC, the instances are allocated on demand and
+ * 		the buffers come from a pool of power of two size classes. The
+ * 		buffer is only taken from the pool when the message is first
+ * 		written or its pointer is requested, and it grows when a
+ * 		write or an append goes beyond the capacity of the message.
  *****************************************************************/
 #include <message.h>
 #include <config.h>
@@ -16,30 +29,197 @@
 #include <stdbool.h>
 #include <string.h>
 
+#ifdef MESSAGE_DYNAMIC
+#include <pthread.h>
+#endif
+
 
 /* For now everything is static, do not want to look for leaks right know *?
 #include <malloc.c> */
 
 /** Internal message_object structure */
-typedef struct {
+typedef struct message_priv_data_st message_priv_data;
+
+struct message_priv_data_st {
 /* TODO create buffer size */
 #ifdef MESSAGE_DYNAMIC
-#error "Currently dynamic message passing is not implemented"
+	/** Underlying buffer taken from the pool, NULL until needed */
+	char *buffer;
+	/** Size class of the buffer */
+	unsigned int buf_class;
 #else
 	/** Underlying buffer object */
 	char buffer[MESSAGE_BUFFER_SZ_MAX];
 #endif
 	/** Length of usable bytes (written) by the application */
 	size_t length;
-	/** Total length of the buffer */
+	/** Total length of the buffer, with MESSAGE_DYNAMIC this is the
+	 *  capacity requested, the buffer is allocated lazily */
 	size_t total_len;
 	/** Information if the buffer is used by a message_obj */
 	bool is_used;
-} message_priv_data;
+	/** Instance whose buffer is viewed instead of this one, NULL if none */
+	message_priv_data *shared;
+	/** Number of instances viewing this buffer */
+	unsigned int refs;
+};
+
+#ifdef MESSAGE_DYNAMIC
+/** Number of size classes of the pool */
+#define MESSAGE_POOL_CLASS_CNT	(8 * sizeof(size_t))
+
+/**
+ * Pool of message buffers, a free buffer holds the link to the next free
+ * buffer of its class.
+ */
+static struct {
+	/** First free buffer of each size class */
+	void		*free[MESSAGE_POOL_CLASS_CNT];
+	/** Messages can be written from several pipeline workers */
+	pthread_mutex_t	lock;
+} message_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/**
+ * @brief Get the smallest size class holding size bytes.
+ * @param size Size requested.
+ * @return The size class, the buffer size is MESSAGE_POOL_SZ_MIN << class.
+ */
+static unsigned int message_pool_class(size_t size)
+{
+	unsigned int cls = 0;
+
+	while ((MESSAGE_POOL_SZ_MIN << cls) < size) {
+		cls++;
+	}
 
+	return cls;
+}
+
+/**
+ * @brief Take a buffer of a size class from the pool.
+ * @param cls Size class.
+ * @return The buffer, NULL if it could not be allocated.
+ */
+static char *message_pool_get(unsigned int cls)
+{
+	void **buf;
+
+	pthread_mutex_lock(&message_pool.lock);
+	if ((buf = message_pool.free[cls])) {
+		message_pool.free[cls] = *buf;
+	}
+	pthread_mutex_unlock(&message_pool.lock);
+
+	if (!buf && !(buf = malloc(MESSAGE_POOL_SZ_MIN << cls))) {
+		ERROR("Could not allocate memory\n");
+	}
+
+	return (char *) buf;
+}
+
+/**
+ * @brief Give a buffer back to the pool.
+ * @param buf The buffer.
+ * @param cls Size class of the buffer.
+ */
+static void message_pool_put(char *buf, unsigned int cls)
+{
+	pthread_mutex_lock(&message_pool.lock);
+	*(void **) buf = message_pool.free[cls];
+	message_pool.free[cls] = buf;
+	pthread_mutex_unlock(&message_pool.lock);
+}
+#else
 /* TODO In config file create message instance */
 static message_priv_data message_instances[MESSAGE_NSTANCES_CNT_MAX];
+#endif
 
+/**
+ * @brief Size of the buffer actually held by the message.
+ * @param pdata Private instance of the message.
+ * @return The size of the buffer, 0 if none is allocated yet.
+ */
+static inline size_t message_capacity(const message_priv_data * const pdata)
+{
+#ifdef MESSAGE_DYNAMIC
+	return pdata->buffer ? (MESSAGE_POOL_SZ_MIN << pdata->buf_class) : 0;
+#else
+	return pdata->total_len;
+#endif
+}
+
+/**
+ * @brief Keep the data NUL terminated when there is room for it, string
+ * 		users rely on it since the buffer is not cleared anymore.
+ * @param pdata Private instance of the message.
+ */
+static void message_terminate(message_priv_data * const pdata)
+{
+	if (pdata->length < message_capacity(pdata)) {
+		pdata->buffer[pdata->length] = '\0';
+	}
+}
+
+/**
+ * @brief Make sure the own buffer of the message holds at least size bytes,
+ * 		the data (length bytes) is kept when the buffer changes.
+ * @param pdata Private instance of the message.
+ * @param size Size needed.
+ * @return 0 upon success, -1 if the buffer cannot hold size bytes.
+ */
+static int message_reserve(message_priv_data * const pdata, size_t size)
+{
+#ifdef MESSAGE_DYNAMIC
+	unsigned int cls;
+	char *buf;
+
+	if (size <= message_capacity(pdata)) {
+		return 0;
+	}
+
+	if (size > MESSAGE_POOL_SZ_MAX) {
+		ERROR("Message of %zu bytes is too big\n", size);
+		return -1;
+	}
+
+	cls = message_pool_class(size);
+	if (!(buf = message_pool_get(cls))) {
+		return -1;
+	}
+
+	if (pdata->buffer && !pdata->shared) {
+		memcpy(buf, pdata->buffer, pdata->length);
+	}
+
+	if (pdata->buffer) {
+		message_pool_put(pdata->buffer, pdata->buf_class);
+	}
+
+	pdata->buffer = buf;
+	pdata->buf_class = cls;
+	if (pdata->total_len < size) {
+		pdata->total_len = size;
+	}
+	message_terminate(pdata);
+
+	return 0;
+#else
+	return size <= pdata->total_len ? 0 : -1;
+#endif
+}
+
+
+/**
+ * @brief Default share callback
+ * */
+static size_t message_share_default(message_obj * const obj,
+				    message_obj * const src)
+{
+	WARNING("Message Object not initialized\n");
+	return -1;
+}
 
 /**
  * @brief Default copy callback
@@ -108,6 +288,47 @@ static size_t message_read_default(message_obj * const obj,
 	return -1;
 }
 
+/**
+ * @brief Stop viewing a shared buffer, the message uses its own buffer again.
+ * @param pdata Private instance of the message.
+ */
+static void message_unshare(message_priv_data * const pdata)
+{
+	if (pdata->shared) {
+		pdata->shared->refs--;
+		pdata->shared = NULL;
+	}
+}
+
+/**
+ * @brief Make the message writable: a shared buffer is copied into the own
+ * 		buffer of the message. Writing a buffer still viewed by other
+ * 		messages is reported.
+ * @param pdata Private instance of the message.
+ * @param keep Copy the shared data, otherwise it is simply dropped.
+ * @return 0 upon success, -1 if the data could not be copied.
+ */
+static int message_own(message_priv_data * const pdata, bool keep)
+{
+	message_priv_data *shared = pdata->shared;
+
+	if (shared) {
+		if (keep) {
+			if (message_reserve(pdata, pdata->length)) {
+				return -1;
+			}
+			memcpy(pdata->buffer, shared->buffer, pdata->length);
+		}
+		message_unshare(pdata);
+	}
+
+	if (pdata->refs) {
+		WARNING("Writing a buffer shared %u times\n", pdata->refs);
+	}
+
+	return 0;
+}
+
 /**
  * @brief Writing len data to message_obj's buffer from the buffer.
  * 		This funcction will make sure that the size written
@@ -123,11 +344,28 @@ static size_t message_write_buffer(message_obj * const obj,
 				 char * const buffer, size_t len)
 {
 	message_priv_data *pdata = (message_priv_data *)obj->pdata;
-	size_t min = obj->total_len(obj) < len ?
-					obj->total_len(obj) : len;
+	size_t min;
 
-	memcpy(obj->ptr(obj), buffer, min);
+#ifdef MESSAGE_DYNAMIC
+	/* Grow, the data is then only truncated at MESSAGE_POOL_SZ_MAX */
+	if (len > pdata->total_len) {
+		pdata->total_len = len < MESSAGE_POOL_SZ_MAX ?
+						len : MESSAGE_POOL_SZ_MAX;
+	}
+#endif
+	min = obj->total_len(obj) < len ? obj->total_len(obj) : len;
+
+	message_own(pdata, false);
+	if (message_reserve(pdata, min)) {
+		return -1;
+	}
+
+	/* An empty write may come before the buffer is allocated */
+	if (min) {
+		memmove(pdata->buffer, buffer, min);
+	}
 	pdata->length = min;
+	message_terminate(pdata);
 
 	return min;
 }
@@ -140,7 +378,8 @@ static size_t message_write_buffer(message_obj * const obj,
  * @param buffer The data to append to the message_obj
  * @param len The size in byte to append to the buffer.
  * @return  the actuall amout of byte written. If the size will overflow,
- * 		then the function will return -1
+ * 		then the function will return -1. With MESSAGE_DYNAMIC the
+ * 		buffer grows up to MESSAGE_POOL_SZ_MAX.
  */
 static size_t message_append_buffer(message_obj * const obj,
 				 char * const buffer, size_t len)
@@ -148,15 +387,41 @@ static size_t message_append_buffer(message_obj * const obj,
 	message_priv_data *pdata = (message_priv_data *)obj->pdata;
 	size_t pos = obj->length(obj);
 
+#ifdef MESSAGE_DYNAMIC
+	if ((len + pos) > obj->total_len(obj)) {
+		/* Double the capacity to amortize the copies */
+		size_t total_len = obj->total_len(obj);
+
+		/* A message initialized with a size of 0 has nothing to double */
+		if (!total_len) {
+			total_len = 1;
+		}
+
+		while ((total_len < (len + pos)) &&
+		       (total_len < MESSAGE_POOL_SZ_MAX)) {
+			total_len *= 2;
+		}
+
+		if (total_len > MESSAGE_POOL_SZ_MAX) {
+			total_len = MESSAGE_POOL_SZ_MAX;
+		}
+		pdata->total_len = total_len;
+	}
+#endif
 	if ((len + pos) > obj->total_len(obj)) {
-		/* TODO memmove in dynamic allocation */
 		ERROR("Not enought space in the buffer,"
 			 "(len/max) %ld/%ld\n",
 				len+pos, obj->total_len(obj));
 		return -1;
 	}
 
-	memcpy(&obj->ptr(obj)[pos], buffer, len);
+	if (message_own(pdata, true) || message_reserve(pdata, len + pos)) {
+		return -1;
+	}
+
+	if (len) {
+		memcpy(&pdata->buffer[pos], buffer, len);
+	}
 	obj->set_length(obj, len + pos);
 
 	return len;
@@ -209,7 +474,12 @@ static void message_set_length_buffer(const message_obj * const obj, size_t len)
 	if (len > pdata->total_len)
 		WARNING("set length bigger than the actual buffer allocating %ld/%ld\n", len, pdata->total_len);
 
+	if (message_own(pdata, len != 0)) {
+		return;
+	}
+
 	pdata->length = len;
+	message_terminate(pdata);
 }
 
 /**
@@ -233,6 +503,16 @@ static size_t message_totlen_buffer(const message_obj * const obj)
 static char *message_ptr_buffer(const message_obj * const obj)
 {
 	message_priv_data *pdata = (message_priv_data *)obj->pdata;
+
+	if (pdata->shared) {
+		pdata = pdata->shared;
+	}
+
+	/* Raw access, the whole capacity can be written */
+	if (message_reserve(pdata, pdata->total_len)) {
+		return NULL;
+	}
+
 	return pdata->buffer;
 }
 
@@ -250,6 +530,36 @@ static size_t message_cpy_buffer(message_obj * const obj,
 	return message_write_buffer(obj, src->ptr(src), src->length(src));
 }
 
+/**
+ * @brief Let obj view the buffer of src instead of copying it. The view is
+ * 		read-only and lasts until obj is written or released.
+ * @param obj Message object viewing the buffer.
+ * @param src Message object holding the data.
+ * @return the number of byte shared.
+ */
+static size_t message_share_buffer(message_obj * const obj,
+				   message_obj * const src)
+{
+	message_priv_data *pdata = (message_priv_data *) obj->pdata;
+	message_priv_data *spdata = (message_priv_data *) src->pdata;
+
+	/* Always view the owner of the data */
+	if (spdata->shared) {
+		spdata = spdata->shared;
+	}
+
+	message_unshare(pdata);
+	if (spdata == pdata) {
+		return pdata->length;
+	}
+
+	pdata->shared = spdata;
+	pdata->length = src->length(src);
+	spdata->refs++;
+
+	return pdata->length;
+}
+
 /**
  * @brief Retrieve an unused private instance of message.
  * @return An available private instance of message.
@@ -257,8 +567,13 @@ static size_t message_cpy_buffer(message_obj * const obj,
 static message_priv_data *message_get_free_instance(void)
 {
 #ifdef MESSAGE_DYNAMIC
-	/*TODO if needed do malloc */
-	return NULL;
+	message_priv_data *pdata;
+
+	if ((pdata = calloc(1, sizeof(*pdata)))) {
+		pdata->is_used = true;
+	}
+
+	return pdata;
 #else
 	unsigned int i = 0;
 	message_priv_data *pdata = NULL;
@@ -279,17 +594,31 @@ static message_priv_data *message_get_free_instance(void)
 /**
  * @brief Set default values to the private instance.
  * @param pdata private instance.
+ * @param size capacity of the message.
  * @return 0 upon success.
  */
-int message_internal_init(message_priv_data *pdata)
+int message_internal_init(message_priv_data *pdata, size_t size)
 {
+#ifndef MESSAGE_DYNAMIC
+	if (size > MESSAGE_BUFFER_SZ_MAX) {
+		WARNING("Message limited to %d bytes\n", MESSAGE_BUFFER_SZ_MAX);
+		size = MESSAGE_BUFFER_SZ_MAX;
+	}
+#endif
 	pdata->length = 0;
-	pdata->total_len = MESSAGE_BUFFER_SZ_MAX;
+	pdata->total_len = size;
+	pdata->shared = NULL;
+	pdata->refs = 0;
 
 	return 0;
 }
 
 int message_init(message_obj * const obj)
+{
+	return message_init_sz(obj, MESSAGE_BUFFER_SZ_MAX);
+}
+
+int message_init_sz(message_obj * const obj, size_t size)
 {
 	message_priv_data *pdata = NULL;
 	if (!(pdata = message_get_free_instance())) {
@@ -297,7 +626,7 @@ int message_init(message_obj * const obj)
 		goto no_free_instance;
 	}
 
-	if (message_internal_init(pdata)){
+	if (message_internal_init(pdata, size)){
 		goto internal_init_failed;
 	}
 
@@ -310,6 +639,7 @@ int message_init(message_obj * const obj)
 	obj->set_length = message_set_length_buffer;
 	obj->total_len = message_totlen_buffer;
 	obj->cpy = message_cpy_buffer;
+	obj->share = message_share_buffer;
 	obj->ptr = message_ptr_buffer;
 
 	return 0;
@@ -332,15 +662,28 @@ int message_fini(message_obj * const obj)
 		return -1;
 	}
 
+	message_unshare(pdata);
+	if (pdata->refs) {
+		WARNING("Message still shared %u times\n", pdata->refs);
+	}
+
 	obj->read = message_read_default;
 	obj->write = message_write_default;
 	obj->append = message_append_default;
 	obj->length = message_length_default;
 	obj->total_len = message_totlen_default;
 	obj->cpy = message_cpy_default;
+	obj->share = message_share_default;
 	obj->ptr = message_ptr_default;
 	obj->pdata = NULL;
 
+#ifdef MESSAGE_DYNAMIC
+	if (pdata->buffer) {
+		message_pool_put(pdata->buffer, pdata->buf_class);
+	}
+	free(pdata);
+#else
 	memset(pdata, 0, sizeof(*pdata));
+#endif
 	return 0;
 }
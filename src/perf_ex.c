@@ -5,26 +5,21 @@
  * 		more detailed are provided in the source file perf_ex.c.
  *****************************************************************/
 
+#include <config.h>
 #include <debug.h>
+#include <elf_sym.h>
 #include <message.h>
 #include <perf_ex.h>
+#include <report_buf.h>
+#include <timestamp.h>
 
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <libswo/libswo.h>
 #include <malloc.h>
 
-typedef struct exe_info_list_st exe_info_list;
-typedef struct exe_line_info_st exe_line_info;
-
-/** Command line format to execute to get the line information */
-#define PERF_EX_ADDR2LINE_CMD "%saddr2line" \
-	" -e%s" \
-	" -f 0x%x"
-
-/** Output format of the addr2line tool */
-#define PERF_EX_SSCANF_FORMAT "%s\n%[^:]:%u"
-
 /** Output string, format representing the end of a function in a file */
 #define PERF_EX_OUT_END_FUNC "\n]"
 
@@ -35,61 +30,153 @@ typedef struct exe_line_info_st exe_line_info;
 /** Output string, format representing the informatio about a line */
 #define PERF_EX_OUT_LINE "\t{ hits: %u, line: %u, address: %x},\n"
 
-/** 
- * This structure holds information regarding the line/address 
- * of a sample
+/** Output string, window closed in incremental mode, followed by the hits */
+#define PERF_EX_OUT_WINDOW "window: %u start: %llu samples: %u"
+
+/** Output string, hits of a function in a window */
+#define PERF_EX_OUT_WINDOW_FUNC " %s: %u"
+
+/** Function of the samples that cannot be resolved */
+#define PERF_EX_FUNC_UNKNOWN "unknown"
+
+/** Function of the samples taken while sleeping */
+#define PERF_EX_FUNC_IDLE "idle"
+
+/** Output string, samples of the report, written before the functions */
+#define PERF_EX_OUT_SUMMARY "\nsamples: %u\nidle: %u\nduty_cycle: %.1f%%\n"
+
+/** Values of the window configuration */
+#define PERF_EX_WINDOW_VAL_SAMPLES	"samples"
+#define PERF_EX_WINDOW_VAL_CYCLES	"cycles"
+#define PERF_EX_WINDOW_VAL_MATRIX	"matrix"
+
+/**
+ * Entry of the direct mapped symbol cache. It holds the result of the
+ * resolution of one address.
  */
-struct exe_line_info_st {
-	/** Link to the next element of this list. */
-	exe_line_info	*next;
-	/** Address of the sample */
+typedef struct {
+	/** Address resolved, only meaningful when is_set is true */
 	unsigned int	addr;
-	/** Line of the corresponding address inside the source file */
-	unsigned int	line;
-	/** Number of occurences */
-	unsigned int	hit;
-};
+	/** Return value of the resolution */
+	int		rc;
+	/** Set once the entry holds a resolved address */
+	bool		is_set;
+	/** Function/file/line of the address */
+	elf_sym_info	info;
+} perf_ex_cache_entry;
 
 /**
- * Performance execution linked likes. On element represent a function located
- * in specific source file. It holds a list of addresses that match this 
- * function.
+ * Entry of the PC histogram. An entry is free as long as hits is 0.
  */
-struct exe_info_list_st {
-	/**
-	 * The next element of the list, if NULL it means that
-	 * the current element is the tail of the list.
-	 */
-	exe_info_list		*next;
-	/**
-	 *  The previous element of the list, if NULL it means
-	 *  that the current element is the head of the list. 
-	 */
-	exe_info_list		*prev;
-	/** The source file path containing the function. */
-	char			file_path[1024];
-	/** 
-	 * Name of the function contained in the source file locate at
-	 *  file_path
-	 */
-	char			function_name[128];
-	/** Number of sample that refere to function_name located in file_path */
-	unsigned int		hits;
-	/** 
- 	 * First line that a sample refers to into the function,
-	 * the lines are ordered by increase number.
-	 */
-	exe_line_info		*line_first;
-	/** Last line that  a sample referes to into the function. */
-	exe_line_info		*line_last;
-};
+typedef struct {
+	/** Address of the samples */
+	unsigned int	addr;
+	/** Number of samples at this address */
+	unsigned int	hits;
+} perf_ex_hist_entry;
+
+/**
+ * Line of the report, one per sampled address. The lines are built from the
+ * histogram at report time and sorted by address, so the lines of a function
+ * are contiguous.
+ */
+typedef struct {
+	/** Address of the samples */
+	unsigned int	addr;
+	/** Number of samples at this address */
+	unsigned int	hits;
+	/** Function/file/line of the address */
+	elf_sym_info	info;
+} perf_ex_report_line;
+
+/**
+ * Slot of the function table of the windows. The name pointer belongs to the
+ * symbol table and is the key, a slot is free as long as name is NULL.
+ */
+typedef struct {
+	/** Function name */
+	const char	*name;
+	/** Index of the function in the windows */
+	unsigned int	idx;
+} perf_ex_func_slot;
+
+/** Hits of one function in a window */
+typedef struct {
+	/** Index of the function */
+	unsigned int	func;
+	/** Number of samples in the function */
+	unsigned int	hits;
+} perf_ex_window_cell;
+
+/** Window closed, kept until the matrix is printed */
+typedef struct {
+	/** First sample number or first cycle of the window */
+	unsigned long long start;
+	/** Number of samples in the window */
+	unsigned int	samples;
+	/** First cell of the window */
+	size_t		first_cell;
+	/** Number of cells of the window */
+	size_t		cell_count;
+} perf_ex_window_info;
+
+/**
+ * The samples are bucketed in windows on top of the histogram of the whole
+ * session. A window holds the hits per function only, resolved when the
+ * sample is accounted. The text of the windows is sent before the report.
+ */
+typedef struct {
+	/** Kind of the windows, PERF_EX_WINDOW_NONE if disabled */
+	perf_ex_window_kind kind;
+	/** Samples or cycles per window */
+	unsigned int	len;
+	/** Print a matrix at the end instead of each window when it closes */
+	bool		is_matrix;
+	/** Index of the current window */
+	unsigned int	index;
+	/** First sample number or first cycle of the current window */
+	unsigned long long start;
+	/** Number of samples of the current window */
+	unsigned int	samples;
+	/** Function table, open addressing on the name pointer */
+	perf_ex_func_slot *slots;
+	/** Mask applied to the hash to get the slot index */
+	unsigned int	slots_mask;
+	/** Names of the functions, by index */
+	const char	**names;
+	/** Number of functions seen */
+	unsigned int	func_count;
+	/** Number of functions the arrays can hold */
+	unsigned int	func_cap;
+	/** Hits of the current window, by function index */
+	unsigned int	*hits;
+	/** Functions hit in the current window */
+	unsigned int	*touched;
+	/** Number of functions hit in the current window */
+	unsigned int	touched_count;
+	/** Windows closed waiting for the matrix */
+	perf_ex_window_info *closed;
+	/** Number of closed windows */
+	size_t		closed_count;
+	/** Number of closed windows the array can hold */
+	size_t		closed_cap;
+	/** Cells of the closed windows, sorted by hits inside a window */
+	perf_ex_window_cell *cells;
+	/** Number of cells */
+	size_t		cell_count;
+	/** Number of cells the array can hold */
+	size_t		cell_cap;
+	/** Text of the windows waiting to be sent */
+	report_buf	out;
+	/** Set once the last window is closed */
+	bool		is_flushed;
+} perf_ex_windows;
 
 /**
  * @brief  This is the private structure of this processing element.
- * @fd_proc  * @path_cmd contains the whole command to call to retrieve the address of from
- *		an elf file.
+ * @syms Symbol table of the elf file, loaded once when the elf is set.
  * @is_init Checks if this module is initialized to avoid double init/fini;
- * @head ;
+ * @hist PC histogram, the samples are only grouped by function at report time;
  */
 typedef struct {
 	/**
@@ -97,15 +184,31 @@ typedef struct {
 	 */
 	const char *toolchain;
 	/**
-	 * This is the fd pointing on the output of the popen to retrieve
-	 * the value of the device.
+	 * Path to the elf file holding the symbols of the target.
 	 */
 	const char *elf;
 	/**
-	 * Command execute by addr2line including option and path to the
-	 * ELF file
+	 * Function and line table of the elf file, used to resolve the
+	 * samples without calling addr2line.
+	 */
+	elf_sym_table *syms;
+	/**
+	 * Direct mapped cache in front of the symbol table, indexed by
+	 * the halfword address of the sample.
+	 */
+	perf_ex_cache_entry *cache;
+	/**
+	 * Mask applied to the halfword address to get the cache index.
+	 */
+	unsigned int cache_mask;
+	/**
+	 * Number of samples resolved from the cache.
+	 */
+	unsigned long cache_hits;
+	/**
+	 * Number of samples that needed the symbol table.
 	 */
-	char path_cmd[1024];
+	unsigned long cache_misses;
 	/**
 	 * Check if the object is initialized to avoid double init/fini
 	 */
@@ -115,209 +218,616 @@ typedef struct {
 	 */
 	unsigned int  total_samples;
 	/**
-	 *  head of the execution info list
+	 *  Samples since the last report, idle ones included.
+	 */
+	unsigned int  report_samples;
+	/**
+	 *  Samples taken while sleeping since the last report.
+	 */
+	unsigned int  report_idle;
+	/**
+	 *  PC histogram, open addressing table with linear probing.
+	 */
+	perf_ex_hist_entry *hist;
+	/**
+	 *  Mask applied to the hash to get the histogram index.
+	 */
+	unsigned int hist_mask;
+	/**
+	 *  Number of used entries in the histogram.
+	 */
+	unsigned int hist_used;
+	/**
+	 *  Report being printed, kept across the data_out rounds.
+	 */
+	perf_ex_report_line *report;
+	/**
+	 *  Number of lines of the report.
+	 */
+	size_t report_count;
+	/**
+	 *  Next line of the report to print.
+	 */
+	size_t report_next;
+	/**
+	 *  End of the lines of the function being printed, 0 between functions.
+	 */
+	size_t report_func_end;
+	/**
+	 *  Input is an array of timestamp_pkt instead of libswo packets.
+	 */
+	bool is_timestamped;
+	/**
+	 *  Windows the samples are bucketed in.
 	 */
-	exe_info_list *head;
+	perf_ex_windows win;
 } perf_ex_private_data;
 
 /** Private data needed as a processing object */
 static perf_ex_private_data perf_ex_priv_data;
 
 /**
- * @brief  This function is looking for the address element that 
- * 		correspond, within the info struct. If no addresses match,
- *		it will allocate a new structure.
- * @param el Function information element to look into.
- * @param addr Address to look for.
- * @param line Line corresponding to the address.
- * @return A pointer on element that correspond to the address. Or NULL if allocation
- *		fails.
+ * @brief Hash of a sample address used to index the histogram.
+ * @param addr Address of the sample.
+ * @return The hash of the address, not masked.
  */
-static exe_line_info *
-perf_ex_find_addr_info(exe_info_list *el, unsigned int addr, unsigned int line)
+static inline unsigned int perf_ex_hist_hash(unsigned int addr)
 {
-	exe_line_info *linfo = el->line_first;
-	exe_line_info *linfo_prev = NULL, *linfo_new;
+	/* Instructions are halfword aligned, Fibonacci hashing on the rest */
+	return (addr >> 1) * 2654435761U;
+}
 
-	while (linfo) {
-		if (addr == linfo->addr) {
-			return linfo;
-		} else if (addr < linfo->addr) {
-			break;
-		}
+/**
+ * @brief Allocate an empty histogram.
+ * @param pdata Private data holding the histogram.
+ * @param entries Number of entries, must be a power of two.
+ * @return 0 upon success, -1 if the allocation failed.
+ */
+static int perf_ex_hist_alloc(perf_ex_private_data * const pdata,
+			      unsigned int entries)
+{
+	perf_ex_hist_entry *hist;
 
-		linfo_prev = linfo;
-		linfo = linfo->next;
+	if (!(hist = calloc(entries, sizeof(*hist)))) {
+		ERROR("Could not allocate memory\n");
+		return -1;
 	}
 
-	linfo_new = (exe_line_info *) calloc(1, sizeof(exe_line_info));
-	if (!linfo_new) {
-		ERROR("Could not allocate memory\n");
-		return NULL;
+	free(pdata->hist);
+	pdata->hist = hist;
+	pdata->hist_mask = entries - 1;
+	pdata->hist_used = 0;
+
+	return 0;
+}
+
+/**
+ * @brief Find the entry of an address, or the free entry where it shall be
+ *		inserted.
+ * @param pdata Private data holding the histogram.
+ * @param addr Address of the sample.
+ * @return The histogram entry.
+ */
+static perf_ex_hist_entry *
+perf_ex_hist_lookup(perf_ex_private_data * const pdata, unsigned int addr)
+{
+	unsigned int i = perf_ex_hist_hash(addr) & pdata->hist_mask;
+
+	while (pdata->hist[i].hits && (pdata->hist[i].addr != addr)) {
+		i = (i + 1) & pdata->hist_mask;
 	}
 
-	linfo_new->line = line;
-	linfo_new->addr = addr;
+	return &pdata->hist[i];
+}
 
-	/* it seems like there are no first line */
-	if (!el->line_first) {
-		el->line_first = linfo_new;
-		el->line_last = linfo_new;
-		return linfo_new;
+/**
+ * @brief Double the size of the histogram and re-insert all the entries.
+ * @param pdata Private data holding the histogram.
+ * @return 0 upon success, -1 if the allocation failed.
+ */
+static int perf_ex_hist_grow(perf_ex_private_data * const pdata)
+{
+	perf_ex_hist_entry *old = pdata->hist;
+	unsigned int old_entries = pdata->hist_mask + 1;
+	unsigned int used = pdata->hist_used;
+
+	/* Keep the old table alive while re-inserting */
+	pdata->hist = NULL;
+	if (perf_ex_hist_alloc(pdata, old_entries * 2)) {
+		pdata->hist = old;
+		return -1;
 	}
 
-	/* In the case this is the last element of the addresses */
-	if (!linfo) {
-		linfo_prev->next = linfo_new;
-		el->line_last = linfo_new;
-	} else {
-		linfo_new->next = linfo;
-		if (linfo == el->line_first)
-			 el->line_first = linfo_new;
+	for (unsigned int i = 0; i < old_entries; i++) {
+		if (old[i].hits) {
+			*perf_ex_hist_lookup(pdata, old[i].addr) = old[i];
+		}
+	}
+
+	pdata->hist_used = used;
+	free(old);
+
+	return 0;
+}
+
+/**
+ * @brief Account one sample in the histogram. The histogram is kept at most
+ *		half full.
+ * @param pdata Private data holding the histogram.
+ * @param addr Address of the sample.
+ * @return 0 upon success, -1 if the histogram could not grow.
+ */
+static int perf_ex_hist_add(perf_ex_private_data * const pdata,
+			    unsigned int addr)
+{
+	perf_ex_hist_entry *entry = perf_ex_hist_lookup(pdata, addr);
+
+	if (!entry->hits) {
+		if ((2 * (pdata->hist_used + 1)) > (pdata->hist_mask + 1)) {
+			if (perf_ex_hist_grow(pdata)) {
+				return -1;
+			}
+			entry = perf_ex_hist_lookup(pdata, addr);
+		}
 
-		if (linfo_prev)
-			linfo_prev->next = linfo_new;
+		entry->addr = addr;
+		pdata->hist_used++;
 	}
 
-	return linfo_new;
+	entry->hits++;
+	return 0;
 }
 
 /**
- * @brief  This function checks that the function info structure matches 
- * 	the function from where belong the sample.
- * @param info Function info structure.
- * @param function Name of the function correspond to the sample address.
- * @param path Path to the file that contains the function.
- * @return if the name of the function correspond to the function_name and if 
- *		the path name corresponds to the file_path it will return 1. 0
- *		if it does not match.
+ * @brief Resolve an address going through the symbol cache first. The
+ *		entry is replaced on a miss, unresolved addresses are cached
+ *		as well.
+ * @param pdata Private data holding the cache and the symbol table.
+ * @param addr Address of the sample.
+ * @param info Structure filled with the function/file/line.
+ * @return 0 if the address belongs to a function, -1 otherwise.
  */
 static int
-perf_ex_match_func_and_line(exe_info_list *info, const char * const function,
-				const char * const path)
+perf_ex_resolve(perf_ex_private_data * const pdata, unsigned int addr,
+		elf_sym_info * const info)
 {
-	int cmp_func = strncmp(function,info->function_name, sizeof(info->function_name) - 1);
-	int cmp_file = strncmp(path, info->file_path, sizeof(info->file_path) - 1);
+	perf_ex_cache_entry *entry =
+			&pdata->cache[(addr >> 1) & pdata->cache_mask];
+
+	if (entry->is_set && (entry->addr == addr)) {
+		pdata->cache_hits++;
+		*info = entry->info;
+		return entry->rc;
+	}
 
-	return (!cmp_func && !cmp_file);
+	pdata->cache_misses++;
+	entry->rc = elf_sym_resolve(pdata->syms, addr, &entry->info);
+	entry->addr = addr;
+	entry->is_set = true;
+	*info = entry->info;
+
+	return entry->rc;
 }
 
-/** 
- * @brief This function will assign a structure to the sample represented by the
- *		path and the function parameter. If no function correspond, it
- *		allocate a new exe_info_list structure to get information from.
- * @param path Path to the source file that correspoond to the sample.
- * @param function Name of the function that correspond to the sample.
- * @return Structure on a exe_info_list corresponding. NULL if allocation fails.
+/**
+ * @brief Make room for at least one more element in an array, its capacity
+ *		is doubled when full.
+ * @param array Array to grow.
+ * @param cap Number of elements the array can hold, updated.
+ * @param count Number of elements of the array.
+ * @param size Size of an element.
+ * @return 0 upon success, -1 if the allocation failed.
  */
-static exe_info_list *
-perf_ex_update_function_info(perf_ex_private_data *pdata, exe_info_list *info,
-				const char * const path,
-				const char * const function)
+static int perf_ex_reserve(void ** const array, size_t * const cap,
+			   size_t count, size_t size)
 {
-	exe_info_list *rinfo;
+	size_t new_cap = *cap ? 2 * *cap : 64;
+	void *tmp;
 
-	if (perf_ex_match_func_and_line(info, function, path)) {
-		return info;
+	if (count < *cap) {
+		return 0;
 	}
 
-	if (info->next) {
-		if (perf_ex_match_func_and_line(info->next, function, path)) {
-			return info->next;
-		}
+	if (!(tmp = realloc(*array, new_cap * size))) {
+		ERROR("Could not allocate memory\n");
+		return -1;
 	}
 
-	rinfo = (exe_info_list *) calloc(1, sizeof(exe_info_list));
-	if (!rinfo) {
+	*array = tmp;
+	*cap = new_cap;
+	return 0;
+}
+
+/**
+ * @brief Double the capacity of the function table of the windows.
+ * @param win Windows of the object.
+ * @return 0 upon success, -1 if the allocation failed.
+ */
+static int perf_ex_window_func_grow(perf_ex_windows * const win)
+{
+	unsigned int cap = win->func_cap ? 2 * win->func_cap : 64;
+	unsigned int mask = 2 * cap - 1;
+	perf_ex_func_slot *slots;
+	unsigned int *hits, *touched;
+	const char **names;
+	unsigned int j;
+
+	if (!(slots = calloc(mask + 1, sizeof(*slots)))) {
 		ERROR("Could not allocate memory\n");
-		return NULL;
+		return -1;
+	}
+
+	/* The current window is kept, only the slots are rebuilt */
+	names = realloc(win->names, cap * sizeof(*names));
+	if (names) {
+		win->names = names;
+	}
+
+	hits = names ? realloc(win->hits, cap * sizeof(*hits)) : NULL;
+	if (hits) {
+		win->hits = hits;
+		memset(&hits[win->func_cap], 0,
+		       (cap - win->func_cap) * sizeof(*hits));
+	}
+
+	touched = hits ? realloc(win->touched, cap * sizeof(*touched)) : NULL;
+	if (!touched) {
+		ERROR("Could not allocate memory\n");
+		free(slots);
+		return -1;
+	}
+
+	win->touched = touched;
+	for (unsigned int i = 0; i < win->func_count; i++) {
+		j = perf_ex_hist_hash((uintptr_t) win->names[i]) & mask;
+		while (slots[j].name) {
+			j = (j + 1) & mask;
+		}
+
+		slots[j].name = win->names[i];
+		slots[j].idx = i;
 	}
 
-	strncpy(rinfo->file_path, path, sizeof(rinfo->file_path) - 1);
-	strncpy(rinfo->function_name, function, sizeof(rinfo->function_name) - 1);
+	free(win->slots);
+	win->slots = slots;
+	win->slots_mask = mask;
+	win->func_cap = cap;
 
-	return rinfo;
+	return 0;
 }
 
-/** 
- * @brief This function is sorting sample, and classifying them into the right
- *		structure.
- * @param pdata Private data holding the head of the list of functions information
- *		structure.
- * @param path Path to the source file that correspond to the sample received.
- * @param addr PC address corresponding to the sample received.
- * @param line Number of the line in the source file that the address 
- *		corresponds to.
- * @return 0 if everything went well, otherwise -1.
+/**
+ * @brief Find the index of a function in the windows, it is added the first
+ *		time it is hit.
+ * @param win Windows of the object.
+ * @param name Name of the function, from the symbol table.
+ * @return The index of the function, -1 if the table could not grow.
  */
-static int
-perf_ex_find_and_update_info(perf_ex_private_data *pdata, const char * const path,
-			const char * const function,  unsigned int addr,
-			unsigned int line)
-{
-	exe_info_list *pinfo, *info = pdata->head;
-	exe_line_info *linfo;
-	int cmp_function;
-	int cmp_path;
-	int rc = 0;
-	bool found = false;
-
-	while (info) {
-		if (!info->line_first) {
-			/* This is the first time this element is filled */
-			strncpy(info->file_path, path, sizeof(info->file_path) - 1);
-			strncpy(info->function_name, function, sizeof(info->function_name) - 1);
-		} else if (info->line_first->addr > addr) {
-			info = perf_ex_update_function_info(pdata, info, path, function);
-			/* Try to find all the element that match the address and line*/
-		} else {
-			if (!perf_ex_match_func_and_line(info, function, path)) {
-				pinfo = info;
-				info = info->next;
-				continue;
+static int perf_ex_window_func(perf_ex_windows * const win,
+			       const char * const name)
+{
+	unsigned int i;
+
+	if (win->slots) {
+		i = perf_ex_hist_hash((uintptr_t) name) & win->slots_mask;
+		while (win->slots[i].name) {
+			if (win->slots[i].name == name) {
+				return win->slots[i].idx;
 			}
+
+			i = (i + 1) & win->slots_mask;
 		}
+	}
 
-		found = true;
-		break;
+	if ((win->func_count == win->func_cap) &&
+	    perf_ex_window_func_grow(win)) {
+		return -1;
 	}
 
-	if (!found) {
-		/** If we land here, this means that not element were matching the address.
-		 *  We need to create a new one
-		 */
-		info = (exe_info_list *) calloc(1, sizeof(exe_info_list));
-		if (!info) {
-			ERROR("Could not allocate memory\n");
+	i = perf_ex_hist_hash((uintptr_t) name) & win->slots_mask;
+	while (win->slots[i].name) {
+		i = (i + 1) & win->slots_mask;
+	}
+
+	win->slots[i].name = name;
+	win->slots[i].idx = win->func_count;
+	win->names[win->func_count] = name;
+
+	return win->func_count++;
+}
+
+/**
+ * @brief Order the cells of a window by decreasing hits.
+ */
+static int perf_ex_compare_window_cells(const void *a, const void *b)
+{
+	const perf_ex_window_cell *ca = a, *cb = b;
+
+	if (ca->hits == cb->hits) {
+		return ca->func < cb->func ? -1 : (ca->func > cb->func);
+	}
+
+	return ca->hits > cb->hits ? -1 : 1;
+}
+
+/**
+ * @brief Close the current window. Its hits are either kept for the matrix
+ *		or printed right away, the functions sorted by decreasing hits.
+ * @param win Windows of the object.
+ * @return 0 upon success, -1 if the allocation failed.
+ */
+static int perf_ex_window_close(perf_ex_windows * const win)
+{
+	perf_ex_window_cell *cells;
+	size_t first = win->cell_count;
+	unsigned int func;
+	FILE *out;
+	int rc = 0;
+
+	if (!win->samples) {
+		return 0;
+	}
+
+	for (unsigned int i = 0; i < win->touched_count; i++) {
+		if (perf_ex_reserve((void **) &win->cells, &win->cell_cap,
+				    win->cell_count,
+				    sizeof(*win->cells))) {
 			return -1;
 		}
 
-		strncpy(info->file_path, path, sizeof(info->file_path) - 1);
-		strncpy(info->function_name, function, sizeof(info->function_name) - 1);
-		pinfo->next = info;
-		info->prev = pinfo;
+		func = win->touched[i];
+		win->cells[win->cell_count].func = func;
+		win->cells[win->cell_count++].hits = win->hits[func];
+		win->hits[func] = 0;
+	}
+
+	cells = &win->cells[first];
+	qsort(cells, win->touched_count, sizeof(*cells),
+	      perf_ex_compare_window_cells);
+
+	if (win->is_matrix) {
+		rc = perf_ex_reserve((void **) &win->closed, &win->closed_cap,
+				     win->closed_count, sizeof(*win->closed));
+		if (!rc) {
+			win->closed[win->closed_count].start = win->start;
+			win->closed[win->closed_count].samples = win->samples;
+			win->closed[win->closed_count].first_cell = first;
+			win->closed[win->closed_count++].cell_count =
+							win->touched_count;
+		}
+	} else if ((out = report_buf_stream(&win->out))) {
+		fprintf(out, PERF_EX_OUT_WINDOW, win->index, win->start,
+			win->samples);
+		for (unsigned int i = 0; i < win->touched_count; i++) {
+			fprintf(out, PERF_EX_OUT_WINDOW_FUNC,
+				win->names[cells[i].func], cells[i].hits);
+		}
+
+		fprintf(out, "\n");
+		/* Printed, the cells are not needed anymore */
+		win->cell_count = first;
+	} else {
+		rc = -1;
+		win->cell_count = first;
 	}
 
-	linfo = perf_ex_find_addr_info(info, addr, line);
-	if (!linfo) {
+	win->touched_count = 0;
+	win->samples = 0;
+	win->index++;
+
+	return rc;
+}
+
+/**
+ * @brief Print the closed windows as a tab separated matrix: one line per
+ *		window, one column per function. The cells are released.
+ * @param win Windows of the object.
+ * @return 0 upon success, -1 if the allocation failed.
+ */
+static int perf_ex_window_matrix(perf_ex_windows * const win)
+{
+	perf_ex_window_info *info;
+	perf_ex_window_cell *cell;
+	FILE *out;
+
+	if (!(out = report_buf_stream(&win->out))) {
+		return -1;
+	}
+
+	fprintf(out, "window\tstart\tsamples");
+	for (unsigned int i = 0; i < win->func_count; i++) {
+		fprintf(out, "\t%s", win->names[i]);
+	}
+
+	for (size_t w = 0; w < win->closed_count; w++) {
+		info = &win->closed[w];
+		for (size_t i = 0; i < info->cell_count; i++) {
+			cell = &win->cells[info->first_cell + i];
+			win->hits[cell->func] = cell->hits;
+		}
+
+		fprintf(out, "\n%zu\t%llu\t%u", w, info->start,
+			info->samples);
+		for (unsigned int i = 0; i < win->func_count; i++) {
+			fprintf(out, "\t%u", win->hits[i]);
+			win->hits[i] = 0;
+		}
+	}
+
+	fprintf(out, "\n");
+	win->closed_count = 0;
+	win->cell_count = 0;
+
+	return 0;
+}
+
+/**
+ * @brief Account one sample in the windows. A sample window closes once
+ *		full, a cycle window when a sample falls after its end. The
+ *		cycle windows are aligned on multiples of their length and the
+ *		windows without samples are skipped.
+ * @param pdata Private data of the object.
+ * @param name Function of the sample, from the symbol table, or one of
+ *		PERF_EX_FUNC_UNKNOWN and PERF_EX_FUNC_IDLE.
+ * @param ts Time of the sample in cycles, only used by the cycle windows.
+ * @return 0 upon success, -1 upon error.
+ */
+static int perf_ex_window_add(perf_ex_private_data * const pdata,
+			      const char * const name, unsigned long long ts)
+{
+	perf_ex_windows * const win = &pdata->win;
+	int func;
+
+	if (win->kind == PERF_EX_WINDOW_CYCLES) {
+		if (win->samples && ((ts - win->start) >= win->len) &&
+		    perf_ex_window_close(win)) {
+			return -1;
+		}
+
+		if (!win->samples) {
+			win->start = ts - (ts % win->len);
+		}
+	} else if (!win->samples) {
+		win->start = pdata->total_samples;
+	}
+
+	if ((func = perf_ex_window_func(win, name)) < 0) {
+		return -1;
+	}
+
+	if (!win->hits[func]++) {
+		win->touched[win->touched_count++] = func;
+	}
+
+	win->samples++;
+	if ((win->kind == PERF_EX_WINDOW_SAMPLES) &&
+	    (win->samples == win->len)) {
+		return perf_ex_window_close(win);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Account one sample in the histogram and in the windows.
+ * @param pdata Private data of the object.
+ * @param addr Address of the sample.
+ * @param ts Time of the sample in cycles, 0 without the timestamps.
+ * @return 0 upon success, -1 upon error.
+ */
+static int perf_ex_add_sample(perf_ex_private_data * const pdata,
+			      unsigned int addr, unsigned long long ts)
+{
+	const char *name = PERF_EX_FUNC_UNKNOWN;
+	elf_sym_info info;
+
+	if (perf_ex_hist_add(pdata, addr)) {
 		return -1;
 	}
 
-	info->hits++;
-	linfo->hit++;
+	if (pdata->win.kind) {
+		if (!perf_ex_resolve(pdata, addr, &info)) {
+			name = info.function;
+		}
+
+		if (perf_ex_window_add(pdata, name, ts)) {
+			return -1;
+		}
+	}
+
+	pdata->total_samples++;
+	pdata->report_samples++;
+	return 0;
+}
+
+/**
+ * @brief Account one sample taken while the core was sleeping. It has no
+ *		meaningful address: it is only counted as idle, and in the
+ *		windows under PERF_EX_FUNC_IDLE.
+ * @param pdata Private data of the object.
+ * @param ts Time of the sample in cycles, 0 without the timestamps.
+ * @return 0 upon success, -1 upon error.
+ */
+static int perf_ex_add_idle(perf_ex_private_data * const pdata,
+			    unsigned long long ts)
+{
+	if (pdata->win.kind && perf_ex_window_add(pdata, PERF_EX_FUNC_IDLE,
+						   ts)) {
+		return -1;
+	}
 
+	pdata->total_samples++;
+	pdata->report_samples++;
+	pdata->report_idle++;
 	return 0;
 }
 
+/**
+ * @brief Release the windows and disable them.
+ * @param win Windows of the object.
+ */
+static void perf_ex_window_free(perf_ex_windows * const win)
+{
+	free(win->slots);
+	free(win->names);
+	free(win->hits);
+	free(win->touched);
+	free(win->closed);
+	free(win->cells);
+	report_buf_fini(&win->out);
+	memset(win, 0, sizeof(*win));
+}
+
+/**
+ * @brief Account the samples of an array of timestamp_pkt.
+ * @param pdata Private data of the object.
+ * @param msg message holding the timestamped packets.
+ * @return The number of packets read, -1 upon error.
+ */
+static size_t
+perf_ex_data_in_timestamped(perf_ex_private_data * const pdata,
+			    message_obj * const msg)
+{
+	const timestamp_pkt *pkts = (const timestamp_pkt *) msg->ptr(msg);
+	unsigned int pkt_count = msg->length(msg) / sizeof(timestamp_pkt);
+
+	int rc;
+
+	for (unsigned int i = 0; i < pkt_count; i++) {
+		switch (pkts[i].type) {
+		case LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE:
+			/* arg is the sleep flag of the sample */
+			rc = pkts[i].arg ?
+			     perf_ex_add_idle(pdata, pkts[i].ts) :
+			     perf_ex_add_sample(pdata, pkts[i].value,
+						pkts[i].ts);
+			break;
+		case LIBSWO_PACKET_TYPE_DWT_PC_VALUE:
+			rc = perf_ex_add_sample(pdata, pkts[i].value,
+						pkts[i].ts);
+			break;
+		default:
+			continue;
+		}
+
+		if (rc) {
+			return -1;
+		}
+	}
+
+	return pkt_count;
+}
+
 /**
  * @brief This is the main receiving callback. This callback will receive libswo 
  *		structure samples. This samples carry the PC value. This PC value
- *		will be interpreted by addr2line and store in the corresponding
- *		structure.
+ *		is only accounted in the histogram, the symbols are resolved
+ *		when the report is printed. Behind the timestamp stage it
+ *		receives timestamp_pkt instead.
  * @param obj Processing obj abstraction.
  * @param msg message containing the information. This is a table of 
- *		union libswo_packet.
- * @return The number of byte written to the output of the forked process addr2line.
+ *		union libswo_packet, or of timestamp_pkt.
+ * @return The number of samples accounted, -1 upon error.
  */
 static size_t
 perf_ex_data_in(processing_obj * const obj, message_obj *const msg)
@@ -327,99 +837,155 @@ perf_ex_data_in(processing_obj * const obj, message_obj *const msg)
 				(perf_ex_private_data *) perf ->pdata;
 	union libswo_packet *packets = (union libswo_packet *) msg->ptr(msg);
 	unsigned int pkt_count = msg->length(msg) / sizeof (union libswo_packet);
-	size_t n, readd = 0;
-	unsigned int line;
-	FILE *f_popen;
-	char function[32];
-	char file[512];
-
-	if (!pdata->toolchain) {
-		ERROR("Provide a valid toolchain\n");
+	size_t ret;
+	int rc;
+
+	if (!pdata->syms) {
+		ERROR("Provide a valid elf file\n");
 		return -1;
 	}
 
-	if (!pkt_count) {
+	if (!msg->length(msg)) {
 		WARNING("No packets \n");
 		return -1;
 	}
 
+	if (pdata->is_timestamped) {
+		ret = perf_ex_data_in_timestamped(pdata, msg);
+		if (ret != (size_t) -1) {
+			obj->stats.packets += ret;
+		}
+
+		return ret;
+	}
+
 	for (unsigned int i = 0; i < pkt_count; i++) {
-		snprintf(pdata->path_cmd, sizeof(pdata->path_cmd) - 1,
-				PERF_EX_ADDR2LINE_CMD, pdata->toolchain, pdata->elf,
-				packets[i].pc_value.pc);
+		/* The decoder may keep other packets as well */
+		switch (packets[i].type) {
+		case LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE:
+			/* The pc of a sample taken while sleeping is 0 */
+			rc = packets[i].pc_sample.sleep ?
+			     perf_ex_add_idle(pdata, 0) :
+			     perf_ex_add_sample(pdata, packets[i].pc_sample.pc,
+						0);
+			break;
+		case LIBSWO_PACKET_TYPE_DWT_PC_VALUE:
+			rc = perf_ex_add_sample(pdata, packets[i].pc_value.pc,
+						0);
+			break;
+		default:
+			continue;
+		}
 
-		if (!(f_popen = popen(pdata->path_cmd, "r"))) {
-			ERROR("Could not execute %s\n",  pdata->path_cmd);
+		if (rc) {
 			return -1;
 		}
+	}
 
-		n = fscanf(f_popen, PERF_EX_SSCANF_FORMAT, function, file,
-				&line);
-		if (EOF == n) {
-			if (ferror(f_popen)) {
-				ERROR("Error while opening reading output of "
-					"cmd %s\n", pdata->path_cmd);
-			}
-		}
-		readd += n;
+	obj->stats.packets += pkt_count;
 
-		if (!strncmp(function, "??", sizeof(function) - 1)) {
-			WARNING("Cannot find function at address %x\n",
-				 packets[i].pc_value.pc);
+	return pkt_count;
+}
+
+/**
+ * @brief Order the report lines by address.
+ */
+static int perf_ex_compare_report_lines(const void *a, const void *b)
+{
+	const perf_ex_report_line *la = a, *lb = b;
+
+	if (la->addr == lb->addr) {
+		return 0;
+	}
+
+	return la->addr < lb->addr ? -1 : 1;
+}
+
+/**
+ * @brief Build the report lines out of the histogram: every sampled address
+ *		is resolved once and the lines are sorted by address. The
+ *		histogram is cleared.
+ * @param pdata Private data holding the histogram.
+ * @param count Set to the number of lines of the report.
+ * @return The report lines, NULL if there is nothing to report or upon error.
+ */
+static perf_ex_report_line *
+perf_ex_build_report(perf_ex_private_data * const pdata, size_t * const count)
+{
+	perf_ex_report_line *lines;
+	perf_ex_hist_entry *entry;
+	size_t n = 0;
+
+	*count = 0;
+	if (!pdata->hist_used) {
+		return NULL;
+	}
+
+	if (!(lines = malloc(pdata->hist_used * sizeof(*lines)))) {
+		ERROR("Could not allocate memory\n");
+		return NULL;
+	}
+
+	for (unsigned int i = 0; i <= pdata->hist_mask; i++) {
+		entry = &pdata->hist[i];
+		if (!entry->hits) {
 			continue;
 		}
 
-		if (pclose(f_popen)) {
-			ERROR("Error while executing %s\n", pdata->path_cmd);
-			return -1;
+		if (perf_ex_resolve(pdata, entry->addr, &lines[n].info)) {
+			WARNING("Cannot find function at address %x\n",
+				 entry->addr);
+		} else {
+			lines[n].addr = entry->addr;
+			lines[n].hits = entry->hits;
+			n++;
 		}
 
-		if (perf_ex_find_and_update_info(pdata, file, function,
-						 packets[i].pc_value.pc, line)) {
-			return -1;
-		}
-		pdata->total_samples++;
+		entry->hits = 0;
 	}
 
-	return readd;
+	pdata->hist_used = 0;
+	qsort(lines, n, sizeof(*lines), perf_ex_compare_report_lines);
+	*count = n;
+
+	return lines;
 }
 
 /**
- * @brief Running through all the addresses list, and write the information
- * 		to the msg object.
- * @param info function info object holding addresses.
- * @param msg buffer where the output information should be written.
- * @param pos The current position inside the buffer.
- * @return the number of char written to the buffer.
+ * @brief Append a formatted string to the report chunk, only if it fits
+ *		entirely.
+ * @param buf Buffer of the chunk.
+ * @param pos Position in the buffer, advanced if the string is written.
+ * @param totlen Size of the buffer.
+ * @param fmt Format of the string.
+ * @return 0 if the string was written, -1 if it does not fit.
  */
-static size_t 
-perf_ex_print_addresses(exe_info_list * info, message_obj *const msg,
-				size_t pos)
+static int perf_ex_print_fmt(char * const buf, size_t * const pos,
+			     size_t totlen, const char * const fmt, ...)
 {
-	exe_line_info *linfo = info->line_first;
-	exe_line_info *tofree;
-	size_t totlen = msg->total_len(msg);
-	size_t new_pos = 0;
+	va_list args;
+	int n;
 
-	while (linfo) {
-		new_pos += snprintf(&msg->ptr(msg)[pos + new_pos], totlen - pos,
-				PERF_EX_OUT_LINE, linfo->hit,
-				linfo->line, linfo->addr);
+	va_start(args, fmt);
+	n = vsnprintf(&buf[*pos], totlen - *pos, fmt, args);
+	va_end(args);
 
-		tofree = linfo;
-		linfo = linfo->next;
-		free(tofree);
+	if ((n < 0) || ((size_t) n >= (totlen - *pos))) {
+		buf[*pos] = '\0';
+		return -1;
 	}
 
-	info->line_first = NULL;
-	info->line_last = NULL;
-
-	return new_pos;
+	*pos += n;
+	return 0;
 }
 
 /**
- * @brief This function will browse all the list_info function structure
- *		and write the function names/file names addressed and stats.
+ * @brief This function will group the sampled addresses by function and
+ *		write the function names/file names addressed and stats, after
+ *		a summary of the samples and of the time spent sleeping. The
+ *		report is written in chunks of at most one message: as long as
+ *		lines are left, req_send_more is set and the next call carries
+ *		on where the previous one stopped.
  * @param obj The processing object pointer abstraction.
  * @param msg buffer where the output information should be written.
  * @return the number of char written to the buffer.
@@ -430,34 +996,101 @@ perf_ex_print(processing_obj * const obj, message_obj *const msg)
 	perf_ex_obj * const perf = (perf_ex_obj * const) obj;
 	perf_ex_private_data *pdata =
 				(perf_ex_private_data *) perf->pdata;
-	exe_info_list *info, *tofree;
+	perf_ex_report_line *lines;
+	size_t first, last;
 	size_t pos = 0;
 	size_t totlen = msg->total_len(msg);
-	unsigned func_hits;
+	char *buf = msg->ptr(msg);
+	unsigned int func_hits;
+	int rc;
+
+	if (!pdata->report) {
+		pdata->report = perf_ex_build_report(pdata,
+						     &pdata->report_count);
+		pdata->report_next = 0;
+		pdata->report_func_end = 0;
+
+		/* The message is empty, the summary always fits */
+		if (pdata->report_samples) {
+			perf_ex_print_fmt(buf, &pos, totlen,
+					  PERF_EX_OUT_SUMMARY,
+					  pdata->report_samples,
+					  pdata->report_idle,
+					  100.0 * (pdata->report_samples -
+						   pdata->report_idle) /
+					  pdata->report_samples);
+			pdata->report_samples = 0;
+			pdata->report_idle = 0;
+		}
+	}
+
+	lines = pdata->report;
+	while (pdata->report_func_end ||
+	       (pdata->report_next < pdata->report_count)) {
+		first = pdata->report_next;
+		if (!pdata->report_func_end) {
+			/* Lines of the same function are contiguous */
+			func_hits = 0;
+			for (last = first; (last < pdata->report_count) &&
+			     (lines[last].info.function ==
+			      lines[first].info.function); last++) {
+				func_hits += lines[last].hits;
+			}
 
-	info = pdata->head;
-	while(info) {
-		pos += snprintf(&msg->ptr(msg)[pos], totlen - pos,
-				PERF_EX_OUT_BEGIN_FUNC, info->file_path,
-				info->function_name, info->hits);
-		pos += perf_ex_print_addresses(info, msg, pos);
-		pos += snprintf(&msg->ptr(msg)[pos], totlen - pos,
-				PERF_EX_OUT_END_FUNC);
+			rc = perf_ex_print_fmt(buf, &pos, totlen,
+					       PERF_EX_OUT_BEGIN_FUNC,
+					       lines[first].info.file,
+					       lines[first].info.function,
+					       func_hits);
+			if (!rc) {
+				pdata->report_func_end = last;
+			}
+		} else if (first < pdata->report_func_end) {
+			rc = perf_ex_print_fmt(buf, &pos, totlen,
+					       PERF_EX_OUT_LINE,
+					       lines[first].hits,
+					       lines[first].info.line,
+					       lines[first].addr);
+			if (!rc) {
+				pdata->report_next++;
+			}
+		} else {
+			rc = perf_ex_print_fmt(buf, &pos, totlen,
+					       PERF_EX_OUT_END_FUNC);
+			if (!rc) {
+				pdata->report_func_end = 0;
+			}
+		}
+
+		if (rc) {
+			if (!pos) {
+				/* Would never fit, do not loop forever on it */
+				WARNING("Report line too long, skipping\n");
+				pdata->report_next++;
+				continue;
+			}
 
-		tofree = info;
-		info = info->next;
-		free(tofree);
+			obj->req_send_more = true;
+			break;
+		}
+	}
+
+	if (!obj->req_send_more) {
+		free(pdata->report);
+		pdata->report = NULL;
+		pdata->report_count = 0;
+		DEBUG("Symbol cache: %lu hits, %lu misses\n",
+		      pdata->cache_hits, pdata->cache_misses);
 	}
 
-	pdata->head = NULL;
 	msg->set_length(msg, pos);
-	ERROR("Message gotten %s\n", msg->ptr(msg));
 	return pos;
 }
 
 /**
  * @brief This function will not write write anything to the output buffer until
- *		the end of processing.
+ *		the end of processing, apart from the windows printed when they
+ *		close.
  * @param obj The processing object pointer abstraction.
  * @param msg buffer where the output information should be written.
  * @return the number of char written to the buffer.
@@ -465,8 +1098,27 @@ perf_ex_print(processing_obj * const obj, message_obj *const msg)
 static size_t
 perf_ex_data_out(processing_obj * const obj, message_obj *const msg)
 {
-	
-	if (obj->req_end) {
+	perf_ex_obj * const perf = (perf_ex_obj * const) obj;
+	perf_ex_private_data *pdata =
+				(perf_ex_private_data *) perf->pdata;
+	perf_ex_windows *win = &pdata->win;
+	size_t len;
+
+	if (obj->req_end && win->kind && !win->is_flushed) {
+		win->is_flushed = true;
+		if (perf_ex_window_close(win) ||
+		    (win->is_matrix && perf_ex_window_matrix(win))) {
+			WARNING("Windows incomplete\n");
+		}
+	}
+
+	if ((len = report_buf_send(&win->out, obj, msg))) {
+		/* The report follows the windows at the end of the session */
+		obj->req_send_more = obj->req_send_more || obj->req_end;
+		return len;
+	}
+
+	if (obj->req_end || pdata->report) {
 		return perf_ex_print(obj, msg);
 	}
 
@@ -474,7 +1126,51 @@ perf_ex_data_out(processing_obj * const obj, message_obj *const msg)
 }
 
 /**
- * @brief This function will save the name of the elf path found in the config 
+ * @brief This function loads the symbols and the lines of the elf file. The
+ *		file is parsed only once, any previously loaded table is released.
+ * @param pdata Private data of the object.
+ * @param path Path to the elf file.
+ * @return  0 if successfully loaded the file, -1 otherwise.
+ */
+static int
+perf_ex_load_elf(perf_ex_private_data * const pdata, const char * const path)
+{
+	elf_sym_table *syms;
+	perf_ex_cache_entry *cache;
+	unsigned int start, end, entries = 1;
+
+	if (!(syms = elf_sym_load(path))) {
+		return -1;
+	}
+
+	/* One entry per halfword of the .text range, the cache is cleared */
+	if (!elf_sym_get_range(syms, &start, &end)) {
+		while ((entries < PERF_EX_CACHE_ENTRIES_MAX) &&
+		       (entries < ((end - start + 1) >> 1))) {
+			entries <<= 1;
+		}
+	}
+
+	if (!(cache = calloc(entries, sizeof(*cache)))) {
+		ERROR("Could not allocate memory\n");
+		elf_sym_free(syms);
+		return -1;
+	}
+
+	elf_sym_free(pdata->syms);
+	free(pdata->cache);
+	pdata->syms = syms;
+	pdata->elf = path;
+	pdata->cache = cache;
+	pdata->cache_mask = entries - 1;
+	pdata->cache_hits = 0;
+	pdata->cache_misses = 0;
+
+	return 0;
+}
+
+/**
+ * @brief This function will load the elf file whose path is found in the config 
  *		object. It assumes that the object was first initialized before
  *		using this function.
  * @param obj The processing object pointer abstraction.
@@ -491,23 +1187,23 @@ perf_ex_set_elf_gbl_config(perf_ex_obj * const obj)
 				.type = CONFIG_STR,
 				.name = CFG_SECTION_EXT_BIN_ELF,
 			  };
+	const char *path;
 
-	pdata->elf = CONFIG_HELPER_GET_STR(&param);
-
+	path = CONFIG_HELPER_GET_STR(&param);
 	if (!param.found) {
 		return -1;
 	}
 
-	return 0;
+	return perf_ex_load_elf(pdata, path);
 }
 
 
 /**
- * @brief This function will save the path to the elf file . The
+ * @brief This function will load the elf file . The
  *		elf path is taken from path parameter.
  * @param obj The processing object pointer abstraction.
- * @param path Path to the toolchain. It assumes the path is non-null.
- * @return  0 if successfully found the path, -1 otherwise.
+ * @param path Path to the elf file. It assumes the path is non-null.
+ * @return  0 if successfully loaded the file, -1 otherwise.
  * @pre The path is non-null
  */
 static int
@@ -516,8 +1212,7 @@ perf_ex_set_elf(perf_ex_obj * const obj, const char * path)
 	perf_ex_private_data *pdata =
 				(perf_ex_private_data *) obj->pdata;
 
-	pdata->toolchain = path;
-	return 0;
+	return perf_ex_load_elf(pdata, path);
 }
 
 /**
@@ -567,6 +1262,131 @@ perf_ex_set_tc(perf_ex_obj * const obj, const char * path)
 	return 0;
 }
 
+/**
+ * @brief This function tells whether the samples come from the timestamp
+ *		object, as an array of timestamp_pkt, instead of the decoder.
+ *		The cycle windows need them.
+ * @param obj The processing object pointer abstraction.
+ * @param is_timestamped true if the input is timestamped.
+ * @return  0.
+ */
+static int
+perf_ex_set_timestamped(perf_ex_obj * const obj, bool is_timestamped)
+{
+	perf_ex_private_data *pdata =
+				(perf_ex_private_data *) obj->pdata;
+
+	pdata->is_timestamped = is_timestamped;
+	return 0;
+}
+
+/**
+ * @brief This function splits the profile in windows of a fixed number of
+ *		samples or cycles. Any window already accounted is dropped.
+ * @param obj The processing object pointer abstraction.
+ * @param kind Kind of the windows, PERF_EX_WINDOW_NONE to disable them.
+ * @param len Samples or cycles per window.
+ * @param is_matrix true to print a matrix of all the windows at the end,
+ *		false to print each window when it closes.
+ * @return  0 upon success, -1 if the windows cannot be used.
+ */
+static int
+perf_ex_set_window(perf_ex_obj * const obj, perf_ex_window_kind kind,
+		   unsigned int len, bool is_matrix)
+{
+	perf_ex_private_data *pdata =
+				(perf_ex_private_data *) obj->pdata;
+
+	if (kind && !len) {
+		ERROR("The window length cannot be 0\n");
+		return -1;
+	}
+
+	if ((kind == PERF_EX_WINDOW_CYCLES) && !pdata->is_timestamped) {
+		ERROR("Cycle windows need the timestamps\n");
+		return -1;
+	}
+
+	perf_ex_window_free(&pdata->win);
+	pdata->win.kind = kind;
+	pdata->win.len = len;
+	pdata->win.is_matrix = is_matrix;
+
+	return 0;
+}
+
+/**
+ * @brief This function sets the windows from the config object. They are
+ *		left disabled if the window kind is not configured.
+ * @param obj The processing object pointer abstraction.
+ * @pre The config object must be initialized.
+ * @return  0 upon success, -1 if the windows are misconfigured.
+ */
+static int
+perf_ex_set_window_gbl_config(perf_ex_obj * const obj)
+{
+	cfg_param param = {
+				.section = CFG_SECTION_PERF_EX,
+				.type = CONFIG_STR,
+				.name = CFG_SECTION_PERF_EX_WINDOW,
+			  };
+	perf_ex_window_kind kind;
+	const char *value;
+	unsigned int len;
+	bool is_matrix;
+
+	value = CONFIG_HELPER_GET_STR(&param);
+	if (!param.found) {
+		return 0;
+	}
+
+	if (!strcmp(value, PERF_EX_WINDOW_VAL_SAMPLES)) {
+		kind = PERF_EX_WINDOW_SAMPLES;
+	} else if (!strcmp(value, PERF_EX_WINDOW_VAL_CYCLES)) {
+		kind = PERF_EX_WINDOW_CYCLES;
+	} else {
+		kind = PERF_EX_WINDOW_NONE;
+	}
+
+	param.name = CFG_SECTION_PERF_EX_WINDOW_LEN;
+	param.type = CONFIG_UNSIGNED_INT;
+	len = CONFIG_HELPER_GET_U32(&param);
+	if (kind && !param.found) {
+		ERROR("%s/%s is not configured\n", param.section, param.name);
+		return -1;
+	}
+
+	param.name = CFG_SECTION_PERF_EX_WINDOW_OUTPUT;
+	param.type = CONFIG_STR;
+	value = CONFIG_HELPER_GET_STR(&param);
+	is_matrix = param.found && !strcmp(value, PERF_EX_WINDOW_VAL_MATRIX);
+
+	DEBUG("perf_ex windows: %u, length %u, %s\n", kind, len,
+	      is_matrix ? "matrix" : "incremental");
+
+	return perf_ex_set_window(obj, kind, len, is_matrix);
+}
+
+/**
+ * @brief This function retrieves the counters of the symbol cache. They are
+ *		reset each time a new elf file is loaded.
+ * @param obj The processing object pointer abstraction.
+ * @param hits Number of samples resolved from the cache.
+ * @param misses Number of samples resolved with the symbol table.
+ * @return  0.
+ */
+static int
+perf_ex_get_cache_stats(perf_ex_obj * const obj, unsigned long * const hits,
+			unsigned long * const misses)
+{
+	perf_ex_private_data *pdata =
+				(perf_ex_private_data *) obj->pdata;
+
+	*hits = pdata->cache_hits;
+	*misses = pdata->cache_misses;
+	return 0;
+}
+
 /**
  * @brief Default function in case of acessing a deinitialized object.
  * @param obj The processing object pointer abstraction.
@@ -616,6 +1436,60 @@ static int perf_ex_set_tc_gbl_config_default(perf_ex_obj * const obj)
 	return 0;
 }
 
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @param obj The processing object pointer abstraction.
+ * @param is_timestamped true if the input is timestamped.
+ * @return  0.
+ */
+static int
+perf_ex_set_timestamped_default(perf_ex_obj * const obj, bool is_timestamped)
+{
+	WARNING("Not initialized\n");
+	return 0;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @param obj The processing object pointer abstraction.
+ * @param kind Kind of the windows.
+ * @param len Samples or cycles per window.
+ * @param is_matrix true to print a matrix of all the windows at the end.
+ * @return  0.
+ */
+static int
+perf_ex_set_window_default(perf_ex_obj * const obj, perf_ex_window_kind kind,
+			   unsigned int len, bool is_matrix)
+{
+	WARNING("Not initialized\n");
+	return 0;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @param obj The processing object pointer abstraction.
+ * @return  0.
+ */
+static int perf_ex_set_window_gbl_config_default(perf_ex_obj * const obj)
+{
+	WARNING("Not initialized\n");
+	return 0;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @param obj The processing object pointer abstraction.
+ * @return  -1.
+ */
+static int
+perf_ex_get_cache_stats_default(perf_ex_obj * const obj,
+				unsigned long * const hits,
+				unsigned long * const misses)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
 int perf_ex_init(perf_ex_obj * const obj)
 {
 	processing_obj *proc_obj = (processing_obj *) obj;
@@ -630,6 +1504,7 @@ int perf_ex_init(perf_ex_obj * const obj)
 		return -1;
 	}
 
+	proc_obj->name = "perf_ex";
 	pdata = &perf_ex_priv_data;
 
 	obj->pdata = (void *) &perf_ex_priv_data;
@@ -638,13 +1513,33 @@ int perf_ex_init(perf_ex_obj * const obj)
 
 	obj->set_elf_gbl_config = perf_ex_set_elf_gbl_config;
 	obj->set_elf = perf_ex_set_elf;
+	obj->get_cache_stats = perf_ex_get_cache_stats;
+	obj->set_timestamped = perf_ex_set_timestamped;
+	obj->set_window = perf_ex_set_window;
+	obj->set_window_gbl_config = perf_ex_set_window_gbl_config;
 
 	proc_obj->data_in = perf_ex_data_in;
 	proc_obj->data_out = perf_ex_data_out;
 
 	pdata->is_init = true;
 	pdata->toolchain = NULL;
-	pdata->head = (exe_info_list *) calloc(1, sizeof(exe_info_list));
+	pdata->elf = NULL;
+	pdata->syms = NULL;
+	pdata->cache = NULL;
+	pdata->cache_hits = 0;
+	pdata->cache_misses = 0;
+	pdata->total_samples = 0;
+	pdata->report_samples = 0;
+	pdata->report_idle = 0;
+	pdata->hist = NULL;
+	pdata->report = NULL;
+	pdata->report_count = 0;
+	pdata->is_timestamped = false;
+	memset(&pdata->win, 0, sizeof(pdata->win));
+	if (perf_ex_hist_alloc(pdata, PERF_EX_HIST_ENTRIES_MIN)) {
+		pdata->is_init = false;
+		return -1;
+	}
 
 	return 0;
 }
@@ -664,10 +1559,23 @@ int perf_ex_fini(perf_ex_obj * const obj)
 
 	obj->set_elf_gbl_config = perf_ex_set_elf_gbl_config_default;
 	obj->set_elf = perf_ex_set_elf_default;
-
-	if (pdata->head)
-		free(pdata->head);
-
+	obj->get_cache_stats = perf_ex_get_cache_stats_default;
+	obj->set_timestamped = perf_ex_set_timestamped_default;
+	obj->set_window = perf_ex_set_window_default;
+	obj->set_window_gbl_config = perf_ex_set_window_gbl_config_default;
+
+	free(pdata->hist);
+	pdata->hist = NULL;
+	free(pdata->report);
+	pdata->report = NULL;
+	perf_ex_window_free(&pdata->win);
+
+	elf_sym_free(pdata->syms);
+	pdata->syms = NULL;
+	free(pdata->cache);
+	pdata->cache = NULL;
+
+	processing_fini((processing_obj *) obj);
 	pdata->is_init = false;
 	return 0;
 }
@@ -8,22 +8,83 @@
  *		will not be able to start the data streaming. Data streaming means that
  *		the data are being passed from a parent processing object to his
  *		child(ren).
+ *
+ *		In threaded mode every processing object but the source runs
+ *		on its own worker thread. The execute_out callback of the
+ *		objects is replaced: instead of calling the children directly,
+ *		the output is pushed to the bounded queue of each child and
+ *		the child worker pops it, calls data_in then execute_out. The
+ *		end request travels in the queues behind the data so every
+ *		stage sees all the data before req_end is set.
  *****************************************************************/
 #include <common-macros.h>
+#include <config.h>
 #include <debug.h>
 
 #include <pipeline.h>
 #include <message.h>
 
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 
+/** Maximum number of processing objects attached to the pipeline */
+#define PIPELINE_PROC_OBJS_MAX		16
+
+/**
+ * Message waiting in the queue of a stage.
+ */
+typedef struct {
+	/** Copy of the message buffer */
+	char		*buffer;
+	/** Size of buffer, grown with the messages */
+	size_t		capacity;
+	/** Number of bytes used in buffer */
+	size_t		length;
+	/** Last message, the stage shall end after processing it */
+	bool		end;
+} pipeline_queue_slot;
+
+/**
+ * Bounded queue feeding a stage, a full queue blocks the parent stage.
+ */
+typedef struct {
+	/** Messages of the queue */
+	pipeline_queue_slot	slots[PIPELINE_QUEUE_LEN];
+	/** Index of the oldest message */
+	unsigned int		head;
+	/** Number of messages in the queue */
+	unsigned int		count;
+	/** Protects head and count */
+	pthread_mutex_t		lock;
+	/** Signaled when a message is pushed */
+	pthread_cond_t		not_empty;
+	/** Signaled when a message is popped */
+	pthread_cond_t		not_full;
+} pipeline_queue;
+
+/**
+ * Processing object running on its own worker thread.
+ */
+typedef struct {
+	/** Processing object of the stage */
+	processing_obj			*obj;
+	/** Original execute_out callback, restored at the end */
+	processing_execute_out_cb	execute_out;
+	/** Messages sent by the parent */
+	pipeline_queue			queue;
+	/** Worker thread */
+	pthread_t			worker;
+} pipeline_stage;
 
 /**
  * This is the pipeline's internal structure
  */
 typedef struct {
 	/** Processing object that can be linked toegther. */
-	processing_obj *proc_objs[16];
+	processing_obj *proc_objs[PIPELINE_PROC_OBJS_MAX];
+	/** Worker of each processing object in threaded mode, 0 is the src */
+	pipeline_stage stages[PIPELINE_PROC_OBJS_MAX];
 	/** The number of processing objects in use. */
 	unsigned int count;
 	/** This boolean makes sure that the src is set. */
@@ -35,6 +96,10 @@ typedef struct {
 	bool is_used;
 	/** This boolean request the pipeline to stop. */
 	bool stop;
+	/** Run each processing object on its own thread */
+	bool is_threaded;
+	/** The workers are running */
+	bool is_started;
 } pipeline_private_data;
 
 /** Private instance of the pipeline, only one available */
@@ -60,6 +125,11 @@ static int pipeline_attach_src(pipeline_obj * const obj, processing_obj *const s
 		return -1;
 	}
 
+	if (pdata->count >= ARRAY_SIZE(pdata->proc_objs)) {
+		ERROR("Too many processing objects\n");
+		return -1;
+	}
+
 	pdata->proc_objs[pdata->count] = src;
 	pdata->is_src_connected = true;
 	pdata->count++;
@@ -83,15 +153,348 @@ static int pipeline_attach_proc(pipeline_obj * const obj,
 		ERROR("Source not connected, please connect source first\n");
 		return -1;
 	}
+
+	if (pdata->count >= ARRAY_SIZE(pdata->proc_objs)) {
+		ERROR("Too many processing objects\n");
+		return -1;
+	}
+
 	pdata->proc_objs[pdata->count] = src;
 	pdata->count++;
 	return 0;
 }
 
+/**
+ * @brief Initialize an empty queue.
+ * @param queue The queue to initialize.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pipeline_queue_init(pipeline_queue * const queue)
+{
+	unsigned int i;
+
+	queue->head = 0;
+	queue->count = 0;
+	for (i = 0; i < ARRAY_SIZE(queue->slots); i++) {
+		queue->slots[i].buffer = malloc(MESSAGE_BUFFER_SZ_MAX);
+		if (!queue->slots[i].buffer) {
+			ERROR("Could not allocate memory\n");
+			goto alloc_failed;
+		}
+		queue->slots[i].capacity = MESSAGE_BUFFER_SZ_MAX;
+	}
+
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->not_empty, NULL);
+	pthread_cond_init(&queue->not_full, NULL);
+
+	return 0;
+alloc_failed:
+	while (i--) {
+		free(queue->slots[i].buffer);
+	}
+	return -1;
+}
+
+/**
+ * @brief Release the queue.
+ * @param queue The queue to release.
+ */
+static void pipeline_queue_fini(pipeline_queue * const queue)
+{
+	for (unsigned int i = 0; i < ARRAY_SIZE(queue->slots); i++) {
+		free(queue->slots[i].buffer);
+		queue->slots[i].buffer = NULL;
+		queue->slots[i].capacity = 0;
+	}
+
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->not_empty);
+	pthread_cond_destroy(&queue->not_full);
+}
+
+/**
+ * @brief Grow the buffer of a slot to hold a message, messages may outgrow
+ *		MESSAGE_BUFFER_SZ_MAX with MESSAGE_DYNAMIC.
+ * @param slot The slot, only written by the producer.
+ * @param len Length of the message.
+ * @return The number of bytes the slot can hold, less than len only if the
+ *		allocation failed.
+ */
+static size_t pipeline_queue_reserve(pipeline_queue_slot * const slot,
+				     size_t len)
+{
+	char *buffer;
+
+	if (len <= slot->capacity) {
+		return len;
+	}
+
+	if (!(buffer = realloc(slot->buffer, len))) {
+		ERROR("Could not allocate memory, message truncated\n");
+		return slot->capacity;
+	}
+
+	slot->buffer = buffer;
+	slot->capacity = len;
+	return len;
+}
+
+/**
+ * @brief Copy a message at the end of the queue, wait while the queue is full.
+ * @param queue The queue of the child stage.
+ * @param msg The message to copy, NULL to push an empty message.
+ * @param end Set if this is the last message sent to the stage.
+ */
+static void pipeline_queue_push(pipeline_queue * const queue,
+				message_obj * const msg, bool end)
+{
+	pipeline_queue_slot *slot;
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == ARRAY_SIZE(queue->slots)) {
+		pthread_cond_wait(&queue->not_full, &queue->lock);
+	}
+
+	slot = &queue->slots[(queue->head + queue->count) %
+			     ARRAY_SIZE(queue->slots)];
+	pthread_mutex_unlock(&queue->lock);
+
+	/* Only the producer writes to the free slots */
+	slot->length = msg ? pipeline_queue_reserve(slot, msg->length(msg)) : 0;
+	slot->end = end;
+	if (slot->length) {
+		memcpy(slot->buffer, msg->ptr(msg), slot->length);
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	queue->count++;
+	pthread_cond_signal(&queue->not_empty);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Copy the oldest message of the queue, wait while the queue is empty.
+ * @param queue The queue of the stage.
+ * @param msg The message receiving the copy.
+ * @return true if this is the last message, false otherwise.
+ */
+static bool pipeline_queue_pop(pipeline_queue * const queue,
+			       message_obj * const msg)
+{
+	pipeline_queue_slot *slot;
+	bool end;
+
+	pthread_mutex_lock(&queue->lock);
+	while (!queue->count) {
+		pthread_cond_wait(&queue->not_empty, &queue->lock);
+	}
+
+	slot = &queue->slots[queue->head];
+	pthread_mutex_unlock(&queue->lock);
+
+	/* Only the consumer reads the used slots */
+	msg->write(msg, slot->buffer, slot->length);
+	end = slot->end;
+
+	pthread_mutex_lock(&queue->lock);
+	queue->head = (queue->head + 1) % ARRAY_SIZE(queue->slots);
+	queue->count--;
+	pthread_cond_signal(&queue->not_full);
+	pthread_mutex_unlock(&queue->lock);
+
+	return end;
+}
+
+/**
+ * @brief Find the stage running a processing object.
+ * @param pdata Pipeline private data.
+ * @param obj The processing object.
+ * @return The stage, NULL if the object is not attached to the pipeline.
+ */
+static pipeline_stage *pipeline_find_stage(pipeline_private_data * const pdata,
+					   processing_obj * const obj)
+{
+	for (unsigned int j = 1; j < pdata->count; j++) {
+		if (pdata->stages[j].obj == obj) {
+			return &pdata->stages[j];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief execute_out callback of the objects in threaded mode. Same as the
+ *		processing object's one except that the output is pushed to the
+ *		queues of the children instead of calling them.
+ * @param obj processing object to execute.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pipeline_execute_out_threaded(processing_obj * const obj)
+{
+	pipeline_private_data * const pdata = &pipeline_pdata;
+	message_obj *msg = &obj->msg;
+	processing_obj *next_child;
+	pipeline_stage *stage;
+	bool end;
+
+	do {
+		obj->req_send_more = false;
+		msg->set_length(msg, 0);
+		if ((processing_data_out(obj, msg) <= 0) && (!obj->req_end)) {
+			return -1;
+		}
+
+		end = obj->req_end && !obj->req_send_more;
+		for (next_child = obj->child; next_child;
+		     next_child = next_child->next) {
+			if (!(stage = pipeline_find_stage(pdata, next_child))) {
+				ERROR("%s is not attached to the pipeline\n",
+				      next_child->name);
+				continue;
+			}
+
+			pipeline_queue_push(&stage->queue, msg, end);
+		}
+	} while (obj->req_send_more);
+
+	return 0;
+}
+
+/**
+ * @brief Worker of a stage: process the messages of the queue until the
+ *		last one. The last message is always passed down so the
+ *		children end as well, even if its data_in failed.
+ * @param arg The stage.
+ */
+static void *pipeline_worker(void *arg)
+{
+	pipeline_stage * const stage = (pipeline_stage *) arg;
+	processing_obj * const obj = stage->obj;
+	bool end = false;
+
+	while (!end) {
+		end = pipeline_queue_pop(&stage->queue, &obj->msg);
+		if (end) {
+			obj->req_end = true;
+		}
+
+		if ((processing_data_in(obj, &obj->msg) == (size_t) -1) &&
+		    !end) {
+			ERROR("error while processing data in %s\n", obj->name);
+			continue;
+		}
+
+		obj->execute_out(obj);
+	}
+
+	DEBUG("Worker of %s ended\n", obj->name);
+	return NULL;
+}
+
+/**
+ * @brief Restore the callbacks and release the queues of the stages.
+ * @param pdata Pipeline private data.
+ */
+static void pipeline_release_stages(pipeline_private_data * const pdata)
+{
+	for (unsigned int j = 0; j < pdata->count; j++) {
+		pdata->stages[j].obj->execute_out =
+					pdata->stages[j].execute_out;
+		if (j) {
+			pipeline_queue_fini(&pdata->stages[j].queue);
+		}
+	}
+}
+
+/**
+ * @brief Start one worker per processing object, the source keeps running
+ *		on the caller's thread.
+ * @param pdata Pipeline private data.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pipeline_start_workers(pipeline_private_data * const pdata)
+{
+	pipeline_stage *stage;
+	unsigned int j;
+
+	/* All the queues exist before any object pushes to them */
+	for (j = 0; j < pdata->count; j++) {
+		stage = &pdata->stages[j];
+		stage->obj = pdata->proc_objs[j];
+		stage->execute_out = stage->obj->execute_out;
+		if (j && pipeline_queue_init(&stage->queue)) {
+			goto queue_init_failed;
+		}
+	}
+
+	for (j = 0; j < pdata->count; j++) {
+		pdata->stages[j].obj->execute_out =
+					pipeline_execute_out_threaded;
+	}
+
+	for (j = 1; j < pdata->count; j++) {
+		stage = &pdata->stages[j];
+		if (pthread_create(&stage->worker, NULL, pipeline_worker,
+				   stage)) {
+			ERROR("Could not start worker of %s\n",
+			      stage->obj->name);
+			goto worker_failed;
+		}
+	}
+
+	pdata->is_started = true;
+	DEBUG("%u workers started\n", pdata->count - 1);
+
+	return 0;
+worker_failed:
+	/* End the workers already running, their output is dropped */
+	for (unsigned int i = 1; i < j; i++) {
+		pipeline_queue_push(&pdata->stages[i].queue, NULL, true);
+	}
+	for (unsigned int i = 1; i < j; i++) {
+		pthread_join(pdata->stages[i].worker, NULL);
+	}
+	pipeline_release_stages(pdata);
+	return -1;
+queue_init_failed:
+	while (--j) {
+		pipeline_queue_fini(&pdata->stages[j].queue);
+	}
+	return -1;
+}
+
+/**
+ * @brief Send the end request from the source, wait for all the workers to
+ *		process it and restore the callbacks.
+ * @param pdata Pipeline private data.
+ * @return The return value of the source's last execution.
+ */
+static int pipeline_stop_workers(pipeline_private_data * const pdata)
+{
+	processing_obj *src = pdata->proc_objs[0];
+	int rc;
+
+	src->req_end = true;
+	rc = src->execute_out(src);
+
+	for (unsigned int j = 1; j < pdata->count; j++) {
+		pthread_join(pdata->stages[j].worker, NULL);
+	}
+
+	pipeline_release_stages(pdata);
+	pdata->is_started = false;
+	DEBUG("Workers stopped\n");
+
+	return rc;
+}
+
 /**
  * @brief This pipeline streams data. It will call the source element and start
  * 		it. Upon stop request, it will set the req_end to gracefully stop
- * 		all  processing object.
+ * 		all  processing object. In threaded mode, the workers are
+ * 		started on the first call and only the source is executed.
  * @param obj The pipeline that will stream the data.
  * @return 0 upon success, -1 otherwise.
  */
@@ -107,6 +510,20 @@ static int pipeline_stream_data(pipeline_obj * const obj)
 		return -1;
 	}
 
+	if (pdata->is_threaded) {
+		if (!pdata->is_started && pipeline_start_workers(pdata)) {
+			return -1;
+		}
+
+		if (stop_pipelines) {
+			DEBUG("Requesting to end pipeline and processing elements\n");
+			pdata->stop = true;
+			return pipeline_stop_workers(pdata);
+		}
+
+		return el->execute_out(el);
+	}
+
 	if (stop_pipelines) {
 		DEBUG("Requesting to end pipeline and processing elements\n");
 		for (unsigned int j = 0; j < pdata->count; j++) {
@@ -118,6 +535,24 @@ static int pipeline_stream_data(pipeline_obj * const obj)
 	return pdata->proc_objs[0]->execute_out(pdata->proc_objs[0]);
 }
 
+/**
+ * @brief Print the statistics of every attached processing object. In
+ *		threaded mode the workers keep updating them meanwhile, the
+ *		values printed are only a snapshot.
+ * @param obj pipeline object.
+ * @param out Stream the statistics are printed to.
+ */
+static void pipeline_print_stats(pipeline_obj * const obj, FILE *out)
+{
+	pipeline_private_data * const pdata =
+			(pipeline_private_data * const) obj->pdata;
+
+	for (unsigned int j = 0; j < pdata->count; j++) {
+		processing_print_stats(pdata->proc_objs[j], out);
+	}
+	fflush(out);
+}
+
 /**
  * @brief This function will return if the pipeline is stopped or not.
  * @param obj pipeline object.
@@ -132,6 +567,27 @@ static bool pipeline_get_stop(pipeline_obj *obj)
 	return pdata->stop;
 }
 
+/**
+ * @brief This function selects the execution mode, it shall be called before
+ *		streaming any data.
+ * @param obj pipeline object.
+ * @param threaded true to run each processing object on its own thread.
+ * @return 0 upon success, -1 if the pipeline already streams.
+ */
+static int pipeline_set_threaded(pipeline_obj * const obj, bool threaded)
+{
+	pipeline_private_data * const pdata =
+			(pipeline_private_data * const) obj->pdata;
+
+	if (pdata->is_started) {
+		ERROR("Cannot change mode while streaming\n");
+		return -1;
+	}
+
+	pdata->is_threaded = threaded;
+	return 0;
+}
+
 void pipeline_set_end_all(void) {
 
 	stop_pipelines = true;
@@ -161,6 +617,8 @@ int pipeline_init(pipeline_obj *obj)
 	obj->attach_proc = pipeline_attach_proc;
 	obj->stream_data = pipeline_stream_data;
 	obj->is_stopped = pipeline_get_stop;
+	obj->set_threaded = pipeline_set_threaded;
+	obj->print_stats = pipeline_print_stats;
 
 	obj->pdata = pdata;
 	pdata->is_used = true;
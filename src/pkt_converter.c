@@ -1,9 +1,12 @@
 #include <pkt_converter.h>
+#include <pkt_log.h>
+#ifdef FORM_SQLITE
+#include <pkt_sql.h>
+#endif
 #include <common-macros.h>
 #include <debug.h>
 
-#include <cJSON.h>
-
+#include <stdio.h>
 #include <string.h>
 
 enum pkt_type_value {
@@ -127,11 +130,12 @@ static inline void handle_extension_pkt_value
 static inline void handle_sync_pkt_size(const union libswo_packet *pkt,
 				      void *data)
 {
-	size_t *data_u = (size_t *) data;
+	/* Printed as hexadecimal, an unsigned int is expected */
+	unsigned int *data_u = (unsigned int *) data;
 	if (pkt->sync.size % 8)
-		*data_u = (size_t)pkt->sync.size;
+		*data_u = (unsigned int)pkt->sync.size;
 	else
-		*data_u = (size_t)pkt->sync.size / 8;
+		*data_u = (unsigned int)pkt->sync.size / 8;
 }
 
 /* LTS */
@@ -288,22 +292,27 @@ static inline void handle_exctrc_pkt_function(const union libswo_packet *pkt,
 	}
 }
 
+const char *pkt_convert_exception_name(unsigned int exception,
+				       char * const buf, size_t len)
+{
+	if (exception < NUM_EXCEPTION_NAMES) {
+		return exception_names[exception];
+	}
+
+	snprintf(buf, len, "External interrupt %u",
+		 exception - (unsigned int) NUM_EXCEPTION_NAMES);
+	return buf;
+}
+
 static inline void handle_exctrc_pkt_exception(const union libswo_packet *pkt,
 					       void *data)
 {
 	static char buf[32];
-	unsigned short exception;
 	const char **name = (const char **) data;
 
-	exception = pkt->exctrc.exception;
 	/*TODO adapting CONCUSION */
-	if (exception < NUM_EXCEPTION_NAMES) {
-		*name = exception_names[exception];
-	} else {
-		snprintf(buf, sizeof(buf) - 1, "External interrupt %lu",
-			exception - NUM_EXCEPTION_NAMES);
-		*name = buf;
-	}
+	*name = pkt_convert_exception_name(pkt->exctrc.exception, buf,
+					   sizeof(buf));
 }
 
 /** Periodic pc */
@@ -503,56 +512,175 @@ static struct packet_type_info ptis[] = {
 	},
 };
 
-static size_t pkt_write_to_cjson(pkt_to_form * const ptf,
-			      const union libswo_packet *pkt)
+/** Digits of the hexadecimal values */
+static const char pkt_hex_digits[] = "0123456789abcdef";
+
+/**
+ * @brief Append raw bytes to the buffer.
+ * @return 0 upon success, -1 if they do not fit.
+ */
+static inline int pkt_json_put(char * const buf, size_t * const pos,
+			       size_t len, const char * const str, size_t n)
 {
-	struct packet_type_info  *pti = &ptis[pkt->type];
+	if (n > (len - *pos)) {
+		return -1;
+	}
+
+	memcpy(&buf[*pos], str, n);
+	*pos += n;
+	return 0;
+}
+
+/**
+ * @brief Append an unsigned value in decimal to the buffer.
+ * @return 0 upon success, -1 if it does not fit.
+ */
+static inline int pkt_json_put_unsigned(char * const buf, size_t * const pos,
+					size_t len, unsigned long long value)
+{
+	char digits[20];
+	unsigned int n = sizeof(digits);
+
+	do {
+		digits[--n] = '0' + (value % 10);
+		value /= 10;
+	} while (value);
+
+	return pkt_json_put(buf, pos, len, &digits[n], sizeof(digits) - n);
+}
+
+/**
+ * @brief Append a 32 bits value as a "0xabcdef01" string to the buffer, the
+ *		format is the one of the hexadecimal values since ever.
+ * @return 0 upon success, -1 if it does not fit.
+ */
+static inline int pkt_json_put_hex(char * const buf, size_t * const pos,
+				   size_t len, unsigned int value)
+{
+	char hex[12] = { '"', '0', 'x' };
+
+	for (unsigned int i = 0; i < 8; i++) {
+		hex[10 - i] = pkt_hex_digits[(value >> (4 * i)) & 0xf];
+	}
+	hex[11] = '"';
+
+	return pkt_json_put(buf, pos, len, hex, sizeof(hex));
+}
+
+int pkt_convert_json_str(char * const buf, size_t * const pos, size_t len,
+			 const char * const str)
+{
+	size_t n = *pos;
+	unsigned char c;
+	char esc[6] = { '\\', 'u', '0', '0' };
+
+	if (pkt_json_put(buf, &n, len, "\"", 1)) {
+		return -1;
+	}
+
+	for (const char *ch = str; *ch; ch++) {
+		c = (unsigned char) *ch;
+		if ((c == '"') || (c == '\\')) {
+			esc[1] = c;
+			if (pkt_json_put(buf, &n, len, esc, 2)) {
+				return -1;
+			}
+		} else if (c < 0x20) {
+			esc[1] = 'u';
+			esc[4] = pkt_hex_digits[c >> 4];
+			esc[5] = pkt_hex_digits[c & 0xf];
+			if (pkt_json_put(buf, &n, len, esc, sizeof(esc))) {
+				return -1;
+			}
+		} else if (pkt_json_put(buf, &n, len, ch, 1)) {
+			return -1;
+		}
+	}
+
+	if (pkt_json_put(buf, &n, len, "\"", 1)) {
+		return -1;
+	}
+
+	*pos = n;
+	return 0;
+}
+
+/**
+ * @brief Write the packet as one JSON object straight into the buffer, there
+ *		is no intermediate tree.
+ * @param pkt Packet to write.
+ * @param buf Output buffer.
+ * @param pos Position in buf, moved past the object upon success.
+ * @param len Size of buf.
+ * @return 0 upon success, 1 if the packet is skipped, -1 if it does not fit.
+ */
+static int pkt_write_to_json(const union libswo_packet * const pkt,
+			     char * const buf, size_t * const pos, size_t len)
+{
+	struct packet_type_info  *pti;
 	struct packet_value_info *pvi;
 	char json_char[32];
-	cJSON *json_root;
-	cJSON *json_value;
-	size_t json_sz, total_sz = 0;
+	size_t json_sz, n = *pos;
 	unsigned int json_nbr;
 	char *json_str = NULL;
+	int rc = 0;
 
-	if (!pti->name) {
-		return 0;
+	if (pkt->type >= ARRAY_SIZE(ptis)) {
+		return 1;
 	}
 
-	if (!(json_root = cJSON_AddObjectToObject(ptf->root, pti->name))) {
-		ERROR("Creating Node root node packet\n");
-		return -1;
+	pti = &ptis[pkt->type];
+	if (!pti->name) {
+		return 1;
 	}
 
-	if (!cJSON_AddStringToObject(json_root, "packet", pti->name)) {
-		ERROR("Could not set not packet name\n");
+	if (pkt_json_put(buf, &n, len, "{\"packet\": ", 11) ||
+	    pkt_convert_json_str(buf, &n, len, pti->name)) {
 		return -1;
 	}
 
-	for (unsigned int i=0; i<pti->count; i++) {
+	for (unsigned int i=0; (i<pti->count) && !rc; i++) {
 		pvi = &pti->values[i];
 
+		if (pkt_json_put(buf, &n, len, ", \"", 3) ||
+		    pkt_json_put(buf, &n, len, pvi->name, strlen(pvi->name)) ||
+		    pkt_json_put(buf, &n, len, "\": ", 3)) {
+			return -1;
+		}
+
 		switch (pvi->type) {
 			case PKT_TYPE_CHAR:
-				json_char[1] = '\0';
+				memset(json_char, 0, sizeof(json_char));
 				pvi->handle_pkt(pkt, json_char);
-				json_value =
-					cJSON_CreateString(json_char);
+				json_char[1] = '\0';
+				if ((unsigned char) json_char[0] >= 0x80) {
+					/* A lone byte is not valid UTF-8 */
+					snprintf(json_char, sizeof(json_char),
+						 "\"\\u%04x\"",
+						 (unsigned char) json_char[0]);
+					rc = pkt_json_put(buf, &n, len,
+							  json_char, 8);
+					break;
+				}
+
+				rc = pkt_convert_json_str(buf, &n, len,
+							  json_char);
 			break;
 			case PKT_TYPE_STR:
 				pvi->handle_pkt(pkt, &json_str);
-				json_value =
-					cJSON_CreateString(json_str);
+				rc = pkt_convert_json_str(buf, &n, len,
+							  json_str);
 			break;
 			case PKT_TYPE_SIZE:
 				pvi->handle_pkt(pkt, &json_sz);
-				json_value =
-					cJSON_CreateNumber((float) json_sz);
+				rc = pkt_json_put_unsigned(buf, &n, len,
+							   json_sz);
 			break;
 			case PKT_TYPE_UNSIGNED:
+				json_nbr = 0;
 				pvi->handle_pkt(pkt, &json_nbr);
-				json_value =
-					cJSON_CreateNumber((float) json_nbr);
+				rc = pkt_json_put_unsigned(buf, &n, len,
+							   json_nbr);
 			break;
 			case PKT_TYPE_HEX:
 				/**
@@ -560,61 +688,42 @@ static size_t pkt_write_to_cjson(pkt_to_form * const ptf,
 				 * printed out as string to keep the format
 				 * 0xabcdef01
 				 */
+				json_nbr = 0;
 				pvi->handle_pkt(pkt, &json_nbr);
-				snprintf(json_char, sizeof(json_char),
-					 "0x%08x", json_nbr);
-				json_value =
-					cJSON_CreateString(json_char);
+				rc = pkt_json_put_hex(buf, &n, len, json_nbr);
 			break;
 			default:
 				ERROR("Not a valid type of pkt value\n");
-				return -1;
+				return 1;
 			break;
 		}
-
-		if (!json_value) {
-			ERROR("Error while creating json element %s\n",
-			      pti->name);
-			return -1;
-		}
-
-		cJSON_AddItemToObject(json_root, pvi->name, json_value);
-		total_sz +=  sizeof(cJSON);
 	}
 
-	return 0;
-}
-
-size_t pkt_convert(pkt_to_form * const ptf, message_obj * const obj)
-{
-	union libswo_packet *packets = (union libswo_packet *) obj->ptr(obj);
-	unsigned int pkt_count = obj->length(obj) / sizeof (union libswo_packet);
-
-
-	DEBUG("Number of packet received %d\n", pkt_count);
-	if (!pkt_count) {
-		WARNING("Buffer underflow\n");
+	if (rc || pkt_json_put(buf, &n, len, "}", 1)) {
 		return -1;
 	}
 
-	for (unsigned int i = 0; i < pkt_count; i++) {
-		if ((ptf->fmt > PKT_CONVERTER_MYSQL) ||
-		    (ptf->fmt < PKT_CONVERTER_CJSON)) {
-			ERROR("Invalid type of output conversion\n");
-			return -1;
-		}
+	*pos = n;
+	return 0;
+}
 
-		switch (ptf->fmt) {
-		case PKT_CONVERTER_CJSON:
-			if (pkt_write_to_cjson(ptf, &packets[i])) {
-				return -1;
-			}
-		break;
-		default:
-			WARNING("Type not implemented\n");
-		break;
-		}
+int pkt_convert(pkt_to_form * const ptf, const union libswo_packet * const pkt,
+		char * const buf, size_t * const pos, size_t len)
+{
+	switch (ptf->fmt) {
+	case PKT_CONVERTER_CJSON:
+		return pkt_write_to_json(pkt, buf, pos, len);
+	case PKT_CONVERTER_SQLITE:
+#ifdef FORM_SQLITE
+		return pkt_sql_insert(ptf->db, pkt);
+#else
+		WARNING("Built without SQLite\n");
+		return 1;
+#endif
+	case PKT_CONVERTER_BIN:
+		return pkt_log_write_pkt(pkt, buf, pos, len);
+	default:
+		ERROR("Invalid type of output conversion\n");
+		return 1;
 	}
-
-	return 0;
 }
@@ -0,0 +1,421 @@
+/*****************************************************************
+ * file: pkt_log.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Binary packet log, a compact alternative to the JSON output. All
+ * 		the integers are little endian.
+ *
+ * 		The log starts with a header:
+ * 		  magic "SWOPKTLG", u16 version, u16 number of fields, then
+ * 		  per field three strings (node, name, value), each one a u16
+ * 		  length followed by the bytes.
+ *
+ * 		Then come the records, a u8 type followed by a payload whose
+ * 		length only depends on the type:
+ * 		  packet records, the type is the libswo packet type:
+ * 		    sync        u32 size
+ * 		    lts         u8 relation, u32 value
+ * 		    gts1        u8 flags (bit 0 clkch, bit 1 wrap), u32 value
+ * 		    gts2        u32 value
+ * 		    ext         u8 source, u32 value
+ * 		    inst, hw    u8 size, u8 address, u32 value
+ * 		    evtcnt      u8 flags (cpi, exc, sleep, lsu, fold, cyc)
+ * 		    exctrc      u16 exception, u8 function
+ * 		    pc sample   u8 sleep, u32 pc
+ * 		    pc value    u8 comparator, u32 pc
+ * 		    addr offset u8 comparator, u16 offset
+ * 		    data value  u8 size, u8 comparator, u8 wnr, u32 value
+ * 		    unknown, overflow: no payload
+ * 		  index records (0xff), every PKT_LOG_INDEX_INTERVAL packets,
+ * 		  and the end record (0xfe) closing the log:
+ * 		    u64 packets written before, u64 offset of the previous
+ * 		    index record (0 for none)
+ *
+ * 		The end record is the last PKT_LOG_INDEX_LEN bytes of a
+ * 		complete log, from there the index records can be walked
+ * 		backward to seek to a packet without decoding the whole log.
+ *****************************************************************/
+#include <pkt_log.h>
+#include <common-macros.h>
+#include <debug.h>
+
+#include <string.h>
+
+/** Payload length of the packet records, 0 for the types without record */
+static const unsigned char pkt_log_payload_len[] = {
+	[LIBSWO_PACKET_TYPE_UNKNOWN]		= 0,
+	[LIBSWO_PACKET_TYPE_SYNC]		= 4,
+	[LIBSWO_PACKET_TYPE_OF]			= 0,
+	[LIBSWO_PACKET_TYPE_LTS]		= 5,
+	[LIBSWO_PACKET_TYPE_GTS1]		= 5,
+	[LIBSWO_PACKET_TYPE_GTS2]		= 4,
+	[LIBSWO_PACKET_TYPE_EXT]		= 5,
+	[LIBSWO_PACKET_TYPE_INST]		= 6,
+	[LIBSWO_PACKET_TYPE_HW]			= 6,
+	[LIBSWO_PACKET_TYPE_DWT_EVTCNT]		= 1,
+	[LIBSWO_PACKET_TYPE_DWT_EXCTRC]		= 3,
+	[LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE]	= 5,
+	[LIBSWO_PACKET_TYPE_DWT_PC_VALUE]	= 5,
+	[LIBSWO_PACKET_TYPE_DWT_ADDR_OFFSET]	= 3,
+	[LIBSWO_PACKET_TYPE_DWT_DATA_VALUE]	= 7,
+};
+
+/**
+ * @brief Tell if the type has a packet record, the types without payload
+ *		are the unknown and overflow packets.
+ */
+static inline int pkt_log_is_pkt_type(unsigned int type)
+{
+	return (type < ARRAY_SIZE(pkt_log_payload_len)) &&
+	       (pkt_log_payload_len[type] ||
+		(type == LIBSWO_PACKET_TYPE_UNKNOWN) ||
+		(type == LIBSWO_PACKET_TYPE_OF));
+}
+
+static inline void pkt_log_put16(unsigned char * const p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static inline void pkt_log_put32(unsigned char * const p, uint32_t v)
+{
+	pkt_log_put16(p, v);
+	pkt_log_put16(&p[2], v >> 16);
+}
+
+static inline void pkt_log_put64(unsigned char * const p, uint64_t v)
+{
+	pkt_log_put32(p, v);
+	pkt_log_put32(&p[4], v >> 32);
+}
+
+static inline uint16_t pkt_log_get16(const unsigned char * const p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t pkt_log_get32(const unsigned char * const p)
+{
+	return pkt_log_get16(p) | ((uint32_t) pkt_log_get16(&p[2]) << 16);
+}
+
+static inline uint64_t pkt_log_get64(const unsigned char * const p)
+{
+	return pkt_log_get32(p) | ((uint64_t) pkt_log_get32(&p[4]) << 32);
+}
+
+/**
+ * @brief Write a string of the header, its length then its bytes.
+ * @return 0 upon success, -1 if it does not fit.
+ */
+static int pkt_log_write_str(char * const buf, size_t * const pos, size_t len,
+			     const char * const str)
+{
+	size_t n = strnlen(str, UINT16_MAX);
+
+	if ((n + 2) > (len - *pos)) {
+		return -1;
+	}
+
+	pkt_log_put16((unsigned char *) &buf[*pos], n);
+	memcpy(&buf[*pos + 2], str, n);
+	*pos += n + 2;
+
+	return 0;
+}
+
+/**
+ * @brief Read a string of the header into strs, it is null terminated.
+ * @return The string, NULL if it is truncated or strs is full.
+ */
+static const char *pkt_log_read_str(const char * const buf,
+				    size_t * const pos, size_t len,
+				    char * const strs, size_t * const strs_pos,
+				    size_t strs_len)
+{
+	char *str = &strs[*strs_pos];
+	size_t n;
+
+	if (2 > (len - *pos)) {
+		return NULL;
+	}
+
+	n = pkt_log_get16((const unsigned char *) &buf[*pos]);
+	if (((n + 2) > (len - *pos)) || ((n + 1) > (strs_len - *strs_pos))) {
+		return NULL;
+	}
+
+	memcpy(str, &buf[*pos + 2], n);
+	str[n] = '\0';
+	*pos += n + 2;
+	*strs_pos += n + 1;
+
+	return str;
+}
+
+int pkt_log_write_header(char * const buf, size_t * const pos, size_t len,
+			 const pkt_log_field * const fields,
+			 unsigned int count)
+{
+	size_t n = *pos;
+
+	if ((PKT_LOG_MAGIC_LEN + 4) > (len - n)) {
+		return -1;
+	}
+
+	memcpy(&buf[n], PKT_LOG_MAGIC, PKT_LOG_MAGIC_LEN);
+	pkt_log_put16((unsigned char *) &buf[n + PKT_LOG_MAGIC_LEN],
+		      PKT_LOG_VERSION);
+	pkt_log_put16((unsigned char *) &buf[n + PKT_LOG_MAGIC_LEN + 2],
+		      count);
+	n += PKT_LOG_MAGIC_LEN + 4;
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (pkt_log_write_str(buf, &n, len, fields[i].node) ||
+		    pkt_log_write_str(buf, &n, len, fields[i].name) ||
+		    pkt_log_write_str(buf, &n, len, fields[i].value)) {
+			return -1;
+		}
+	}
+
+	*pos = n;
+	return 0;
+}
+
+int pkt_log_read_header(const char * const buf, size_t * const pos,
+			size_t len, pkt_log_field * const fields,
+			unsigned int * const count, char * const strs,
+			size_t strs_len)
+{
+	const unsigned char *p = (const unsigned char *) &buf[*pos];
+	size_t n = *pos, strs_pos = 0;
+	unsigned int version, nfields;
+
+	if (((PKT_LOG_MAGIC_LEN + 4) > (len - n)) ||
+	    memcmp(p, PKT_LOG_MAGIC, PKT_LOG_MAGIC_LEN)) {
+		ERROR("Not a packet log\n");
+		return -1;
+	}
+
+	version = pkt_log_get16(&p[PKT_LOG_MAGIC_LEN]);
+	if (version != PKT_LOG_VERSION) {
+		ERROR("Packet log version %u not supported\n", version);
+		return -1;
+	}
+
+	nfields = pkt_log_get16(&p[PKT_LOG_MAGIC_LEN + 2]);
+	if (nfields > *count) {
+		ERROR("Too many fields in the header %u/%u\n", nfields, *count);
+		return -1;
+	}
+
+	n += PKT_LOG_MAGIC_LEN + 4;
+	for (unsigned int i = 0; i < nfields; i++) {
+		fields[i].node = pkt_log_read_str(buf, &n, len, strs,
+						  &strs_pos, strs_len);
+		fields[i].name = pkt_log_read_str(buf, &n, len, strs,
+						  &strs_pos, strs_len);
+		fields[i].value = pkt_log_read_str(buf, &n, len, strs,
+						   &strs_pos, strs_len);
+		if (!fields[i].node || !fields[i].name || !fields[i].value) {
+			ERROR("Truncated header\n");
+			return -1;
+		}
+	}
+
+	*count = nfields;
+	*pos = n;
+	return 0;
+}
+
+int pkt_log_write_pkt(const union libswo_packet * const pkt,
+		      char * const buf, size_t * const pos, size_t len)
+{
+	unsigned char *p = (unsigned char *) &buf[*pos];
+
+	if (!pkt_log_is_pkt_type(pkt->type)) {
+		return 1;
+	}
+
+	if ((1U + pkt_log_payload_len[pkt->type]) > (len - *pos)) {
+		return -1;
+	}
+
+	p[0] = pkt->type;
+	switch (pkt->type) {
+	case LIBSWO_PACKET_TYPE_SYNC:
+		pkt_log_put32(&p[1], pkt->sync.size);
+		break;
+	case LIBSWO_PACKET_TYPE_LTS:
+		p[1] = pkt->lts.relation;
+		pkt_log_put32(&p[2], pkt->lts.value);
+		break;
+	case LIBSWO_PACKET_TYPE_GTS1:
+		p[1] = (pkt->gts1.clkch ? 1 : 0) | (pkt->gts1.wrap ? 2 : 0);
+		pkt_log_put32(&p[2], pkt->gts1.value);
+		break;
+	case LIBSWO_PACKET_TYPE_GTS2:
+		pkt_log_put32(&p[1], pkt->gts2.value);
+		break;
+	case LIBSWO_PACKET_TYPE_EXT:
+		p[1] = pkt->ext.source;
+		pkt_log_put32(&p[2], pkt->ext.value);
+		break;
+	case LIBSWO_PACKET_TYPE_INST:
+	case LIBSWO_PACKET_TYPE_HW:
+		/* Both share the layout of the hardware source packet */
+		p[1] = pkt->hw.size;
+		p[2] = pkt->hw.address;
+		pkt_log_put32(&p[3], pkt->hw.value);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_EVTCNT:
+		p[1] = (pkt->evtcnt.cpi ? 0x01 : 0) |
+		       (pkt->evtcnt.exc ? 0x02 : 0) |
+		       (pkt->evtcnt.sleep ? 0x04 : 0) |
+		       (pkt->evtcnt.lsu ? 0x08 : 0) |
+		       (pkt->evtcnt.fold ? 0x10 : 0) |
+		       (pkt->evtcnt.cyc ? 0x20 : 0);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_EXCTRC:
+		pkt_log_put16(&p[1], pkt->exctrc.exception);
+		p[3] = pkt->exctrc.function;
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE:
+		p[1] = pkt->pc_sample.sleep;
+		pkt_log_put32(&p[2], pkt->pc_sample.pc);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_PC_VALUE:
+		p[1] = pkt->pc_value.cmpn;
+		pkt_log_put32(&p[2], pkt->pc_value.pc);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_ADDR_OFFSET:
+		p[1] = pkt->addr_offset.cmpn;
+		pkt_log_put16(&p[2], pkt->addr_offset.offset);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_DATA_VALUE:
+		p[1] = pkt->data_value.size;
+		p[2] = pkt->data_value.cmpn;
+		p[3] = pkt->data_value.wnr;
+		pkt_log_put32(&p[4], pkt->data_value.data_value);
+		break;
+	default:
+		break;
+	}
+
+	*pos += 1 + pkt_log_payload_len[pkt->type];
+	return 0;
+}
+
+int pkt_log_write_index(unsigned int type, const pkt_log_index * const idx,
+			char * const buf, size_t * const pos, size_t len)
+{
+	unsigned char *p = (unsigned char *) &buf[*pos];
+
+	if (PKT_LOG_INDEX_LEN > (len - *pos)) {
+		return -1;
+	}
+
+	p[0] = type;
+	pkt_log_put64(&p[1], idx->count);
+	pkt_log_put64(&p[9], idx->prev);
+	*pos += PKT_LOG_INDEX_LEN;
+
+	return 0;
+}
+
+int pkt_log_read(const char * const buf, size_t * const pos, size_t len,
+		 union libswo_packet * const pkt, pkt_log_index * const idx)
+{
+	const unsigned char *p = (const unsigned char *) &buf[*pos];
+	unsigned int type;
+
+	if (*pos >= len) {
+		return -1;
+	}
+
+	type = p[0];
+	if ((type == PKT_LOG_REC_INDEX) || (type == PKT_LOG_REC_END)) {
+		if (PKT_LOG_INDEX_LEN > (len - *pos)) {
+			return -1;
+		}
+
+		idx->count = pkt_log_get64(&p[1]);
+		idx->prev = pkt_log_get64(&p[9]);
+		*pos += PKT_LOG_INDEX_LEN;
+		return type;
+	}
+
+	if (!pkt_log_is_pkt_type(type)) {
+		ERROR("Unknown record type 0x%02x\n", type);
+		return -1;
+	}
+
+	if ((1U + pkt_log_payload_len[type]) > (len - *pos)) {
+		return -1;
+	}
+
+	memset(pkt, 0, sizeof(*pkt));
+	pkt->type = type;
+	switch (type) {
+	case LIBSWO_PACKET_TYPE_SYNC:
+		pkt->sync.size = pkt_log_get32(&p[1]);
+		break;
+	case LIBSWO_PACKET_TYPE_LTS:
+		pkt->lts.relation = p[1];
+		pkt->lts.value = pkt_log_get32(&p[2]);
+		break;
+	case LIBSWO_PACKET_TYPE_GTS1:
+		pkt->gts1.clkch = p[1] & 1;
+		pkt->gts1.wrap = (p[1] >> 1) & 1;
+		pkt->gts1.value = pkt_log_get32(&p[2]);
+		break;
+	case LIBSWO_PACKET_TYPE_GTS2:
+		pkt->gts2.value = pkt_log_get32(&p[1]);
+		break;
+	case LIBSWO_PACKET_TYPE_EXT:
+		pkt->ext.source = p[1];
+		pkt->ext.value = pkt_log_get32(&p[2]);
+		break;
+	case LIBSWO_PACKET_TYPE_INST:
+	case LIBSWO_PACKET_TYPE_HW:
+		pkt->hw.size = p[1];
+		pkt->hw.address = p[2];
+		pkt->hw.value = pkt_log_get32(&p[3]);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_EVTCNT:
+		pkt->evtcnt.cpi = (p[1] & 0x01) != 0;
+		pkt->evtcnt.exc = (p[1] & 0x02) != 0;
+		pkt->evtcnt.sleep = (p[1] & 0x04) != 0;
+		pkt->evtcnt.lsu = (p[1] & 0x08) != 0;
+		pkt->evtcnt.fold = (p[1] & 0x10) != 0;
+		pkt->evtcnt.cyc = (p[1] & 0x20) != 0;
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_EXCTRC:
+		pkt->exctrc.exception = pkt_log_get16(&p[1]);
+		pkt->exctrc.function = p[3];
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE:
+		pkt->pc_sample.sleep = p[1];
+		pkt->pc_sample.pc = pkt_log_get32(&p[2]);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_PC_VALUE:
+		pkt->pc_value.cmpn = p[1];
+		pkt->pc_value.pc = pkt_log_get32(&p[2]);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_ADDR_OFFSET:
+		pkt->addr_offset.cmpn = p[1];
+		pkt->addr_offset.offset = pkt_log_get16(&p[2]);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_DATA_VALUE:
+		pkt->data_value.size = p[1];
+		pkt->data_value.cmpn = p[2];
+		pkt->data_value.wnr = p[3];
+		pkt->data_value.data_value = pkt_log_get32(&p[4]);
+		break;
+	default:
+		break;
+	}
+
+	*pos += 1 + pkt_log_payload_len[type];
+	return type;
+}
@@ -0,0 +1,460 @@
+/*****************************************************************
+ * file: pkt_sql.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: SQLite packet database, the capture can be queried without a
+ * 		server nor a conversion.
+ *
+ * 		Each packet type has its own table, the first two columns
+ * 		are shared:
+ * 		  seq  number of the packet in the capture, all tables
+ * 		       included, so the order of the packets is kept
+ * 		  ts   sum of the LTS values received before the packet,
+ * 		       the lts rows included, in timestamp ticks. An LTS
+ * 		       timestamps the packets before it: their time is
+ * 		       the ts of the next lts row, see timestamp.c .
+ * 		followed by the fields of the packet:
+ * 		  sync        size
+ * 		  lts         relation, value
+ * 		  gts1        value, clkch, wrap
+ * 		  gts2        value
+ * 		  ext         source, value
+ * 		  inst, hw    address, size, value
+ * 		  evtcnt      cpi, exc, sleep, lsu, fold, cyc
+ * 		  exctrc      exception, function
+ * 		  pc_sample   sleep, pc
+ * 		  pc_value    cmpn, pc
+ * 		  addr_offset cmpn, offset
+ * 		  data_value  cmpn, wnr, size, value
+ * 		The table session holds the session, board and software
+ * 		information as (node, name, value).
+ *
+ * 		The packets are inserted with prepared statements, in one
+ * 		transaction per pkt_sql_begin/pkt_sql_commit, the journal is
+ * 		a WAL. The indexes on ts, and on pc for the tables having
+ * 		one, are built when the database is closed: building them
+ * 		once is much faster than keeping them up to date on every
+ * 		insert.
+ *****************************************************************/
+#include <pkt_sql.h>
+#include <config.h>
+#include <common-macros.h>
+#include <debug.h>
+
+#include <sqlite3.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Longest statement built from the table descriptions */
+#define PKT_SQL_STMT_LEN_MAX		512
+
+/** Table of a packet type */
+typedef struct {
+	/** Name of the table, NULL for the types without table */
+	const char	*name;
+	/** Columns following seq and ts */
+	const char	*columns;
+	/** Number of columns following seq and ts */
+	unsigned int	ncolumns;
+	/** Column indexed besides ts, NULL for none */
+	const char	*index;
+} pkt_sql_table;
+
+static const pkt_sql_table pkt_sql_tables[] = {
+	[LIBSWO_PACKET_TYPE_SYNC] = {
+		"sync", "size INTEGER", 1, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_LTS] = {
+		"lts", "relation INTEGER, value INTEGER", 2, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_GTS1] = {
+		"gts1", "value INTEGER, clkch INTEGER, wrap INTEGER", 3, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_GTS2] = {
+		"gts2", "value INTEGER", 1, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_EXT] = {
+		"ext", "source INTEGER, value INTEGER", 2, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_INST] = {
+		"inst", "address INTEGER, size INTEGER, value INTEGER", 3, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_HW] = {
+		"hw", "address INTEGER, size INTEGER, value INTEGER", 3, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_DWT_EVTCNT] = {
+		"evtcnt", "cpi INTEGER, exc INTEGER, sleep INTEGER, "
+			  "lsu INTEGER, fold INTEGER, cyc INTEGER", 6, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_DWT_EXCTRC] = {
+		"exctrc", "exception INTEGER, function INTEGER", 2, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE] = {
+		"pc_sample", "sleep INTEGER, pc INTEGER", 2, "pc",
+	},
+	[LIBSWO_PACKET_TYPE_DWT_PC_VALUE] = {
+		"pc_value", "cmpn INTEGER, pc INTEGER", 2, "pc",
+	},
+	[LIBSWO_PACKET_TYPE_DWT_ADDR_OFFSET] = {
+		"addr_offset", "cmpn INTEGER, offset INTEGER", 2, NULL,
+	},
+	[LIBSWO_PACKET_TYPE_DWT_DATA_VALUE] = {
+		"data_value", "cmpn INTEGER, wnr INTEGER, size INTEGER, "
+			      "value INTEGER", 4, NULL,
+	},
+};
+
+struct pkt_sql_db_st {
+	/** SQLite connection */
+	sqlite3		*sqlite;
+	/** Insert statement of each table */
+	sqlite3_stmt	*insert[ARRAY_SIZE(pkt_sql_tables)];
+	/** Insert statement of the session table */
+	sqlite3_stmt	*session;
+	/** Number of the next packet */
+	uint64_t	seq;
+	/** Sum of the LTS values inserted so far */
+	uint64_t	ts;
+};
+
+/**
+ * @brief Run a statement without result.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pkt_sql_exec(pkt_sql_db * const db, const char * const sql)
+{
+	char *err = NULL;
+
+	if (sqlite3_exec(db->sqlite, sql, NULL, NULL, &err) != SQLITE_OK) {
+		ERROR("%s: %s\n", sql, err ? err : "unknown error");
+		sqlite3_free(err);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Run a statement built from a format without result.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pkt_sql_execf(pkt_sql_db * const db, const char * const fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static int pkt_sql_execf(pkt_sql_db * const db, const char * const fmt, ...)
+{
+	char sql[PKT_SQL_STMT_LEN_MAX];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(sql, sizeof(sql), fmt, ap);
+	va_end(ap);
+
+	if ((n < 0) || ((size_t) n >= sizeof(sql))) {
+		ERROR("Statement too long\n");
+		return -1;
+	}
+
+	return pkt_sql_exec(db, sql);
+}
+
+/**
+ * @brief Prepare a statement kept for the whole capture.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pkt_sql_prepare(pkt_sql_db * const db, const char * const sql,
+			   sqlite3_stmt ** const stmt)
+{
+	if (sqlite3_prepare_v3(db->sqlite, sql, -1, SQLITE_PREPARE_PERSISTENT,
+			       stmt, NULL) != SQLITE_OK) {
+		ERROR("%s: %s\n", sql, sqlite3_errmsg(db->sqlite));
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Create the table of a packet type and prepare its insert statement.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pkt_sql_create_table(pkt_sql_db * const db, unsigned int type)
+{
+	const pkt_sql_table * const table = &pkt_sql_tables[type];
+	char sql[PKT_SQL_STMT_LEN_MAX];
+	size_t n;
+
+	if (pkt_sql_execf(db, "CREATE TABLE %s (seq INTEGER PRIMARY KEY, "
+			  "ts INTEGER NOT NULL, %s)", table->name,
+			  table->columns)) {
+		return -1;
+	}
+
+	/* One parameter per column, seq and ts included */
+	n = snprintf(sql, sizeof(sql), "INSERT INTO %s VALUES (?, ?",
+		     table->name);
+	for (unsigned int i = 0; (i < table->ncolumns) &&
+				 (n < (sizeof(sql) - 4)); i++) {
+		n += snprintf(&sql[n], sizeof(sql) - n, ", ?");
+	}
+
+	if ((n + 2) > sizeof(sql)) {
+		ERROR("Statement too long\n");
+		return -1;
+	}
+	strcpy(&sql[n], ")");
+
+	return pkt_sql_prepare(db, sql, &db->insert[type]);
+}
+
+/**
+ * @brief Remove a previous database and its journal files.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int pkt_sql_unlink(const char * const path)
+{
+	static const char * const suffixes[] = { "", "-wal", "-shm" };
+	char file[CONFIG_STR_LEN_MAX + 8];
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(suffixes); i++) {
+		if (snprintf(file, sizeof(file), "%s%s", path, suffixes[i]) >=
+		    (int) sizeof(file)) {
+			ERROR("Path too long %s\n", path);
+			return -1;
+		}
+
+		unlink(file);
+	}
+
+	return 0;
+}
+
+int pkt_sql_open(pkt_sql_db ** const db, const char * const path)
+{
+	pkt_sql_db *sdb;
+
+	/* The database is overwritten as the other outputs are */
+	if (pkt_sql_unlink(path)) {
+		return -1;
+	}
+
+	sdb = calloc(1, sizeof(*sdb));
+	if (!sdb) {
+		ERROR("Could not allocate memory\n");
+		return -1;
+	}
+
+	if (sqlite3_open_v2(path, &sdb->sqlite, SQLITE_OPEN_READWRITE |
+			    SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL) !=
+	    SQLITE_OK) {
+		ERROR("Could not open %s: %s\n", path,
+		      sdb->sqlite ? sqlite3_errmsg(sdb->sqlite) : "no memory");
+		goto open_failed;
+	}
+
+	/*
+	 * A WAL only synced at checkpoints: a crash may lose the last
+	 * transactions, never corrupt the database.
+	 */
+	if (pkt_sql_exec(sdb, "PRAGMA journal_mode = WAL") ||
+	    pkt_sql_exec(sdb, "PRAGMA synchronous = NORMAL") ||
+	    pkt_sql_execf(sdb, "PRAGMA cache_size = -%u", PKT_SQL_CACHE_KB)) {
+		goto open_failed;
+	}
+
+	if (pkt_sql_exec(sdb, "CREATE TABLE session (node TEXT, name TEXT, "
+			 "value TEXT)") ||
+	    pkt_sql_prepare(sdb, "INSERT INTO session VALUES (?, ?, ?)",
+			    &sdb->session)) {
+		goto open_failed;
+	}
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(pkt_sql_tables); i++) {
+		if (pkt_sql_tables[i].name && pkt_sql_create_table(sdb, i)) {
+			goto open_failed;
+		}
+	}
+
+	*db = sdb;
+	return 0;
+open_failed:
+	for (unsigned int i = 0; i < ARRAY_SIZE(sdb->insert); i++) {
+		sqlite3_finalize(sdb->insert[i]);
+	}
+	sqlite3_finalize(sdb->session);
+	sqlite3_close(sdb->sqlite);
+	free(sdb);
+	return -1;
+}
+
+int pkt_sql_add_session(pkt_sql_db * const db, const char * const node,
+			const char * const name, const char * const value)
+{
+	sqlite3_stmt * const stmt = db->session;
+	int rc;
+
+	sqlite3_bind_text(stmt, 1, node, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 3, value, -1, SQLITE_STATIC);
+
+	rc = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	if (rc != SQLITE_DONE) {
+		ERROR("Could not insert %s/%s: %s\n", node, name,
+		      sqlite3_errmsg(db->sqlite));
+		return -1;
+	}
+
+	return 0;
+}
+
+int pkt_sql_begin(pkt_sql_db * const db)
+{
+	return pkt_sql_exec(db, "BEGIN");
+}
+
+int pkt_sql_commit(pkt_sql_db * const db)
+{
+	return pkt_sql_exec(db, "COMMIT");
+}
+
+void pkt_sql_rollback(pkt_sql_db * const db)
+{
+	pkt_sql_exec(db, "ROLLBACK");
+}
+
+int pkt_sql_insert(pkt_sql_db * const db,
+		   const union libswo_packet * const pkt)
+{
+	sqlite3_stmt *stmt;
+	int rc;
+
+	if ((pkt->type >= ARRAY_SIZE(pkt_sql_tables)) ||
+	    !(stmt = db->insert[pkt->type])) {
+		return 1;
+	}
+
+	if (pkt->type == LIBSWO_PACKET_TYPE_LTS) {
+		db->ts += pkt->lts.value;
+	}
+
+	sqlite3_bind_int64(stmt, 1, db->seq);
+	sqlite3_bind_int64(stmt, 2, db->ts);
+
+	switch (pkt->type) {
+	case LIBSWO_PACKET_TYPE_SYNC:
+		sqlite3_bind_int64(stmt, 3, pkt->sync.size);
+		break;
+	case LIBSWO_PACKET_TYPE_LTS:
+		sqlite3_bind_int(stmt, 3, pkt->lts.relation);
+		sqlite3_bind_int64(stmt, 4, pkt->lts.value);
+		break;
+	case LIBSWO_PACKET_TYPE_GTS1:
+		sqlite3_bind_int64(stmt, 3, pkt->gts1.value);
+		sqlite3_bind_int(stmt, 4, pkt->gts1.clkch);
+		sqlite3_bind_int(stmt, 5, pkt->gts1.wrap);
+		break;
+	case LIBSWO_PACKET_TYPE_GTS2:
+		sqlite3_bind_int64(stmt, 3, pkt->gts2.value);
+		break;
+	case LIBSWO_PACKET_TYPE_EXT:
+		sqlite3_bind_int(stmt, 3, pkt->ext.source);
+		sqlite3_bind_int64(stmt, 4, pkt->ext.value);
+		break;
+	case LIBSWO_PACKET_TYPE_INST:
+	case LIBSWO_PACKET_TYPE_HW:
+		/* Both share the layout of the hardware source packet */
+		sqlite3_bind_int(stmt, 3, pkt->hw.address);
+		sqlite3_bind_int(stmt, 4, pkt->hw.size);
+		sqlite3_bind_int64(stmt, 5, pkt->hw.value);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_EVTCNT:
+		sqlite3_bind_int(stmt, 3, pkt->evtcnt.cpi);
+		sqlite3_bind_int(stmt, 4, pkt->evtcnt.exc);
+		sqlite3_bind_int(stmt, 5, pkt->evtcnt.sleep);
+		sqlite3_bind_int(stmt, 6, pkt->evtcnt.lsu);
+		sqlite3_bind_int(stmt, 7, pkt->evtcnt.fold);
+		sqlite3_bind_int(stmt, 8, pkt->evtcnt.cyc);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_EXCTRC:
+		sqlite3_bind_int(stmt, 3, pkt->exctrc.exception);
+		sqlite3_bind_int(stmt, 4, pkt->exctrc.function);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE:
+		sqlite3_bind_int(stmt, 3, pkt->pc_sample.sleep);
+		sqlite3_bind_int64(stmt, 4, pkt->pc_sample.pc);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_PC_VALUE:
+		sqlite3_bind_int(stmt, 3, pkt->pc_value.cmpn);
+		sqlite3_bind_int64(stmt, 4, pkt->pc_value.pc);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_ADDR_OFFSET:
+		sqlite3_bind_int(stmt, 3, pkt->addr_offset.cmpn);
+		sqlite3_bind_int(stmt, 4, pkt->addr_offset.offset);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_DATA_VALUE:
+		sqlite3_bind_int(stmt, 3, pkt->data_value.cmpn);
+		sqlite3_bind_int(stmt, 4, pkt->data_value.wnr);
+		sqlite3_bind_int(stmt, 5, pkt->data_value.size);
+		sqlite3_bind_int64(stmt, 6, pkt->data_value.data_value);
+		break;
+	default:
+		break;
+	}
+
+	rc = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	if (rc != SQLITE_DONE) {
+		ERROR("Could not insert packet %llu: %s\n",
+		      (unsigned long long) db->seq, sqlite3_errmsg(db->sqlite));
+		return -1;
+	}
+
+	db->seq++;
+	return 0;
+}
+
+int pkt_sql_close(pkt_sql_db * const db)
+{
+	const pkt_sql_table *table;
+	int rc = 0;
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(pkt_sql_tables); i++) {
+		sqlite3_finalize(db->insert[i]);
+		table = &pkt_sql_tables[i];
+		if (!table->name) {
+			continue;
+		}
+
+		if (pkt_sql_execf(db, "CREATE INDEX %s_ts ON %s (ts)",
+				  table->name, table->name)) {
+			rc = -1;
+		}
+
+		if (table->index &&
+		    pkt_sql_execf(db, "CREATE INDEX %s_%s ON %s (%s)",
+				  table->name, table->index, table->name,
+				  table->index)) {
+			rc = -1;
+		}
+	}
+	sqlite3_finalize(db->session);
+
+	/* Leave a single file behind */
+	if (pkt_sql_exec(db, "PRAGMA wal_checkpoint(TRUNCATE)")) {
+		rc = -1;
+	}
+
+	if (sqlite3_close(db->sqlite) != SQLITE_OK) {
+		ERROR("Could not close the database: %s\n",
+		      sqlite3_errmsg(db->sqlite));
+		rc = -1;
+	}
+
+	free(db);
+	return rc;
+}
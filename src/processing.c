@@ -21,6 +21,7 @@
 #include <processing.h>
 #include <debug.h>
 #include <string.h>
+#include <time.h>
 
 /**
  * Processing obj Internal structure.
@@ -107,31 +108,162 @@ static int processing_execute_out(processing_obj * const obj)
 	processing_obj *next_child;
 	message_obj *msg = &obj->msg;
 
-	msg->set_length(msg, 0);
-	memset(msg->ptr(msg), 0, msg->total_len(msg));
-	if ((obj->data_out(obj, msg) <= 0) && (!obj->req_end)) {
-		return -1;
-	}
+	/*
+	 * The object sets req_send_more when its output does not fit in one
+	 * message, the children are fed again until it is cleared.
+	 */
+	do {
+		obj->req_send_more = false;
+		msg->set_length(msg, 0);
+		if ((processing_data_out(obj, msg) <= 0) && (!obj->req_end)) {
+			return -1;
+		}
+
+		/* The children view the output, it is not copied */
+		next_child = obj->child;
+		while (next_child) {
+			next_child->msg.share(&next_child->msg, msg);
+			if (processing_data_in(next_child, &next_child->msg) ==
+			    (size_t) -1) {
+				ERROR("error while processing data in %s\n",
+				      next_child->name);
+				next_child->msg.set_length(&next_child->msg, 0);
+				next_child = next_child->next;
+				continue;
+			}
 
-	next_child = obj->child;
-	while (next_child) {
-		next_child->msg.cpy(&next_child->msg, msg);
-		if (next_child->data_in(next_child, &next_child->msg) < 0) {
-			ERROR("error while processing data in %s\n", next_child->name);
+			/* Dive deeper */
+			if (next_child->execute_out(next_child) < (size_t) 0) {
+				return -1;
+			}
+
+			/* Continue on the same level */
 			next_child = next_child->next;
-			continue;
 		}
+	} while (obj->req_send_more);
 
-		/* Dive deeper */
-		if (next_child->execute_out(next_child) < (size_t) 0) {
-			return -1;
-		}
+	return 0;
+}
+
+static unsigned long long processing_now_ns(void)
+{
+	struct timespec ts;
 
-		/* Continue on the same level */
-		next_child = next_child->next;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Account one call of data_in or data_out.
+ * @param dir Statistics of the callback.
+ * @param rc Return value of the callback.
+ * @param bytes Bytes received or produced.
+ * @param ns Duration of the call.
+ */
+static void processing_stats_add(processing_stats_dir * const dir, size_t rc,
+				 size_t bytes, unsigned long long ns)
+{
+	unsigned int bucket = 0;
+
+	dir->calls++;
+	dir->time_ns += ns;
+	if (rc == (size_t) -1) {
+		dir->errors++;
+	} else {
+		dir->bytes += bytes;
 	}
 
-	return 0;
+	while ((ns >>= 1) && (bucket < (PROCESSING_STATS_HIST_LEN - 1))) {
+		bucket++;
+	}
+	dir->hist[bucket]++;
+}
+
+size_t processing_data_in(processing_obj * const obj, message_obj * const msg)
+{
+	size_t bytes = msg->length(msg);
+	unsigned long long start = processing_now_ns();
+	size_t rc;
+
+	rc = obj->data_in(obj, msg);
+	processing_stats_add(&obj->stats.in, rc, bytes,
+			     processing_now_ns() - start);
+
+	return rc;
+}
+
+size_t processing_data_out(processing_obj * const obj,
+			   message_obj * const msg)
+{
+	unsigned long long start = processing_now_ns();
+	size_t rc;
+
+	rc = obj->data_out(obj, msg);
+	processing_stats_add(&obj->stats.out, rc, msg->length(msg),
+			     processing_now_ns() - start);
+
+	return rc;
+}
+
+/**
+ * @brief Upper bound of the bucket holding the given quantile of the calls.
+ * @param dir Statistics of the callback.
+ * @param permille Quantile in per mille.
+ * @return The bound in ns.
+ */
+static unsigned long long
+processing_stats_quantile(const processing_stats_dir * const dir,
+			  unsigned int permille)
+{
+	unsigned long long count = 0, target;
+	unsigned int i;
+
+	target = ((unsigned long long) dir->calls * permille + 999) / 1000;
+	for (i = 0; i < (PROCESSING_STATS_HIST_LEN - 1); i++) {
+		count += dir->hist[i];
+		if (count >= target)
+			break;
+	}
+
+	return 2ULL << i;
+}
+
+static void processing_print_stats_dir(const char * const name,
+				       const processing_stats_dir * const dir,
+				       FILE *out)
+{
+	unsigned int i;
+
+	fprintf(out, "  %-8s calls %lu errors %lu bytes %llu", name,
+		dir->calls, dir->errors, dir->bytes);
+	if (!dir->calls) {
+		fprintf(out, "\n");
+		return;
+	}
+
+	fprintf(out, " mean_us %.3f p50_us < %.3f p99_us < %.3f\n",
+		dir->time_ns / 1000.0 / dir->calls,
+		processing_stats_quantile(dir, 500) / 1000.0,
+		processing_stats_quantile(dir, 990) / 1000.0);
+
+	/* Non empty buckets as upper_bound_us:count */
+	fprintf(out, "  %-8s hist", name);
+	for (i = 0; i < PROCESSING_STATS_HIST_LEN; i++) {
+		if (dir->hist[i])
+			fprintf(out, " %.3f:%lu", (2ULL << i) / 1000.0,
+				dir->hist[i]);
+	}
+	fprintf(out, "\n");
+}
+
+void processing_print_stats(const processing_obj * const obj, FILE *out)
+{
+	fprintf(out, "[%s]\n", obj->name);
+	processing_print_stats_dir("data_in", &obj->stats.in, out);
+	processing_print_stats_dir("data_out", &obj->stats.out, out);
+	if (obj->stats.packets) {
+		fprintf(out, "  packets  %llu\n", obj->stats.packets);
+	}
 }
 
 int processing_init(processing_obj * const obj)
@@ -148,8 +280,10 @@ int processing_init(processing_obj * const obj)
 	obj->execute_out = processing_execute_out;
 	obj->name = "Unknown";
 	obj->req_end = false;
+	obj->req_send_more = false;
 	obj->child = NULL;
 	obj->next = NULL;
+	memset(&obj->stats, 0, sizeof(obj->stats));
 
 	return 0;
 }
@@ -0,0 +1,68 @@
+/*****************************************************************
+ * file: report_buf.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Text buffer of the reports of the processing objects. The text is
+ * 		formatted with stdio into an open_memstream and written in
+ * 		chunks of at most one message, the processing object is asked
+ * 		to send more while text is left. The stream is rewound once the
+ * 		text is sent, the text written afterwards reuses its memory.
+ *****************************************************************/
+#include <report_buf.h>
+#include <debug.h>
+
+FILE *report_buf_stream(report_buf * const buf)
+{
+	if (!buf->stream &&
+	    !(buf->stream = open_memstream(&buf->text, &buf->len))) {
+		ERROR("Could not allocate memory\n");
+	}
+
+	return buf->stream;
+}
+
+size_t report_buf_send(report_buf * const buf, processing_obj * const proc_obj,
+		       message_obj * const msg)
+{
+	size_t len;
+
+	proc_obj->req_send_more = false;
+	if (!buf->stream) {
+		return 0;
+	}
+
+	if (fflush(buf->stream)) {
+		ERROR("Could not write the report\n");
+	}
+
+	if (!(len = buf->len - buf->sent)) {
+		return 0;
+	}
+
+	if (len > msg->total_len(msg)) {
+		len = msg->total_len(msg);
+	}
+
+	msg->write(msg, &buf->text[buf->sent], len);
+	buf->sent += len;
+	if (buf->sent == buf->len) {
+		rewind(buf->stream);
+		fflush(buf->stream);
+		buf->sent = 0;
+	}
+
+	proc_obj->req_send_more = (buf->sent != buf->len);
+	return len;
+}
+
+void report_buf_fini(report_buf * const buf)
+{
+	if (buf->stream) {
+		fclose(buf->stream);
+	}
+
+	free(buf->text);
+	buf->stream = NULL;
+	buf->text = NULL;
+	buf->len = 0;
+	buf->sent = 0;
+}
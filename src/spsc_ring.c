@@ -0,0 +1,117 @@
+/*****************************************************************
+ * file: spsc_ring.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Lock-free byte ring shared by exactly one producer thread and one
+ * 		consumer thread. The producer only moves head, the consumer
+ * 		only moves tail. Both are free running counters, the position
+ * 		in the storage is the counter masked by the size of the ring.
+ * 		The release store of a counter publishes the bytes written
+ * 		(head) or freed (tail) before it to the other thread.
+ *****************************************************************/
+#include <spsc_ring.h>
+#include <debug.h>
+
+#include <string.h>
+
+int spsc_ring_init(spsc_ring * const ring, size_t size)
+{
+	if (!size || (size & (size - 1))) {
+		ERROR("Ring size %zu is not a power of two\n", size);
+		return -1;
+	}
+
+	if (!(ring->buffer = malloc(size))) {
+		ERROR("Could not allocate memory\n");
+		return -1;
+	}
+
+	ring->size = size;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+
+	return 0;
+}
+
+void spsc_ring_fini(spsc_ring * const ring)
+{
+	free(ring->buffer);
+	ring->buffer = NULL;
+	ring->size = 0;
+}
+
+size_t spsc_ring_write_region(spsc_ring * const ring, char **ptr)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	size_t pos = head & (ring->size - 1);
+	size_t free_len = ring->size - (head - tail);
+
+	*ptr = &ring->buffer[pos];
+
+	/* Stop at the end of the storage */
+	if (free_len > (ring->size - pos)) {
+		free_len = ring->size - pos;
+	}
+
+	return free_len;
+}
+
+void spsc_ring_commit(spsc_ring * const ring, size_t len)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+	atomic_store_explicit(&ring->head, head + len, memory_order_release);
+}
+
+size_t spsc_ring_write(spsc_ring * const ring, const char * const buf,
+		       size_t len)
+{
+	size_t written = 0, n;
+	char *ptr;
+
+	/* At most two regions: up to the end of the storage, then from 0 */
+	while ((written < len) && (n = spsc_ring_write_region(ring, &ptr))) {
+		if (n > (len - written)) {
+			n = len - written;
+		}
+
+		memcpy(ptr, &buf[written], n);
+		spsc_ring_commit(ring, n);
+		written += n;
+	}
+
+	return written;
+}
+
+size_t spsc_ring_read(spsc_ring * const ring, char * const buf, size_t len)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	size_t pos = tail & (ring->size - 1);
+	size_t n, first;
+
+	n = head - tail;
+	if (n > len) {
+		n = len;
+	}
+
+	first = ring->size - pos;
+	if (first > n) {
+		first = n;
+	}
+
+	memcpy(buf, &ring->buffer[pos], first);
+	memcpy(&buf[first], ring->buffer, n - first);
+
+	atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+
+	return n;
+}
+
+size_t spsc_ring_count(spsc_ring * const ring)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	return head - tail;
+}
@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common-macros.h>
+#include <config.h>
+#include <data_trace.h>
+#include <message.h>
+#include <timestamp.h>
+
+#include <libswo/libswo.h>
+
+#include "test_proc.h"
+
+typedef void (*test_func) (void);
+
+#define DATA_TRACE_01_ELF	BENCHMARKING_TOP_DIR "/res/tests/main.elf"
+
+/** Data value packet of a 4 bytes access */
+#define DATA_TRACE_01_VALUE(_ts, _cmpn, _value, _flags)			\
+	{ .ts = (_ts), .value = (_value),				\
+	  .type = LIBSWO_PACKET_TYPE_DWT_DATA_VALUE,			\
+	  .arg = (_cmpn), .size = 5, .flags = (_flags) }
+
+/** Address offset packet */
+#define DATA_TRACE_01_OFFSET(_ts, _cmpn, _offset)			\
+	{ .ts = (_ts), .value = (_offset),				\
+	  .type = LIBSWO_PACKET_TYPE_DWT_ADDR_OFFSET, .arg = (_cmpn) }
+
+static void test_data_trace_01_init_fini(void)
+{
+	data_trace_obj dt;
+
+	assert(data_trace_init(&dt) == 0);
+	assert(data_trace_init(&dt) == -1);
+	assert(data_trace_fini(&dt) == 0);
+	assert(data_trace_fini(&dt) == -1);
+	assert(dt.set_variable(&dt, 0, "STMU") == -1);
+}
+
+static void test_data_trace_01_variable(void)
+{
+	data_trace_obj dt;
+	char *report;
+	timestamp_pkt pkts[] = {
+		DATA_TRACE_01_VALUE(1000, 0, 1, TIMESTAMP_PKT_WNR),
+		DATA_TRACE_01_VALUE(1100, 0, 1, 0),
+		/* Same value stored again */
+		DATA_TRACE_01_VALUE(1200, 0, 1, TIMESTAMP_PKT_WNR),
+		DATA_TRACE_01_OFFSET(1300, 0, 2),
+		DATA_TRACE_01_VALUE(1300, 0, 7, TIMESTAMP_PKT_WNR |
+					       TIMESTAMP_PKT_DELAYED),
+		DATA_TRACE_01_VALUE(2000, 0, 3, 0),
+		/* No variable, still accounted */
+		DATA_TRACE_01_VALUE(1500, 2, 0xaa, 0),
+		/* Not a comparator */
+		DATA_TRACE_01_VALUE(1500, DATA_TRACE_CMP_MAX, 0, 0),
+	};
+
+	assert(data_trace_init(&dt) == 0);
+
+	/* The variables are looked up in the elf file */
+	assert(dt.set_variable(&dt, 0, "STMU") == -1);
+	assert(dt.set_elf(&dt, DATA_TRACE_01_ELF) == 0);
+	assert(dt.set_variable(&dt, 0, "no_such_variable") == -1);
+	assert(dt.set_variable(&dt, DATA_TRACE_CMP_MAX, "STMU") == -1);
+	assert(dt.set_variable(&dt, 0, "STMU") == 0);
+
+	report = test_proc_run((processing_obj *) &dt, pkts, sizeof(pkts),
+			       true);
+
+	/* Nothing is written before the end of the session */
+	assert(!strncmp(report, "data_trace: values 6 approximate 1\n", 35));
+	assert(strstr(report, "variable: STMU (comparator 0) address: "
+			      "0x20000000 size: 4\n"
+			      "accesses: reads 2 writes 3 offsets 1 "
+			      "rate_per_mcycle 5000.0\n"
+			      "values: changes 2 silent_writes 1 min 0x1 "
+			      "max 0x7 last 0x3\n"
+			      "timeline: 5 of 5 accesses\n"
+			      "\t1000 w 0x00000001\n"
+			      "\t1100 r 0x00000001\n"
+			      "\t1200 w 0x00000001\n"
+			      "\t1300 w 0x00000007 +2 ~\n"
+			      "\t2000 r 0x00000003\n"));
+	assert(strstr(report, "variable: - (comparator 2)\n"));
+	assert(!strstr(report, "comparator 1"));
+
+	free(report);
+	assert(data_trace_fini(&dt) == 0);
+}
+
+static void test_data_trace_01_ring(void)
+{
+	data_trace_obj dt;
+	const char *head = "timeline: 256 of 258 accesses\n\t2 r 0x02\n";
+	char *report, *line;
+	static timestamp_pkt pkts[DATA_TRACE_RING_LEN + 2];
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(pkts); i++) {
+		pkts[i] = (timestamp_pkt) DATA_TRACE_01_VALUE(i, 1, i, 0);
+		pkts[i].size = 2;
+	}
+
+	assert(data_trace_init(&dt) == 0);
+	report = test_proc_run((processing_obj *) &dt, pkts, sizeof(pkts),
+			       true);
+
+	/* Only the last accesses are kept, the bytes are masked */
+	assert((line = strstr(report, "timeline: ")));
+	assert(!strncmp(line, head, strlen(head)));
+	assert(strstr(report, "\t257 r 0x01\n"));
+	assert(strstr(report, "changes 257 silent_writes 0 min 0x0 max 0xff"));
+
+	free(report);
+	assert(data_trace_fini(&dt) == 0);
+}
+
+static test_func ftests[] = {
+	test_data_trace_01_init_fini,
+	test_data_trace_01_variable,
+	test_data_trace_01_ring,
+	NULL,
+};
+
+int main(void)
+{
+	unsigned int i = 0;
+
+	while (ftests[i]) {
+		ftests[i++]();
+	}
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common-macros.h>
+#include <config.h>
+#include <evtcnt.h>
+#include <message.h>
+#include <timestamp.h>
+
+#include <libswo/libswo.h>
+
+#include "test_proc.h"
+
+typedef void (*test_func) (void);
+
+/** Event counter packet */
+#define EVTCNT_01_PKT(_ts, _flags)					\
+	{ .ts = (_ts), .type = LIBSWO_PACKET_TYPE_DWT_EVTCNT,		\
+	  .arg = (_flags) }
+
+static void test_evtcnt_01_init_fini(void)
+{
+	evtcnt_obj evt;
+
+	assert(evtcnt_init(&evt) == 0);
+	assert(evtcnt_init(&evt) == -1);
+	assert(evtcnt_fini(&evt) == 0);
+	assert(evtcnt_fini(&evt) == -1);
+}
+
+static void test_evtcnt_01_libswo(void)
+{
+	evtcnt_obj evt;
+	processing_obj *proc = (processing_obj *) &evt;
+	char *text;
+	union libswo_packet pkts[] = {
+		{ .evtcnt = { .type = LIBSWO_PACKET_TYPE_DWT_EVTCNT,
+			      .lsu = true, .cpi = true } },
+		{ .pc_sample = { .type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE,
+				 .pc = 0x08000100 } },
+		{ .evtcnt = { .type = LIBSWO_PACKET_TYPE_DWT_EVTCNT,
+			      .lsu = true, .cyc = true } },
+	};
+
+	assert(evtcnt_init(&evt) == 0);
+	/* The windows need the timestamps */
+	assert(evt.set_window(&evt, 1000) == -1);
+
+	text = test_proc_run(proc, pkts, sizeof(pkts), true);
+	assert(!strcmp(text, "evtcnt: packets 2\n"
+			     "cpi_cycles: 256\n"
+			     "exc_cycles: 0\n"
+			     "sleep_cycles: 0\n"
+			     "lsu_cycles: 512\n"
+			     "fold_cycles: 0\n"
+			     "cyc_wraps: 1\n"));
+	free(text);
+
+	assert(evtcnt_fini(&evt) == 0);
+}
+
+static void test_evtcnt_01_windows(void)
+{
+	evtcnt_obj evt;
+	processing_obj *proc = (processing_obj *) &evt;
+	char *text;
+	timestamp_pkt pkts[] = {
+		EVTCNT_01_PKT(100, TIMESTAMP_PKT_EVT_SLEEP),
+		EVTCNT_01_PKT(900, TIMESTAMP_PKT_EVT_SLEEP),
+		EVTCNT_01_PKT(1100, TIMESTAMP_PKT_EVT_EXC),
+		/* Nothing in [2000, 3000) */
+		EVTCNT_01_PKT(3100, TIMESTAMP_PKT_EVT_LSU),
+	};
+
+	assert(evtcnt_init(&evt) == 0);
+	assert(evt.set_timestamped(&evt, true) == 0);
+	assert(evt.set_window(&evt, 1000) == 0);
+
+	/* The windows are written when they close */
+	text = test_proc_run(proc, pkts, sizeof(pkts), false);
+	assert(!strcmp(text,
+		       "window: start 0 cpi_cycles: 0 (0.0%) exc_cycles: 0 "
+		       "(0.0%) sleep_cycles: 512 (51.2%) lsu_cycles: 0 (0.0%) "
+		       "fold_cycles: 0 (0.0%) cyc_wraps: 0\n"
+		       "window: start 1000 cpi_cycles: 0 (0.0%) exc_cycles: "
+		       "256 (25.6%) sleep_cycles: 0 (0.0%) lsu_cycles: 0 "
+		       "(0.0%) fold_cycles: 0 (0.0%) cyc_wraps: 0\n"));
+	free(text);
+
+	text = test_proc_run(proc, pkts, 0, true);
+	assert(!strncmp(text, "window: start 3000 ", 19));
+	assert(strstr(text, "\nevtcnt: packets 4 elapsed_cycles 3000\n"
+			    "cpi_cycles: 0 (0.0%)\n"
+			    "exc_cycles: 256 (8.5%)\n"
+			    "sleep_cycles: 512 (17.1%)\n"
+			    "lsu_cycles: 256 (8.5%)\n"));
+	free(text);
+
+	assert(evtcnt_fini(&evt) == 0);
+}
+
+static test_func ftests[] = {
+	test_evtcnt_01_init_fini,
+	test_evtcnt_01_libswo,
+	test_evtcnt_01_windows,
+	NULL,
+};
+
+int main(void)
+{
+	unsigned int i = 0;
+
+	while (ftests[i]) {
+		ftests[i++]();
+	}
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common-macros.h>
+#include <config.h>
+#include <exc_trace.h>
+#include <message.h>
+#include <timestamp.h>
+
+#include <libswo/libswo.h>
+
+#include "test_proc.h"
+
+typedef void (*test_func) (void);
+
+/** Exception trace packet */
+#define EXC_TRACE_01_PKT(_ts, _exc, _func)				\
+	{ .ts = (_ts), .value = (_exc),					\
+	  .type = LIBSWO_PACKET_TYPE_DWT_EXCTRC,			\
+	  .arg = LIBSWO_EXCTRC_FUNC_ ## _func }
+
+static void test_exc_trace_01_init_fini(void)
+{
+	exc_trace_obj exc;
+
+	assert(exc_trace_init(&exc) == 0);
+	assert(exc_trace_init(&exc) == -1);
+	assert(exc_trace_fini(&exc) == 0);
+	assert(exc_trace_fini(&exc) == -1);
+}
+
+static void test_exc_trace_01_nested(void)
+{
+	exc_trace_obj exc;
+	char *report;
+	timestamp_pkt pkts[] = {
+		EXC_TRACE_01_PKT(100, 15, ENTER),
+		EXC_TRACE_01_PKT(200, 16, ENTER),
+		EXC_TRACE_01_PKT(250, 16, EXIT),
+		/* Tail chained, the SysTick stays preempted */
+		EXC_TRACE_01_PKT(260, 17, ENTER),
+		EXC_TRACE_01_PKT(300, 17, EXIT),
+		EXC_TRACE_01_PKT(300, 15, RETURN),
+		EXC_TRACE_01_PKT(400, 15, EXIT),
+		EXC_TRACE_01_PKT(400, 0, RETURN),
+		/* Exit lost on the way */
+		EXC_TRACE_01_PKT(500, 15, ENTER),
+		EXC_TRACE_01_PKT(600, 0, RETURN),
+		EXC_TRACE_01_PKT(700, 16, EXIT),
+	};
+
+	assert(exc_trace_init(&exc) == 0);
+	report = test_proc_run((processing_obj *) &exc, pkts, sizeof(pkts),
+			       true);
+
+	/* Nothing is written before the end of the session */
+	assert(!strncmp(report, "exceptions: ", 12));
+
+	assert(strstr(report, "events 11 approximate 0 unmatched 2 "
+			      "overflows 0 max_depth 2\n"));
+	assert(strstr(report, "exception: SysTick (15)\n"
+			      "entries: 2 preempting: 0 preempted: 1\n"
+			      "handler_cycles: count 1 mean 200.0 min 200 "
+			      "max 200\n"));
+	assert(strstr(report, "preempted_cycles: count 1 mean 100.0 min 100 "
+			      "max 100\npreempted_hist 128:1\n"));
+	assert(strstr(report, "exception: External interrupt 0 (16)\n"
+			      "entries: 1 preempting: 1 preempted: 0\n"
+			      "handler_cycles: count 1 mean 50.0"));
+	assert(strstr(report, "exception: External interrupt 1 (17)\n"
+			      "entries: 1 preempting: 1 preempted: 0\n"));
+
+	free(report);
+	assert(exc_trace_fini(&exc) == 0);
+}
+
+static test_func ftests[] = {
+	test_exc_trace_01_init_fini,
+	test_exc_trace_01_nested,
+	NULL,
+};
+
+int main(void)
+{
+	unsigned int i = 0;
+
+	while (ftests[i]) {
+		ftests[i++]();
+	}
+
+	return 0;
+}
@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common-macros.h>
+#include <config_ini.h>
+#include <itm2mem_info.h>
+#include <message.h>
+
+#include <libswo/libswo.h>
+
+typedef void (*test_func) (void);
+
+#define ITM2MEM_INFO_01_CONFIG	BENCHMARKING_TOP_DIR \
+				"/res/configs/memory_heap_config.ini"
+
+/** Instrumentation packet of a write of _len bytes on a port */
+#define ITM2MEM_INFO_01_INST(_port, _len, _value)			\
+	{ .inst = { .type = LIBSWO_PACKET_TYPE_INST,			\
+		    .size = (_len) + 1, .address = (_port),		\
+		    .value = (_value) } }
+
+/** 32-bit write on the port of the records */
+#define ITM2MEM_INFO_01_WORD(_value)					\
+	ITM2MEM_INFO_01_INST(ITM2MEM_INFO_PORT, 4, (_value))
+
+#define ITM2MEM_INFO_01_ALLOC(_depth, _size)				\
+	ITM2MEM_INFO_01_WORD(ITM2MEM_REC_HEADER(ITM2MEM_REC_ALLOC,	\
+						(_depth), (_size)))
+
+#define ITM2MEM_INFO_01_FREE(_depth)					\
+	ITM2MEM_INFO_01_WORD(ITM2MEM_REC_HEADER(ITM2MEM_REC_FREE,	\
+						(_depth), 0))
+
+static config_ini_obj cfg;
+
+/**
+ * @brief Initialize the object, it reads its output paths in the
+ *		configuration.
+ */
+static void itm2mem_info_01_init(itm2mem_info_obj * const obj)
+{
+	static bool is_cfg_open;
+
+	if (!is_cfg_open) {
+		assert(config_ini_init(&cfg) == 0);
+		assert(cfg.open_cfg(&cfg, ITM2MEM_INFO_01_CONFIG) == 0);
+		is_cfg_open = true;
+	}
+
+	memset(obj, 0, sizeof(*obj));
+	assert(itm2mem_info_init(obj) == 0);
+}
+
+/**
+ * @brief Feed the packets to the object.
+ */
+static void itm2mem_info_01_feed(itm2mem_info_obj * const obj,
+				 const union libswo_packet * const pkts,
+				 size_t count)
+{
+	processing_obj *proc = (processing_obj *) obj;
+	message_obj msg;
+
+	assert(message_init(&msg) == 0);
+	msg.write(&msg, (char *) pkts, count * sizeof(*pkts));
+	assert(proc->data_in(proc, &msg) == count * sizeof(*pkts));
+	assert(message_fini(&msg) == 0);
+}
+
+/**
+ * @brief Check the counters of the records.
+ */
+static void itm2mem_info_01_check(itm2mem_info_obj * const obj,
+				  unsigned long allocs, unsigned long frees,
+				  unsigned long skipped,
+				  unsigned long truncated)
+{
+	itm2mem_info_stats stats;
+
+	assert(obj->get_stats(obj, &stats) == 0);
+	assert(stats.allocs == allocs);
+	assert(stats.frees == frees);
+	assert(stats.skipped == skipped);
+	assert(stats.truncated == truncated);
+}
+
+static void test_itm2mem_info_01_records(void)
+{
+	itm2mem_info_obj obj;
+	itm2mem_info_stats stats;
+	union libswo_packet pkts[] = {
+		ITM2MEM_INFO_01_ALLOC(2, 100),
+		ITM2MEM_INFO_01_WORD(0x20000010),
+		ITM2MEM_INFO_01_WORD(0x08000101),
+		ITM2MEM_INFO_01_WORD(0x08000203),
+		ITM2MEM_INFO_01_FREE(1),
+		ITM2MEM_INFO_01_WORD(0x20000010),
+		ITM2MEM_INFO_01_WORD(0x08000301),
+		/* No backtrace, the record ends with its pointer */
+		ITM2MEM_INFO_01_ALLOC(0, 16),
+		ITM2MEM_INFO_01_WORD(0x20000080),
+		ITM2MEM_INFO_01_FREE(0),
+		ITM2MEM_INFO_01_WORD(0x20000080),
+	};
+
+	itm2mem_info_01_init(&obj);
+	itm2mem_info_01_feed(&obj, pkts, ARRAY_SIZE(pkts));
+	itm2mem_info_01_check(&obj, 2, 2, 0, 0);
+
+	assert(itm2mem_info_fini(&obj) == 0);
+	assert(obj.get_stats(&obj, &stats) == -1);
+}
+
+static void test_itm2mem_info_01_resync(void)
+{
+	itm2mem_info_obj obj;
+	union libswo_packet pkts[] = {
+		/* Tail of a record whose header was lost */
+		ITM2MEM_INFO_01_WORD(0x20000010),
+		ITM2MEM_INFO_01_WORD(0x08000101),
+		ITM2MEM_INFO_01_ALLOC(1, 32),
+		/* The other ports and packets are not part of the records */
+		ITM2MEM_INFO_01_INST(0, 1, 'x'),
+		{ .pc_sample = { .type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE,
+				 .pc = 0x08000100 } },
+		ITM2MEM_INFO_01_WORD(0x20000040),
+		ITM2MEM_INFO_01_WORD(0x08000101),
+	};
+
+	itm2mem_info_01_init(&obj);
+	itm2mem_info_01_feed(&obj, pkts, ARRAY_SIZE(pkts));
+	itm2mem_info_01_check(&obj, 1, 0, 2, 0);
+	assert(itm2mem_info_fini(&obj) == 0);
+}
+
+static void test_itm2mem_info_01_narrow(void)
+{
+	itm2mem_info_obj obj;
+	uint32_t header = ITM2MEM_REC_HEADER(ITM2MEM_REC_ALLOC, 2, 24);
+	union libswo_packet pkts[] = {
+		/* Header written byte per byte, little endian */
+		ITM2MEM_INFO_01_INST(ITM2MEM_INFO_PORT, 1, header & 0xff),
+		ITM2MEM_INFO_01_INST(ITM2MEM_INFO_PORT, 1,
+				     (header >> 8) & 0xff),
+		ITM2MEM_INFO_01_INST(ITM2MEM_INFO_PORT, 1,
+				     (header >> 16) & 0xff),
+		ITM2MEM_INFO_01_INST(ITM2MEM_INFO_PORT, 1, header >> 24),
+		/* Pointer written by half words */
+		ITM2MEM_INFO_01_INST(ITM2MEM_INFO_PORT, 2, 0x00c0),
+		ITM2MEM_INFO_01_INST(ITM2MEM_INFO_PORT, 2, 0x2000),
+		/* A word write straddling two words */
+		ITM2MEM_INFO_01_INST(ITM2MEM_INFO_PORT, 2, 0x0101),
+		ITM2MEM_INFO_01_WORD(0x02030800),
+		ITM2MEM_INFO_01_INST(ITM2MEM_INFO_PORT, 2, 0x0008),
+		/* Aligned again, a word write fills a word */
+		ITM2MEM_INFO_01_FREE(0),
+		ITM2MEM_INFO_01_WORD(0x200000c0),
+	};
+
+	itm2mem_info_01_init(&obj);
+	itm2mem_info_01_feed(&obj, pkts, ARRAY_SIZE(pkts));
+	itm2mem_info_01_check(&obj, 1, 1, 0, 0);
+	assert(itm2mem_info_fini(&obj) == 0);
+}
+
+static void test_itm2mem_info_01_truncated(void)
+{
+	itm2mem_info_obj obj;
+	processing_obj *proc = (processing_obj *) &obj;
+	union libswo_packet cut[] = {
+		ITM2MEM_INFO_01_ALLOC(3, 64),
+		ITM2MEM_INFO_01_WORD(0x20000100),
+		ITM2MEM_INFO_01_WORD(0x08000101),
+	};
+	union libswo_packet next[] = {
+		ITM2MEM_INFO_01_ALLOC(1, 8),
+		ITM2MEM_INFO_01_WORD(0x20000200),
+		ITM2MEM_INFO_01_WORD(0x08000101),
+	};
+
+	itm2mem_info_01_init(&obj);
+	itm2mem_info_01_feed(&obj, cut, ARRAY_SIZE(cut));
+	itm2mem_info_01_check(&obj, 0, 0, 0, 0);
+
+	/*
+	 * The last data_in of the session drops the record being received,
+	 * data_out is not called as it writes the report.
+	 */
+	proc->req_end = true;
+	itm2mem_info_01_feed(&obj, NULL, 0);
+	itm2mem_info_01_check(&obj, 0, 0, 0, 1);
+
+	/* The next record is not mixed with the dropped one */
+	proc->req_end = false;
+	itm2mem_info_01_feed(&obj, next, ARRAY_SIZE(next));
+	itm2mem_info_01_check(&obj, 1, 0, 0, 1);
+	assert(itm2mem_info_fini(&obj) == 0);
+}
+
+static test_func ftests[] = {
+	test_itm2mem_info_01_records,
+	test_itm2mem_info_01_resync,
+	test_itm2mem_info_01_narrow,
+	test_itm2mem_info_01_truncated,
+	NULL,
+};
+
+int main(void)
+{
+	unsigned int i = 0;
+
+	while (ftests[i]) {
+		ftests[i++]();
+	}
+
+	config_ini_fini(&cfg);
+	return 0;
+}
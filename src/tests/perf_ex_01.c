@@ -3,12 +3,17 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <config.h>
 #include <message.h>
 #include <perf_ex.h>
+#include <timestamp.h>
 
 #include <libswo/libswo.h>
 
+/** ELF file used to resolve the samples */
+#define PERF_EX_01_ELF	BENCHMARKING_TOP_DIR "/res/tests/main.elf"
 
 typedef void (*test_func) (void);
 
@@ -50,7 +55,7 @@ static void test_perf_ex_01_double_fini(void)
 	assert(perf_ex_fini(&perf_ex) == -1);
 }
 
-static void test_perf_ex_01_data_in_no_tc(void)
+static void test_perf_ex_01_data_in_no_elf(void)
 {
 	message_obj msg;
 	perf_ex_obj perf_ex;
@@ -79,7 +84,7 @@ static void test_perf_ex_01_data_in_no_tc(void)
 }
 
 
-static void test_perf_ex_01_data_in_tc_increasing_addresses(void)
+static void test_perf_ex_01_data_in_elf_increasing_addresses(void)
 {
 	message_obj msg;
 	perf_ex_obj perf_ex;
@@ -93,7 +98,7 @@ static void test_perf_ex_01_data_in_tc_increasing_addresses(void)
 
 	assert(message_init(&msg) == 0);
 	assert(perf_ex_init(&perf_ex) == 0);
-	assert(perf_ex.set_tc(&perf_ex, "arm-none-eabi-") == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
 
 	test_packets = (union libswo_packet *) msg.ptr(&msg);
 
@@ -112,7 +117,7 @@ static void test_perf_ex_01_data_in_tc_increasing_addresses(void)
 	assert(perf_ex_fini(&perf_ex) == 0);
 }
 
-static void test_perf_ex_01_data_in_tc_decreasing_addresses(void)
+static void test_perf_ex_01_data_in_elf_decreasing_addresses(void)
 {
 	message_obj msg;
 	perf_ex_obj perf_ex;
@@ -126,7 +131,7 @@ static void test_perf_ex_01_data_in_tc_decreasing_addresses(void)
 
 	assert(message_init(&msg) == 0);
 	assert(perf_ex_init(&perf_ex) == 0);
-	assert(perf_ex.set_tc(&perf_ex, "arm-none-eabi-") == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
 
 	test_packets = (union libswo_packet *) msg.ptr(&msg);
 
@@ -146,7 +151,7 @@ static void test_perf_ex_01_data_in_tc_decreasing_addresses(void)
 }
 
 
-static void test_perf_ex_01_data_in_tc_not_ordered_addresses_no_overlap(void) 
+static void test_perf_ex_01_data_in_elf_not_ordered_addresses_no_overlap(void) 
 {
 	message_obj msg;
 	perf_ex_obj perf_ex;
@@ -160,7 +165,7 @@ static void test_perf_ex_01_data_in_tc_not_ordered_addresses_no_overlap(void)
 
 	assert(message_init(&msg) == 0);
 	assert(perf_ex_init(&perf_ex) == 0);
-	assert(perf_ex.set_tc(&perf_ex, "arm-none-eabi-") == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
 
 	test_packets = (union libswo_packet *) msg.ptr(&msg);
 	for (unsigned int i = 0; i < msg.total_len(&msg)/sizeof(test_packet); i++) {
@@ -182,7 +187,7 @@ static void test_perf_ex_01_data_in_tc_not_ordered_addresses_no_overlap(void)
 	assert(perf_ex_fini(&perf_ex) == 0);
 }
 
-static void test_perf_ex_01_data_in_tc_not_ordered_addresses_overlap(void) 
+static void test_perf_ex_01_data_in_elf_not_ordered_addresses_overlap(void) 
 {
 	message_obj msg;
 	perf_ex_obj perf_ex;
@@ -196,7 +201,7 @@ static void test_perf_ex_01_data_in_tc_not_ordered_addresses_overlap(void)
 
 	assert(message_init(&msg) == 0);
 	assert(perf_ex_init(&perf_ex) == 0);
-	assert(perf_ex.set_tc(&perf_ex, "arm-none-eabi-") == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
 
 	test_packets = (union libswo_packet *) msg.ptr(&msg);
 	for (unsigned int i = 0; i < msg.total_len(&msg)/sizeof(test_packet); i++) {
@@ -218,15 +223,313 @@ static void test_perf_ex_01_data_in_tc_not_ordered_addresses_overlap(void)
 	assert(perf_ex_fini(&perf_ex) == 0);
 }
 
+static void test_perf_ex_01_cache_repeated_addresses(void)
+{
+	message_obj msg;
+	perf_ex_obj perf_ex;
+	union libswo_packet *test_packets;
+	union libswo_packet test_packet = {
+		.pc_sample = {
+			.type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE,
+			.size = 8,
+		}
+	};
+	unsigned int count;
+	unsigned long hits, misses;
+
+	assert(message_init(&msg) == 0);
+	assert(perf_ex_init(&perf_ex) == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
+
+	test_packets = (union libswo_packet *) msg.ptr(&msg);
+	count = msg.total_len(&msg)/sizeof(test_packet);
+
+	/* The addresses are resolved once per report */
+	perf_ex.proc_obj.req_end = true;
+	for (unsigned int i = 0; i < 2; i++) {
+		for (unsigned int j = 0; j < count; j++) {
+			test_packet.pc_sample.pc = 0x08000320 + (j % 4) * 2;
+			memcpy(&test_packets[j], &test_packet, sizeof(test_packet)); 
+		}
+
+		msg.set_length(&msg, count * sizeof(test_packet));
+		assert(perf_ex.proc_obj.data_in(&perf_ex.proc_obj, &msg) == count);
+		assert(perf_ex.proc_obj.data_out(&perf_ex.proc_obj, &msg) > 0);
+
+		assert(perf_ex.get_cache_stats(&perf_ex, &hits, &misses) == 0);
+		assert(misses == 4);
+		assert(hits == 4 * i);
+	}
+
+	assert(message_fini(&msg) == 0);
+	assert(perf_ex_fini(&perf_ex) == 0);
+}
+
+static void test_perf_ex_01_report_chunked(void)
+{
+	message_obj msg;
+	perf_ex_obj perf_ex;
+	union libswo_packet *test_packets;
+	union libswo_packet test_packet = {
+		.pc_sample = {
+			.type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE,
+			.size = 8,
+		}
+	};
+	unsigned int count, chunks = 0, funcs = 0, ends = 0;
+	char *pos;
+
+	assert(message_init(&msg) == 0);
+	assert(perf_ex_init(&perf_ex) == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
+
+	/* Sample one halfword per packet, the report exceeds one message */
+	test_packets = (union libswo_packet *) msg.ptr(&msg);
+	count = msg.total_len(&msg)/sizeof(test_packet);
+	for (unsigned int i = 0; i < count; i++) {
+		test_packet.pc_sample.pc = 0x08000050 + i * 2;
+		memcpy(&test_packets[i], &test_packet, sizeof(test_packet)); 
+	}
+
+	msg.set_length(&msg, count * sizeof(test_packet));
+	assert(perf_ex.proc_obj.data_in(&perf_ex.proc_obj, &msg) == count);
+
+	perf_ex.proc_obj.req_end = true;
+	do {
+		perf_ex.proc_obj.req_send_more = false;
+		assert(perf_ex.proc_obj.data_out(&perf_ex.proc_obj, &msg) > 0);
+		assert(msg.length(&msg) < msg.total_len(&msg));
+		chunks++;
+
+		/* Functions are never split in the middle of a line */
+		for (pos = msg.ptr(&msg); (pos = strstr(pos, "function: ")); pos++)
+			funcs++;
+		for (pos = msg.ptr(&msg); (pos = strstr(pos, "\n]")); pos++)
+			ends++;
+	} while (perf_ex.proc_obj.req_send_more);
+
+	assert(chunks > 1);
+	assert(funcs > 0);
+	assert(funcs == ends);
+
+	assert(message_fini(&msg) == 0);
+	assert(perf_ex_fini(&perf_ex) == 0);
+}
+
+static void test_perf_ex_01_window_samples(void)
+{
+	message_obj msg;
+	perf_ex_obj perf_ex;
+	union libswo_packet *test_packets;
+	union libswo_packet test_packet = {
+		.pc_sample = {
+			.type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE,
+			.size = 8,
+		}
+	};
+	unsigned int count, windows = 0;
+	char *pos;
+
+	assert(message_init(&msg) == 0);
+	assert(perf_ex_init(&perf_ex) == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
+	assert(perf_ex.set_window(&perf_ex, PERF_EX_WINDOW_SAMPLES, 0,
+				  false) == -1);
+	/* Cycle windows need the timestamps */
+	assert(perf_ex.set_window(&perf_ex, PERF_EX_WINDOW_CYCLES, 100,
+				  false) == -1);
+	assert(perf_ex.set_window(&perf_ex, PERF_EX_WINDOW_SAMPLES, 100,
+				  false) == 0);
+
+	test_packets = (union libswo_packet *) msg.ptr(&msg);
+	count = 250;
+	for (unsigned int i = 0; i < count; i++) {
+		test_packet.pc_sample.pc = 0x08000320 + (i % 4) * 2;
+		memcpy(&test_packets[i], &test_packet, sizeof(test_packet));
+	}
+
+	msg.set_length(&msg, count * sizeof(test_packet));
+	assert(perf_ex.proc_obj.data_in(&perf_ex.proc_obj, &msg) == count);
+
+	/* The full windows are printed before the end of the session */
+	perf_ex.proc_obj.req_send_more = false;
+	assert(perf_ex.proc_obj.data_out(&perf_ex.proc_obj, &msg) > 0);
+	assert(!perf_ex.proc_obj.req_send_more);
+	for (pos = msg.ptr(&msg); (pos = strstr(pos, "samples: 100 ")); pos++)
+		windows++;
+	assert(windows == count / 100);
+
+	/* Then the last one and the report */
+	perf_ex.proc_obj.req_end = true;
+	perf_ex.proc_obj.req_send_more = false;
+	assert(perf_ex.proc_obj.data_out(&perf_ex.proc_obj, &msg) > 0);
+	assert(!strncmp(msg.ptr(&msg), "window: 2 start: 200 samples: 50 ",
+			33));
+	assert(perf_ex.proc_obj.req_send_more);
+	perf_ex.proc_obj.req_send_more = false;
+	assert(perf_ex.proc_obj.data_out(&perf_ex.proc_obj, &msg) > 0);
+	assert(strstr(msg.ptr(&msg), "function: "));
+
+	assert(message_fini(&msg) == 0);
+	assert(perf_ex_fini(&perf_ex) == 0);
+}
+
+static void test_perf_ex_01_window_cycles_matrix(void)
+{
+	message_obj msg;
+	perf_ex_obj perf_ex;
+	timestamp_pkt *test_packets;
+	unsigned int count, lines = 0;
+	char *pos;
+
+	assert(message_init(&msg) == 0);
+	assert(perf_ex_init(&perf_ex) == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
+	assert(perf_ex.set_timestamped(&perf_ex, true) == 0);
+	assert(perf_ex.set_window(&perf_ex, PERF_EX_WINDOW_CYCLES, 1000,
+				  true) == 0);
+
+	/* 10 samples per window, a gap of 3 windows in the middle */
+	test_packets = (timestamp_pkt *) msg.ptr(&msg);
+	count = 100;
+	for (unsigned int i = 0; i < count; i++) {
+		memset(&test_packets[i], 0, sizeof(*test_packets));
+		test_packets[i].type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE;
+		test_packets[i].value = 0x08000320 + (i % 4) * 2;
+		test_packets[i].ts = 500 + i * 100 + ((i < 50) ? 0 : 3000);
+	}
+
+	msg.set_length(&msg, count * sizeof(*test_packets));
+	assert(perf_ex.proc_obj.data_in(&perf_ex.proc_obj, &msg) == count);
+
+	/* Nothing before the end of the session */
+	perf_ex.proc_obj.req_send_more = false;
+	assert(perf_ex.proc_obj.data_out(&perf_ex.proc_obj, &msg) == 0);
+
+	perf_ex.proc_obj.req_end = true;
+	assert(perf_ex.proc_obj.data_out(&perf_ex.proc_obj, &msg) > 0);
+	assert(!strncmp(msg.ptr(&msg), "window\tstart\tsamples\t", 21));
+	for (pos = msg.ptr(&msg); (pos = strchr(pos, '\n')); pos++)
+		lines++;
+	/* Header and 12 windows, the empty ones are skipped */
+	assert(lines == 13);
+	assert(strstr(msg.ptr(&msg), "\n0\t0\t5\t"));
+	assert(strstr(msg.ptr(&msg), "\n5\t5000\t5\t"));
+	assert(strstr(msg.ptr(&msg), "\n6\t8000\t5\t"));
+	assert(strstr(msg.ptr(&msg), "\n11\t13000\t5\t"));
+
+	assert(message_fini(&msg) == 0);
+	assert(perf_ex_fini(&perf_ex) == 0);
+}
+
+static void test_perf_ex_01_window_hist_grow(void)
+{
+	message_obj msg;
+	perf_ex_obj perf_ex;
+	timestamp_pkt *test_packets;
+	unsigned int count = 300, windows = 0, full = 0;
+	char *pos;
+
+	assert(message_init(&msg) == 0);
+	assert(perf_ex_init(&perf_ex) == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
+	assert(perf_ex.set_timestamped(&perf_ex, true) == 0);
+	assert(perf_ex.set_window(&perf_ex, PERF_EX_WINDOW_SAMPLES, 100,
+				  false) == 0);
+
+	/* More distinct pcs than the histogram first holds: it grows */
+	for (unsigned int batch = 0; batch < 2; batch++) {
+		test_packets = (timestamp_pkt *) msg.ptr(&msg);
+		for (unsigned int i = 0; i < count; i++) {
+			memset(&test_packets[i], 0, sizeof(*test_packets));
+			test_packets[i].type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE;
+			test_packets[i].value = 0x08000000 +
+						(batch * count + i) * 2;
+			test_packets[i].ts = (batch * count + i) * 10;
+		}
+
+		msg.set_length(&msg, count * sizeof(*test_packets));
+		assert(perf_ex.proc_obj.data_in(&perf_ex.proc_obj, &msg) ==
+		       count);
+	}
+
+	perf_ex.proc_obj.req_end = true;
+	do {
+		perf_ex.proc_obj.req_send_more = false;
+		msg.set_length(&msg, 0);
+		perf_ex.proc_obj.data_out(&perf_ex.proc_obj, &msg);
+		for (pos = msg.ptr(&msg); (pos = strstr(pos, "window: "));
+		     pos++) {
+			windows++;
+			full += !strncmp(strstr(pos, "samples: "),
+					 "samples: 100 ", 13);
+		}
+	} while (perf_ex.proc_obj.req_send_more);
+
+	assert((windows == 6) && (full == 6));
+
+	assert(message_fini(&msg) == 0);
+	assert(perf_ex_fini(&perf_ex) == 0);
+}
+
+static void test_perf_ex_01_idle_samples(void)
+{
+	message_obj msg;
+	perf_ex_obj perf_ex;
+	union libswo_packet *test_packets;
+	union libswo_packet test_packet = {
+		.pc_sample = {
+			.type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE,
+			.size = 8,
+		}
+	};
+	unsigned long hits, misses;
+	const char *summary = "\nsamples: 100\nidle: 25\nduty_cycle: 75.0%\n";
+
+	assert(message_init(&msg) == 0);
+	assert(perf_ex_init(&perf_ex) == 0);
+	assert(perf_ex.set_elf(&perf_ex, PERF_EX_01_ELF) == 0);
+
+	/* One sample out of four is taken while sleeping */
+	test_packets = (union libswo_packet *) msg.ptr(&msg);
+	for (unsigned int i = 0; i < 100; i++) {
+		test_packet.pc_sample.sleep = !(i % 4);
+		test_packet.pc_sample.pc = test_packet.pc_sample.sleep ?
+					   0 : 0x08000320;
+		memcpy(&test_packets[i], &test_packet, sizeof(test_packet));
+	}
+
+	msg.set_length(&msg, 100 * sizeof(test_packet));
+	assert(perf_ex.proc_obj.data_in(&perf_ex.proc_obj, &msg) == 100);
+
+	perf_ex.proc_obj.req_end = true;
+	assert(perf_ex.proc_obj.data_out(&perf_ex.proc_obj, &msg) > 0);
+	assert(!strncmp(msg.ptr(&msg), summary, strlen(summary)));
+	assert(strstr(msg.ptr(&msg), "hits: 75\n"));
+
+	/* The sleeping samples are never resolved */
+	assert(perf_ex.get_cache_stats(&perf_ex, &hits, &misses) == 0);
+	assert((hits == 0) && (misses == 1));
+
+	assert(message_fini(&msg) == 0);
+	assert(perf_ex_fini(&perf_ex) == 0);
+}
+
 static test_func ftests[] = {	
 	test_perf_ex_01_init_fini,
 	test_perf_ex_01_double_init,
 	test_perf_ex_01_double_fini,
-	test_perf_ex_01_data_in_no_tc,
-	test_perf_ex_01_data_in_tc_increasing_addresses,
-	test_perf_ex_01_data_in_tc_decreasing_addresses,
-	test_perf_ex_01_data_in_tc_not_ordered_addresses_no_overlap,
-	test_perf_ex_01_data_in_tc_not_ordered_addresses_overlap,
+	test_perf_ex_01_data_in_no_elf,
+	test_perf_ex_01_data_in_elf_increasing_addresses,
+	test_perf_ex_01_data_in_elf_decreasing_addresses,
+	test_perf_ex_01_data_in_elf_not_ordered_addresses_no_overlap,
+	test_perf_ex_01_data_in_elf_not_ordered_addresses_overlap,
+	test_perf_ex_01_cache_repeated_addresses,
+	test_perf_ex_01_report_chunked,
+	test_perf_ex_01_window_samples,
+	test_perf_ex_01_window_cycles_matrix,
+	test_perf_ex_01_window_hist_grow,
+	test_perf_ex_01_idle_samples,
 	NULL,
 };
 
@@ -0,0 +1,128 @@
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <spsc_ring.h>
+
+/** Number of bytes streamed through the ring by the threaded test */
+#define SPSC_RING_01_STREAM_LEN	(4U << 20)
+
+typedef void (*test_func) (void);
+
+static void test_spsc_ring_01_init_fini(void)
+{
+	spsc_ring ring;
+
+	assert(spsc_ring_init(&ring, 1000) == -1);
+	assert(spsc_ring_init(&ring, 1024) == 0);
+	assert(spsc_ring_count(&ring) == 0);
+	spsc_ring_fini(&ring);
+}
+
+static void test_spsc_ring_01_full_wrap(void)
+{
+	spsc_ring ring;
+	char in[48], out[48];
+
+	for (unsigned int i = 0; i < sizeof(in); i++) {
+		in[i] = (char) i;
+	}
+
+	assert(spsc_ring_init(&ring, 64) == 0);
+
+	/* Fill, then wrap around the end of the storage */
+	assert(spsc_ring_write(&ring, in, sizeof(in)) == sizeof(in));
+	assert(spsc_ring_write(&ring, in, sizeof(in)) == 64 - sizeof(in));
+	assert(spsc_ring_count(&ring) == 64);
+
+	assert(spsc_ring_read(&ring, out, sizeof(out)) == sizeof(out));
+	assert(!memcmp(in, out, sizeof(in)));
+	assert(spsc_ring_write(&ring, in, sizeof(in)) == sizeof(in));
+
+	assert(spsc_ring_read(&ring, out, 16) == 16);
+	assert(!memcmp(in, out, 16));
+	assert(spsc_ring_read(&ring, out, sizeof(out)) == sizeof(out));
+	assert(!memcmp(in, out, sizeof(in)));
+	assert(spsc_ring_read(&ring, out, sizeof(out)) == 0);
+
+	spsc_ring_fini(&ring);
+}
+
+static void *spsc_ring_01_producer(void *arg)
+{
+	spsc_ring *ring = (spsc_ring *) arg;
+	unsigned int pos = 0;
+	size_t len;
+	char *ptr;
+
+	while (pos < SPSC_RING_01_STREAM_LEN) {
+		if (!(len = spsc_ring_write_region(ring, &ptr))) {
+			sched_yield();
+			continue;
+		}
+
+		if (len > (SPSC_RING_01_STREAM_LEN - pos)) {
+			len = SPSC_RING_01_STREAM_LEN - pos;
+		}
+
+		for (size_t i = 0; i < len; i++) {
+			ptr[i] = (char) (pos + i);
+		}
+
+		spsc_ring_commit(ring, len);
+		pos += len;
+	}
+
+	return NULL;
+}
+
+static void test_spsc_ring_01_threads(void)
+{
+	spsc_ring ring;
+	pthread_t producer;
+	unsigned int pos = 0;
+	char out[333];
+	size_t n;
+
+	assert(spsc_ring_init(&ring, 4096) == 0);
+	assert(pthread_create(&producer, NULL, spsc_ring_01_producer,
+			      &ring) == 0);
+
+	/* Bytes come out in order, none lost nor duplicated */
+	while (pos < SPSC_RING_01_STREAM_LEN) {
+		if (!(n = spsc_ring_read(&ring, out, sizeof(out)))) {
+			sched_yield();
+			continue;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			assert(out[i] == (char) (pos + i));
+		}
+		pos += n;
+	}
+
+	assert(pthread_join(producer, NULL) == 0);
+	assert(spsc_ring_count(&ring) == 0);
+	spsc_ring_fini(&ring);
+}
+
+static test_func ftests[] = {
+	test_spsc_ring_01_init_fini,
+	test_spsc_ring_01_full_wrap,
+	test_spsc_ring_01_threads,
+	NULL,
+};
+
+int main(void)
+{
+	unsigned int i = 0;
+
+	while (ftests[i]) {
+		ftests[i++]();
+	}
+
+	return 0;
+}
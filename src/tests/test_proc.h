@@ -0,0 +1,52 @@
+/*****************************************************************
+ * file: test_proc.h
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Helpers of the tests of the processing objects.
+ *****************************************************************/
+#ifndef __TEST_PROC_H__
+#define __TEST_PROC_H__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <message.h>
+#include <processing.h>
+
+/**
+ * @brief Feed a buffer to the object, then collect what it writes until it
+ *		does not ask to send more.
+ * @param proc The processing object.
+ * @param buf Input of the object.
+ * @param len Length of the input.
+ * @param end Set the end of the session before collecting the output.
+ * @return The output as a string, to be freed.
+ */
+static inline char *test_proc_run(processing_obj * const proc,
+				  const void * const buf, size_t len, bool end)
+{
+	message_obj msg;
+	char *text = NULL;
+	size_t text_len = 0, n;
+
+	assert(message_init(&msg) == 0);
+	msg.write(&msg, (char *) buf, len);
+	assert(proc->data_in(proc, &msg) == len);
+
+	proc->req_end = end;
+	do {
+		proc->req_send_more = false;
+		msg.set_length(&msg, 0);
+		n = proc->data_out(proc, &msg);
+		assert((text = realloc(text, text_len + n + 1)));
+		memcpy(&text[text_len], msg.ptr(&msg), n);
+		text_len += n;
+	} while (proc->req_send_more);
+
+	text[text_len] = '\0';
+	assert(message_fini(&msg) == 0);
+	return text;
+}
+
+#endif /* __TEST_PROC_H__ */
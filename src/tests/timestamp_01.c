@@ -0,0 +1,180 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common-macros.h>
+#include <config.h>
+#include <message.h>
+#include <timestamp.h>
+
+#include <libswo/libswo.h>
+
+typedef void (*test_func) (void);
+
+/**
+ * @brief Feed the packets to the object and collect its output.
+ * @return The number of timestamped packets written to out.
+ */
+static size_t timestamp_01_run(timestamp_obj * const ts,
+			       const union libswo_packet * const pkts,
+			       size_t count, timestamp_pkt * const out,
+			       size_t out_len, bool end)
+{
+	processing_obj *proc = (processing_obj *) ts;
+	message_obj msg;
+	size_t n = 0, len;
+
+	assert(message_init(&msg) == 0);
+	msg.write(&msg, (char *) pkts, count * sizeof(*pkts));
+	assert(proc->data_in(proc, &msg) == count * sizeof(*pkts));
+
+	proc->req_end = end;
+	do {
+		proc->req_send_more = false;
+		msg.set_length(&msg, 0);
+		len = proc->data_out(proc, &msg);
+		assert(!(len % sizeof(timestamp_pkt)));
+		assert((n + len / sizeof(timestamp_pkt)) <= out_len);
+		memcpy(&out[n], msg.ptr(&msg), len);
+		n += len / sizeof(timestamp_pkt);
+	} while (proc->req_send_more);
+
+	assert(message_fini(&msg) == 0);
+	return n;
+}
+
+static void test_timestamp_01_init_fini(void)
+{
+	timestamp_obj ts;
+
+	assert(timestamp_init(&ts) == 0);
+	assert(timestamp_init(&ts) == -1);
+	assert(timestamp_fini(&ts) == 0);
+	assert(timestamp_fini(&ts) == -1);
+}
+
+static void test_timestamp_01_lts(void)
+{
+	timestamp_obj ts;
+	timestamp_pkt out[8];
+	union libswo_packet pkts[] = {
+		{ .pc_sample = { .type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE,
+				 .pc = 0x08000100 } },
+		{ .lts = { .type = LIBSWO_PACKET_TYPE_LTS, .value = 10 } },
+		{ .pc_sample = { .type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE,
+				 .pc = 0x08000200 } },
+		{ .exctrc = { .type = LIBSWO_PACKET_TYPE_DWT_EXCTRC,
+			      .exception = 15,
+			      .function = LIBSWO_EXCTRC_FUNC_ENTER } },
+		{ .lts = { .type = LIBSWO_PACKET_TYPE_LTS, .value = 5,
+			   .relation = LIBSWO_LTS_REL_TS } },
+		{ .pc_sample = { .type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE,
+				 .pc = 0x08000300 } },
+	};
+
+	assert(timestamp_init(&ts) == 0);
+	assert(ts.set_lts_prescaler(&ts, 4) == 0);
+
+	/* The last sample waits for its LTS */
+	assert(timestamp_01_run(&ts, pkts, ARRAY_SIZE(pkts), out,
+				ARRAY_SIZE(out), false) == 3);
+	assert((out[0].ts == 40) && (out[0].value == 0x08000100));
+	assert(!out[0].flags);
+	assert((out[1].ts == 60) && (out[1].value == 0x08000200));
+	assert((out[2].ts == 60) && (out[2].value == 15));
+	assert(out[2].type == LIBSWO_PACKET_TYPE_DWT_EXCTRC);
+	assert(out[2].arg == LIBSWO_EXCTRC_FUNC_ENTER);
+	assert(out[2].flags & TIMESTAMP_PKT_DELAYED);
+
+	/* Released without LTS at the end of the session */
+	assert(timestamp_01_run(&ts, pkts, 0, out, ARRAY_SIZE(out), true) ==
+	       1);
+	assert((out[0].ts == 60) && (out[0].value == 0x08000300));
+	assert(out[0].flags & TIMESTAMP_PKT_DELAYED);
+
+	assert(timestamp_fini(&ts) == 0);
+}
+
+static void test_timestamp_01_gts(void)
+{
+	timestamp_obj ts;
+	timestamp_pkt out[8];
+	union libswo_packet pkts[] = {
+		{ .gts1 = { .type = LIBSWO_PACKET_TYPE_GTS1,
+			    .value = 1000 } },
+		{ .hw = { .type = LIBSWO_PACKET_TYPE_HW, .address = 1,
+			  .value = 0xaa } },
+		{ .lts = { .type = LIBSWO_PACKET_TYPE_LTS, .value = 1 } },
+		/* New high bits: nothing changes until the GTS2 */
+		{ .gts1 = { .type = LIBSWO_PACKET_TYPE_GTS1, .value = 7,
+			    .wrap = true } },
+		{ .hw = { .type = LIBSWO_PACKET_TYPE_HW, .address = 2,
+			  .value = 0xbb } },
+		{ .lts = { .type = LIBSWO_PACKET_TYPE_LTS, .value = 1 } },
+		{ .gts2 = { .type = LIBSWO_PACKET_TYPE_GTS2, .value = 1 } },
+		{ .hw = { .type = LIBSWO_PACKET_TYPE_HW, .address = 3,
+			  .value = 0xcc } },
+		{ .lts = { .type = LIBSWO_PACKET_TYPE_LTS, .value = 1 } },
+		/* Behind the current time: ignored */
+		{ .gts1 = { .type = LIBSWO_PACKET_TYPE_GTS1, .value = 0 } },
+		{ .hw = { .type = LIBSWO_PACKET_TYPE_HW, .address = 4,
+			  .value = 0xdd } },
+		{ .lts = { .type = LIBSWO_PACKET_TYPE_LTS, .value = 1 } },
+	};
+
+	assert(timestamp_init(&ts) == 0);
+	assert(timestamp_01_run(&ts, pkts, ARRAY_SIZE(pkts), out,
+				ARRAY_SIZE(out), true) == 4);
+	assert((out[0].ts == 1001) && (out[0].arg == 1));
+	assert((out[1].ts == 1002) && (out[1].arg == 2));
+	assert((out[2].ts == ((1ULL << 26) | 7) + 1) && (out[2].arg == 3));
+	assert((out[3].ts == ((1ULL << 26) | 7) + 2) && (out[3].arg == 4));
+	assert(out[3].value == 0xdd);
+
+	assert(timestamp_fini(&ts) == 0);
+}
+
+static void test_timestamp_01_no_lts(void)
+{
+	timestamp_obj ts;
+	static timestamp_pkt out[2 * TIMESTAMP_PENDING_MAX];
+	static union libswo_packet pkts[TIMESTAMP_PENDING_MAX + 1];
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(pkts); i++) {
+		pkts[i].pc_sample.type = LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE;
+		pkts[i].pc_sample.pc = 0x08000000 + i * 2;
+	}
+
+	assert(timestamp_init(&ts) == 0);
+
+	/* Never held more than TIMESTAMP_PENDING_MAX packets */
+	assert(timestamp_01_run(&ts, pkts, ARRAY_SIZE(pkts), out,
+				ARRAY_SIZE(out), false) ==
+	       TIMESTAMP_PENDING_MAX);
+	for (unsigned int i = 0; i < TIMESTAMP_PENDING_MAX; i++) {
+		assert(out[i].flags & TIMESTAMP_PKT_DELAYED);
+		assert(out[i].value == pkts[i].pc_sample.pc);
+	}
+
+	assert(timestamp_fini(&ts) == 0);
+}
+
+static test_func ftests[] = {
+	test_timestamp_01_init_fini,
+	test_timestamp_01_lts,
+	test_timestamp_01_gts,
+	test_timestamp_01_no_lts,
+	NULL,
+};
+
+int main(void)
+{
+	unsigned int i = 0;
+
+	while (ftests[i]) {
+		ftests[i++]();
+	}
+
+	return 0;
+}
@@ -0,0 +1,413 @@
+/*****************************************************************
+ * file: timestamp.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Timestamp processing object. It receives the libswo packets of
+ * 		the decoder, local and global timestamps included, and gives
+ * 		each of the other packets its time in cycles. The output is an
+ * 		array of timestamp_pkt.
+ *
+ * 		A local timestamp (LTS) packet follows the packets it
+ * 		timestamps and holds the ticks elapsed since the previous one,
+ * 		a tick being lts_prescaler cycles. The packets are held until
+ * 		the LTS following them arrives. When the relation of the LTS is
+ * 		not synchronous, the target delayed either the timestamp or the
+ * 		packets: they are flagged TIMESTAMP_PKT_DELAYED.
+ *
+ * 		The global timestamps give the absolute time: GTS1 carries the
+ * 		low TIMESTAMP_GTS1_BITS bits, GTS2 the high ones. A GTS1 with
+ * 		the wrap flag set announces new high bits, the time is only
+ * 		updated once the GTS2 holding them arrives. The time never goes
+ * 		backward: a global timestamp behind the time reached with the
+ * 		local timestamps is ignored.
+ *
+ * 		If no LTS comes, e.g. the local timestamps are disabled on the
+ * 		target, the packets are released with the current time and
+ * 		flagged TIMESTAMP_PKT_DELAYED once TIMESTAMP_PENDING_MAX of
+ * 		them are held, and at the end of the session.
+ *****************************************************************/
+#include <config.h>
+#include <debug.h>
+#include <message.h>
+#include <timestamp.h>
+
+#include <libswo/libswo.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Bits of the global timestamp carried by GTS1 */
+#define TIMESTAMP_GTS1_BITS		26U
+
+/** Private data of the timestamp object */
+typedef struct {
+	/** Check if the object is initialized to avoid double init/fini */
+	bool		is_init;
+	/** Current time in cycles */
+	uint64_t	now;
+	/** Cycles per local timestamp tick */
+	unsigned int	lts_prescaler;
+	/** Low bits of the global timestamp, from the last GTS1 */
+	uint32_t	gts_low;
+	/** High bits of the global timestamp, from the last GTS2 */
+	uint64_t	gts_high;
+	/** A GTS1 announced new high bits, waiting for the GTS2 */
+	bool		is_gts_wrap;
+	/** Packets waiting for the LTS following them */
+	timestamp_pkt	pending[TIMESTAMP_PENDING_MAX];
+	/** Number of packets waiting */
+	size_t		pending_count;
+	/** Timestamped packets not sent yet */
+	timestamp_pkt	*out;
+	/** Number of timestamped packets */
+	size_t		out_count;
+	/** Next timestamped packet to send */
+	size_t		out_next;
+	/** Number of packets out can hold */
+	size_t		out_cap;
+	/** Number of packets released without their LTS */
+	unsigned long	unconfirmed;
+} timestamp_private_data;
+
+static timestamp_private_data timestamp_priv_data;
+
+/**
+ * @brief Squeeze a libswo packet in a timestamp_pkt.
+ * @param pkt The libswo packet.
+ * @param tpkt The packet filled, its time is not set.
+ * @return true if the packet is kept, false for the synchronisation and
+ *		unknown packets.
+ */
+static bool timestamp_pkt_set(const union libswo_packet * const pkt,
+			      timestamp_pkt * const tpkt)
+{
+	memset(tpkt, 0, sizeof(*tpkt));
+	tpkt->type = pkt->type;
+
+	switch (pkt->type) {
+	case LIBSWO_PACKET_TYPE_OF:
+		break;
+	case LIBSWO_PACKET_TYPE_EXT:
+		tpkt->arg = pkt->ext.source;
+		tpkt->value = pkt->ext.value;
+		break;
+	case LIBSWO_PACKET_TYPE_INST:
+	case LIBSWO_PACKET_TYPE_HW:
+		/* Both share the layout of the hardware source packet */
+		tpkt->arg = pkt->hw.address;
+		tpkt->size = pkt->hw.size;
+		tpkt->value = pkt->hw.value;
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_EVTCNT:
+		tpkt->arg = (pkt->evtcnt.cpi ? TIMESTAMP_PKT_EVT_CPI : 0) |
+			    (pkt->evtcnt.exc ? TIMESTAMP_PKT_EVT_EXC : 0) |
+			    (pkt->evtcnt.sleep ? TIMESTAMP_PKT_EVT_SLEEP : 0) |
+			    (pkt->evtcnt.lsu ? TIMESTAMP_PKT_EVT_LSU : 0) |
+			    (pkt->evtcnt.fold ? TIMESTAMP_PKT_EVT_FOLD : 0) |
+			    (pkt->evtcnt.cyc ? TIMESTAMP_PKT_EVT_CYC : 0);
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_EXCTRC:
+		tpkt->arg = pkt->exctrc.function;
+		tpkt->value = pkt->exctrc.exception;
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_PC_SAMPLE:
+		tpkt->arg = pkt->pc_sample.sleep;
+		tpkt->value = pkt->pc_sample.pc;
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_PC_VALUE:
+		tpkt->arg = pkt->pc_value.cmpn;
+		tpkt->value = pkt->pc_value.pc;
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_ADDR_OFFSET:
+		tpkt->arg = pkt->addr_offset.cmpn;
+		tpkt->value = pkt->addr_offset.offset;
+		break;
+	case LIBSWO_PACKET_TYPE_DWT_DATA_VALUE:
+		tpkt->arg = pkt->data_value.cmpn;
+		tpkt->size = pkt->data_value.size;
+		tpkt->value = pkt->data_value.data_value;
+		tpkt->flags = pkt->data_value.wnr ? TIMESTAMP_PKT_WNR : 0;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Release the waiting packets with the current time.
+ * @param pdata Private data.
+ * @param flags Flags added to the packets.
+ */
+static void timestamp_release(timestamp_private_data * const pdata,
+			      uint8_t flags)
+{
+	timestamp_pkt *tpkt;
+
+	for (size_t i = 0; i < pdata->pending_count; i++) {
+		tpkt = &pdata->out[pdata->out_count++];
+		*tpkt = pdata->pending[i];
+		tpkt->ts = pdata->now;
+		tpkt->flags |= flags;
+	}
+
+	pdata->pending_count = 0;
+}
+
+/**
+ * @brief Move the time to the global timestamp, if it is ahead.
+ * @param pdata Private data.
+ */
+static void timestamp_set_global(timestamp_private_data * const pdata)
+{
+	uint64_t global = (pdata->gts_high << TIMESTAMP_GTS1_BITS) |
+			  pdata->gts_low;
+
+	if (global > pdata->now) {
+		pdata->now = global;
+	}
+}
+
+/**
+ * @brief Timestamp one packet.
+ * @param pdata Private data.
+ * @param pkt The libswo packet.
+ */
+static void timestamp_add(timestamp_private_data * const pdata,
+			  const union libswo_packet * const pkt)
+{
+	switch (pkt->type) {
+	case LIBSWO_PACKET_TYPE_LTS:
+		pdata->now += (uint64_t) pkt->lts.value * pdata->lts_prescaler;
+		timestamp_release(pdata,
+				  (pkt->lts.relation == LIBSWO_LTS_REL_SYNC) ?
+				  0 : TIMESTAMP_PKT_DELAYED);
+		break;
+	case LIBSWO_PACKET_TYPE_GTS1:
+		pdata->gts_low = pkt->gts1.value &
+				 ((1U << TIMESTAMP_GTS1_BITS) - 1);
+		if (pkt->gts1.wrap) {
+			pdata->is_gts_wrap = true;
+		} else if (!pdata->is_gts_wrap) {
+			timestamp_set_global(pdata);
+		}
+		break;
+	case LIBSWO_PACKET_TYPE_GTS2:
+		pdata->gts_high = pkt->gts2.value;
+		pdata->is_gts_wrap = false;
+		timestamp_set_global(pdata);
+		break;
+	default:
+		if (!timestamp_pkt_set(pkt,
+				       &pdata->pending[pdata->pending_count])) {
+			break;
+		}
+
+		if (++pdata->pending_count == TIMESTAMP_PENDING_MAX) {
+			pdata->unconfirmed += pdata->pending_count;
+			timestamp_release(pdata, TIMESTAMP_PKT_DELAYED);
+		}
+		break;
+	}
+}
+
+/**
+ * @brief This is the receiving callback, it timestamps the libswo packets of
+ *		the message. The packets following the last LTS are kept for
+ *		the next call.
+ * @param proc_obj Processing obj abstraction.
+ * @param msg Message containing a table of union libswo_packet.
+ * @return The number of bytes read, -1 upon error.
+ */
+static size_t
+timestamp_data_in(processing_obj * const proc_obj, message_obj * const msg)
+{
+	timestamp_obj *obj = (timestamp_obj *) proc_obj;
+	timestamp_private_data *pdata = (timestamp_private_data *) obj->pdata;
+	const union libswo_packet *packets =
+				(const union libswo_packet *) msg->ptr(msg);
+	size_t pkt_count = msg->length(msg) / sizeof(union libswo_packet);
+	timestamp_pkt *out;
+
+	/* The previous packets were all sent, data_out runs until then */
+	pdata->out_count = 0;
+	pdata->out_next = 0;
+
+	/* At most all the packets, and the waiting ones, are released */
+	if ((pkt_count + TIMESTAMP_PENDING_MAX) > pdata->out_cap) {
+		out = realloc(pdata->out, (pkt_count + TIMESTAMP_PENDING_MAX) *
+					  sizeof(*out));
+		if (!out) {
+			ERROR("Could not allocate memory\n");
+			return -1;
+		}
+
+		pdata->out = out;
+		pdata->out_cap = pkt_count + TIMESTAMP_PENDING_MAX;
+	}
+
+	for (size_t i = 0; i < pkt_count; i++) {
+		timestamp_add(pdata, &packets[i]);
+	}
+
+	proc_obj->stats.packets += pkt_count;
+	return pkt_count * sizeof(union libswo_packet);
+}
+
+/**
+ * @brief This is the sending callback, it writes the timestamped packets.
+ *		req_send_more is set when they do not fit in one message. At
+ *		the end of the session, the waiting packets are released.
+ * @param proc_obj Processing obj abstraction.
+ * @param msg Message where the table of timestamp_pkt is written.
+ * @return The number of bytes written.
+ */
+static size_t
+timestamp_data_out(processing_obj * const proc_obj, message_obj * const msg)
+{
+	timestamp_obj *obj = (timestamp_obj *) proc_obj;
+	timestamp_private_data *pdata = (timestamp_private_data *) obj->pdata;
+	size_t count;
+
+	if (proc_obj->req_end && pdata->pending_count && pdata->out) {
+		pdata->unconfirmed += pdata->pending_count;
+		timestamp_release(pdata, TIMESTAMP_PKT_DELAYED);
+	}
+
+	count = msg->total_len(msg) / sizeof(timestamp_pkt);
+	if (count > (pdata->out_count - pdata->out_next)) {
+		count = pdata->out_count - pdata->out_next;
+	}
+
+	msg->write(msg, (void *) &pdata->out[pdata->out_next],
+		   count * sizeof(timestamp_pkt));
+	pdata->out_next += count;
+	proc_obj->req_send_more = (pdata->out_next != pdata->out_count);
+
+	return count * sizeof(timestamp_pkt);
+}
+
+/**
+ * @brief Set the number of cycles per local timestamp tick, it matches the
+ *		prescaler of the ITM (1, 4, 16 or 64).
+ * @param obj The timestamp object.
+ * @param prescaler Cycles per tick.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int timestamp_set_lts_prescaler(timestamp_obj * const obj,
+				       unsigned int prescaler)
+{
+	timestamp_private_data *pdata = (timestamp_private_data *) obj->pdata;
+
+	if (!prescaler) {
+		ERROR("Invalid local timestamp prescaler\n");
+		return -1;
+	}
+
+	pdata->lts_prescaler = prescaler;
+	return 0;
+}
+
+/**
+ * @brief Set the number of cycles per local timestamp tick from the
+ *		configuration, it is left untouched if not configured.
+ * @param obj The timestamp object.
+ * @pre The config object must be initialized.
+ * @return 0 upon success, -1 otherwise.
+ */
+static int timestamp_set_lts_prescaler_gbl_config(timestamp_obj * const obj)
+{
+	cfg_param param = {
+				.section = CFG_SECTION_TIMESTAMP,
+				.type = CONFIG_UNSIGNED_INT,
+				.name = CFG_SECTION_TIMESTAMP_LTS_PRESCALER,
+			  };
+	unsigned int prescaler;
+
+	prescaler = CONFIG_HELPER_GET_U32(&param);
+	if (!param.found) {
+		return 0;
+	}
+
+	DEBUG("\t-local timestamp prescaler: %u\n", prescaler);
+	return timestamp_set_lts_prescaler(obj, prescaler);
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @return -1.
+ */
+static int timestamp_set_lts_prescaler_default(timestamp_obj * const obj,
+					       unsigned int prescaler)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
+/**
+ * @brief Default function in case of acessing a deinitialized object.
+ * @return -1.
+ */
+static int
+timestamp_set_lts_prescaler_gbl_config_default(timestamp_obj * const obj)
+{
+	WARNING("Not initialized\n");
+	return -1;
+}
+
+int timestamp_init(timestamp_obj * const obj)
+{
+	processing_obj *proc_obj = (processing_obj *) obj;
+	timestamp_private_data *pdata = &timestamp_priv_data;
+
+	if (pdata->is_init) {
+		ERROR("Cannot initialize more than one instance\n");
+		return -1;
+	}
+
+	if (processing_init(proc_obj)) {
+		return -1;
+	}
+
+	proc_obj->name = "timestamp";
+	obj->pdata = (void *) pdata;
+	obj->set_lts_prescaler = timestamp_set_lts_prescaler;
+	obj->set_lts_prescaler_gbl_config =
+				timestamp_set_lts_prescaler_gbl_config;
+
+	proc_obj->data_in = timestamp_data_in;
+	proc_obj->data_out = timestamp_data_out;
+
+	memset(pdata, 0, sizeof(*pdata));
+	pdata->lts_prescaler = 1;
+	pdata->is_init = true;
+
+	return 0;
+}
+
+int timestamp_fini(timestamp_obj * const obj)
+{
+	timestamp_private_data *pdata = &timestamp_priv_data;
+
+	if (!pdata->is_init) {
+		ERROR("Not initialized\n");
+		return -1;
+	}
+
+	if (pdata->unconfirmed) {
+		WARNING("%lu packets without local timestamp\n",
+			pdata->unconfirmed);
+	}
+
+	obj->set_lts_prescaler = timestamp_set_lts_prescaler_default;
+	obj->set_lts_prescaler_gbl_config =
+				timestamp_set_lts_prescaler_gbl_config_default;
+
+	free(pdata->out);
+	pdata->out = NULL;
+
+	processing_fini((processing_obj *) obj);
+	pdata->is_init = false;
+	return 0;
+}
@@ -26,8 +26,10 @@
 
 /* time for timeout (could use poll or select) */
 #include <sys/time.h>
+#include <time.h>
 
 #include <uart.h>
+#include <uart_baudrate.h>
 
 /* Common macros */
 #include <common-macros.h>
@@ -49,6 +51,13 @@
 
 #include <poll.h>
 
+/* reader thread */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+#include <spsc_ring.h>
+
 #define SYNC_DWT_TRACE 		((char) 0x00)
 #define SYNC_DWT_END 		((char) 0x80)
 
@@ -63,7 +72,8 @@
 #define ADD_BAUDRATE(a,b) { .term_val = a, .user_val = b }
 /**
  * This structure holds information regarding the baudrate translation
- * between termios and user 
+ * between termios and user. Other rates are set with termios2 when the
+ * platform supports it.
  */
 struct {
 	/** This is the take from the GLIBC library termios */
@@ -72,6 +82,20 @@ struct {
 	unsigned int user_val;
 } uart_baudrate_tbl[] = {
 	ADD_BAUDRATE(B115200, 115200),
+	ADD_BAUDRATE(B9600, 9600),
+	ADD_BAUDRATE(B19200, 19200),
+	ADD_BAUDRATE(B38400, 38400),
+	ADD_BAUDRATE(B57600, 57600),
+	ADD_BAUDRATE(B230400, 230400),
+#ifdef B4000000
+	ADD_BAUDRATE(B460800, 460800),
+	ADD_BAUDRATE(B921600, 921600),
+	ADD_BAUDRATE(B1000000, 1000000),
+	ADD_BAUDRATE(B1500000, 1500000),
+	ADD_BAUDRATE(B2000000, 2000000),
+	ADD_BAUDRATE(B3000000, 3000000),
+	ADD_BAUDRATE(B4000000, 4000000),
+#endif /* B4000000 */
 };
 
 /** TODO create a common interface file and uart */
@@ -89,6 +113,24 @@ typedef struct  {
 	/** If open (open was called) */
 	bool is_open;
 	/** Manage multi thread concurency */
+	/** Thread draining the device into the ring */
+	pthread_t reader;
+	/** If the reader thread was started */
+	bool is_reading;
+	/** Request the reader thread to stop */
+	atomic_bool stop_reader;
+	/** Set by the reader thread when it exits */
+	atomic_bool reader_done;
+	/** Bytes read by the reader thread, consumed by uart_receive */
+	spsc_ring ring;
+	/** Signaled by the reader thread each time bytes are committed */
+	struct pollfd efd;
+	/** Bytes dropped because the ring was full */
+	atomic_ulong dropped;
+	/** Bytes a message is filled with, 0 for the whole message */
+	size_t fill;
+	/** Longest wait for the fill once the first byte arrived */
+	unsigned int fill_deadline_ms;
 } uart_private_data;
 
 static uart_private_data uarts_instances[UART_DEV_COUNT_MAX] = {0};
@@ -119,12 +161,48 @@ static void uart_free_instance(uart_obj * const uart)
 	memset(uartpd, 0, sizeof(*uartpd));
 }
 
+/**
+ * \brief Check the baudrate applied by the driver, it is rounded to the
+ *	  closest divisor of the UART clock.
+ * \param baudrate: Baudrate requested.
+ * \param applied: Baudrate read back from the driver.
+ * \return 0 if the rate is within UART_BAUDRATE_TOLERANCE_PCT, -1 otherwise.
+ */
+static int uart_check_baudrate(unsigned int baudrate, unsigned int applied)
+{
+	unsigned long long diff = (applied > baudrate) ?
+				  (applied - baudrate) : (baudrate - applied);
+
+	if ((diff * 100) > ((unsigned long long) baudrate *
+			    UART_BAUDRATE_TOLERANCE_PCT)) {
+		ERROR("Baudrate %u requested, %u applied by the driver\n",
+		      baudrate, applied);
+		return -1;
+	}
+
+	if (diff) {
+		WARNING("Baudrate %u requested, %u applied by the driver\n",
+			baudrate, applied);
+	}
+
+	return 0;
+}
+
 /* As for now, it only set the baudrate to be enhanced */
 static int uart_set_baudrate(uart_obj * const uart, unsigned int baudrate)
 {
 	uart_private_data * const uartpd = uart->pdata;
-	unsigned int default_br = uart_baudrate_tbl[0].term_val;
+	/* Placeholder for the rates only termios2 can set */
+	unsigned int default_br = B38400;
+	bool is_standard = false;
+	unsigned int applied;
+
 	DEBUG("Setting baudrate %d \n", baudrate);
+	if (!baudrate) {
+		ERROR("Invalid baudrate 0\n");
+		return -1;
+	}
+
         if (tcgetattr (uartpd->pfd.fd, &uartpd->tty) != 0) {
                 ERROR("error %d from tcgetattr", errno);
                 return -1;
@@ -133,6 +211,7 @@ static int uart_set_baudrate(uart_obj * const uart, unsigned int baudrate)
 	for (unsigned int i = 0; i < ARRAY_SIZE(uart_baudrate_tbl); i++) {
 		if (baudrate == uart_baudrate_tbl[i].user_val) {
 			default_br = uart_baudrate_tbl[i].term_val;
+			is_standard = true;
 			break;
 		}	
 	}
@@ -151,6 +230,23 @@ static int uart_set_baudrate(uart_obj * const uart, unsigned int baudrate)
                 return -1;
         }
 
+	/* The exact rate, e.g. 2, 4 or 6 Mbaud, is set with termios2 */
+	if (uart_baudrate_set(uartpd->pfd.fd, baudrate) ||
+	    uart_baudrate_get(uartpd->pfd.fd, &applied)) {
+		if (!is_standard) {
+			ERROR("Baudrate %u not supported\n", baudrate);
+			return -1;
+		}
+
+		DEBUG("Standard baudrate %u set with termios\n", baudrate);
+		return 0;
+	}
+
+	if (uart_check_baudrate(baudrate, applied)) {
+		return -1;
+	}
+
+	DEBUG("Baudrate applied %u\n", applied);
 	return 0;
 }
 
@@ -178,12 +274,129 @@ static int uart_open(uart_obj * const uart)
 	if (uartpd->pfd.fd < 0) {
 		ERROR("Device %s error while opening: %s\n",
 		      uartpd->dev_path, strerror(errno));
-		return -1;
+		goto open_failed;
+	}
+
+	uartpd->efd.fd = eventfd(0, EFD_NONBLOCK);
+	if (uartpd->efd.fd < 0) {
+		ERROR("Could not create eventfd: %s\n", strerror(errno));
+		goto eventfd_failed;
+	}
+
+	if (spsc_ring_init(&uartpd->ring, UART_RING_SZ)) {
+		goto ring_init_failed;
 	}
 
 	uartpd->pfd.events = POLLIN|POLLPRI;
+	uartpd->efd.events = POLLIN;
+	uartpd->is_reading = false;
 	uartpd->is_open = 1;
 
+	return 0;
+ring_init_failed:
+	close(uartpd->efd.fd);
+eventfd_failed:
+	close(uartpd->pfd.fd);
+open_failed:
+	return -1;
+}
+
+/**
+ * \brief Wake up the consumer waiting on the eventfd.
+ * \param pdata: UART private data.
+ */
+static void uart_reader_notify(uart_private_data * const pdata)
+{
+	const uint64_t one = 1;
+
+	/* A saturated counter still wakes up the consumer */
+	if (write(pdata->efd.fd, &one, sizeof(one)) < 0) {
+		DEBUG("eventfd not written: %s\n", strerror(errno));
+	}
+}
+
+/**
+ * \brief Reader thread: it drains the device into the ring so the tty buffer
+ *	  does not overrun while the pipeline decodes. When the ring is full
+ *	  the bytes are still read from the device and accounted as dropped.
+ * \param arg: UART private data.
+ */
+static void *uart_reader(void *arg)
+{
+	uart_private_data * const pdata = (uart_private_data *) arg;
+	char discard[UART_INTERNAL_BUF_LEN_MAX];
+	ssize_t readd;
+	size_t len;
+	char *ptr;
+	int rc;
+
+	while (!atomic_load(&pdata->stop_reader)) {
+		rc = poll(&pdata->pfd, 1, UART_TIMEOUT_MS);
+		if (-1 == rc) {
+			if (errno == EINTR)
+				continue;
+
+			ERROR("Error while polling %s\n", strerror(errno));
+			break;
+		}
+
+		if (!rc)
+			continue;
+
+		if (!(pdata->pfd.revents & POLLIN)) {
+			WARNING("Invalid event!\n");
+			break;
+		}
+
+		if (!(len = spsc_ring_write_region(&pdata->ring, &ptr))) {
+			ptr = discard;
+			len = sizeof(discard);
+		}
+
+		readd = read(pdata->pfd.fd, ptr, len);
+		if (readd < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+
+			ERROR("Error while reading %s\n", strerror(errno));
+			break;
+		}
+
+		if (ptr == discard) {
+			atomic_fetch_add(&pdata->dropped, readd);
+			continue;
+		}
+
+		spsc_ring_commit(&pdata->ring, readd);
+		uart_reader_notify(pdata);
+	}
+
+	atomic_store(&pdata->reader_done, true);
+	uart_reader_notify(pdata);
+
+	return NULL;
+}
+
+/**
+ * \brief Start the reader thread, this is done on the first receive so the
+ *	  baudrate is already set.
+ * \param pdata: UART private data.
+ */
+static int uart_start_reader(uart_private_data * const pdata)
+{
+	int rc;
+
+	atomic_store(&pdata->stop_reader, false);
+	atomic_store(&pdata->reader_done, false);
+	atomic_store(&pdata->dropped, 0);
+
+	rc = pthread_create(&pdata->reader, NULL, uart_reader, pdata);
+	if (rc) {
+		ERROR("Could not start reader thread: %s\n", strerror(rc));
+		return -1;
+	}
+
+	pdata->is_reading = true;
 	return 0;
 }
 
@@ -198,7 +411,22 @@ static int uart_close(uart_obj * const uart)
 		      uartpd->dev_path);
 		return -1;
 	}
+
+	if (uartpd->is_reading) {
+		atomic_store(&uartpd->stop_reader, true);
+		pthread_join(uartpd->reader, NULL);
+		uartpd->is_reading = false;
+	}
+
+	if (atomic_load(&uartpd->dropped)) {
+		WARNING("Device %s: %lu bytes dropped, reader ring full\n",
+			uartpd->dev_path, atomic_load(&uartpd->dropped));
+	}
+
+	spsc_ring_fini(&uartpd->ring);
+	close(uartpd->efd.fd);
 	close(uartpd->pfd.fd);
+	uartpd->is_open = false;
 
 	return 0;
 }
@@ -219,7 +447,72 @@ static int uart_debug_table(const char * const buffer, size_t len,
 }
 
 /**
- * \brief this function receives information from the UART device
+ * \brief Wait for the reader thread to commit bytes.
+ * \param pdata: UART private data.
+ * \param timeout_ms: Longest wait.
+ * \return 1 if the reader thread signaled, 0 on timeout, -1 on error.
+ */
+static int uart_wait_reader(uart_private_data * const pdata,
+			    int timeout_ms)
+{
+	uint64_t cnt;
+	int rc;
+
+	rc = poll(&pdata->efd, 1, timeout_ms);
+	if (-1 == rc) {
+		if (errno == EINTR)
+			return 0;
+
+		ERROR("Error while polling %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (!rc) {
+		return 0;
+	}
+
+	if ((read(pdata->efd.fd, &cnt, sizeof(cnt)) < 0) &&
+	    (errno != EAGAIN)) {
+		ERROR("Error while reading eventfd %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 1;
+}
+
+/**
+ * \brief Once the first byte arrived, wait for the ring to hold fill bytes
+ *	  or for the deadline, whichever comes first.
+ * \param pdata: UART private data.
+ * \param fill: Number of bytes wanted.
+ */
+static void uart_wait_fill(uart_private_data * const pdata, size_t fill)
+{
+	struct timespec now;
+	long long end_ms, left_ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	end_ms = now.tv_sec * 1000LL + now.tv_nsec / 1000000 +
+		 pdata->fill_deadline_ms;
+
+	while ((spsc_ring_count(&pdata->ring) < fill) &&
+	       !atomic_load(&pdata->reader_done)) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		left_ms = end_ms - (now.tv_sec * 1000LL +
+				    now.tv_nsec / 1000000);
+		if ((left_ms <= 0) ||
+		    (uart_wait_reader(pdata, (int) left_ms) < 0)) {
+			break;
+		}
+	}
+}
+
+/**
+ * \brief this function receives information from the UART device. The reader
+ *	  thread reads the device into the SPSC ring. Once the first byte
+ *	  arrived, this waits for the configured fill or for the deadline,
+ *	  whichever comes first, then copies up to fill bytes from the ring
+ *	  into the message.
  * \param obj: UART object reference.
  * \param msg: message object where data is going to be receive.
  */
@@ -227,14 +520,23 @@ static size_t uart_receive(processing_obj * const obj, message_obj * const msg)
 {
 	uart_obj * const uart = (uart_obj * const) obj;
 	uart_private_data * const pdata = (uart_private_data *) uart->pdata;
-	char ptr[UART_INTERNAL_BUF_LEN_MAX];
-	size_t readd, n = 0;
 	unsigned int retries = UART_MAX_POLL_RETRIES;
+	size_t fill = msg->total_len(msg);
+	size_t n;
 	int rc;
-	while (sizeof(ptr) - n) {
-		rc = poll(&pdata->pfd, 1, UART_TIMEOUT_MS);
+
+	if (!pdata->is_reading && uart_start_reader(pdata)) {
+		return -1;
+	}
+
+	while (!spsc_ring_count(&pdata->ring)) {
+		if (atomic_load(&pdata->reader_done)) {
+			WARNING("UART reader stopped\n");
+			return -1;
+		}
+
+		rc = uart_wait_reader(pdata, UART_TIMEOUT_MS);
 		if (-1 == rc) {
-			ERROR("Error while polling %s\n", strerror(errno));
 			return -1;
 		}
 
@@ -245,24 +547,75 @@ static size_t uart_receive(processing_obj * const obj, message_obj * const msg)
 			WARNING("UART timed out no data !\n");
 			return -1;
 		}
+	}
 
-		if (!(pdata->pfd.revents & POLLIN)) {
-			WARNING("Invalid event!\n");
-			return -1;
-		}
+	if (pdata->fill && (pdata->fill < fill)) {
+		fill = pdata->fill;
+	}
 
-		readd = read(pdata->pfd.fd, &ptr[n], sizeof(ptr) - n);
-		if (readd < 0) {
-			return -1;
-		}
-		n+=readd;
+	if (pdata->fill_deadline_ms) {
+		uart_wait_fill(pdata, fill);
 	}
 
-	msg->write(msg, ptr, n);
+	/* The bytes are copied once, from the ring to the message */
+	n = spsc_ring_read(&pdata->ring, msg->ptr(msg), fill);
+	msg->set_length(msg, n);
 
 	return n;
 }
 
+/**
+ * \brief Set the batching of the received bytes.
+ * \param uart: UART object.
+ * \param fill: Bytes a message is filled with, 0 for the whole message.
+ * \param deadline_ms: Longest wait for the fill once the first byte arrived,
+ *	  0 to send the bytes as soon as they arrive.
+ * \return 0 upon success, -1 otherwise.
+ */
+static int uart_set_fill(uart_obj * const uart, size_t fill,
+			 unsigned int deadline_ms)
+{
+	uart_private_data * const pdata = (uart_private_data *) uart->pdata;
+
+	pdata->fill = fill;
+	pdata->fill_deadline_ms = deadline_ms;
+	DEBUG("Fill %zu bytes, deadline %u ms\n", fill, deadline_ms);
+
+	return 0;
+}
+
+/**
+ * \brief Set the batching of the received bytes from the configuration,
+ *	  the values not configured are left unchanged.
+ * \param uart: UART object.
+ * \return 0 upon success, -1 otherwise.
+ */
+static int uart_set_fill_gbl_config(uart_obj * const uart)
+{
+	uart_private_data * const pdata = (uart_private_data *) uart->pdata;
+	size_t fill = pdata->fill;
+	unsigned int deadline_ms = pdata->fill_deadline_ms;
+	unsigned int value;
+	cfg_param param = {
+		.section = CFG_SECTION_UART_SWO,
+		.name = CFG_SECTION_UART_SWO_FILL,
+		.type = CONFIG_UNSIGNED_INT,
+	};
+
+	value = CONFIG_HELPER_GET_U32(&param);
+	if (param.found) {
+		fill = value;
+	}
+
+	param.name = CFG_SECTION_UART_SWO_FILL_DEADLINE;
+	value = CONFIG_HELPER_GET_U32(&param);
+	if (param.found) {
+		deadline_ms = value;
+	}
+
+	return uart_set_fill(uart, fill, deadline_ms);
+}
+
 int uart_init(uart_obj * const uart)
 {
 	processing_obj *proc_obj = (processing_obj *) uart;
@@ -276,11 +629,15 @@ int uart_init(uart_obj * const uart)
 	uart->uart_set_dev = uart_set_dev;
 	uart->uart_init_dev = uart_open;
 	uart->uart_fini_dev = uart_close;
+	uart->uart_set_fill = uart_set_fill;
+	uart->uart_set_fill_gbl_config = uart_set_fill_gbl_config;
+	uart_set_fill(uart, 0, UART_FILL_DEADLINE_MS);
 	if (processing_init(proc_obj)) {
 		goto processing_init_failed;
 	}
 
 	proc_obj->data_out = uart_receive;
+	proc_obj->name = "uart";
 	return 0;
 processing_init_failed:
 free_instance_failed:
@@ -0,0 +1,68 @@
+/*****************************************************************
+ * file: uart_baudrate.c
+ * author: Alexandre Malki <amalki@piap.pl>
+ * brief: Arbitrary UART baudrates with the Linux termios2 interface
+ *		(BOTHER). It is kept away from uart.c since the kernel's
+ *		struct termios from <asm/termbits.h> clashes with the one of
+ *		the C library <termios.h>. The driver rounds the rate to the
+ *		closest divisor it supports and reports the result, so the
+ *		rate read back is the one really applied.
+ *****************************************************************/
+#include <uart_baudrate.h>
+#include <debug.h>
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+int uart_baudrate_set(int fd, unsigned int baudrate)
+{
+	struct termios2 tio;
+
+	if (ioctl(fd, TCGETS2, &tio)) {
+		ERROR("error from TCGETS2: %s\n", strerror(errno));
+		return -1;
+	}
+
+	tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+	tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+	tio.c_ispeed = baudrate;
+	tio.c_ospeed = baudrate;
+
+	if (ioctl(fd, TCSETS2, &tio)) {
+		ERROR("error from TCSETS2: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int uart_baudrate_get(int fd, unsigned int * const baudrate)
+{
+	struct termios2 tio;
+
+	if (ioctl(fd, TCGETS2, &tio)) {
+		ERROR("error from TCGETS2: %s\n", strerror(errno));
+		return -1;
+	}
+
+	*baudrate = tio.c_ospeed;
+	return 0;
+}
+
+#else /* __linux__ */
+
+int uart_baudrate_set(int fd, unsigned int baudrate)
+{
+	return -1;
+}
+
+int uart_baudrate_get(int fd, unsigned int * const baudrate)
+{
+	return -1;
+}
+
+#endif /* __linux__ */